@@ -1,12 +1,19 @@
 #include "esp_camera.h"
+#include "img_converters.h"
+#include "driver/uart.h"
+#include "esp_heap_caps.h"
+#include "esp_sntp.h"
+#include "esp_pm.h"
 #include <WiFi.h>
-#include <HTTPClient.h>
 #include <WiFiClientSecure.h>
+#include <WebServer.h>
 #include <Wire.h>
 #include <Adafruit_SSD1306.h>
 #include <Adafruit_GFX.h>
 #include <time.h>
-#include <UniversalTelegramBot.h>
+#include <LittleFS.h>
+#include <UniversalTelegramBot.h>   // TELEGRAM_CERTIFICATE_ROOT
+#include <atomic>
 
 // =============================================
 // CONFIGURATION - UPDATE THESE VALUES
@@ -18,17 +25,28 @@ const char* password = "Logician";
 const char* serverURL = "https://web-production-23072.up.railway.app/upload";
 const char* serverTestURL = "https://web-production-23072.up.railway.app/test";
 
+// Upload hosts (kept open as HTTP/1.1 keep-alive TLS connections)
+// Point these at a local stand-in server to exercise the upload path off-device
+const char* serverHost = "web-production-23072.up.railway.app";
+const char* telegramHost = "api.telegram.org";
+const uint16_t httpsPort = 443;
+
 // Telegram Bot Configuration
 #define BOTtoken "8260428040:AAHopZu53sdpM5-gPxa9nL2-Y2d7tsnOcRI"
 #define CHAT_ID "5765390339"
+#define TELEGRAM_VERIFY_CERT true   // false to point telegramHost at server/mock_telegram.py
 
 // CAMERA ID - CHANGE THIS FOR EACH CAMERA
 const char* CAMERA_ID = "CAM001";
 
 // NTP Time Server Configuration
+// - SNTP runs in the background and never holds up boot; captures taken
+//   before the first sync get a "boot N +s" stamp that is replaced by the
+//   wall-clock time as soon as the clock is set
 const char* ntpServer = "pool.ntp.org";
 const long gmtOffset_sec = 3600;
 const int daylightOffset_sec = 0;
+#define TIME_RESYNC_INTERVAL 10800000UL    // ms between SNTP polls once synced (3 h)
 
 // =============================================
 // PIN DEFINITIONS
@@ -40,6 +58,348 @@ const int daylightOffset_sec = 0;
 #define CAMERA_INIT_RETRIES 5
 #define CAMERA_INIT_DELAY 2000
 
+// =============================================
+// CONNECTION SETTINGS
+// =============================================
+#define KEEPALIVE_IDLE_TIMEOUT 50000   // reopen sockets idle longer than this (server side drops them)
+#define HTTP_RESPONSE_TIMEOUT 15000
+#define CONNECTION_LOCK_TIMEOUT 20000
+#define HTTP_BODY_MAX 1024             // response body bytes kept (logging, Telegram updates)
+#define HTTP_LINE_MAX 256              // longer status/header lines are truncated
+#define HTTP_RX_CHUNK 256              // socket read size while parsing a response
+#define TLS_RECORD_SIZE 4096           // matches the mbedTLS outgoing record size (SSL_OUT_CONTENT_LEN)
+#define MULTIPART_BOUNDARY "----ESP32CAMBoundary"
+
+// =============================================
+// RESUMABLE UPLOAD SETTINGS
+// - server uploads go out in numbered chunks under an upload ID and
+//   resume from the server's acknowledged offset after a drop (protocol
+//   notes above postResumable(); server/upload_server.py implements it)
+// - a server that does not know the protocol gets the plain POST instead
+// =============================================
+#define RESUMABLE_UPLOADS true
+#define UPLOAD_PATH "/upload"
+#define UPLOAD_CHUNK_SIZE (16 * 1024)      // a multiple of TLS_RECORD_SIZE
+#define UPLOAD_RESUME_ATTEMPTS 6           // failed chunks/reconnects before giving up
+#define UPLOAD_RESUME_BACKOFF 250          // ms before a resume, times the failures so far
+
+// =============================================
+// REMOTE TRIGGER SETTINGS
+// - "/capture" in the bot chat (read by a getUpdates long-poll on its own
+//   keep-alive connection) or GET /capture on the local HTTP port queue a
+//   capture at once: no button, no cooldown
+// - command -> photo delivered latency goes into the "command" histogram
+// =============================================
+#define TELEGRAM_COMMANDS_ENABLED true
+#define TELEGRAM_POLL_TIMEOUT 10           // s the server holds a getUpdates; below HTTP_RESPONSE_TIMEOUT
+#define TELEGRAM_POLL_RETRY 5000           // ms after a failed poll
+#define TELEGRAM_POLL_TASK_STACK 12288     // TLS handshake needs a deep stack
+#define TELEGRAM_COMMAND_MAX_AGE 120       // s; older commands (sent while offline) are skipped
+#define TELEGRAM_POLL_MIN_BLOCK 49152      // largest free block to open the poll's TLS session: two HEAP_TLS_MIN_BLOCK
+#define LOCAL_API_ENABLED true
+#define LOCAL_API_PORT 80
+#define LOCAL_API_KEY ""                   // when set, requests need ?key=<value>
+#define LOCAL_API_POLL 20                  // ms between handleClient() calls
+#define LOCAL_API_TASK_STACK 4096
+
+// =============================================
+// TELEGRAM BATCH SETTINGS
+// - photos for Telegram are gathered and sent as one sendMediaGroup of
+//   up to TELEGRAM_BATCH_MAX, one request instead of one per plate
+// - latency-first sends whatever is waiting as soon as the previous
+//   request is done, so batches only form under load; throughput-first
+//   holds the first photo up to TELEGRAM_BATCH_WINDOW to fill a batch
+// =============================================
+#define BATCH_LATENCY_FIRST 0
+#define BATCH_THROUGHPUT_FIRST 1
+#define TELEGRAM_BATCHING true
+#define TELEGRAM_BATCH_POLICY BATCH_LATENCY_FIRST
+#define TELEGRAM_BATCH_MAX 10              // sendMediaGroup takes 2-10 photos
+#define TELEGRAM_BATCH_WINDOW 5000         // ms, throughput-first only
+
+// =============================================
+// FRAME DISPATCH SETTINGS
+// =============================================
+#define UPLOAD_TASK_STACK 12288        // TLS handshake needs a deep stack
+#define UPLOAD_TASK_PRIORITY 2
+#define DISPATCH_TIMEOUT 60000
+
+// =============================================
+// PIPELINE SETTINGS
+// - capture, burst scoring, dedup and crop run on the APP core; every
+//   network wait runs on the PRO core next to the WiFi stack
+// - the two sides are joined by a bounded lock-free queue of frame handles
+// =============================================
+#define CAPTURE_CORE 1
+#define NETWORK_CORE 0                 // the WiFi/lwIP tasks already live here
+#define PIPELINE_DEPTH 4               // captures waiting for or in upload
+#define FRAME_POOL_SIZE (PIPELINE_DEPTH + 2)  // plus the frame being captured and one late upload
+#define PIPELINE_FULL_POLL 10          // ms between checks while the queue is full
+#define NETWORK_TASK_STACK 8192
+#define BURST_TEST_MAX 20              // captures the "burst" command may request
+
+// =============================================
+// OFFLINE QUEUE SETTINGS
+// - captures that could not be delivered are kept on LittleFS and sent
+//   once the server / Telegram can be reached again
+// =============================================
+#define OFFLINE_QUEUE_ENABLED true
+#define OFFLINE_QUEUE_DIR "/queue"
+#define OFFLINE_QUEUE_MAX_RECORDS 50
+#define OFFLINE_QUEUE_MAX_BYTES (1024 * 1024)   // default partition table leaves ~1.4 MB
+#define OFFLINE_RETENTION_HOURS 72              // older captures are dropped (needs synced time)
+#define OFFLINE_DRAIN_INTERVAL 30000            // retry period while captures are waiting
+#define OFFLINE_DRAIN_BATCH 10                  // records sent per drain pass (one media group)
+#define OFFLINE_STORE_QUEUE_LEN 4               // captures waiting to be written
+#define OFFLINE_TASK_STACK 12288                // drains over TLS
+
+// =============================================
+// FRAME RING SETTINGS (pre-trigger capture)
+// =============================================
+#define FRAME_RING_ENABLED true
+#define FRAME_RING_SLOTS 8
+#define FRAME_RING_PSRAM_BUDGET (1536 * 1024)  // split evenly across the slots
+#define FRAME_RING_INTERVAL 100               // min ms between stored frames
+#define FRAME_RING_PRE_TRIGGER 500            // ms of history a trigger may use
+#define FRAME_RING_POST_TRIGGER 300           // max ms a trigger waits for a newer frame
+#define FRAME_RING_TASK_STACK 4096
+
+// =============================================
+// FAST BOOT SETTINGS
+// =============================================
+#define FAST_BOOT_ENABLED true            // overlap camera init, WiFi and server probe; skip boot pauses
+#define FAST_BOOT_POWER_CYCLE_DELAY 20    // ms per camera power-cycle step (500 in normal boot)
+#define FAST_BOOT_WIFI_TIMEOUT 10000
+#define BOOT_TIMELINE_MAX 16
+#define RTC_CACHE_MAGIC 0xCA3E0001
+
+// =============================================
+// EVENT LOOP SETTINGS
+// =============================================
+#define BUTTON_DEBOUNCE_MS 30
+#define HOLD_MESSAGE_DELAY 1000       // hold this long before the power-off countdown shows
+#define RESULT_DISPLAY_TIME 2000
+#define POWER_OFF_MESSAGE_TIME 2000
+#define POWER_OFF_CAMERA_WAIT 3000     // ms a running capture gets to finish before the camera is shut down
+#define APP_EVENT_QUEUE_LEN 16
+#define CAPTURE_REQUEST_QUEUE_LEN 8    // triggers waiting for the capture task
+#define CAPTURE_TASK_STACK 8192
+#define CAPTURE_TIMELINE_MAX 8         // stage marks kept per capture
+
+// =============================================
+// IDLE SLEEP SETTINGS
+// - with nothing to do the board light-sleeps: automatically (esp_pm) where
+//   the core allows it, otherwise the loop sleeps in timed slices; the
+//   button (GPIO 13) or serial input wakes it at once
+// - while idle the camera sensor is in standby, the frame ring is paused
+//   and the radio is in max modem sleep
+// - the CURRENT_* values are assumed typical ESP32-CAM + OLED figures, not
+//   measurements; they only feed the estimate in printPowerStats()
+// =============================================
+#define IDLE_SLEEP_ENABLED true
+#define IDLE_SLEEP_AFTER 10000          // ms of idle before the first sleep
+#define IDLE_CHECK_INTERVAL 1000        // loop wake-up while waiting to go idle
+#define IDLE_SLEEP_SLICE 1000           // max ms per light sleep, about 10 beacons of AP buffering
+#define IDLE_AWAKE_WINDOW 30            // ms awake after a timed wake for WiFi and the supervisor
+#define IDLE_SERIAL_AWAKE 30000         // stay awake this long after serial input woke the board
+#define IDLE_UART_WAKE_EDGES 3          // RX edges that wake; those characters are lost
+#define IDLE_AUTO_LIGHT_SLEEP true      // esp_pm light sleep (needs CONFIG_PM_ENABLE + tickless idle in the core)
+#define IDLE_PM_MAX_MHZ 240
+#define IDLE_PM_MIN_MHZ 80              // CPU clock between automatic sleeps; WiFi needs the 80 MHz APB
+#define IDLE_LISTEN_INTERVAL 10         // beacons the AP buffers for us in max modem sleep
+#define WAKE_LATENCY_BUDGET 300         // ms from button wake to camera ready
+#define CURRENT_ACTIVE_MA 160           // estimate, not measured
+#define CURRENT_IDLE_AWAKE_MA 45        // estimate, not measured
+#define CURRENT_LIGHT_SLEEP_MA 9        // estimate, not measured: mostly the OLED and the regulator
+
+// =============================================
+// SUPERVISOR SETTINGS
+// - WiFi, server and camera faults are retried in the background with
+//   exponential backoff instead of restarting the ESP32
+// =============================================
+#define SUPERVISOR_INTERVAL 500
+#define SUPERVISOR_TASK_STACK 12288    // the server probe runs TLS
+#define WIFI_CONNECT_TIMEOUT 10000     // an attempt that has not associated by then failed
+#define WIFI_BACKOFF_MIN 1000          // extra wait after a failed attempt, doubled each time
+#define WIFI_BACKOFF_MAX 60000
+#define SERVER_PROBE_MIN 5000          // re-probe period while the server is unreachable
+#define SERVER_PROBE_MAX 300000
+#define CAMERA_RETRY_MIN 1000
+#define CAMERA_RETRY_MAX 60000
+
+// =============================================
+// HEAP MONITOR SETTINGS
+// - the supervisor samples free internal RAM and its largest free block;
+//   TLS needs one large block per session, so a shrinking largest block
+//   is reported long before a handshake fails
+// =============================================
+#define HEAP_SAMPLE_INTERVAL 10000
+#define HEAP_TLS_MIN_BLOCK 24576       // mbedTLS input + output record buffers
+#define HEAP_TREND_SAMPLES 30          // samples per trend window (5 min)
+#define HEAP_TREND_WARN 3              // windows in a row with a smaller largest block
+#define HEAP_TREND_MARGIN 256          // B it has to be smaller by; less is allocation jitter
+
+// =============================================
+// PLATE CROP SETTINGS
+// - uploads a high-quality crop of the likely plate region plus a small
+//   thumbnail of the whole scene instead of the full frame
+// =============================================
+#define PLATE_CROP_ENABLED true
+#define PLATE_DETECT_SCALE JPG_SCALE_4X    // detector runs on a 1/4-scale luma plane
+#define PLATE_DETECT_SHIFT 2               // matches PLATE_DETECT_SCALE
+#define PLATE_EDGE_THRESHOLD 40            // luma step counted as a vertical edge
+#define PLATE_MIN_EDGE_DENSITY 18          // % of window pixels that must be edges
+#define PLATE_ASPECT 4                     // width : height of a plate window
+#define PLATE_CROP_MARGIN 50               // % of the window added around the crop
+#define PLATE_CROP_QUALITY 90              // fmt2jpg quality, higher is better
+#define PLATE_THUMB_QUALITY 30
+
+// Plate window widths searched, in 1/4-scale pixels
+const int plateWindowWidths[] = { 24, 32, 48, 64, 96 };
+
+// =============================================
+// EXPOSURE SETTINGS
+// - on-demand captures fire once frame brightness has stopped changing
+//   instead of after fixed delays
+// - day/night sensor profiles follow the measured light level
+// =============================================
+#define AE_SAMPLE_SCALE JPG_SCALE_8X      // brightness is measured on a 1/8-scale decode
+#define AE_SAMPLE_SHIFT 3                 // matches AE_SAMPLE_SCALE
+#define AE_SETTLE_DELTA 3                 // mean luma change (0-255) between frames counted as steady
+#define AE_SETTLE_FRAMES 2                // steady frame pairs needed
+#define AE_SETTLE_TIMEOUT 800             // take the latest frame after this many ms
+#define EXPOSURE_AUTO_PRESET true
+#define NIGHT_ENTER_LUMA 45               // AE out of range under the day preset
+#define DAY_ENTER_LUMA 80                 // and the night preset needs no more than
+#define DAY_ENTER_GAIN_X16 32             // 2x sensor gain (OV2640 gain register)
+#define DAY_ENTER_LUMA_NO_GAIN 170        // without a gain reading, only clear daylight
+
+// =============================================
+// SENSOR PROFILE SETTINGS
+// - every sensor_t setting the sketch uses, as one constexpr row per
+//   profile; a profile is applied in a single pass that only writes the
+//   values the driver's status cache says are different
+// - "day" and "night" follow the light level (EXPOSURE_AUTO_PRESET);
+//   "fast" freezes moving plates with a short fixed exposure and is picked
+//   with the "sensor" serial command, which also turns the auto switch off
+// =============================================
+enum SensorField {
+  SF_BRIGHTNESS,
+  SF_CONTRAST,
+  SF_SATURATION,
+  SF_WHITEBAL,
+  SF_AWB_GAIN,
+  SF_WB_MODE,
+  SF_EXPOSURE_CTRL,             // before SF_AEC_VALUE: a manual value needs AEC off first
+  SF_AEC_VALUE,
+  SF_AEC2,                      // DSP night mode, lets AEC stretch exposure across frames
+  SF_AE_LEVEL,
+  SF_GAIN_CTRL,
+  SF_AGC_GAIN,
+  SF_GAINCEILING,
+  SF_BPC,
+  SF_WPC,
+  SF_RAW_GMA,
+  SF_LENC,
+  SF_HMIRROR,
+  SF_VFLIP,
+  SF_DCW,
+  SF_COLORBAR,
+  SENSOR_FIELD_COUNT
+};
+
+#define SENSOR_ANY -32768                 // left as it is (e.g. the exposure value under AEC)
+
+struct SensorProfile {
+  const char* name;
+  int16_t values[SENSOR_FIELD_COUNT];     // indexed by SensorField
+};
+
+constexpr SensorProfile sensorProfiles[] = {
+  //          bri con sat awb awbg wbm aec  aec_value  aec2 ael agc agcg  gain ceiling     bpc wpc gma lenc hm vf dcw bar
+  { "day",   { 0,  0,  0,  1,  1,   0,  1,  SENSOR_ANY, 0,   0,  1,  0,  GAINCEILING_2X,  0,  1,  1,  1,   0, 0, 1,  0 } },
+  { "night", { 0,  0,  0,  1,  1,   0,  1,  SENSOR_ANY, 1,   1,  1,  0,  GAINCEILING_32X, 0,  1,  1,  1,   0, 0, 1,  0 } },
+  { "fast",  { 0,  1,  0,  1,  1,   0,  0,  120,        0,   0,  1,  0,  GAINCEILING_16X, 0,  1,  1,  1,   0, 0, 1,  0 } },
+};
+#define SENSOR_PROFILE_COUNT (int)(sizeof(sensorProfiles) / sizeof(sensorProfiles[0]))
+#define SENSOR_DAY 0
+#define SENSOR_NIGHT 1
+#define SENSOR_FAST 2
+
+// =============================================
+// BURST SETTINGS
+// - several frames around the trigger are scored for sharpness and only
+//   the sharpest one is uploaded
+// =============================================
+#define BURST_FRAMES 4                    // frames scored per capture, 1 disables
+#define FOCUS_SAMPLE_SCALE JPG_SCALE_4X   // Laplacian runs on a 1/4-scale luma plane
+#define FOCUS_SAMPLE_SHIFT 2              // matches FOCUS_SAMPLE_SCALE
+
+// =============================================
+// DUPLICATE SUPPRESSION SETTINGS
+// - a capture that looks like a recent one (dHash within
+//   DEDUP_MAX_DISTANCE bits and no cell more than DEDUP_MAX_CELL_DIFF
+//   brighter or darker) is reported as "duplicate of #N" instead of
+//   uploading the image again
+// - both limits come from host/bench_focus_dedup: re-triggers on the same
+//   scene stay within 5 bits and 19 levels, while a car leaving or another
+//   car parking in the same spot can be as close as 1 bit, so the hash
+//   alone cannot tell them apart; all but a small car of about the
+//   background's shade differ by 28 levels or more
+// =============================================
+#define DEDUP_ENABLED true
+#define DEDUP_HISTORY 8                   // recent capture hashes kept
+#define DEDUP_MAX_DISTANCE 6              // Hamming distance (of 64 bits) counted as the same scene
+#define DEDUP_MAX_CELL_DIFF 24            // largest cell luma change (after exposure offset) still the same scene
+#define DEDUP_WINDOW 300000               // only captures this recent (ms) can suppress a new one
+
+// =============================================
+// ADAPTIVE QUALITY SETTINGS
+// - frame size and JPEG quality follow the measured uplink so both uploads
+//   finish within TARGET_DELIVERY_MS
+// - profiles are ordered best first; the camera is initialized with the
+//   first one, so none may be larger than it (the JPEG buffer is sized then)
+// =============================================
+#define ADAPTIVE_QUALITY_ENABLED true
+#define TARGET_DELIVERY_MS 4000            // dispatch budget for both uploads
+#define UPLINK_EWMA_WEIGHT 30              // % weight of the newest sample
+#define PROFILE_STEP_UP_MARGIN 75          // step up only if predicted <= this % of target
+#define UPLOAD_OVERHEAD_MS 400             // request and response time besides the bytes
+
+struct CaptureProfile {
+  const char* name;
+  framesize_t frameSize;
+  int quality;                  // esp_camera quality, lower is better
+  size_t expectedBytes;         // typical JPEG size until one has been measured
+};
+
+const CaptureProfile captureProfiles[] = {
+  { "SVGA q10", FRAMESIZE_SVGA, 10, 60 * 1024 },
+  { "SVGA q14", FRAMESIZE_SVGA, 14, 40 * 1024 },
+  { "VGA q12",  FRAMESIZE_VGA,  12, 30 * 1024 },
+  { "VGA q18",  FRAMESIZE_VGA,  18, 18 * 1024 },
+  { "CIF q15",  FRAMESIZE_CIF,  15, 12 * 1024 },
+  { "QVGA q15", FRAMESIZE_QVGA, 15,  7 * 1024 },
+};
+#define CAPTURE_PROFILE_COUNT (int)(sizeof(captureProfiles) / sizeof(captureProfiles[0]))
+
+// =============================================
+// METRICS SETTINGS
+// - fixed-size latency histograms per hot stage plus counters, printed
+//   with the "metrics" serial command and sent along with every upload
+// =============================================
+#define METRICS_IN_UPLOADS true
+#define METRICS_RECORD_MAX 512             // compact record sent as the "metrics" form field
+#define SERIAL_COMMAND_TASK_STACK 4096
+#define SERIAL_COMMAND_MAX 32
+
+// Histogram bucket upper bounds in ms; one more bucket catches the rest
+const uint16_t latencyBucketBounds[] = {
+  1, 2, 3, 5, 7, 10, 15, 20, 30, 50, 70, 100, 150, 200, 300, 500, 700,
+  1000, 1500, 2000, 3000, 5000, 7000, 10000, 15000, 20000, 30000, 60000
+};
+#define LATENCY_BUCKETS (int)(sizeof(latencyBucketBounds) / sizeof(latencyBucketBounds[0]) + 1)
+
 // =============================================
 // OLED DISPLAY SETTINGS
 // =============================================
@@ -47,8 +407,16 @@ const int daylightOffset_sec = 0;
 #define SCREEN_HEIGHT 64
 #define OLED_RESET -1
 #define SCREEN_ADDRESS 0x3C
+#define DISPLAY_LINE_LEN 21          // characters per line at text size 1
+#define DISPLAY_I2C_CHUNK 64         // data bytes per I2C transaction
+#define DISPLAY_SPEED_PROBES 16      // clean writes needed to accept a bus speed
+#define DISPLAY_TASK_STACK 4096
+#define DISPLAY_VERBOSE false        // log bytes pushed for every screen refresh
 Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 
+// Tried fastest first; the panel must ACK every probe at a speed to get it
+const uint32_t displayBusSpeeds[] = { 800000, 400000, 100000, 50000 };
+
 // =============================================
 // ESP32-CAM AI THINKER PIN DEFINITIONS
 // =============================================
@@ -73,19 +441,444 @@ Adafruit_SSD1306 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire, OLED_RESET);
 // SYSTEM VARIABLES
 // =============================================
 WiFiClientSecure clientTCP;
-UniversalTelegramBot bot(BOTtoken, clientTCP);
+WiFiClientSecure serverClient;
+WiFiClientSecure telegramPollClient;
+
+// One persistent TLS connection per upload host
+struct HostConnection {
+  const char* name;
+  WiFiClientSecure* client;
+  SemaphoreHandle_t lock = NULL;
+  unsigned long lastUsed = 0;
+  bool reused = false;          // current request runs on a reused socket
+  uint32_t handshakes = 0;
+  uint32_t handshakeFailures = 0;
+  uint32_t reuses = 0;
+  unsigned long handshakeTimeTotal = 0;
+  unsigned long handshakeTimeMax = 0;
+  uint8_t record[TLS_RECORD_SIZE] = {};  // request staging buffer, used under lock
+  bool quiet = false;           // no log line per reuse (the long-poll reuses every few seconds)
+};
+
+HostConnection telegramConn = { "Telegram", &clientTCP };
+HostConnection serverConn = { "Server", &serverClient };
+HostConnection telegramPollConn = { "Telegram poll", &telegramPollClient };
+
+// Resumable server uploads
+uint32_t uploadIdSalt = 0;
+uint32_t uploadSequence = 0;
+bool resumableServer = RESUMABLE_UPLOADS;   // cleared when the server does not speak it
+
+// Incremental HTTP/1.1 response parser; lives on the caller's stack
+enum HttpStage {
+  HTTP_STATUS_LINE,
+  HTTP_HEADERS,
+  HTTP_BODY,                    // Content-Length body
+  HTTP_CHUNK_SIZE,
+  HTTP_CHUNK_DATA,
+  HTTP_CHUNK_END,               // CRLF after a chunk
+  HTTP_TRAILERS,
+  HTTP_BODY_UNTIL_CLOSE,        // no framing, body ends when the peer closes
+  HTTP_DONE,
+  HTTP_FAILED
+};
+
+struct HttpResponse {
+  HttpStage stage;
+  int status;                   // -1 until the status line is parsed
+  bool keepAlive;
+  bool chunked;
+  long remaining;               // Content-Length or bytes left in the chunk, -1 = unknown
+  char line[HTTP_LINE_MAX];
+  size_t lineLen;
+  char body[HTTP_BODY_MAX + 1]; // start of the body, NUL terminated
+  size_t bodyLen;
+  uint8_t rx[HTTP_RX_CHUNK];    // bytes read from the socket but not parsed yet
+  size_t rxPos;
+  size_t rxLen;
+  long uploadOffset;            // Upload-Offset header, -1 if absent
+};
+
+// One stored JPEG in the PSRAM frame ring
+struct RingSlot {
+  uint8_t* buf;
+  size_t len;
+  size_t width;
+  size_t height;
+  unsigned long capturedAt;     // millis() at frame capture
+  uint32_t sequence;
+  int refs;                     // readers holding the slot, -1 while being written
+};
+
+RingSlot frameRing[FRAME_RING_SLOTS];
+size_t frameRingSlotSize = 0;
+int frameRingNext = 0;
+uint32_t frameRingSequence = 0;
+uint32_t ringFramesStored = 0;
+uint32_t ringFramesDropped = 0;   // no free slot, or frame larger than a slot
+uint32_t ringFramesOversize = 0;
+bool frameRingActive = false;
+volatile bool frameRingRunning = false;
+volatile bool frameRingStopped = true;
+portMUX_TYPE frameRingLock = portMUX_INITIALIZER_UNLOCKED;
+
+// One JPEG shared read-only by the upload tasks
+struct SharedFrame {
+  const uint8_t* buf;
+  size_t len;
+  size_t width;
+  size_t height;
+  camera_fb_t* fb;              // returned to the camera driver on last release
+  RingSlot* slot;               // or handed back to the frame ring
+  uint8_t* copyBuf;             // or a burst winner copied out of the framebuffer, freed
+  uint8_t* cropBuf;             // plate crop and scene thumbnail, freed on last release
+  size_t cropLen;
+  uint8_t* thumbBuf;
+  size_t thumbLen;
+  int refs;
+  char timestamp[32];
+  SemaphoreHandle_t done;       // given once by every consumer that finishes
+  bool pooled;                  // from framePool, otherwise from the heap
+  bool serverOk;
+  bool telegramOk;
+  unsigned long serverTime;
+  unsigned long telegramTime;
+  size_t serverBytes;           // image bytes each consumer sent
+  size_t telegramBytes;
+  int profile;                  // capture profile active when the frame was taken
+  int captureNumber;
+  time_t capturedAt;            // epoch, 0 if the clock was not synced yet
+  int64_t capturedUs;           // esp_timer time of the capture
+};
+
+portMUX_TYPE frameRefLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Frames and their semaphores are reused instead of allocated per capture;
+// the upload workers take them from fixed-length queues
+SharedFrame framePool[FRAME_POOL_SIZE];
+bool framePoolUsed[FRAME_POOL_SIZE];
+uint32_t framePoolFallbacks = 0;   // pool empty, frame taken from the heap
+QueueHandle_t serverUploadQueue = NULL;
+QueueHandle_t telegramUploadQueue = NULL;
+
+// Sensor profile and the brightness of the last capture; changed under cameraLock
+int activeSensorProfile = SENSOR_DAY;
+bool sensorProfileAuto = EXPOSURE_AUTO_PRESET;   // day/night follow the light level
+unsigned long sensorApplyUsLast = 0;
+int sensorWritesLast = 0;
+int sensorSkippedLast = 0;
+uint32_t sensorProfileSwitches = 0;
+int lastFrameLuma = -1;
+uint8_t* aeSampleBuf = NULL;
+size_t aeSampleSize = 0;
+uint8_t* focusSampleBuf = NULL;
+size_t focusSampleSize = 0;
+
+// Perceptual hashes of recent uploaded captures; capture task only
+struct CaptureHash {
+  uint64_t hash;
+  uint8_t cells[8][9];          // mean luma of the cells the hash compares
+  int captureNumber;
+  unsigned long lastSeen;       // refreshed by every duplicate of it
+};
+
+CaptureHash captureHashes[DEDUP_HISTORY];
+int captureHashNext = 0;
+
+// Uplink estimate and capture profile; only touched by the capture task
+int activeProfile = 0;
+float uplinkBytesPerMs = 0;                              // EWMA, 0 until measured
+uint32_t uplinkSamples = 0;
+size_t profileSentBytes[CAPTURE_PROFILE_COUNT] = {};     // EWMA per dispatch, 0 until measured
+
+// WiFi association and last NTP sync, kept in RTC memory across deep sleep
+struct RtcBootCache {
+  uint32_t magic;
+  uint8_t bssid[6];
+  int32_t channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns;
+};
+
+RTC_DATA_ATTR RtcBootCache rtcCache;
+RTC_DATA_ATTR time_t rtcLastTimeSync = 0;
+RTC_DATA_ATTR uint32_t rtcBootCount = 0;    // tells provisional capture stamps of different boots apart
+
+struct BootPhase {
+  const char* name;
+  unsigned long at;
+};
+
+BootPhase bootTimeline[BOOT_TIMELINE_MAX];
+int bootPhaseCount = 0;
+bool firstCaptureLogged = false;
+volatile bool serverProbeDone = false;
+portMUX_TYPE bootTimelineLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Stage marks of the capture in progress; only touched by the capture task
+BootPhase captureTimeline[CAPTURE_TIMELINE_MAX];
+int capturePhaseCount = 0;
+
+// Offline queue record: this header, then the image, then the thumbnail
+#define OFFLINE_RECORD_MAGIC 0x51524332  // "QRC2"
+#define OFFLINE_TO_SERVER 0x01
+#define OFFLINE_TO_TELEGRAM 0x02
+
+struct OfflineRecordHeader {
+  uint32_t magic;
+  uint32_t pending;             // OFFLINE_TO_* targets still to deliver
+  uint32_t captureNumber;
+  time_t capturedAt;            // epoch, 0 if the clock was not synced
+  int64_t capturedUs;           // esp_timer time, to correct capturedAt after a sync
+  uint32_t bootId;              // rtcBootCount of the capture; capturedUs is only valid in that boot
+  char timestamp[32];
+  uint32_t imageLen;
+  uint32_t thumbLen;
+};
+
+// A capture copied out of its frame, on its way to flash (or to a
+// Telegram batch, which hands it to flash if the batch fails)
+struct OfflineCapture {
+  OfflineRecordHeader header;
+  uint8_t* data;                // PSRAM copy of image + thumbnail
+  unsigned long queuedAt;
+};
+
+QueueHandle_t offlineQueue = NULL;      // OfflineCapture*, NULL asks for a drain
+bool offlineQueueActive = false;
+volatile int offlineRecordCount = 0;    // written by the offline task only
+size_t offlineQueueBytes = 0;
+uint32_t nextOfflineSequence = 1;
+uint32_t offlineStored = 0;
+uint32_t offlineDelivered = 0;
+uint32_t offlineDropped = 0;
+
+// Latency histograms and counters; recorded from several tasks under metricsLock
+enum MetricStage {
+  STAGE_CAMERA_INIT,
+  STAGE_FRAME_GRAB,
+  STAGE_TLS_CONNECT,
+  STAGE_REQUEST_WRITE,
+  STAGE_FIRST_BYTE,             // request written -> status line received
+  STAGE_DISPLAY_UPDATE,
+  STAGE_DISPATCH,
+  STAGE_WAKE,                   // light-sleep button wake -> camera ready
+  STAGE_COMMAND,                // remote command received -> photo delivered
+  STAGE_TELEGRAM_BATCH,         // photo handed to the Telegram batch -> batch sent
+  STAGE_SENSOR_PROFILE,         // applying a sensor profile
+  METRIC_STAGE_COUNT
+};
+
+const char* metricStageNames[METRIC_STAGE_COUNT] = {
+  "cam_init", "grab", "tls", "write", "ttfb", "display", "dispatch", "wake", "command", "tg_batch", "sensor"
+};
+
+struct LatencyHistogram {
+  uint32_t counts[LATENCY_BUCKETS];
+  uint32_t total;
+  uint32_t maxMs;
+};
+
+struct MetricCounters {
+  uint32_t captures;
+  uint32_t captureFailures;
+  uint32_t uploads;
+  uint32_t uploadFailures;
+  uint32_t uploadRetries;
+  uint32_t bytesSent;
+  uint32_t duplicates;          // captures sent as "duplicate of #N"
+  uint32_t duplicateBytes;      // image bytes not uploaded because of that
+  uint32_t resentBytes;         // server upload body bytes sent more than once
+};
+
+LatencyHistogram stageHistograms[METRIC_STAGE_COUNT];
+MetricCounters metricCounters;
+portMUX_TYPE metricsLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Faults handled by the supervisor task
+enum FaultType {
+  FAULT_WIFI,
+  FAULT_SERVER,
+  FAULT_CAMERA,
+  FAULT_TYPE_COUNT
+};
+
+struct FaultState {
+  const char* name;
+  bool active = false;
+  unsigned long since = 0;
+  unsigned long nextAttempt = 0;
+  unsigned long backoff = 0;
+  uint32_t attempts = 0;        // recovery attempts for the current fault
+  uint32_t occurrences = 0;
+  uint32_t recoveries = 0;
+  unsigned long recoveryTimeTotal = 0;
+  unsigned long recoveryTimeMax = 0;
+};
+
+FaultState faults[FAULT_TYPE_COUNT] = { { "WiFi" }, { "Server" }, { "Camera" } };
+volatile bool cameraFaultReported = false;  // set by setup / the capture task
+SemaphoreHandle_t cameraLock = NULL;         // held by a capture or a camera re-init
+TaskHandle_t supervisorTaskHandle = NULL;
+
+// Idle sleep; idleMode* is loop-only, cameraParked is under cameraLock
+bool idleModeActive = false;
+unsigned long idleSince = 0;
+unsigned long serialAwakeUntil = 0;
+bool autoLightSleep = false;                 // esp_pm light-sleeps the idle loop; idleWakeISR has the button
+bool autoLightSleepSupported = IDLE_AUTO_LIGHT_SLEEP;  // cleared when esp_pm_configure() refuses
+volatile int64_t idleWakeAt = 0;             // esp_timer time idleWakeISR fired
+bool cameraParked = false;
+bool ringParked = false;                     // the frame ring was running when parked
+bool cameraStandbyAllowed = true;            // cleared if waking it blows the budget
+volatile bool offlineTaskBusy = false;
+
+struct PowerStats {
+  int64_t idleModeStart;        // esp_timer us
+  int64_t idleModeUs;           // closed idle periods, light sleep included
+  int64_t lightSleepUs;
+  uint32_t sleeps;
+  uint32_t buttonWakes;
+  uint32_t serialWakes;
+  uint32_t timerWakes;
+};
+
+PowerStats powerStats = {};
+
+// Button / capture / upload flow
+enum AppState {
+  STATE_IDLE,
+  STATE_PRESSED,          // released: capture; held BUTTON_HOLD_TIME: power off
+  STATE_CAPTURING,
+  STATE_UPLOADING,        // frame handed to the network task; button re-armed
+  STATE_SHOW_RESULT,
+  STATE_POWERING_OFF
+};
+
+enum AppEventType {
+  EVT_BUTTON_EDGE,        // from the button ISR
+  EVT_UPLOAD_STARTED,     // from the capture task: frame queued for upload
+  EVT_CAPTURE_DONE,       // from the network task, or the capture task on failure
+  EVT_HEALTH_CHANGED,     // from the supervisor: a fault was raised or recovered
+  EVT_REMOTE_TRIGGER,     // from the Telegram poll / local API: a capture was queued
+  EVT_IDLE_WAKE           // from idleWakeISR: the button woke an automatic light sleep
+};
+
+// What asked for a capture
+enum CaptureTrigger {
+  TRIGGER_BUTTON,
+  TRIGGER_BURST,
+  TRIGGER_TELEGRAM,
+  TRIGGER_HTTP
+};
+
+const char* captureTriggerNames[] = { "button", "burst", "Telegram", "HTTP" };
+
+struct CaptureRequest {
+  uint8_t trigger;
+  unsigned long at;
+};
+
+struct CaptureResult {
+  bool captured;
+  bool serverAttempted;
+  bool serverOk;
+  bool telegramOk;
+  bool telegramBatched;         // handed to the Telegram batch, result not known yet
+  bool queued;                  // kept in the offline queue for a later retry
+  int duplicateOf;              // capture number this one repeated, 0 if uploaded
+  int captureNumber;
+  size_t len;
+  uint8_t trigger;              // CaptureTrigger
+  unsigned long requestedAt;    // when the trigger was queued
+};
+
+struct AppEvent {
+  uint8_t type;
+  unsigned long at;
+  CaptureResult result;
+};
+
+// One capture handed from the capture task to the network task
+struct PipelineJob {
+  SharedFrame* frame;           // NULL for a duplicate event
+  CaptureResult result;
+  char timestamp[32];
+  time_t capturedAt;            // as in SharedFrame, kept for duplicate events
+  int64_t capturedUs;
+  int distance;                 // dHash distance of a duplicate
+  unsigned long triggerTime;
+};
+
+// Single producer (capture task), single consumer (network task): each
+// index is only written by one side, and the release store of head
+// publishes the job written before it
+PipelineJob pipelineJobs[PIPELINE_DEPTH];
+std::atomic<uint32_t> pipelineHead(0);
+std::atomic<uint32_t> pipelineTail(0);
+TaskHandle_t networkTaskHandle = NULL;
+volatile bool captureTaskBusy = false;
+volatile bool networkTaskBusy = false;
+uint32_t pipelineMaxDepth = 0;
+unsigned long pipelineFullWaitMs = 0;     // capture task time spent on a full queue
+
+// "burst" serial test: back-to-back captures through the pipeline
+struct BurstTest {
+  volatile bool running;
+  int requested;
+  volatile int captured;        // queued by the capture task
+  volatile int finished;        // delivered (or given up) by the network task
+  unsigned long start;
+  volatile unsigned long lastQueued;
+  volatile uint32_t maxDepth;
+};
+
+BurstTest burstTest = {};
+
+QueueHandle_t appEvents = NULL;
+QueueHandle_t captureRequests = NULL;        // CaptureRequest, consumed by the capture task
+TaskHandle_t captureTaskHandle = NULL;
+AppState appState = STATE_IDLE;
+bool stateDeadlineActive = false;
+unsigned long stateDeadline = 0;
+bool debouncePending = false;
+unsigned long debounceDeadline = 0;
+unsigned long debounceEdgeTime = 0;
+bool buttonStable = false;
+unsigned long pressStartTime = 0;
+bool pressSkipsCapture = false;
+volatile unsigned long lastButtonEdge = 0;
+
+// OLED rendering task
+struct DisplayMessage {
+  char lines[3][DISPLAY_LINE_LEN + 1];
+  bool blank;
+};
+
+QueueHandle_t displayQueue = NULL;         // length 1: newer messages replace unrendered ones
+SemaphoreHandle_t displayFlushed = NULL;
+uint8_t displayShadow[SCREEN_WIDTH * SCREEN_HEIGHT / 8];   // what the panel currently shows
+uint32_t displayBusSpeed = 0;
+uint32_t displayUpdates = 0;
+uint32_t displaySkipped = 0;
+uint32_t displayBytesLast = 0;
+uint32_t displayBytesTotal = 0;
+volatile bool displayBusy = false;         // a render is on the I2C bus
 
-bool buttonPressed = false;
-bool lastButtonState = false;
 unsigned long lastCaptureTime = 0;
-unsigned long buttonPressStartTime = 0;
-bool buttonHoldDetected = false;
 const unsigned long CAPTURE_COOLDOWN = 3000;
-const unsigned long CAPTURE_DELAY = 5000;
 const unsigned long BUTTON_HOLD_TIME = 5000;
 int captureCount = 0;
+unsigned long lastCommandLatency = 0;       // last remote command -> photo delivered, ms
 bool systemInitialized = false;
-bool timeInitialized = false;
+volatile bool poweringOff = false;          // no new captures; the remote trigger tasks end
+volatile bool timeInitialized = false;      // set by the SNTP callback or from the RTC
+bool timeSyncStarted = false;
+uint32_t timeSyncs = 0;
+unsigned long lastTimeSyncMs = 0;
+uint32_t timestampsCorrected = 0;
 bool serverReachable = false;
 bool systemError = false;
 bool displayAvailable = false;
@@ -93,25 +886,100 @@ bool displayAvailable = false;
 // =============================================
 // FUNCTION DECLARATIONS
 // =============================================
-void displayMessage(String line1, String line2 = "", String line3 = "");
+void displayMessage(const char* line1, const char* line2 = "", const char* line3 = "");
+void displayBlank();
+uint32_t selectDisplayBusSpeed();
+void displayTask(void* param);
 void initializePins();
 bool initializeDisplay();
 bool connectToWiFi();
 void initializeTime();
 bool testServerConnection();
-void captureAndProcessImage();
-bool uploadImageToServer(uint8_t* imageData, size_t imageLen, String timestamp);
-bool sendPhotoToTelegram(camera_fb_t * fb);
+struct PipelineJob;
+PipelineJob captureAndProcessImage(const CaptureRequest &request);
+bool requestCapture(CaptureTrigger trigger, TickType_t wait);
+void initializeRemoteTriggers();
+void printRemoteTriggerStats();
+void queueForNetwork(PipelineJob &job);
+void finishCapture(PipelineJob &job);
+void startBurstTest(int count);
+void networkTask(void* param);
+void initializeEventLoop();
+void handleAppEvent(const AppEvent &event);
+void runAppTimers(unsigned long now);
+bool uploadImageToServer(const uint8_t* imageData, size_t imageLen, const char* timestamp,
+                         const uint8_t* thumbData = NULL, size_t thumbLen = 0);
+bool sendPhotoToTelegram(const uint8_t* imageData, size_t imageLen, const char* caption = NULL);
+bool sendTelegramBatch(OfflineCapture* const* captures, int count);
+void formatPhotoCaption(char* out, size_t len, int captureNumber, const char* timestamp);
+bool sendTelegramText(const char* text);
+bool postDuplicateToServer(int captureNumber, int duplicateOf, int distance, const char* timestamp);
+SharedFrame* newSharedFrame(const uint8_t* buf, size_t len, size_t width, size_t height);
+void releaseFrame(SharedFrame* frame);
+bool dispatchFrame(SharedFrame* frame, const char* timestamp, bool toServer, bool &telegramBatched,
+                   bool &serverOk, bool &telegramOk);
+bool initializeOfflineQueue();
+bool queueOfflineCapture(SharedFrame* frame, uint32_t pending);
+void kickOfflineDrain();
+void initializeTelegramBatching();
+bool queueTelegramBatch(SharedFrame* frame);
+void printTelegramBatchStats();
+bool initializeFrameRing();
+void stopFrameRing();
+void releaseRingSlot(RingSlot* slot);
+void initializeConnections();
+WiFiClientSecure* acquireConnection(HostConnection &conn, const char* host);
+void releaseConnection(HostConnection &conn, bool keepAlive);
+struct MultipartPart;
+bool sendMultipartRequest(HostConnection &conn, const char* host, const char* path,
+                          const MultipartPart* parts, int count, size_t* bodySent = NULL);
+void httpParseReset(HttpResponse &response);
+void httpResponseBegin(HttpResponse &response);
+int readHttpResponse(WiFiClientSecure &client, HttpResponse &response, bool untilStatus);
+void printConnectionStats(HostConnection &conn);
 void powerOffSystem();
-void checkButtonForRestart();
+void runIdleSleep(unsigned long now);
+void handleButtonWake(int64_t wokeAt);
+void setIdleListenInterval();
+void resumeParkedCamera();
+void printPowerStats();
+void initializeSupervisor();
+void printSupervisorStats();
+void bootMark(const char* phase);
+void bootPause(unsigned long ms);
+void printBootTimeline();
+void captureMark(const char* stage);
+void printCaptureTimeline();
+void startWiFi(bool useCache);
+void saveWiFiCache();
+bool finishFastWiFi();
+void startServerProbe();
+void recordUplinkSample(SharedFrame* frame, bool telegramBatched);
+void recordLatency(MetricStage stage, unsigned long ms);
+void countMetric(uint32_t &counter, uint32_t amount = 1);
+size_t formatMetricsRecord(char* out, size_t len);
+void initializeSerialCommands();
+void adaptCaptureProfile();
+int applySensorProfile(sensor_t* s, int profile);
+void handleSensorCommand(const char* arg);
+void formatCaptureTime(char* out, size_t len, time_t capturedAt, int64_t capturedUs);
+const char* frameTimestamp(SharedFrame* frame, char* buf, size_t len);
+time_t wallClockAt(int64_t timerUs);
+bool correctCaptureTime(OfflineRecordHeader &header);
+void printTimeStats();
+void initializeUploadWorkers();
+void sampleHeap(unsigned long now);
+void printHeapStats();
 
 // =============================================
 // CAMERA INITIALIZATION (SAFER VERSION)
 // - 10s delay BEFORE esp_camera_init()
 // - uses fb_count = 1 when PSRAM present to reduce camera task pressure
+//   (2 when the frame ring streams frames continuously)
 // =============================================
 bool initializeCamera() {
   Serial.println("Starting camera init sequence...");
+  unsigned long initStart = millis();
 
   // Check PSRAM early
   if (!psramFound()) {
@@ -122,21 +990,25 @@ bool initializeCamera() {
 
   // Power cycle camera before initialization
   if (PWDN_GPIO_NUM != -1) {
+    unsigned long powerCycleDelay = FAST_BOOT_ENABLED ? FAST_BOOT_POWER_CYCLE_DELAY : 500;
     pinMode(PWDN_GPIO_NUM, OUTPUT);
     digitalWrite(PWDN_GPIO_NUM, 1); // power down
-    delay(500);
+    delay(powerCycleDelay);
     digitalWrite(PWDN_GPIO_NUM, 0); // power up
-    delay(500);
+    delay(powerCycleDelay);
   }
 
   // --- IMPORTANT: wait BEFORE starting the camera driver ---
-  Serial.println("⏳ Waiting 10 seconds BEFORE esp_camera_init() to reduce cam_task stack pressure...");
-  if (displayAvailable) {
-    displayMessage("CAMERA INIT", "Delaying 10s before init");
-  }
-  for (int i = 0; i < 100; ++i) {
-    delay(100); // total 10s
-    yield();    // let other tasks run
+  // (fast start skips this; WiFi association runs meanwhile instead)
+  if (!FAST_BOOT_ENABLED) {
+    Serial.println("⏳ Waiting 10 seconds BEFORE esp_camera_init() to reduce cam_task stack pressure...");
+    if (displayAvailable) {
+      displayMessage("CAMERA INIT", "Delaying 10s before init");
+    }
+    for (int i = 0; i < 100; ++i) {
+      delay(100); // total 10s
+      yield();    // let other tasks run
+    }
   }
 
   camera_config_t config;
@@ -167,7 +1039,7 @@ bool initializeCamera() {
   if (psramFound()) {
     config.frame_size = FRAMESIZE_SVGA;
     config.jpeg_quality = 10;
-    config.fb_count = 1; // reduced to 1 for stability
+    config.fb_count = FRAME_RING_ENABLED ? 2 : 1; // reduced to 1 for stability unless the ring streams
     config.fb_location = CAMERA_FB_IN_PSRAM;
   } else {
     config.frame_size = FRAMESIZE_QVGA;
@@ -180,7 +1052,11 @@ bool initializeCamera() {
   esp_err_t err = ESP_FAIL;
   for (int attempt = 1; attempt <= CAMERA_INIT_RETRIES; attempt++) {
     Serial.printf("🎥 Camera init attempt %d/%d...\n", attempt, CAMERA_INIT_RETRIES);
-    if (displayAvailable) displayMessage("CAMERA INIT", String("Attempt ") + String(attempt));
+    if (displayAvailable) {
+      char line[DISPLAY_LINE_LEN + 1];
+      snprintf(line, sizeof(line), "Attempt %d", attempt);
+      displayMessage("CAMERA INIT", line);
+    }
 
     err = esp_camera_init(&config);
     if (err == ESP_OK) {
@@ -206,31 +1082,15 @@ bool initializeCamera() {
     return false;
   }
 
-  s->set_framesize(s, FRAMESIZE_SVGA);
-  s->set_quality(s, 10);
-  s->set_brightness(s, 0);
-  s->set_contrast(s, 0);
-  s->set_saturation(s, 0);
-  s->set_whitebal(s, 1);
-  s->set_awb_gain(s, 1);
-  s->set_wb_mode(s, 0);
-  s->set_exposure_ctrl(s, 1);
-  s->set_aec2(s, 0);
-  s->set_ae_level(s, 0);
-  s->set_aec_value(s, 300);
-  s->set_gain_ctrl(s, 1);
-  s->set_agc_gain(s, 0);
-  s->set_gainceiling(s, (gainceiling_t)0);
-  s->set_bpc(s, 0);
-  s->set_wpc(s, 1);
-  s->set_raw_gma(s, 1);
-  s->set_lenc(s, 1);
-  s->set_hmirror(s, 0);
-  s->set_vflip(s, 0);
-  s->set_dcw(s, 1);
-  s->set_colorbar(s, 0);
+  // camera_config_t already set the first profile's size and quality; a
+  // re-init after adaptive quality stepped down has to set them again
+  const CaptureProfile &profile = captureProfiles[activeProfile];
+  if (s->status.framesize != profile.frameSize) s->set_framesize(s, profile.frameSize);
+  if (s->status.quality != profile.quality) s->set_quality(s, profile.quality);
+  applySensorProfile(s, activeSensorProfile);
 
   Serial.println("✓ Camera configured and ready");
+  recordLatency(STAGE_CAMERA_INIT, millis() - initStart);
   if (displayAvailable) displayMessage("CAMERA READY", "Initialized");
 
   return true;
@@ -241,7 +1101,8 @@ bool initializeCamera() {
 // =============================================
 void setup() {
   Serial.begin(115200);
-  delay(1000);
+  bootPause(1000);
+  rtcBootCount++;
 
   esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
 
@@ -256,156 +1117,423 @@ void setup() {
     Serial.println("Status: COLD BOOT");
   }
 
+  if (FAST_BOOT_ENABLED) Serial.println("Boot: FAST START");
   Serial.println("=================================");
+  bootMark("serial");
+  initializeSerialCommands();
 
   initializePins();
+  initializeConnections();  // the fast-start server probe uses the server connection
+
+  // fast start: association and the server probe run while the camera initializes
+  if (FAST_BOOT_ENABLED) {
+    startWiFi(true);
+    startServerProbe();
+    bootMark("wifi started");
+  }
 
   delay(200);
   displayAvailable = initializeDisplay();
   if (!displayAvailable) {
     Serial.println("⚠️ OLED initialization failed - continuing without display");
   }
+  bootMark("display");
 
   if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0 && displayAvailable) {
     displayMessage("WAKING UP...", "System starting");
-    delay(1500);
+    bootPause(1500);
   }
 
-  displayMessage("System Starting...", "Camera: " + String(CAMERA_ID), "Initializing...");
+  char cameraLine[DISPLAY_LINE_LEN + 1];
+  snprintf(cameraLine, sizeof(cameraLine), "Camera: %s", CAMERA_ID);
+  displayMessage("System Starting...", cameraLine, "Initializing...");
 
-  if (!initializeCamera()) {
-    Serial.println("❌ CAMERA ERROR! Entering recovery mode");
-    systemError = true;
-    displayMessage("CAMERA ERROR!", "Try:", "1. Check camera");
-    delay(2000);
-    displayMessage("CAMERA ERROR!", "2. Press button", "to restart");
+  if (initializeCamera()) {
+    bootMark("camera");
 
-    unsigned long errorStartTime = millis();
-    while (millis() - errorStartTime < 10000) {
-      checkButtonForRestart();
-      delay(100);
+    frameRingActive = FRAME_RING_ENABLED && initializeFrameRing();
+    if (FRAME_RING_ENABLED && !frameRingActive) {
+      Serial.println("⚠️ Frame ring unavailable - capturing on demand");
     }
+  } else {
+    // the supervisor keeps re-initializing the camera in place
+    Serial.println("❌ CAMERA ERROR! Recovering in the background");
+    systemError = true;
+    cameraFaultReported = true;
+    displayMessage("CAMERA ERROR!", "Retrying...", "Check camera");
+  }
 
-    Serial.println("🔄 Auto-restarting after camera error...");
-    displayMessage("AUTO RESTART", "Please wait...");
-    delay(2000);
-    ESP.restart();
+  if (OFFLINE_QUEUE_ENABLED && !initializeOfflineQueue()) {
+    Serial.println("⚠️ Offline queue unavailable - failed uploads are lost");
   }
+  if (TELEGRAM_BATCHING) initializeTelegramBatching();
+  bootMark("offline queue");
 
   displayMessage("Camera Ready!", "Connecting WiFi...");
 
-  if (connectToWiFi()) {
-    clientTCP.setCACert(TELEGRAM_CERTIFICATE_ROOT);
+  bool wifiConnected = FAST_BOOT_ENABLED ? finishFastWiFi() : connectToWiFi();
+  if (wifiConnected) {
+    bootMark("wifi connected");
 
     initializeTime();
+    bootMark("time");
 
-    Serial.println("\n🔍 Testing cloud server connection...");
-    displayMessage("TESTING SERVER", "Please wait...");
-    delay(1000);
-
-    if (testServerConnection()) {
-      serverReachable = true;
+    if (FAST_BOOT_ENABLED) {
+      // the probe task sets serverReachable when it finishes
       systemInitialized = true;
-      displayMessage("SYSTEM READY!", "Server: Online", "Press button");
-      Serial.println("✅ System Fully Ready!");
-      delay(2000);
+      displayMessage("SYSTEM READY!", serverProbeDone ? (serverReachable ? "Server: Online" : "Server: Offline") : "Server: Checking", "Press button");
+      Serial.println("✅ System Ready!");
     } else {
-      serverReachable = false;
-      systemInitialized = true;
-      displayMessage("SYSTEM READY!", "Server: Offline", "Press button");
-      Serial.println("✅ System Ready (Telegram only)");
-      delay(2000);
-    }
-  } else {
-    systemError = true;
-    displayMessage("WiFi FAILED!", "Press to restart");
-    Serial.println("❌ WiFi failed - waiting for restart");
+      Serial.println("\n🔍 Testing cloud server connection...");
+      displayMessage("TESTING SERVER", "Please wait...");
+      bootPause(1000);
 
-    unsigned long wifiErrorTime = millis();
-    while (millis() - wifiErrorTime < 10000) {
-      checkButtonForRestart();
-      delay(100);
+      if (testServerConnection()) {
+        serverReachable = true;
+        systemInitialized = true;
+        displayMessage("SYSTEM READY!", "Server: Online", "Press button");
+        Serial.println("✅ System Fully Ready!");
+        bootPause(2000);
+      } else {
+        serverReachable = false;
+        systemInitialized = true;
+        displayMessage("SYSTEM READY!", "Server: Offline", "Press button");
+        Serial.println("✅ System Ready (Telegram only)");
+        bootPause(2000);
+      }
     }
-
-    Serial.println("🔄 Auto-restarting after WiFi error...");
-    displayMessage("AUTO RESTART", "Please wait...");
-    delay(2000);
-    ESP.restart();
+  } else {
+    // captures still work and go to the offline queue until WiFi is back
+    systemInitialized = true;
+    displayMessage("WiFi FAILED!", "Retrying...", "Press button");
+    Serial.println("❌ WiFi failed - reconnecting in the background");
   }
+
+  initializeSupervisor();
+  initializeEventLoop();
+  initializeRemoteTriggers();
+  bootMark("ready");
+  printBootTimeline();
 }
 
 // =============================================
 // MAIN LOOP
+// - blocks on appEvents until the next event or state deadline; nothing
+//   in the button / capture / upload flow waits with delay()
 // =============================================
+TickType_t nextAppWait(unsigned long now) {
+  if (!debouncePending && !stateDeadlineActive) return portMAX_DELAY;
+
+  long wait = debouncePending ? (long)(debounceDeadline - now) : (long)(stateDeadline - now);
+  if (stateDeadlineActive && (long)(stateDeadline - now) < wait) wait = (long)(stateDeadline - now);
+  return wait <= 0 ? 0 : pdMS_TO_TICKS(wait);
+}
+
 void loop() {
-  if (!systemInitialized) {
-    delay(1000);
-    return;
+  AppEvent event;
+  TickType_t wait = nextAppWait(millis());
+  // with nothing scheduled, come back to decide on idle sleep
+  // (under automatic light sleep the core sleeps while the loop blocks)
+  if (IDLE_SLEEP_ENABLED && wait == portMAX_DELAY) {
+    if (!idleModeActive) wait = pdMS_TO_TICKS(IDLE_CHECK_INTERVAL);
+    else wait = pdMS_TO_TICKS(autoLightSleep ? IDLE_SLEEP_SLICE : IDLE_AWAKE_WINDOW);
+  }
+
+  if (xQueueReceive(appEvents, &event, wait) == pdTRUE) {
+    handleAppEvent(event);
   }
+  runAppTimers(millis());
+  if (IDLE_SLEEP_ENABLED) runIdleSleep(millis());
+}
+
+// =============================================
+// EVENT LOOP
+// - the button ISR posts rate-limited edges; the level is sampled once it
+//   has been stable for BUTTON_DEBOUNCE_MS
+// - captures run on their own task and report back through appEvents
+// - all timing goes through millis() and buttonIsDown(), so the state
+//   machine can be driven by a stubbed GPIO/timer layer off-device
+// =============================================
+bool buttonIsDown() {
+  return digitalRead(BUTTON_PIN) == LOW;
+}
+
+void IRAM_ATTR buttonISR() {
+  unsigned long now = millis();
+  if (now - lastButtonEdge < BUTTON_DEBOUNCE_MS) return;
+  lastButtonEdge = now;
 
-  buttonPressed = (digitalRead(BUTTON_PIN) == LOW);
+  AppEvent event = {};
+  event.type = EVT_BUTTON_EDGE;
+  event.at = now;
+
+  BaseType_t woken = pdFALSE;
+  xQueueSendFromISR(appEvents, &event, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
 
-  if (buttonPressed && !lastButtonState) {
-    buttonPressStartTime = millis();
-    buttonHoldDetected = false;
+// Queues a capture for the capture task; safe from any task
+bool requestCapture(CaptureTrigger trigger, TickType_t wait) {
+  if (poweringOff) return false;
+  CaptureRequest request = { (uint8_t)trigger, millis() };
+  if (xQueueSend(captureRequests, &request, wait) != pdTRUE) {
+    Serial.printf("⚠️ Capture queue full - %s trigger dropped\n", captureTriggerNames[trigger]);
+    return false;
   }
+  return true;
+}
 
-  if (buttonPressed && !buttonHoldDetected) {
-    unsigned long holdDuration = millis() - buttonPressStartTime;
+void captureTask(void*) {
+  CaptureRequest request;
+  while (true) {
+    // one capture per request, so a burst of triggers queues up
+    xQueueReceive(captureRequests, &request, portMAX_DELAY);
+    captureTaskBusy = true;
 
-    if (holdDuration >= 1000 && holdDuration < BUTTON_HOLD_TIME) {
-      int secondsRemaining = (BUTTON_HOLD_TIME - holdDuration) / 1000 + 1;
-      displayMessage("HOLD TO POWER OFF", String(secondsRemaining) + " seconds...");
+    // the camera is not re-initialized under a capture
+    xSemaphoreTake(cameraLock, portMAX_DELAY);
+    if (cameraParked) resumeParkedCamera();  // triggered without a button wake
+    PipelineJob job = captureAndProcessImage(request);
+
+    // a frame that could not be copied out of the driver still holds its
+    // framebuffer, so it is uploaded here under the lock as before
+    bool uploadHere = job.frame != NULL && job.frame->fb != NULL;
+    if (uploadHere) {
+      Serial.println("⚠️ Frame still in the camera driver - uploading on the capture task");
+      AppEvent started = { EVT_UPLOAD_STARTED, millis(), job.result };
+      xQueueSend(appEvents, &started, 0);
+      finishCapture(job);
     }
+    xSemaphoreGive(cameraLock);
 
-    if (holdDuration >= BUTTON_HOLD_TIME) {
-      buttonHoldDetected = true;
-      powerOffSystem();
+    // the network task only counts what it delivered, so a burst that lost
+    // a capture here would never finish
+    if ((uploadHere || !job.result.captured) && burstTest.running) {
+      burstTest.running = false;
+      Serial.println("⚠️ Burst test aborted: a capture did not go through the pipeline");
+    }
+
+    if (!uploadHere && !job.result.captured) {
+      AppEvent done = { EVT_CAPTURE_DONE, millis(), job.result };
+      xQueueSend(appEvents, &done, portMAX_DELAY);
+    } else if (!uploadHere) {
+      queueForNetwork(job);
     }
+    captureTaskBusy = false;
+  }
+}
+
+void initializeEventLoop() {
+  appEvents = xQueueCreate(APP_EVENT_QUEUE_LEN, sizeof(AppEvent));
+  captureRequests = xQueueCreate(CAPTURE_REQUEST_QUEUE_LEN, sizeof(CaptureRequest));
+  initializeUploadWorkers();
+  if (xTaskCreatePinnedToCore(captureTask, "capture", CAPTURE_TASK_STACK, NULL, 2, &captureTaskHandle, CAPTURE_CORE) != pdPASS) {
+    Serial.println("❌ Could not start capture task");
+  }
+  if (xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, NULL, 2, &networkTaskHandle, NETWORK_CORE) != pdPASS) {
+    Serial.println("❌ Could not start network task");
   }
 
-  if (buttonPressed && !lastButtonState && !buttonHoldDetected) {
-    Serial.println("🔘 Button pressed! Starting 5-second countdown...");
-    displayMessage("BUTTON PRESSED", "Wait 5 seconds...");
-    delay(200);
+  buttonStable = buttonIsDown();
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, CHANGE);
+  Serial.println("✓ Event loop ready (button interrupt on GPIO 13)");
+}
 
-    if (millis() - lastCaptureTime > CAPTURE_COOLDOWN) {
-      bool stillHeld = true;
-      for (int i = 5; i > 0 && stillHeld; i--) {
-        Serial.printf("⏱️ Capturing in %d seconds...\n", i);
-        displayMessage("CAPTURING IN...", String(i) + " seconds");
+void enterState(AppState state, unsigned long now, unsigned long timeout) {
+  appState = state;
+  stateDeadlineActive = timeout > 0;
+  stateDeadline = now + timeout;
+}
 
-        for (int j = 0; j < 10; j++) {
-          delay(100);
-          if (digitalRead(BUTTON_PIN) == HIGH) {
-            stillHeld = false;
-            break;
-          }
-        }
+void showIdleStatus() {
+  if (faults[FAULT_CAMERA].active) {
+    displayMessage("CAMERA ERROR", "Recovering...");
+  } else if (WiFi.status() != WL_CONNECTED) {
+    displayMessage("WiFi OFFLINE", "Reconnecting...", "Press button");
+  } else if (serverReachable) {
+    char line[DISPLAY_LINE_LEN + 1];
+    snprintf(line, sizeof(line), "Camera: %s", CAMERA_ID);
+    displayMessage("SERVER REACHABLE", line, "Press button");
+  } else {
+    displayMessage("SERVER NOT", "REACHABLE", "Press button");
+  }
+}
+
+void onButtonDown(unsigned long now) {
+  switch (appState) {
+    case STATE_IDLE:
+    case STATE_UPLOADING:
+    case STATE_SHOW_RESULT:
+      pressStartTime = now;
+      pressSkipsCapture = lastCaptureTime != 0 && now - lastCaptureTime <= CAPTURE_COOLDOWN;
+      if (pressSkipsCapture) {
+        Serial.println("⏱️ Capture cooldown active, skipping...");
+        displayMessage("COOLDOWN ACTIVE", "Skipping capture");
+      } else {
+        Serial.println("🔘 Button pressed! Release to capture, hold to power off");
+        displayMessage("BUTTON PRESSED", "Release to capture", "Hold to power off");
       }
+      enterState(STATE_PRESSED, now, HOLD_MESSAGE_DELAY);
+      break;
 
-      if (!stillHeld || digitalRead(BUTTON_PIN) == HIGH) {
-        captureAndProcessImage();
-        lastCaptureTime = millis();
+    default:
+      break;  // capture running or powering off
+  }
+}
+
+void onButtonUp(unsigned long now) {
+  if (appState != STATE_PRESSED) return;
+  Serial.println("Button released");
+
+  if (pressSkipsCapture) {
+    showIdleStatus();
+    enterState(STATE_IDLE, now, 0);
+    return;
+  }
+
+  displayMessage("CAPTURING...", "Please wait...");
+  enterState(STATE_CAPTURING, now, 0);
+  if (!requestCapture(TRIGGER_BUTTON, 0)) {
+    displayMessage("CAPTURE BUSY", "Try again");
+    enterState(STATE_SHOW_RESULT, now, RESULT_DISPLAY_TIME);
+  }
+}
+
+void onStateTimeout(unsigned long now) {
+  switch (appState) {
+    case STATE_PRESSED: {
+      unsigned long holdDuration = now - pressStartTime;
+      if (holdDuration >= BUTTON_HOLD_TIME) {
+        Serial.println("\n🔴 POWERING OFF SYSTEM...");
+        displayMessage("POWERING OFF...", "Goodbye!");
+        enterState(STATE_POWERING_OFF, now, POWER_OFF_MESSAGE_TIME);
+        break;
       }
-    } else {
-      Serial.println("⏱️ Capture cooldown active, skipping...");
-      displayMessage("COOLDOWN ACTIVE", "Skipping capture");
-      delay(1000);
+
+      int secondsRemaining = (BUTTON_HOLD_TIME - holdDuration) / 1000 + 1;
+      char line[DISPLAY_LINE_LEN + 1];
+      snprintf(line, sizeof(line), "%d seconds...", secondsRemaining);
+      displayMessage("HOLD TO POWER OFF", line);
+      // refresh on the next whole second of the hold
+      enterState(STATE_PRESSED, now, 1000 - holdDuration % 1000);
+      break;
     }
+
+    case STATE_SHOW_RESULT:
+      showIdleStatus();
+      enterState(STATE_IDLE, now, 0);
+      break;
+
+    case STATE_POWERING_OFF:
+      powerOffSystem();
+      break;
+
+    default:
+      break;
   }
+}
 
-  if (!buttonPressed && lastButtonState && !buttonHoldDetected) {
-    if (serverReachable) {
-      displayMessage("SERVER REACHABLE", "Camera: " + String(CAMERA_ID), "Press button");
-    } else {
-      displayMessage("SERVER NOT", "REACHABLE", "Press button");
+void onCaptureDone(const CaptureResult &result, unsigned long now) {
+  if (!result.captured) lastCaptureTime = now;
+
+  // a press for the next capture owns the screen; this result is only logged
+  bool screenFree = appState == STATE_IDLE || appState == STATE_UPLOADING || appState == STATE_SHOW_RESULT ||
+                    (appState == STATE_CAPTURING && !result.captured);
+  if (!screenFree) return;
+
+  if (!result.captured) {
+    Serial.println("❌ Camera capture failed!");
+    displayMessage("CAPTURE FAILED", "Camera error", "Recovering...");
+    enterState(STATE_SHOW_RESULT, now, RESULT_DISPLAY_TIME);
+    return;
+  }
+
+  char line[DISPLAY_LINE_LEN + 1];
+  if (result.duplicateOf > 0) {
+    snprintf(line, sizeof(line), "Same as #%d", result.duplicateOf);
+    displayMessage("DUPLICATE", line, "Not re-uploaded");
+    enterState(STATE_SHOW_RESULT, now, RESULT_DISPLAY_TIME);
+    return;
+  }
+
+  const char* serverLine = !result.serverAttempted ? "Server: skipped" : (result.serverOk ? "Server: OK" : "Server: FAILED");
+  if (result.queued) serverLine = "Queued for retry";
+  const char* telegramLine = result.telegramBatched ? "TELEGRAM: BATCHED" : (result.telegramOk ? "TELEGRAM: SUCCESS" : "TELEGRAM: FAILED");
+  snprintf(line, sizeof(line), "Plate #%d", result.captureNumber);
+  displayMessage(telegramLine, line, serverLine);
+  enterState(STATE_SHOW_RESULT, now, RESULT_DISPLAY_TIME);
+}
+
+void handleAppEvent(const AppEvent &event) {
+  char line[DISPLAY_LINE_LEN + 1];
+  switch (event.type) {
+    case EVT_IDLE_WAKE:
+      if (idleModeActive) {
+        handleButtonWake(idleWakeAt);
+        break;
+      }
+      // idle mode already ended and the edge ISR missed the press:
+      // treat it as an edge
+      [[fallthrough]];
+    case EVT_BUTTON_EDGE:
+      // sample the level once it has settled
+      debouncePending = true;
+      debounceEdgeTime = event.at;
+      debounceDeadline = event.at + BUTTON_DEBOUNCE_MS;
+      break;
+
+    case EVT_UPLOAD_STARTED:
+      // the cooldown runs from the frame, not the upload, so the next
+      // capture can be taken while this one is still being sent
+      lastCaptureTime = event.at;
+      // a press owns the screen; remote and burst captures also show from idle
+      if (appState == STATE_PRESSED || appState == STATE_POWERING_OFF) break;
+      if (event.result.duplicateOf > 0) {
+        snprintf(line, sizeof(line), "Same as #%d", event.result.duplicateOf);
+        displayMessage("DUPLICATE", line, "Sending event");
+      } else {
+        snprintf(line, sizeof(line), "%u KB", (unsigned)(event.result.len / 1024));
+        displayMessage("UPLOADING", line, event.result.serverAttempted ? "Server + Telegram" : "Telegram only");
+      }
+      enterState(STATE_UPLOADING, event.at, 0);
+      break;
+
+    case EVT_CAPTURE_DONE:
+      onCaptureDone(event.result, event.at);
+      break;
+
+    case EVT_HEALTH_CHANGED:
+      if (appState == STATE_IDLE) showIdleStatus();
+      break;
+
+    case EVT_REMOTE_TRIGGER:
+      // posted after the request, so this capture may already be uploading
+      if (appState != STATE_IDLE && appState != STATE_SHOW_RESULT) break;
+      snprintf(line, sizeof(line), "From %s", captureTriggerNames[event.result.trigger]);
+      displayMessage("REMOTE CAPTURE", line, "Please wait...");
+      enterState(STATE_IDLE, event.at, 0);
+      break;
+  }
+}
+
+void runAppTimers(unsigned long now) {
+  if (debouncePending && (long)(now - debounceDeadline) >= 0) {
+    debouncePending = false;
+    bool down = buttonIsDown();
+    if (down != buttonStable) {
+      buttonStable = down;
+      if (down) {
+        onButtonDown(debounceEdgeTime);
+      } else {
+        onButtonUp(now);
+      }
     }
-    Serial.println("Button released");
   }
 
-  lastButtonState = buttonPressed;
-  delay(50);
+  if (stateDeadlineActive && (long)(now - stateDeadline) >= 0) {
+    stateDeadlineActive = false;
+    onStateTimeout(now);
+  }
 }
 
 // =============================================
@@ -436,26 +1564,25 @@ bool initializeDisplay() {
 
   display.clearDisplay();
   display.display();
-  Serial.println("✓ OLED display initialized");
-  return true;
-}
+  memset(displayShadow, 0, sizeof(displayShadow));
 
-void checkButtonForRestart() {
-  bool currentButtonState = (digitalRead(BUTTON_PIN) == LOW);
+  displayBusSpeed = selectDisplayBusSpeed();
 
-  if (currentButtonState && !lastButtonState) {
-    Serial.println("🔄 Button pressed - Restarting ESP32...");
-    displayMessage("RESTARTING...", "Please wait...");
-    delay(1000);
-    ESP.restart();
+  displayQueue = xQueueCreate(1, sizeof(DisplayMessage));
+  displayFlushed = xSemaphoreCreateBinary();
+  if (xTaskCreate(displayTask, "display", DISPLAY_TASK_STACK, NULL, 1, NULL) != pdPASS) {
+    Serial.println("❌ Could not start display task");
+    return false;
   }
 
-  lastButtonState = currentButtonState;
+  Serial.printf("✓ OLED display initialized (I2C %u kHz)\n", displayBusSpeed / 1000);
+  return true;
 }
 
 bool connectToWiFi() {
   WiFi.mode(WIFI_STA);
   WiFi.begin(ssid, password);
+  setIdleListenInterval();
 
   displayMessage("CONNECTING WiFi", "Please wait...");
   Serial.print("Connecting to WiFi");
@@ -466,7 +1593,9 @@ bool connectToWiFi() {
     Serial.print(".");
     attempts++;
     if (attempts % 5 == 0) {
-      displayMessage("CONNECTING WiFi", String("Attempt ") + String(attempts) + "/30");
+      char line[DISPLAY_LINE_LEN + 1];
+      snprintf(line, sizeof(line), "Attempt %d/30", attempts);
+      displayMessage("CONNECTING WiFi", line);
     }
   }
   Serial.println();
@@ -475,8 +1604,12 @@ bool connectToWiFi() {
     Serial.println("✓ WiFi connected successfully!");
     Serial.print("📡 IP address: ");
     Serial.println(WiFi.localIP());
-    displayMessage("WiFi CONNECTED", WiFi.localIP().toString());
-    delay(2000);
+    IPAddress ip = WiFi.localIP();
+    char line[DISPLAY_LINE_LEN + 1];
+    snprintf(line, sizeof(line), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+    displayMessage("WiFi CONNECTED", line);
+    saveWiFiCache();
+    bootPause(2000);
     return true;
   } else {
     Serial.println("❌ WiFi connection failed!");
@@ -484,172 +1617,3036 @@ bool connectToWiFi() {
   }
 }
 
-void initializeTime() {
-  Serial.println("🕐 Initializing time from NTP server...");
-  displayMessage("SYNCING TIME", "Please wait...");
+// =============================================
+// FAST START
+// - WiFi association starts before camera init and joins the BSSID,
+//   channel and IP lease cached in RTC memory (no scan, no DHCP)
+// - the server probe runs on its own task as soon as WiFi is up
+// - each boot phase is timestamped for the boot timeline
+// =============================================
+void bootMark(const char* phase) {
+  portENTER_CRITICAL(&bootTimelineLock);
+  if (bootPhaseCount < BOOT_TIMELINE_MAX) {
+    bootTimeline[bootPhaseCount].name = phase;
+    bootTimeline[bootPhaseCount].at = millis();
+    bootPhaseCount++;
+  }
+  portEXIT_CRITICAL(&bootTimelineLock);
+}
 
-  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+// Holds a boot message on screen; skipped in fast-start mode
+void bootPause(unsigned long ms) {
+  if (!FAST_BOOT_ENABLED) delay(ms);
+}
 
-  struct tm timeinfo;
-  int attempts = 0;
-  while (!getLocalTime(&timeinfo) && attempts < 5) {
-    Serial.print(".");
-    delay(500);
-    attempts++;
+void printBootTimeline() {
+  Serial.println("⏱️ Boot timeline (ms since reset):");
+  unsigned long previous = 0;
+  for (int i = 0; i < bootPhaseCount; i++) {
+    Serial.printf("  %-16s %6lu  (+%lu)\n", bootTimeline[i].name, bootTimeline[i].at, bootTimeline[i].at - previous);
+    previous = bootTimeline[i].at;
   }
+}
 
-  if (attempts < 5) {
-    Serial.println("\n✓ Time synchronized!");
-    Serial.println(&timeinfo, "Current time: %A, %B %d %Y %H:%M:%S");
-    timeInitialized = true;
-
-    char timeStr[10];
-    strftime(timeStr, sizeof(timeStr), "%H:%M:%S", &timeinfo);
-    displayMessage("TIME SYNCED", String(timeStr));
-    delay(1000);
-  } else {
-    Serial.println("\n⚠️ Time sync timeout - using system time");
-    timeInitialized = false;
-    displayMessage("TIME: Local Mode");
-    delay(1000);
+// Same marks for every capture, timed from the trigger
+void captureMark(const char* stage) {
+  if (capturePhaseCount < CAPTURE_TIMELINE_MAX) {
+    captureTimeline[capturePhaseCount].name = stage;
+    captureTimeline[capturePhaseCount].at = millis();
+    capturePhaseCount++;
   }
 }
 
-String getTimestamp() {
-  if (timeInitialized) {
-    struct tm timeinfo;
-    if (getLocalTime(&timeinfo)) {
-      char timestamp[30];
-      strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &timeinfo);
-      return String(timestamp);
-    }
+void printCaptureTimeline() {
+  if (capturePhaseCount == 0) return;
+  unsigned long start = captureTimeline[0].at;
+  Serial.printf("⏱️ Capture #%d timeline (ms since trigger):", captureCount);
+  for (int i = 1; i < capturePhaseCount; i++) {
+    Serial.printf(" %s %lu (+%lu)", captureTimeline[i].name, captureTimeline[i].at - start,
+                  captureTimeline[i].at - captureTimeline[i - 1].at);
   }
+  Serial.println();
+}
 
-  unsigned long seconds = millis() / 1000;
-  unsigned long minutes = seconds / 60;
-  unsigned long hours = minutes / 60;
-  return String("Uptime: ") + String(hours) + "h " + String(minutes % 60) + "m " + String(seconds % 60) + "s";
+void saveWiFiCache() {
+  uint8_t* bssid = WiFi.BSSID();
+  if (bssid == NULL) return;
+
+  memcpy(rtcCache.bssid, bssid, sizeof(rtcCache.bssid));
+  rtcCache.channel = WiFi.channel();
+  rtcCache.ip = (uint32_t)WiFi.localIP();
+  rtcCache.gateway = (uint32_t)WiFi.gatewayIP();
+  rtcCache.subnet = (uint32_t)WiFi.subnetMask();
+  rtcCache.dns = (uint32_t)WiFi.dnsIP();
+  rtcCache.magic = RTC_CACHE_MAGIC;
 }
 
-// =============================================
-// SERVER CONNECTION TEST
-// =============================================
-bool testServerConnection() {
-  HTTPClient http;
+void startWiFi(bool useCache) {
+  WiFi.mode(WIFI_STA);
 
-  Serial.println("\n========================");
-  Serial.println("🔍 TESTING CLOUD SERVER");
+  if (useCache && rtcCache.magic == RTC_CACHE_MAGIC) {
+    Serial.printf("📡 Fast WiFi: channel %d, cached IP %s\n", rtcCache.channel, IPAddress(rtcCache.ip).toString().c_str());
+    WiFi.config(IPAddress(rtcCache.ip), IPAddress(rtcCache.gateway), IPAddress(rtcCache.subnet), IPAddress(rtcCache.dns));
+    WiFi.begin(ssid, password, rtcCache.channel, rtcCache.bssid);
+  } else {
+    WiFi.begin(ssid, password);
+  }
+  setIdleListenInterval();
+}
+
+bool waitForWiFi(unsigned long timeout) {
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED && millis() - start < timeout) {
+    delay(20);
+  }
+  return WiFi.status() == WL_CONNECTED;
+}
+
+// Waits for the association started by startWiFi(); falls back to a full
+// scan + DHCP when the cached parameters no longer work
+bool finishFastWiFi() {
+  if (!waitForWiFi(FAST_BOOT_WIFI_TIMEOUT) && rtcCache.magic == RTC_CACHE_MAGIC) {
+    Serial.println("⚠️ Cached WiFi parameters failed - full scan + DHCP");
+    rtcCache.magic = 0;
+    WiFi.disconnect();
+    WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+    startWiFi(false);
+    waitForWiFi(FAST_BOOT_WIFI_TIMEOUT);
+  }
+
+  if (WiFi.status() != WL_CONNECTED) {
+    Serial.println("❌ WiFi connection failed!");
+    return false;
+  }
+
+  Serial.print("✓ WiFi connected, IP: ");
+  Serial.println(WiFi.localIP());
+  saveWiFiCache();
+  return true;
+}
+
+void serverProbeTask(void*) {
+  if (waitForWiFi(2 * FAST_BOOT_WIFI_TIMEOUT)) {
+    serverReachable = testServerConnection();
+    bootMark("server probed");
+  }
+  serverProbeDone = true;
+  vTaskDelete(NULL);
+}
+
+void startServerProbe() {
+  serverProbeDone = false;
+  if (xTaskCreate(serverProbeTask, "server_probe", UPLOAD_TASK_STACK, NULL, 1, NULL) != pdPASS) {
+    Serial.println("⚠️ Could not start server probe task");
+    serverProbeDone = true;
+  }
+}
+
+// Runs on the lwIP task after every successful SNTP poll
+void onTimeSynced(struct timeval* tv) {
+  bool first = !timeInitialized;
+  timeInitialized = true;
+  rtcLastTimeSync = tv->tv_sec;
+  timeSyncs++;
+  lastTimeSyncMs = millis();
+
+  char now[32];
+  formatCaptureTime(now, sizeof(now), tv->tv_sec, 0);
+  Serial.printf("🕐 Time synchronized: %s%s\n", now, first ? " - provisional capture stamps will be corrected" : "");
+}
+
+// Starts SNTP in the background (or polls again after a reconnect); boot
+// never waits for it
+void initializeTime() {
+  if (timeSyncStarted) {
+    sntp_restart();
+    return;
+  }
+  timeSyncStarted = true;
+
+  sntp_set_time_sync_notification_cb(onTimeSynced);
+  sntp_set_sync_interval(TIME_RESYNC_INTERVAL);
+  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer);
+
+  // the RTC keeps counting through deep sleep, so a clock synced before
+  // powerOffSystem() is still valid on wake
+  if (rtcLastTimeSync > 0 && time(NULL) >= rtcLastTimeSync) {
+    timeInitialized = true;
+    Serial.printf("✓ Time kept across deep sleep (last NTP sync %ld s ago)\n", (long)(time(NULL) - rtcLastTimeSync));
+  } else {
+    Serial.println("🕐 Syncing time from NTP in the background");
+  }
+}
+
+// Wall-clock time of an esp_timer reading from this boot; the clock must be set
+time_t wallClockAt(int64_t timerUs) {
+  return time(NULL) - (time_t)((esp_timer_get_time() - timerUs) / 1000000);
+}
+
+// "2024-05-01 12:00:00", or "boot 7 +12.345s" while the clock is not set
+void formatCaptureTime(char* out, size_t len, time_t capturedAt, int64_t capturedUs) {
+  if (capturedAt != 0) {
+    struct tm timeinfo;
+    localtime_r(&capturedAt, &timeinfo);
+    if (strftime(out, len, "%Y-%m-%d %H:%M:%S", &timeinfo) > 0) return;
+  }
+  unsigned long ms = capturedUs / 1000;
+  snprintf(out, len, "boot %u +%lu.%03lus", rtcBootCount, ms / 1000, ms % 1000);
+}
+
+// The frame's stamp, corrected into buf if it was taken before the clock was set
+const char* frameTimestamp(SharedFrame* frame, char* buf, size_t len) {
+  if (frame->capturedAt != 0 || !timeInitialized) return frame->timestamp;
+  formatCaptureTime(buf, len, wallClockAt(frame->capturedUs), 0);
+  return buf;
+}
+
+// Gives a capture queued before the clock was set its wall-clock time.
+// Records from an earlier boot keep their stamp: esp_timer restarted.
+bool correctCaptureTime(OfflineRecordHeader &header) {
+  if (header.capturedAt != 0 || !timeInitialized || header.bootId != rtcBootCount) return false;
+  header.capturedAt = wallClockAt(header.capturedUs);
+  formatCaptureTime(header.timestamp, sizeof(header.timestamp), header.capturedAt, 0);
+  timestampsCorrected++;
+  return true;
+}
+
+void printTimeStats() {
+  if (!timeInitialized) {
+    Serial.printf("🕐 Clock not set yet (boot %u), captures get provisional stamps\n", rtcBootCount);
+    return;
+  }
+  char now[32];
+  formatCaptureTime(now, sizeof(now), time(NULL), 0);
+  Serial.printf("🕐 Clock %s, %u syncs this boot (last %lu s ago), %u queued stamps corrected\n", now, timeSyncs,
+                timeSyncs > 0 ? (millis() - lastTimeSyncMs) / 1000 : 0UL, timestampsCorrected);
+}
+
+// =============================================
+// SUPERVISOR
+// - one background task owns recovery, so nothing restarts the ESP32 or
+//   spins in a loop waiting for the button
+// - WiFi: reassociates with exponential backoff (cached BSSID first, then
+//   a full scan); the core's own auto-reconnect is off so the two don't race
+// - server: re-probes serverTestURL with backoff until serverReachable can
+//   go back to true, then kicks the offline queue
+// - camera: a failed init or capture is fixed in place with
+//   esp_camera_deinit()/initializeCamera(), under cameraLock so no capture
+//   is using the driver
+// - time from a fault being raised to its recovery is kept per fault type
+// =============================================
+void notifyHealthChanged() {
+  if (appEvents == NULL) return;
+  AppEvent event = {};
+  event.type = EVT_HEALTH_CHANGED;
+  event.at = millis();
+  xQueueSend(appEvents, &event, 0);
+}
+
+void raiseFault(FaultType type, unsigned long now, unsigned long firstBackoff) {
+  FaultState &f = faults[type];
+  if (f.active) return;
+  f.active = true;
+  f.since = now;
+  f.nextAttempt = now;
+  f.backoff = firstBackoff;
+  f.attempts = 0;
+  f.occurrences++;
+  systemError = true;
+  Serial.printf("🚨 %s fault - recovering in the background\n", f.name);
+  notifyHealthChanged();
+}
+
+void resolveFault(FaultType type, unsigned long now) {
+  FaultState &f = faults[type];
+  if (!f.active) return;
+  unsigned long elapsed = now - f.since;
+  f.active = false;
+  f.recoveries++;
+  f.recoveryTimeTotal += elapsed;
+  if (elapsed > f.recoveryTimeMax) f.recoveryTimeMax = elapsed;
+
+  systemError = false;
+  for (int i = 0; i < FAULT_TYPE_COUNT; i++) systemError |= faults[i].active;
+
+  Serial.printf("✅ %s recovered after %lu ms (%u attempts)\n", f.name, elapsed, f.attempts);
+  notifyHealthChanged();
+}
+
+// True when a retry is due; schedules the one after it
+bool recoveryAttemptDue(FaultState &f, unsigned long now, unsigned long attemptTime, unsigned long maxBackoff) {
+  if ((long)(now - f.nextAttempt) < 0) return false;
+  f.attempts++;
+  f.nextAttempt = now + attemptTime + f.backoff;
+  f.backoff = min(f.backoff * 2, maxBackoff);
+  return true;
+}
+
+void superviseWiFi(unsigned long now) {
+  FaultState &f = faults[FAULT_WIFI];
+  if (WiFi.status() == WL_CONNECTED) {
+    if (!f.active) return;
+    saveWiFiCache();
+    resolveFault(FAULT_WIFI, now);
+    if (!timeInitialized) initializeTime();
+    kickOfflineDrain();
+    return;
+  }
+
+  raiseFault(FAULT_WIFI, now, WIFI_BACKOFF_MIN);
+  if (!recoveryAttemptDue(f, now, WIFI_CONNECT_TIMEOUT, WIFI_BACKOFF_MAX)) return;
+
+  bool useCache = f.attempts == 1 && rtcCache.magic == RTC_CACHE_MAGIC;
+  Serial.printf("📡 WiFi reconnect attempt %u (%s)\n", f.attempts, useCache ? "cached BSSID" : "full scan");
+  WiFi.disconnect();
+  if (!useCache) WiFi.config(IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0), IPAddress(0, 0, 0, 0));
+  startWiFi(useCache);
+}
+
+void superviseServer(unsigned long now) {
+  FaultState &f = faults[FAULT_SERVER];
+  if (serverReachable) {
+    if (f.active) {
+      resolveFault(FAULT_SERVER, now);
+      kickOfflineDrain();
+    }
+    return;
+  }
+
+  raiseFault(FAULT_SERVER, now, SERVER_PROBE_MIN);
+  if (WiFi.status() != WL_CONNECTED || !recoveryAttemptDue(f, now, 0, SERVER_PROBE_MAX)) return;
+
+  if (testServerConnection()) serverReachable = true;
+}
+
+void superviseCamera(unsigned long now) {
+  FaultState &f = faults[FAULT_CAMERA];
+  if (!cameraFaultReported) return;
+
+  raiseFault(FAULT_CAMERA, now, CAMERA_RETRY_MIN);
+  if ((long)(now - f.nextAttempt) < 0) return;
+  if (xSemaphoreTake(cameraLock, 0) != pdTRUE) return;  // a capture is running, try next tick
+
+  recoveryAttemptDue(f, now, 0, CAMERA_RETRY_MAX);
+  Serial.printf("📷 Camera re-init attempt %u\n", f.attempts);
+  stopFrameRing();
+  esp_camera_deinit();
+  bool ok = initializeCamera();
+  if (ok) frameRingActive = FRAME_RING_ENABLED && initializeFrameRing();
+  if (ok) cameraParked = false;  // a fresh init is streaming again
+  xSemaphoreGive(cameraLock);
+
+  if (ok) {
+    cameraFaultReported = false;
+    resolveFault(FAULT_CAMERA, millis());
+  }
+}
+
+void supervisorTask(void*) {
+  while (true) {
+    superviseWiFi(millis());
+    if (serverProbeDone) superviseServer(millis());  // the boot probe answers first
+    superviseCamera(millis());
+    sampleHeap(millis());
+    // the tick count stands still in light sleep; the idle loop pokes us after each slice
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SUPERVISOR_INTERVAL));
+  }
+}
+
+void initializeSupervisor() {
+  cameraLock = xSemaphoreCreateMutex();
+  WiFi.setAutoReconnect(false);
+  if (!FAST_BOOT_ENABLED) serverProbeDone = true;  // setup() already probed
+
+  if (xTaskCreate(supervisorTask, "supervisor", SUPERVISOR_TASK_STACK, NULL, 1, &supervisorTaskHandle) != pdPASS) {
+    Serial.println("❌ Could not start supervisor task");
+  }
+}
+
+void printSupervisorStats() {
+  Serial.println("🩺 Faults (recovery ms):");
+  for (int i = 0; i < FAULT_TYPE_COUNT; i++) {
+    const FaultState &f = faults[i];
+    Serial.printf("  %-7s %s, %u faults, %u recovered (avg %lu, max %lu)\n", f.name,
+                  f.active ? "DOWN" : "ok", f.occurrences, f.recoveries,
+                  f.recoveries ? f.recoveryTimeTotal / f.recoveries : 0UL, f.recoveryTimeMax);
+  }
+}
+
+// =============================================
+// HEAP MONITOR
+// - internal RAM only: PSRAM holds the frames and never backs a TLS session
+// - fragmentation is the share of free RAM that is not in the largest block
+// - the minimum largest block of each HEAP_TREND_SAMPLES window is compared
+//   with the previous window; a leak or creeping fragmentation shrinks it
+//   window after window, a busy moment only dents one
+// =============================================
+struct HeapMonitor {
+  size_t freeNow;
+  size_t freeLow;               // heap_caps_get_minimum_free_size, since boot
+  size_t largestNow;
+  size_t largestLow;
+  size_t largestBoot;           // first sample
+  int fragmentation;            // %
+  int fragmentationMax;
+  uint32_t samples;
+  uint32_t lowBlockSamples;     // largest block too small for a TLS session
+  bool lowBlock;
+  size_t windowLargestLow;
+  size_t previousWindowLow;     // 0 until the first window is complete
+  int windowSamples;
+  int shrinkingWindows;
+  unsigned long lastSample;
+};
+
+HeapMonitor heapMonitor = {};
+
+void sampleHeap(unsigned long now) {
+  HeapMonitor &h = heapMonitor;
+  if (h.samples > 0 && now - h.lastSample < HEAP_SAMPLE_INTERVAL) return;
+  h.lastSample = now;
+
+  h.freeNow = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  h.freeLow = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+  h.largestNow = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  h.fragmentation = h.freeNow > 0 ? 100 - (int)(h.largestNow * 100 / h.freeNow) : 0;
+  if (h.samples == 0) {
+    h.largestBoot = h.largestNow;
+    h.largestLow = h.largestNow;
+    h.windowLargestLow = h.largestNow;
+  }
+  h.samples++;
+  h.largestLow = min(h.largestLow, h.largestNow);
+  h.fragmentationMax = max(h.fragmentationMax, h.fragmentation);
+
+  bool lowBlock = h.largestNow < HEAP_TLS_MIN_BLOCK;
+  if (lowBlock) h.lowBlockSamples++;
+  if (lowBlock != h.lowBlock) {
+    Serial.printf(lowBlock ? "⚠️ Largest free block %u B is below a TLS session (%u B free, %d%% fragmented)\n"
+                           : "✓ Largest free block back to %u B (%u B free, %d%% fragmented)\n",
+                  (unsigned)h.largestNow, (unsigned)h.freeNow, h.fragmentation);
+    h.lowBlock = lowBlock;
+  }
+
+  h.windowLargestLow = min(h.windowLargestLow, h.largestNow);
+  if (++h.windowSamples < HEAP_TREND_SAMPLES) return;
+
+  if (h.previousWindowLow > 0 && h.windowLargestLow + HEAP_TREND_MARGIN < h.previousWindowLow) {
+    h.shrinkingWindows++;
+  } else {
+    h.shrinkingWindows = 0;
+  }
+  if (h.shrinkingWindows >= HEAP_TREND_WARN) {
+    Serial.printf("⚠️ Largest free block shrinking for %d windows: %u B (boot %u B)\n",
+                  h.shrinkingWindows, (unsigned)h.windowLargestLow, (unsigned)h.largestBoot);
+  }
+  h.previousWindowLow = h.windowLargestLow;
+  h.windowLargestLow = h.largestNow;
+  h.windowSamples = 0;
+}
+
+void printHeapStats() {
+  const HeapMonitor &h = heapMonitor;
+  Serial.printf("🧠 Heap: %u KB free (low %u KB), largest block %u KB (low %u KB, boot %u KB)\n",
+                (unsigned)(h.freeNow / 1024), (unsigned)(h.freeLow / 1024), (unsigned)(h.largestNow / 1024),
+                (unsigned)(h.largestLow / 1024), (unsigned)(h.largestBoot / 1024));
+  Serial.printf("  fragmentation %d%% (max %d%%), %u of %u samples below a TLS session, %d shrinking windows\n",
+                h.fragmentation, h.fragmentationMax, h.lowBlockSamples, h.samples, h.shrinkingWindows);
+  Serial.printf("  frame pool %d, %u heap fallbacks\n", FRAME_POOL_SIZE, framePoolFallbacks);
+}
+
+// =============================================
+// SERVER CONNECTION TEST
+// =============================================
+// GET serverTestURL on the server's keep-alive connection, so a probe
+// neither builds a second TLS context nor allocates Strings
+bool testServerConnection() {
+  Serial.println("\n========================");
+  Serial.println("🔍 TESTING CLOUD SERVER");
   Serial.println("========================");
   Serial.printf("📍 Target: %s\n", serverTestURL);
 
-  http.begin(serverTestURL);
-  http.setTimeout(8000);
-  http.setConnectTimeout(5000);
+  int httpCode = -1;
+  HttpResponse response;
+  WiFiClientSecure* client = acquireConnection(serverConn, serverHost);
+  if (client != NULL) {
+    const char* path = strchr(serverTestURL + strlen("https://"), '/');
+    int len = snprintf((char*)serverConn.record, TLS_RECORD_SIZE,
+                       "GET %s HTTP/1.1\r\n"
+                       "Host: %s\r\n"
+                       "User-Agent: ESP32CAM\r\n"
+                       "Connection: keep-alive\r\n\r\n",
+                       path != NULL ? path : "/", serverHost);
+    httpResponseBegin(response);
+    if (client->write(serverConn.record, len) == (size_t)len) {
+      httpCode = readHttpResponse(*client, response, false);
+    }
+    releaseConnection(serverConn, httpCode > 0 && response.keepAlive);
+  }
+
+  if (httpCode > 0) {
+    Serial.printf("📡 Response code: %d\n", httpCode);
+  } else {
+    Serial.println("❌ Error: no response");
+  }
+
+  if (httpCode > 0 && httpCode < 400) {
+    Serial.println("✅ Cloud server is REACHABLE!");
+    return true;
+  } else {
+    Serial.println("❌ Server not reachable - will use Telegram only");
+    return false;
+  }
+}
+
+// =============================================
+// FRAME RING
+// - a capture task streams JPEGs into FRAME_RING_SLOTS fixed PSRAM slots
+// - a trigger pulls frames from just before and after the event out of the
+//   ring instead of flushing and waiting on the sensor
+// - slots held by a reader are skipped; a frame with no free slot, or too
+//   large for one, is counted as dropped
+// =============================================
+void storeRingFrame(camera_fb_t* fb) {
+  if (fb->len == 0) return;
+  if (fb->len > frameRingSlotSize) {
+    ringFramesDropped++;
+    ringFramesOversize++;
+    return;
+  }
+
+  RingSlot* slot = NULL;
+  portENTER_CRITICAL(&frameRingLock);
+  for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+    int index = (frameRingNext + i) % FRAME_RING_SLOTS;
+    if (frameRing[index].refs == 0) {
+      slot = &frameRing[index];
+      slot->refs = -1;
+      slot->len = 0;
+      frameRingNext = (index + 1) % FRAME_RING_SLOTS;
+      break;
+    }
+  }
+  portEXIT_CRITICAL(&frameRingLock);
+
+  if (slot == NULL) {
+    ringFramesDropped++;
+    return;
+  }
+
+  memcpy(slot->buf, fb->buf, fb->len);
+
+  portENTER_CRITICAL(&frameRingLock);
+  slot->len = fb->len;
+  slot->width = fb->width;
+  slot->height = fb->height;
+  slot->capturedAt = fb->timestamp.tv_sec * 1000UL + fb->timestamp.tv_usec / 1000;
+  slot->sequence = ++frameRingSequence;
+  slot->refs = 0;
+  ringFramesStored++;
+  portEXIT_CRITICAL(&frameRingLock);
+}
+
+void frameRingCaptureTask(void*) {
+  unsigned long lastStored = 0;
+
+  while (frameRingRunning) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb) {
+      vTaskDelay(pdMS_TO_TICKS(10));
+      continue;
+    }
+    if (millis() - lastStored >= FRAME_RING_INTERVAL) {
+      storeRingFrame(fb);
+      lastStored = millis();
+    }
+    esp_camera_fb_return(fb);
+  }
+
+  frameRingStopped = true;
+  vTaskDelete(NULL);
+}
+
+bool initializeFrameRing() {
+  frameRingSlotSize = FRAME_RING_PSRAM_BUDGET / FRAME_RING_SLOTS;
+
+  for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+    if (frameRing[i].buf != NULL) continue;  // restarted after a camera re-init
+    frameRing[i].buf = (uint8_t*)ps_malloc(frameRingSlotSize);
+    if (frameRing[i].buf == NULL) {
+      Serial.printf("❌ Frame ring: PSRAM allocation failed at slot %d\n", i);
+      for (int j = 0; j < i; j++) {
+        free(frameRing[j].buf);
+        frameRing[j].buf = NULL;
+      }
+      return false;
+    }
+  }
+
+  frameRingRunning = true;
+  frameRingStopped = false;
+  if (xTaskCreatePinnedToCore(frameRingCaptureTask, "frame_ring", FRAME_RING_TASK_STACK, NULL, 1, NULL, CAPTURE_CORE) != pdPASS) {
+    Serial.println("❌ Frame ring: could not start capture task");
+    frameRingRunning = false;
+    frameRingStopped = true;
+    return false;
+  }
+
+  Serial.printf("✓ Frame ring: %d x %u KB in PSRAM (%u KB)\n", FRAME_RING_SLOTS,
+                (unsigned)(frameRingSlotSize / 1024), (unsigned)(frameRingSlotSize * FRAME_RING_SLOTS / 1024));
+  return true;
+}
+
+// Stops the capture task so the camera can be shut down
+void stopFrameRing() {
+  if (!frameRingActive) return;
+
+  frameRingRunning = false;
+  unsigned long start = millis();
+  while (!frameRingStopped && millis() - start < 1000) delay(10);
+  frameRingActive = false;
+}
+
+void releaseRingSlot(RingSlot* slot) {
+  portENTER_CRITICAL(&frameRingLock);
+  slot->refs--;
+  portEXIT_CRITICAL(&frameRingLock);
+}
+
+bool ringHasFrameSince(unsigned long since) {
+  bool found = false;
+  portENTER_CRITICAL(&frameRingLock);
+  for (int i = 0; i < FRAME_RING_SLOTS && !found; i++) {
+    found = frameRing[i].refs >= 0 && frameRing[i].len > 0 && (long)(frameRing[i].capturedAt - since) >= 0;
+  }
+  portEXIT_CRITICAL(&frameRingLock);
+  return found;
+}
+
+// Holds every stored frame from FRAME_RING_PRE_TRIGGER before the event up
+// to the first frame after it (waiting at most FRAME_RING_POST_TRIGGER),
+// oldest first. Falls back to the newest frame if the window is empty.
+// Every returned slot must be given back with releaseRingSlot().
+int pullRingFrames(unsigned long eventTime, RingSlot** out, int maxFrames) {
+  while ((long)(millis() - eventTime) < FRAME_RING_POST_TRIGGER && !ringHasFrameSince(eventTime)) {
+    delay(5);
+  }
+
+  unsigned long windowStart = eventTime - FRAME_RING_PRE_TRIGGER;
+  unsigned long windowEnd = eventTime + FRAME_RING_POST_TRIGGER;
+  int count = 0;
+  RingSlot* newest = NULL;
+
+  portENTER_CRITICAL(&frameRingLock);
+  for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+    RingSlot* slot = &frameRing[i];
+    if (slot->refs < 0 || slot->len == 0) continue;
+    if (newest == NULL || slot->sequence > newest->sequence) newest = slot;
+    if ((long)(slot->capturedAt - windowStart) < 0 || (long)(slot->capturedAt - windowEnd) > 0) continue;
+    if (count == maxFrames) continue;
+
+    // insert sorted by sequence
+    int j = count++;
+    while (j > 0 && out[j - 1]->sequence > slot->sequence) {
+      out[j] = out[j - 1];
+      j--;
+    }
+    out[j] = slot;
+    slot->refs++;
+  }
+  if (count == 0 && newest != NULL && maxFrames > 0) {
+    out[count++] = newest;
+    newest->refs++;
+  }
+  portEXIT_CRITICAL(&frameRingLock);
+
+  return count;
+}
+
+// PSRAM the ring's slots actually hold (0 when the allocation failed)
+size_t frameRingPsramUsed() {
+  size_t used = 0;
+  for (int i = 0; i < FRAME_RING_SLOTS; i++) {
+    if (frameRing[i].buf != NULL) used += frameRingSlotSize;
+  }
+  return used;
+}
+
+void printFrameRingStats() {
+  Serial.printf("🎞️ Frame ring: %u stored, %u dropped (%u oversize), %u of %u KB PSRAM\n",
+                ringFramesStored, ringFramesDropped, ringFramesOversize,
+                (unsigned)(frameRingPsramUsed() / 1024), (unsigned)(FRAME_RING_PSRAM_BUDGET / 1024));
+}
+
+// =============================================
+// PLATE CROP
+// - the frame is decoded at 1/4 scale; every pixel whose luma differs
+//   from its right neighbour by PLATE_EDGE_THRESHOLD is a vertical edge
+// - plate characters are dense vertical strokes, so the plate-shaped
+//   window with the highest edge density (via an integral image) wins
+// - the winning region is re-encoded at full resolution; the 1/4-scale
+//   decode doubles as the low-quality scene thumbnail
+// =============================================
+uint32_t plateCropAttempts = 0;
+uint32_t plateCropHits = 0;
+uint32_t plateBytesSaved = 0;
+
+// jpg2rgb565 writes big-endian RGB565
+uint8_t rgb565Luma(const uint8_t* px) {
+  int r = px[0] & 0xF8;
+  int g = ((px[0] & 0x07) << 5) | ((px[1] & 0xE0) >> 3);
+  int b = (px[1] & 0x1F) << 3;
+  return (r * 77 + g * 150 + b * 29) >> 8;
+}
+
+// Finds the densest plate-shaped window in a scaled RGB565 image; the box
+// is returned in the scaled image's pixels
+bool findPlateRegion(const uint8_t* rgb, int w, int h, int &boxX, int &boxY, int &boxW, int &boxH) {
+  // edge counts fit in 16 bits for any 1/4-scale frame up to HD
+  if (w * h > 65535) return false;
+  uint16_t* integral = (uint16_t*)ps_calloc((w + 1) * (h + 1), sizeof(uint16_t));
+  if (integral == NULL) return false;
+
+  for (int y = 0; y < h; y++) {
+    const uint8_t* row = rgb + y * w * 2;
+    uint16_t rowSum = 0;
+    uint8_t previous = rgb565Luma(row);
+    for (int x = 0; x < w; x++) {
+      uint8_t luma = x + 1 < w ? rgb565Luma(row + (x + 1) * 2) : previous;
+      if (abs(luma - previous) >= PLATE_EDGE_THRESHOLD) rowSum++;
+      previous = luma;
+      integral[(y + 1) * (w + 1) + x + 1] = integral[y * (w + 1) + x + 1] + rowSum;
+    }
+  }
+
+  int bestDensity = 0;
+  for (int winW : plateWindowWidths) {
+    int winH = max(4, winW / PLATE_ASPECT);
+    if (winW > w || winH > h) continue;
+
+    int step = max(2, winH / 2);
+    for (int y = 0; y + winH <= h; y += step) {
+      for (int x = 0; x + winW <= w; x += step) {
+        int edges = integral[(y + winH) * (w + 1) + x + winW] - integral[y * (w + 1) + x + winW]
+                  - integral[(y + winH) * (w + 1) + x] + integral[y * (w + 1) + x];
+        int density = edges * 100 / (winW * winH);
+        if (density > bestDensity) {
+          bestDensity = density;
+          boxX = x;
+          boxY = y;
+          boxW = winW;
+          boxH = winH;
+        }
+      }
+    }
+  }
+
+  free(integral);
+  return bestDensity >= PLATE_MIN_EDGE_DENSITY;
+}
+
+// Decodes the full frame and re-encodes only the given region
+bool encodePlateCrop(SharedFrame* frame, int x, int y, int w, int h) {
+  uint8_t* rgb = (uint8_t*)ps_malloc(frame->width * frame->height * 2);
+  if (rgb == NULL) return false;
+
+  bool ok = jpg2rgb565(frame->buf, frame->len, rgb, JPG_SCALE_NONE);
+  if (ok) {
+    // pack the crop rows to the front of the buffer (never overlaps forward)
+    for (int row = 0; row < h; row++) {
+      memmove(rgb + row * w * 2, rgb + ((y + row) * frame->width + x) * 2, w * 2);
+    }
+    ok = fmt2jpg(rgb, w * h * 2, w, h, PIXFORMAT_RGB565, PLATE_CROP_QUALITY, &frame->cropBuf, &frame->cropLen);
+  }
+
+  free(rgb);
+  return ok;
+}
+
+// Attaches a plate crop and scene thumbnail to the frame when a likely
+// plate is found; otherwise the full frame is uploaded as before
+void cropPlateRegion(SharedFrame* frame) {
+  unsigned long start = millis();
+  plateCropAttempts++;
+
+  int w = frame->width >> PLATE_DETECT_SHIFT;
+  int h = frame->height >> PLATE_DETECT_SHIFT;
+  uint8_t* small = (uint8_t*)ps_malloc(w * h * 2);
+  if (small == NULL) return;
+
+  int boxX = 0, boxY = 0, boxW = 0, boxH = 0;
+  bool found = jpg2rgb565(frame->buf, frame->len, small, PLATE_DETECT_SCALE) &&
+               findPlateRegion(small, w, h, boxX, boxY, boxW, boxH);
+
+  if (found) {
+    // grow the window by the margin, map it to full resolution and clamp
+    int marginX = boxW * PLATE_CROP_MARGIN / 200;
+    int marginY = boxH * PLATE_CROP_MARGIN / 100;
+    int x0 = max(0, (boxX - marginX) << PLATE_DETECT_SHIFT);
+    int y0 = max(0, (boxY - marginY) << PLATE_DETECT_SHIFT);
+    int x1 = min((int)frame->width, (boxX + boxW + marginX) << PLATE_DETECT_SHIFT);
+    int y1 = min((int)frame->height, (boxY + boxH + marginY) << PLATE_DETECT_SHIFT);
+
+    found = encodePlateCrop(frame, x0, y0, (x1 - x0) & ~1, (y1 - y0) & ~1) &&
+            fmt2jpg(small, w * h * 2, w, h, PIXFORMAT_RGB565, PLATE_THUMB_QUALITY, &frame->thumbBuf, &frame->thumbLen);
+
+    if (found) {
+      Serial.printf("🔍 Plate region %dx%d at (%d,%d): crop %u KB + thumb %u KB (full %u KB)\n",
+                    x1 - x0, y1 - y0, x0, y0, (unsigned)(frame->cropLen / 1024),
+                    (unsigned)(frame->thumbLen / 1024), (unsigned)(frame->len / 1024));
+    }
+  }
+
+  free(small);
+
+  // a crop that does not save anything is not worth the loss of context
+  if (found && frame->cropLen + frame->thumbLen >= frame->len) found = false;
+
+  if (!found) {
+    free(frame->cropBuf);
+    free(frame->thumbBuf);
+    frame->cropBuf = NULL;
+    frame->thumbBuf = NULL;
+    frame->cropLen = 0;
+    frame->thumbLen = 0;
+    Serial.printf("🔍 No plate region found (%lu ms) - uploading full frame\n", millis() - start);
+  } else {
+    plateCropHits++;
+    plateBytesSaved += frame->len - frame->cropLen - frame->thumbLen;
+    Serial.printf("🔍 Crop took %lu ms; hits %u/%u, %u KB saved so far\n",
+                  millis() - start, plateCropHits, plateCropAttempts, plateBytesSaved / 1024);
+  }
+}
+
+// =============================================
+// EXPOSURE
+// - brightness is the mean luma of a 1/8-scale decode, which only needs
+//   the JPEG DC coefficients and takes a few ms
+// - an on-demand capture takes frames until AE_SETTLE_FRAMES consecutive
+//   pairs differ by no more than AE_SETTLE_DELTA, or AE_SETTLE_TIMEOUT
+//   passes; frames are handed back as they are measured so this also
+//   works with a single framebuffer
+// - day -> night when AE cannot lift the scene under the day preset;
+//   night -> day when the night preset runs at low gain with a normal
+//   image (OV2640 gain register), so the two do not flap
+// =============================================
+// The driver's cached value of a field; every setter below updates it
+int sensorStatusValue(const camera_status_t &st, int field) {
+  switch (field) {
+    case SF_BRIGHTNESS:    return st.brightness;
+    case SF_CONTRAST:      return st.contrast;
+    case SF_SATURATION:    return st.saturation;
+    case SF_WHITEBAL:      return st.awb;
+    case SF_AWB_GAIN:      return st.awb_gain;
+    case SF_WB_MODE:       return st.wb_mode;
+    case SF_EXPOSURE_CTRL: return st.aec;
+    case SF_AEC_VALUE:     return st.aec_value;
+    case SF_AEC2:          return st.aec2;
+    case SF_AE_LEVEL:      return st.ae_level;
+    case SF_GAIN_CTRL:     return st.agc;
+    case SF_AGC_GAIN:      return st.agc_gain;
+    case SF_GAINCEILING:   return st.gainceiling;
+    case SF_BPC:           return st.bpc;
+    case SF_WPC:           return st.wpc;
+    case SF_RAW_GMA:       return st.raw_gma;
+    case SF_LENC:          return st.lenc;
+    case SF_HMIRROR:       return st.hmirror;
+    case SF_VFLIP:         return st.vflip;
+    case SF_DCW:           return st.dcw;
+    case SF_COLORBAR:      return st.colorbar;
+  }
+  return SENSOR_ANY;
+}
+
+int setSensorField(sensor_t* s, int field, int value) {
+  switch (field) {
+    case SF_BRIGHTNESS:    return s->set_brightness(s, value);
+    case SF_CONTRAST:      return s->set_contrast(s, value);
+    case SF_SATURATION:    return s->set_saturation(s, value);
+    case SF_WHITEBAL:      return s->set_whitebal(s, value);
+    case SF_AWB_GAIN:      return s->set_awb_gain(s, value);
+    case SF_WB_MODE:       return s->set_wb_mode(s, value);
+    case SF_EXPOSURE_CTRL: return s->set_exposure_ctrl(s, value);
+    case SF_AEC_VALUE:     return s->set_aec_value(s, value);
+    case SF_AEC2:          return s->set_aec2(s, value);
+    case SF_AE_LEVEL:      return s->set_ae_level(s, value);
+    case SF_GAIN_CTRL:     return s->set_gain_ctrl(s, value);
+    case SF_AGC_GAIN:      return s->set_agc_gain(s, value);
+    case SF_GAINCEILING:   return s->set_gainceiling(s, (gainceiling_t)value);
+    case SF_BPC:           return s->set_bpc(s, value);
+    case SF_WPC:           return s->set_wpc(s, value);
+    case SF_RAW_GMA:       return s->set_raw_gma(s, value);
+    case SF_LENC:          return s->set_lenc(s, value);
+    case SF_HMIRROR:       return s->set_hmirror(s, value);
+    case SF_VFLIP:         return s->set_vflip(s, value);
+    case SF_DCW:           return s->set_dcw(s, value);
+    case SF_COLORBAR:      return s->set_colorbar(s, value);
+  }
+  return -1;
+}
+
+// One pass over the profile's row; each write is an SCCB transaction, so
+// values the sensor already has are skipped. Runs with cameraLock held
+// (or before the capture task exists). Returns the failed writes.
+int applySensorProfile(sensor_t* s, int profile) {
+  const SensorProfile &p = sensorProfiles[profile];
+  unsigned long start = micros();
+  int writes = 0, failures = 0;
+
+  for (int field = 0; field < SENSOR_FIELD_COUNT; field++) {
+    int value = p.values[field];
+    if (value == SENSOR_ANY || sensorStatusValue(s->status, field) == value) continue;
+    if (setSensorField(s, field, value) != 0) failures++;
+    writes++;
+  }
+
+  sensorApplyUsLast = micros() - start;
+  sensorWritesLast = writes;
+  sensorSkippedLast = SENSOR_FIELD_COUNT - writes;
+  activeSensorProfile = profile;
+  recordLatency(STAGE_SENSOR_PROFILE, sensorApplyUsLast / 1000);
+  Serial.printf("🎛️ Sensor profile %s: %d writes, %d skipped, %lu us%s\n", p.name, writes,
+                sensorSkippedLast, sensorApplyUsLast, failures > 0 ? " (some writes failed)" : "");
+  return failures;
+}
+
+// 1/8-scale RGB565 decode of a JPEG into the shared sample buffer
+const uint8_t* decodeSample(const uint8_t* jpg, size_t len, size_t width, size_t height, int &w, int &h) {
+  w = width >> AE_SAMPLE_SHIFT;
+  h = height >> AE_SAMPLE_SHIFT;
+  size_t need = w * h * 2;
+  if (need == 0) return NULL;
+
+  if (need > aeSampleSize) {
+    free(aeSampleBuf);
+    aeSampleBuf = (uint8_t*)ps_malloc(need);
+    aeSampleSize = aeSampleBuf != NULL ? need : 0;
+    if (aeSampleBuf == NULL) return NULL;
+  }
+  return jpg2rgb565(jpg, len, aeSampleBuf, AE_SAMPLE_SCALE) ? aeSampleBuf : NULL;
+}
+
+// Mean luma (0-255) of a JPEG, -1 if it could not be decoded
+int frameMeanLuma(const uint8_t* jpg, size_t len, size_t width, size_t height) {
+  int w, h;
+  const uint8_t* rgb = decodeSample(jpg, len, width, height, w, h);
+  if (rgb == NULL) return -1;
+
+  uint32_t sum = 0;
+  for (int i = 0; i < w * h; i++) sum += rgb565Luma(rgb + i * 2);
+  return sum / (w * h);
+}
+
+// Current AGC gain x16 from the OV2640 gain register, -1 if not available
+int readSensorGainX16(sensor_t* s) {
+  if (s->id.PID != OV2640_PID || s->get_reg == NULL) return -1;
+  int g = s->get_reg(s, 0x100, 0xFF);  // sensor bank, GAIN
+  if (g < 0) return -1;
+  return ((g >> 7 & 1) + 1) * ((g >> 6 & 1) + 1) * ((g >> 5 & 1) + 1) * ((g >> 4 & 1) + 1) * (16 + (g & 0x0F));
+}
+
+// Runs between captures with the brightness of the last frame
+void adaptSensorProfile(int luma) {
+  if (luma < 0) return;
+  sensor_t* s = esp_camera_sensor_get();
+  if (s == NULL) return;
+
+  int next = activeSensorProfile;
+  if (activeSensorProfile == SENSOR_DAY && luma < NIGHT_ENTER_LUMA) {
+    next = SENSOR_NIGHT;
+  } else if (activeSensorProfile == SENSOR_NIGHT) {
+    int gain = readSensorGainX16(s);
+    bool bright = gain >= 0 ? gain <= DAY_ENTER_GAIN_X16 && luma >= DAY_ENTER_LUMA : luma >= DAY_ENTER_LUMA_NO_GAIN;
+    if (bright) next = SENSOR_DAY;
+  }
+  if (next == activeSensorProfile) return;
+
+  Serial.printf("🌗 Sensor profile %s -> %s (luma %d)\n",
+                sensorProfiles[activeSensorProfile].name, sensorProfiles[next].name, luma);
+  applySensorProfile(s, next);
+  sensorProfileSwitches++;
+}
+
+// Serial "sensor [day|night|fast|auto]": switches at once, between captures
+void handleSensorCommand(const char* arg) {
+  if (arg[0] == '\0') {
+    Serial.printf("🎛️ Sensor profile %s (%s), last apply %d writes + %d skipped in %lu us, %u switches\n",
+                  sensorProfiles[activeSensorProfile].name, sensorProfileAuto ? "auto day/night" : "fixed",
+                  sensorWritesLast, sensorSkippedLast, sensorApplyUsLast, sensorProfileSwitches);
+    return;
+  }
+
+  int profile = -1;
+  for (int i = 0; i < SENSOR_PROFILE_COUNT; i++) {
+    if (strcmp(arg, sensorProfiles[i].name) == 0) profile = i;
+  }
+  if (profile < 0 && strcmp(arg, "auto") != 0) {
+    Serial.printf("⚠️ Unknown sensor profile '%s' (day, night, fast, auto)\n", arg);
+    return;
+  }
+
+  if (xSemaphoreTake(cameraLock, pdMS_TO_TICKS(CONNECTION_LOCK_TIMEOUT)) != pdTRUE) {
+    Serial.println("⚠️ Camera busy - sensor profile not changed");
+    return;
+  }
+  sensorProfileAuto = profile < 0;
+  sensor_t* s = esp_camera_sensor_get();
+  if (profile >= 0 && s != NULL) {
+    applySensorProfile(s, profile);
+    sensorProfileSwitches++;
+  } else if (profile >= 0) {
+    activeSensorProfile = profile;  // applied by the next camera init
+  }
+  xSemaphoreGive(cameraLock);
+  Serial.printf("🎛️ Sensor profile %s, %s\n", sensorProfiles[activeSensorProfile].name,
+                sensorProfileAuto ? "day/night follow the light level" : "fixed until \"sensor auto\"");
+}
+
+// =============================================
+// FOCUS SCORING
+// - score = variance of the 4-neighbour Laplacian over a 1/4-scale luma
+//   plane; motion blur and defocus both flatten it
+// - the static background is the same in every frame of a burst, so the
+//   ranking is driven by how sharp the moving car is
+// =============================================
+// Focus score of a JPEG, -1 if it could not be decoded
+long frameFocusScore(const uint8_t* jpg, size_t len, size_t width, size_t height) {
+  int w = width >> FOCUS_SAMPLE_SHIFT;
+  int h = height >> FOCUS_SAMPLE_SHIFT;
+  size_t need = w * h * 2;
+  if (w < 3 || h < 3) return -1;
+
+  if (need > focusSampleSize) {
+    free(focusSampleBuf);
+    focusSampleBuf = (uint8_t*)ps_malloc(need);
+    focusSampleSize = focusSampleBuf != NULL ? need : 0;
+    if (focusSampleBuf == NULL) return -1;
+  }
+  if (!jpg2rgb565(jpg, len, focusSampleBuf, FOCUS_SAMPLE_SCALE)) return -1;
+
+  // luma in place, one byte per pixel, in the front half of the buffer
+  uint8_t* luma = focusSampleBuf;
+  for (int i = 0; i < w * h; i++) luma[i] = rgb565Luma(focusSampleBuf + i * 2);
+
+  int64_t sum = 0;
+  int64_t sumSq = 0;
+  for (int y = 1; y < h - 1; y++) {
+    const uint8_t* row = luma + y * w;
+    for (int x = 1; x < w - 1; x++) {
+      int lap = 4 * row[x] - row[x - 1] - row[x + 1] - row[x - w] - row[x + w];
+      sum += lap;
+      sumSq += lap * lap;
+    }
+  }
+  int64_t n = (int64_t)(w - 2) * (h - 2);
+  return (long)((sumSq - sum * sum / n) / n);
+}
+
+// Copies the frame's JPEG to PSRAM and hands its framebuffer back
+bool detachFrameBuffer(SharedFrame* frame, const uint8_t* buf, size_t len, size_t width, size_t height) {
+  uint8_t* copy = (uint8_t*)ps_malloc(len);
+  if (copy == NULL) return false;
+  memcpy(copy, buf, len);
+
+  if (frame->fb != NULL) esp_camera_fb_return(frame->fb);
+  free(frame->copyBuf);
+  frame->fb = NULL;
+  frame->copyBuf = copy;
+  frame->buf = copy;
+  frame->len = len;
+  frame->width = width;
+  frame->height = height;
+  return true;
+}
+
+// Takes BURST_FRAMES - 1 more frames after the settled one and keeps the
+// sharpest. The current best lives in PSRAM so the driver always has a
+// free framebuffer, even with fb_count = 1.
+SharedFrame* burstCameraFrames(SharedFrame* frame) {
+  unsigned long start = millis();
+  long bestScore = frameFocusScore(frame->buf, frame->len, frame->width, frame->height);
+  long worstScore = bestScore;
+  int bestIndex = 0;
+
+  if (!detachFrameBuffer(frame, frame->buf, frame->len, frame->width, frame->height)) return frame;
+
+  for (int i = 1; i < BURST_FRAMES; i++) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (!fb || fb->len == 0) {
+      if (fb) esp_camera_fb_return(fb);
+      break;
+    }
+
+    long score = frameFocusScore(fb->buf, fb->len, fb->width, fb->height);
+    if (score >= 0 && (worstScore < 0 || score < worstScore)) worstScore = score;
+    if (score > bestScore && detachFrameBuffer(frame, fb->buf, fb->len, fb->width, fb->height)) {
+      bestScore = score;
+      bestIndex = i;
+    }
+    esp_camera_fb_return(fb);
+  }
+
+  Serial.printf("🔎 Sharpest of burst: frame %d, focus %ld (worst %ld), %lu ms\n",
+                bestIndex + 1, bestScore, worstScore, millis() - start);
+  return frame;
+}
+
+// =============================================
+// DUPLICATE SUPPRESSION
+// - dHash: the 1/8-scale luma plane is box-averaged down to 9x8 cells and
+//   each bit says whether a cell is brighter than its right neighbour, so
+//   exposure drift and JPEG noise barely move it
+// - the sign of a gradient survives a car being swapped for another one in
+//   the same spot, so the cell means are kept too and compared once the
+//   overall exposure offset is taken out
+// - a match refreshes the original's entry, so a car that stays in view
+//   keeps being suppressed against its first upload
+// =============================================
+bool frameDHash(const uint8_t* jpg, size_t len, size_t width, size_t height, CaptureHash &sig) {
+  int w, h;
+  const uint8_t* rgb = decodeSample(jpg, len, width, height, w, h);
+  if (rgb == NULL || w < 9 || h < 8) return false;
+
+  uint8_t (&cells)[8][9] = sig.cells;
+  for (int cy = 0; cy < 8; cy++) {
+    int y0 = cy * h / 8, y1 = (cy + 1) * h / 8;
+    for (int cx = 0; cx < 9; cx++) {
+      int x0 = cx * w / 9, x1 = (cx + 1) * w / 9;
+      uint32_t sum = 0;
+      for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) sum += rgb565Luma(rgb + (y * w + x) * 2);
+      }
+      cells[cy][cx] = sum / ((x1 - x0) * (y1 - y0));
+    }
+  }
+
+  sig.hash = 0;
+  for (int cy = 0; cy < 8; cy++) {
+    for (int cx = 0; cx < 8; cx++) sig.hash = (sig.hash << 1) | (cells[cy][cx] > cells[cy][cx + 1] ? 1 : 0);
+  }
+  return true;
+}
+
+// Largest change of one cell between two frames, after the difference in
+// mean brightness is taken out
+int cellDifference(const uint8_t a[8][9], const uint8_t b[8][9]) {
+  int offset = 0;
+  for (int cy = 0; cy < 8; cy++) {
+    for (int cx = 0; cx < 9; cx++) offset += a[cy][cx] - b[cy][cx];
+  }
+  offset /= 72;
+
+  int worst = 0;
+  for (int cy = 0; cy < 8; cy++) {
+    for (int cx = 0; cx < 9; cx++) worst = max(worst, abs(a[cy][cx] - b[cy][cx] - offset));
+  }
+  return worst;
+}
+
+// Returns the capture number this frame repeats, or 0 and remembers it
+int findDuplicateCapture(SharedFrame* frame, int captureNumber, int &distance) {
+  CaptureHash sig;
+  if (!frameDHash(frame->buf, frame->len, frame->width, frame->height, sig)) return 0;
+
+  unsigned long now = millis();
+  CaptureHash* match = NULL;
+  distance = 65;
+  for (int i = 0; i < DEDUP_HISTORY; i++) {
+    CaptureHash &entry = captureHashes[i];
+    if (entry.captureNumber == 0 || now - entry.lastSeen > DEDUP_WINDOW) continue;
+    int d = __builtin_popcountll(entry.hash ^ sig.hash);
+    if (d < distance && cellDifference(entry.cells, sig.cells) <= DEDUP_MAX_CELL_DIFF) {
+      distance = d;
+      match = &entry;
+    }
+  }
+
+  if (match != NULL && distance <= DEDUP_MAX_DISTANCE) {
+    match->lastSeen = now;
+    return match->captureNumber;
+  }
+
+  CaptureHash &slot = captureHashes[captureHashNext];
+  captureHashNext = (captureHashNext + 1) % DEDUP_HISTORY;
+  slot.hash = sig.hash;
+  memcpy(slot.cells, sig.cells, sizeof(slot.cells));
+  slot.captureNumber = captureNumber;
+  slot.lastSeen = now;
+  return 0;
+}
+
+// Sends the lightweight event in place of the image
+void sendDuplicateEvent(CaptureResult &result, const char* timestamp, int distance) {
+  if (result.serverAttempted) {
+    result.serverOk = postDuplicateToServer(result.captureNumber, result.duplicateOf, distance, timestamp);
+  }
+
+  char text[128];
+  snprintf(text, sizeof(text), "%s: capture #%d (%s) is a duplicate of #%d",
+           CAMERA_ID, result.captureNumber, timestamp, result.duplicateOf);
+  result.telegramOk = WiFi.status() == WL_CONNECTED && sendTelegramText(text);
+}
+
+// =============================================
+// ADAPTIVE QUALITY
+// - every dispatch feeds one uplink sample: image bytes that were delivered
+//   over the time the slowest successful upload took, since both share the
+//   link; failed uploads say nothing about throughput and are skipped
+// - the bytes a profile actually sends (after cropping) are learned too, so
+//   the prediction covers the crop as well as frame size and quality. A
+//   batched Telegram photo goes out later, but its part of the media group
+//   (the same image) still crosses the link and is counted
+// - steps down as far as needed at once, but up only one profile at a time
+//   and only with headroom, so the profile does not flap between captures
+// =============================================
+void recordUplinkSample(SharedFrame* frame, bool telegramBatched) {
+  size_t bytes = 0;
+  unsigned long ms = 0;
+  if (frame->serverOk) {
+    bytes += frame->serverBytes;
+    ms = max(ms, frame->serverTime);
+  }
+  if (frame->telegramOk) {
+    bytes += frame->telegramBytes;
+    ms = max(ms, frame->telegramTime);
+  }
+  if (bytes > 0 && ms > UPLOAD_OVERHEAD_MS) {
+    float sample = (float)bytes / (ms - UPLOAD_OVERHEAD_MS);
+    uplinkBytesPerMs = uplinkSamples == 0 ? sample :
+        (sample * UPLINK_EWMA_WEIGHT + uplinkBytesPerMs * (100 - UPLINK_EWMA_WEIGHT)) / 100;
+    uplinkSamples++;
+  }
+
+  // learn the per-dispatch size only from dispatches that delivered both
+  // photos, the Telegram one possibly as its share of a batch
+  if (!frame->serverOk || !(frame->telegramOk || telegramBatched)) return;
+  size_t sent = frame->serverBytes;
+  sent += frame->telegramOk ? frame->telegramBytes : (frame->cropBuf != NULL ? frame->cropLen : frame->len);
+  size_t &learned = profileSentBytes[frame->profile];
+  learned = learned == 0 ? sent : (sent * UPLINK_EWMA_WEIGHT + learned * (100 - UPLINK_EWMA_WEIGHT)) / 100;
+}
+
+// Expected dispatch time for a profile, 0 while the uplink is unmeasured
+unsigned long predictDeliveryTime(int profile) {
+  if (uplinkSamples == 0) return 0;
+  size_t bytes = profileSentBytes[profile];
+  if (bytes == 0) bytes = captureProfiles[profile].expectedBytes * 2;  // server + Telegram
+  return UPLOAD_OVERHEAD_MS + (unsigned long)(bytes / uplinkBytesPerMs);
+}
+
+int chooseCaptureProfile() {
+  if (uplinkSamples == 0) return activeProfile;
+
+  int best = CAPTURE_PROFILE_COUNT - 1;
+  for (int i = 0; i < CAPTURE_PROFILE_COUNT; i++) {
+    if (predictDeliveryTime(i) <= TARGET_DELIVERY_MS) {
+      best = i;
+      break;
+    }
+  }
+
+  if (best < activeProfile) {
+    int up = activeProfile - 1;
+    return predictDeliveryTime(up) <= (unsigned long)TARGET_DELIVERY_MS * PROFILE_STEP_UP_MARGIN / 100 ? up : activeProfile;
+  }
+  return best;
+}
+
+// Runs between captures, after the previous dispatch has been measured
+void adaptCaptureProfile() {
+  Serial.printf("📶 Profile %s | uplink %.1f KB/s | predicted %lu ms (target %d ms)\n",
+                captureProfiles[activeProfile].name, uplinkBytesPerMs * 1000 / 1024,
+                predictDeliveryTime(activeProfile), TARGET_DELIVERY_MS);
+
+  int next = chooseCaptureProfile();
+  if (next == activeProfile) return;
+
+  sensor_t* s = esp_camera_sensor_get();
+  if (s == NULL) return;
+
+  const CaptureProfile &profile = captureProfiles[next];
+  if (s->set_framesize(s, profile.frameSize) != 0 || s->set_quality(s, profile.quality) != 0) {
+    Serial.printf("⚠️ Could not switch to profile %s\n", profile.name);
+    return;
+  }
+
+  Serial.printf("📶 Profile %s -> %s (predicted %lu ms)\n",
+                captureProfiles[activeProfile].name, profile.name, predictDeliveryTime(next));
+  activeProfile = next;
+}
+
+// =============================================
+// IMAGE CAPTURE AND PROCESSING
+// =============================================
+// Grabs a frame straight from the sensor once auto-exposure has settled
+SharedFrame* grabCameraFrame() {
+  unsigned long start = millis();
+  camera_fb_t* fb = NULL;
+  int previous = -1;
+  int steady = 0;
+  int frames = 0;
+  int failures = 0;
+  bool settled = false;
+
+  while (true) {
+    fb = esp_camera_fb_get();
+    if (!fb || fb->len == 0) {
+      if (fb) esp_camera_fb_return(fb);
+      fb = NULL;
+      Serial.printf("⚠️ Capture attempt failed (%d)\n", ++failures);
+      if (failures >= 3) break;
+      continue;
+    }
+
+    frames++;
+    int luma = frameMeanLuma(fb->buf, fb->len, fb->width, fb->height);
+    steady = luma >= 0 && previous >= 0 && abs(luma - previous) <= AE_SETTLE_DELTA ? steady + 1 : 0;
+    previous = luma;
+    lastFrameLuma = luma;
+
+    settled = steady >= AE_SETTLE_FRAMES;
+    if (settled || millis() - start >= AE_SETTLE_TIMEOUT) break;
+    esp_camera_fb_return(fb);
+  }
+
+  if (fb == NULL) {
+    Serial.println("❌ Camera capture failed after 3 attempts!");
+    return NULL;
+  }
+
+  Serial.printf("✓ Exposure %s after %d frames, %lu ms (luma %d)\n",
+                settled ? "settled" : "timed out", frames, millis() - start, previous);
+
+  SharedFrame* frame = newSharedFrame(fb->buf, fb->len, fb->width, fb->height);
+  frame->fb = fb;
+  return BURST_FRAMES > 1 ? burstCameraFrames(frame) : frame;
+}
+
+// Takes the ring frame closest to the trigger, without touching the sensor
+SharedFrame* grabRingFrame(unsigned long triggerTime) {
+  RingSlot* candidates[FRAME_RING_SLOTS];
+  int count = pullRingFrames(triggerTime, candidates, FRAME_RING_SLOTS);
+  if (count == 0) {
+    Serial.println("❌ Frame ring is empty!");
+    return NULL;
+  }
+
+  // closest to the trigger first
+  for (int i = 1; i < count; i++) {
+    RingSlot* slot = candidates[i];
+    long distance = labs((long)(slot->capturedAt - triggerTime));
+    int j = i;
+    while (j > 0 && labs((long)(candidates[j - 1]->capturedAt - triggerTime)) > distance) {
+      candidates[j] = candidates[j - 1];
+      j--;
+    }
+    candidates[j] = slot;
+  }
+
+  // the sharpest of the BURST_FRAMES closest frames; ties go to the closest
+  unsigned long scoreStart = millis();
+  RingSlot* best = candidates[0];
+  long bestScore = -1;
+  int scored = min(count, max(BURST_FRAMES, 1));
+  for (int i = 0; scored > 1 && i < scored; i++) {
+    long score = frameFocusScore(candidates[i]->buf, candidates[i]->len, candidates[i]->width, candidates[i]->height);
+    if (score > bestScore) {
+      bestScore = score;
+      best = candidates[i];
+    }
+  }
+  for (int i = 0; i < count; i++) {
+    if (candidates[i] != best) releaseRingSlot(candidates[i]);
+  }
+
+  Serial.printf("✓ Ring frame #%u, %ld ms from trigger (%d candidates)\n",
+                best->sequence, (long)(best->capturedAt - triggerTime), count);
+  if (scored > 1) {
+    Serial.printf("🔎 Sharpest of %d ring frames: focus %ld, %lu ms\n", scored, bestScore, millis() - scoreStart);
+  }
+
+  SharedFrame* frame = newSharedFrame(best->buf, best->len, best->width, best->height);
+  frame->slot = best;
+  return frame;
+}
+
+// Runs on the capture task: grabs and prepares a frame for the network
+// task. Display updates are left to the event loop, which gets progress
+// through appEvents.
+PipelineJob captureAndProcessImage(const CaptureRequest &request) {
+  PipelineJob job = {};
+  CaptureResult &result = job.result;
+  result.trigger = request.trigger;
+  result.requestedAt = request.at;
+  Serial.println("📸 Starting image capture process...");
+
+  unsigned long triggerTime = millis();
+  job.triggerTime = triggerTime;
+  capturePhaseCount = 0;
+  captureMark("trigger");
+  SharedFrame* frame = frameRingActive ? grabRingFrame(triggerTime) : grabCameraFrame();
+
+  if (frame == NULL) {
+    countMetric(metricCounters.captureFailures);
+    cameraFaultReported = true;
+    return job;
+  }
+  captureMark("frame");
+  unsigned long usableAfter = millis() - triggerTime;
+  recordLatency(STAGE_FRAME_GRAB, usableAfter);
+  if (frameRingActive) lastFrameLuma = frameMeanLuma(frame->buf, frame->len, frame->width, frame->height);
+  Serial.printf("🎯 Trigger to usable frame: %lu ms (luma %d, %s preset)\n",
+                usableAfter, lastFrameLuma, sensorProfiles[activeSensorProfile].name);
+  countMetric(metricCounters.captures);
+
+  captureCount++;
+  frame->captureNumber = captureCount;
+  frame->capturedUs = esp_timer_get_time();
+  frame->capturedAt = timeInitialized ? time(NULL) : 0;
+  formatCaptureTime(job.timestamp, sizeof(job.timestamp), frame->capturedAt, frame->capturedUs);
+  job.capturedAt = frame->capturedAt;
+  job.capturedUs = frame->capturedUs;
+
+  if (!firstCaptureLogged) {
+    firstCaptureLogged = true;
+    bootMark("first capture");
+    Serial.printf("⏱️ Boot to first capture: %lu ms\n", millis());
+  }
+
+  Serial.printf("✓ Image captured! Size: %u bytes (%u KB)\n", (unsigned)frame->len, (unsigned)(frame->len / 1024));
+  Serial.printf("  Resolution: %ux%u\n", (unsigned)frame->width, (unsigned)frame->height);
+  Serial.printf("📷 Camera ID: %s\n", CAMERA_ID);
+  Serial.printf("🕐 Timestamp: %s\n", job.timestamp);
+  if (frameRingActive) printFrameRingStats();
+
+  result.captureNumber = captureCount;
+  result.serverAttempted = WiFi.status() == WL_CONNECTED && serverReachable;
+  // a photo asked for by name is always sent, even of an unchanged scene
+  bool remote = request.trigger == TRIGGER_TELEGRAM || request.trigger == TRIGGER_HTTP;
+  result.duplicateOf = DEDUP_ENABLED && !remote ? findDuplicateCapture(frame, captureCount, job.distance) : 0;
+  if (result.duplicateOf > 0) {
+    Serial.printf("♊ Capture #%d repeats #%d (distance %d) - sending an event instead\n",
+                  captureCount, result.duplicateOf, job.distance);
+    result.captured = true;
+    countMetric(metricCounters.duplicates);
+    countMetric(metricCounters.duplicateBytes, frame->len);
+    releaseFrame(frame);
+    captureMark("duplicate");
+    printCaptureTimeline();
+    return job;
+  }
+
+  if (PLATE_CROP_ENABLED) {
+    cropPlateRegion(frame);
+    captureMark("crop");
+  }
+
+  result.captured = true;
+  result.len = frame->cropBuf != NULL ? frame->cropLen + frame->thumbLen : frame->len;
+
+  // a queued frame must not hold a driver framebuffer: the driver needs it
+  // for the next grab, and a camera re-init would pull it from under the
+  // upload. Ring slots are PSRAM already.
+  if (frame->fb != NULL && !detachFrameBuffer(frame, frame->buf, frame->len, frame->width, frame->height)) {
+    Serial.println("⚠️ No PSRAM to copy the frame out of the driver");
+  }
+  job.frame = frame;
+  captureMark("prepared");
+
+  // tuned from the uploads finished so far; the camera is only touched here
+  if (ADAPTIVE_QUALITY_ENABLED) {
+    adaptCaptureProfile();
+    captureMark("adapt");
+  }
+  if (sensorProfileAuto) adaptSensorProfile(lastFrameLuma);
+
+  printCaptureTimeline();
+  return job;
+}
+
+// =============================================
+// FRAME DISPATCH
+// - the server upload and the Telegram send run concurrently on their own
+//   tasks, both reading the same JPEG in place (no copies)
+// - every holder owns one reference; the framebuffer or ring slot is given
+//   back when the last one is released, even if the dispatcher gave up
+//   waiting first
+// =============================================
+void retainFrame(SharedFrame* frame) {
+  portENTER_CRITICAL(&frameRefLock);
+  frame->refs++;
+  portEXIT_CRITICAL(&frameRefLock);
+}
+
+void releaseFrame(SharedFrame* frame) {
+  portENTER_CRITICAL(&frameRefLock);
+  int refs = --frame->refs;
+  portEXIT_CRITICAL(&frameRefLock);
+
+  if (refs > 0) return;
+
+  if (frame->fb != NULL) esp_camera_fb_return(frame->fb);
+  if (frame->slot != NULL) releaseRingSlot(frame->slot);
+  free(frame->copyBuf);
+  free(frame->cropBuf);
+  free(frame->thumbBuf);
+
+  if (!frame->pooled) {
+    vSemaphoreDelete(frame->done);
+    delete frame;
+    return;
+  }
+  portENTER_CRITICAL(&frameRefLock);
+  framePoolUsed[frame - framePool] = false;
+  portEXIT_CRITICAL(&frameRefLock);
+}
+
+void uploadFrameToServer(SharedFrame* frame) {
+  unsigned long start = millis();
+  char corrected[32];
+  const char* timestamp = frameTimestamp(frame, corrected, sizeof(corrected));
+
+  if (frame->cropBuf != NULL) {
+    frame->serverBytes = frame->cropLen + frame->thumbLen;
+    frame->serverOk = uploadImageToServer(frame->cropBuf, frame->cropLen, timestamp, frame->thumbBuf, frame->thumbLen);
+  } else {
+    frame->serverBytes = frame->len;
+    frame->serverOk = uploadImageToServer(frame->buf, frame->len, timestamp);
+  }
+  frame->serverTime = millis() - start;
+  countMetric(metricCounters.uploads);
+  if (!frame->serverOk) countMetric(metricCounters.uploadFailures);
+}
+
+void sendFrameToTelegram(SharedFrame* frame) {
+  unsigned long start = millis();
+
+  char caption[64];
+  char corrected[32];
+  formatPhotoCaption(caption, sizeof(caption), frame->captureNumber, frameTimestamp(frame, corrected, sizeof(corrected)));
+  if (frame->cropBuf != NULL) {
+    frame->telegramBytes = frame->cropLen;
+    frame->telegramOk = sendPhotoToTelegram(frame->cropBuf, frame->cropLen, caption);
+  } else {
+    frame->telegramBytes = frame->len;
+    frame->telegramOk = sendPhotoToTelegram(frame->buf, frame->len, caption);
+  }
+  frame->telegramTime = millis() - start;
+  countMetric(metricCounters.uploads);
+  if (!frame->telegramOk) countMetric(metricCounters.uploadFailures);
+}
+
+// One long-lived worker per destination; creating a task (and its TLS-deep
+// stack) per upload left holes in the internal heap
+void serverUploadTask(void*) {
+  SharedFrame* frame;
+  while (true) {
+    xQueueReceive(serverUploadQueue, &frame, portMAX_DELAY);
+    uploadFrameToServer(frame);
+    xSemaphoreGive(frame->done);
+    releaseFrame(frame);
+  }
+}
+
+void telegramUploadTask(void*) {
+  SharedFrame* frame;
+  while (true) {
+    xQueueReceive(telegramUploadQueue, &frame, portMAX_DELAY);
+    sendFrameToTelegram(frame);
+    xSemaphoreGive(frame->done);
+    releaseFrame(frame);
+  }
+}
+
+void initializeUploadWorkers() {
+  serverUploadQueue = xQueueCreate(FRAME_POOL_SIZE, sizeof(SharedFrame*));
+  telegramUploadQueue = xQueueCreate(FRAME_POOL_SIZE, sizeof(SharedFrame*));
+  for (int i = 0; i < FRAME_POOL_SIZE; i++) framePool[i].done = xSemaphoreCreateCounting(2, 0);
+
+  if (xTaskCreatePinnedToCore(serverUploadTask, "upload_server", UPLOAD_TASK_STACK, NULL, UPLOAD_TASK_PRIORITY, NULL, NETWORK_CORE) != pdPASS ||
+      xTaskCreatePinnedToCore(telegramUploadTask, "upload_telegram", UPLOAD_TASK_STACK, NULL, UPLOAD_TASK_PRIORITY, NULL, NETWORK_CORE) != pdPASS) {
+    Serial.println("❌ Could not start upload workers");
+  }
+}
+
+bool startFrameConsumer(SharedFrame* frame, QueueHandle_t queue, const char* name) {
+  retainFrame(frame);
+  if (queue == NULL || xQueueSend(queue, &frame, 0) != pdTRUE) {
+    Serial.printf("❌ Could not queue frame for %s\n", name);
+    releaseFrame(frame);
+    return false;
+  }
+  return true;
+}
+
+// The caller attaches the owner of buf (fb or slot) before dispatching
+SharedFrame* newSharedFrame(const uint8_t* buf, size_t len, size_t width, size_t height) {
+  SharedFrame* frame = NULL;
+  portENTER_CRITICAL(&frameRefLock);
+  for (int i = 0; i < FRAME_POOL_SIZE && frame == NULL; i++) {
+    if (framePool[i].done != NULL && !framePoolUsed[i]) {
+      framePoolUsed[i] = true;
+      frame = &framePool[i];
+    }
+  }
+  portEXIT_CRITICAL(&frameRefLock);
+
+  if (frame != NULL) {
+    SemaphoreHandle_t done = frame->done;
+    *frame = SharedFrame();
+    frame->done = done;
+    frame->pooled = true;
+    // a consumer that finished after its dispatcher timed out left a give behind
+    while (xSemaphoreTake(done, 0) == pdTRUE) {}
+  } else {
+    framePoolFallbacks++;
+    frame = new SharedFrame();
+    frame->done = xSemaphoreCreateCounting(2, 0);
+  }
+
+  frame->buf = buf;
+  frame->len = len;
+  frame->width = width;
+  frame->height = height;
+  frame->refs = 1;  // held by the dispatcher until the results are read
+  frame->profile = activeProfile;
+  return frame;
+}
+
+// Returns true when an undelivered capture was handed to the offline queue.
+// telegramBatched asks for the Telegram batch and says whether it took the
+// photo; a batched photo is reported and retried by the batch.
+bool dispatchFrame(SharedFrame* frame, const char* timestamp, bool toServer, bool &telegramBatched,
+                   bool &serverOk, bool &telegramOk) {
+  snprintf(frame->timestamp, sizeof(frame->timestamp), "%s", timestamp);
+
+  unsigned long start = millis();
+  int consumers = 0;
+  if (toServer && startFrameConsumer(frame, serverUploadQueue, "server upload")) consumers++;
+  telegramBatched = telegramBatched && queueTelegramBatch(frame);
+  if (!telegramBatched && startFrameConsumer(frame, telegramUploadQueue, "Telegram upload")) consumers++;
+
+  int finished = 0;
+  while (finished < consumers) {
+    long remaining = DISPATCH_TIMEOUT - (long)(millis() - start);
+    if (remaining <= 0 || xSemaphoreTake(frame->done, pdMS_TO_TICKS(remaining)) != pdTRUE) {
+      Serial.printf("⚠️ Dispatch timeout: %d of %d uploads still running\n", consumers - finished, consumers);
+      break;
+    }
+    finished++;
+  }
+
+  // results are only set by consumers that finished; a late one still owns its reference
+  serverOk = frame->serverOk;
+  telegramOk = frame->telegramOk;
+
+  Serial.printf("⏱️ Dispatch: %lu ms total (server %lu ms, Telegram %lu ms)\n",
+                millis() - start, frame->serverTime, frame->telegramTime);
+  recordLatency(STAGE_DISPATCH, millis() - start);
+
+  // a consumer still running past the timeout has not published its time
+  if (finished == consumers) recordUplinkSample(frame, telegramBatched);
+
+  // a skipped server upload is still owed; a late consumer may succeed and
+  // cause a duplicate, which beats losing the capture
+  uint32_t pending = (serverOk ? 0 : OFFLINE_TO_SERVER) | (telegramOk || telegramBatched ? 0 : OFFLINE_TO_TELEGRAM);
+  bool queued = OFFLINE_QUEUE_ENABLED && pending != 0 && queueOfflineCapture(frame, pending);
+  if (serverOk || telegramOk) kickOfflineDrain();
+
+  releaseFrame(frame);
+  return queued;
+}
+
+// =============================================
+// CAPTURE PIPELINE
+// - the capture task pushes prepared frames and goes straight back to
+//   waiting for a trigger, so frame N+1 is grabbed, scored and cropped
+//   while frame N is still uploading
+// - a full queue stalls the capture task (it never drops a capture); the
+//   wait is counted so a too-shallow PIPELINE_DEPTH shows up in the stats
+// =============================================
+uint32_t pipelineDepth() {
+  return pipelineHead.load(std::memory_order_acquire) - pipelineTail.load(std::memory_order_acquire);
+}
+
+bool pipelinePush(const PipelineJob &job) {
+  uint32_t head = pipelineHead.load(std::memory_order_relaxed);
+  if (head - pipelineTail.load(std::memory_order_acquire) >= PIPELINE_DEPTH) return false;
+  pipelineJobs[head % PIPELINE_DEPTH] = job;
+  pipelineHead.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool pipelinePop(PipelineJob &job) {
+  uint32_t tail = pipelineTail.load(std::memory_order_relaxed);
+  if (tail == pipelineHead.load(std::memory_order_acquire)) return false;
+  job = pipelineJobs[tail % PIPELINE_DEPTH];
+  pipelineTail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+// Capture task side
+void queueForNetwork(PipelineJob &job) {
+  // sent before the push so it always reaches the event loop ahead of the
+  // job's EVT_CAPTURE_DONE
+  AppEvent started = { EVT_UPLOAD_STARTED, millis(), job.result };
+  xQueueSend(appEvents, &started, 0);
+
+  unsigned long waitStart = millis();
+  bool waited = false;
+  while (!pipelinePush(job)) {
+    if (!waited) Serial.printf("⏳ Upload queue full (%d) - capture waits\n", PIPELINE_DEPTH);
+    waited = true;
+    vTaskDelay(pdMS_TO_TICKS(PIPELINE_FULL_POLL));
+  }
+  if (waited) pipelineFullWaitMs += millis() - waitStart;
+
+  uint32_t depth = pipelineDepth();
+  if (depth > pipelineMaxDepth) pipelineMaxDepth = depth;
+  if (burstTest.running) {
+    burstTest.captured++;
+    burstTest.lastQueued = millis();
+    if (depth > burstTest.maxDepth) burstTest.maxDepth = depth;
+  }
+
+  xTaskNotifyGive(networkTaskHandle);
+  Serial.printf("✓ Capture #%d queued for upload (depth %u), ready for next capture\n",
+                job.result.captureNumber, (unsigned)depth);
+}
+
+// Network task side: delivers one capture and reports it to the event loop
+void finishCapture(PipelineJob &job) {
+  CaptureResult &result = job.result;
+
+  if (job.frame == NULL) {
+    if (job.capturedAt == 0 && timeInitialized) {
+      formatCaptureTime(job.timestamp, sizeof(job.timestamp), wallClockAt(job.capturedUs), 0);
+    }
+    sendDuplicateEvent(result, job.timestamp, job.distance);
+  } else {
+    // the dispatcher owns the frame from here and frees it once both uploads are done;
+    // a photo asked for by command is not held back for a batch
+    bool remote = result.trigger == TRIGGER_TELEGRAM || result.trigger == TRIGGER_HTTP;
+    result.telegramBatched = TELEGRAM_BATCHING && !remote;
+    result.queued = dispatchFrame(job.frame, job.timestamp, result.serverAttempted, result.telegramBatched,
+                                  result.serverOk, result.telegramOk);
+    job.frame = NULL;
+  }
+
+  if (result.serverAttempted) {
+    if (result.serverOk) {
+      Serial.println("✅ Server upload successful!");
+    } else {
+      Serial.println("❌ Server upload failed");
+      serverReachable = false;
+    }
+  }
+
+  if (result.telegramBatched) {
+    Serial.println("📤 Telegram photo batched");
+  } else if (result.telegramOk) {
+    Serial.println("✅ Telegram delivery successful!");
+  } else {
+    Serial.println("❌ Telegram send failed");
+  }
+
+  Serial.printf("⏱️ Capture #%d delivered %lu ms after its trigger\n", result.captureNumber, millis() - job.triggerTime);
+  if (result.trigger == TRIGGER_TELEGRAM || result.trigger == TRIGGER_HTTP) {
+    lastCommandLatency = millis() - result.requestedAt;
+    recordLatency(STAGE_COMMAND, lastCommandLatency);
+    Serial.printf("📨 %s command to photo: %lu ms\n", captureTriggerNames[result.trigger], lastCommandLatency);
+  }
+  AppEvent done = { EVT_CAPTURE_DONE, millis(), result };
+  xQueueSend(appEvents, &done, portMAX_DELAY);
+}
+
+void finishBurstTest() {
+  unsigned long elapsed = millis() - burstTest.start;
+  unsigned long captureSpan = burstTest.lastQueued - burstTest.start;
+  burstTest.running = false;
+
+  Serial.printf("📈 Burst of %d: all delivered in %lu ms\n", burstTest.requested, elapsed);
+  Serial.printf("  capture rate %lu/min, delivery rate %lu/min, max queue depth %u of %d\n",
+                captureSpan > 0 ? burstTest.captured * 60000UL / captureSpan : 0,
+                elapsed > 0 ? burstTest.finished * 60000UL / elapsed : 0,
+                (unsigned)burstTest.maxDepth, PIPELINE_DEPTH);
+}
+
+void networkTask(void*) {
+  PipelineJob job;
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    networkTaskBusy = true;
+    while (pipelinePop(job)) {
+      finishCapture(job);
+      if (burstTest.running && ++burstTest.finished >= burstTest.requested) finishBurstTest();
+    }
+    networkTaskBusy = false;
+  }
+}
+
+// Serial "burst N": N back-to-back captures, bypassing the button cooldown
+void startBurstTest(int count) {
+  if (burstTest.running) {
+    Serial.println("⚠️ A burst test is already running");
+    return;
+  }
+  if (count < 1 || count > BURST_TEST_MAX) {
+    Serial.printf("⚠️ Burst size must be 1-%d\n", BURST_TEST_MAX);
+    return;
+  }
+
+  burstTest = {};
+  burstTest.requested = count;
+  burstTest.start = millis();
+  burstTest.running = true;
+  Serial.printf("📈 Burst test: %d captures\n", count);
+  // blocks this (serial) task while the request queue is full
+  for (int i = 0; i < count; i++) requestCapture(TRIGGER_BURST, portMAX_DELAY);
+}
+
+void printPipelineStats() {
+  Serial.printf("  pipeline depth %u now, %u max of %d; capture waited %lu ms on a full queue\n",
+                (unsigned)pipelineDepth(), (unsigned)pipelineMaxDepth, PIPELINE_DEPTH, pipelineFullWaitMs);
+}
+
+// =============================================
+// OFFLINE QUEUE
+// - one LittleFS file per undelivered capture, named by sequence so the
+//   oldest drains first
+// - the capture task only copies the JPEGs to PSRAM and queues them; the
+//   flash write happens on the offline task, so captures never wait on it
+// - appends are crash-safe: a record is written as .tmp and renamed once
+//   complete, and stray .tmp files are removed at boot
+// - each record is written once and deleted once; only a partial delivery
+//   rewrites its header, which LittleFS commits atomically on close. LittleFS
+//   wear-levels the rest
+// - a drain pass sends up to OFFLINE_DRAIN_BATCH records back to back over
+//   the kept-alive connections, and stops per target at the first failure;
+//   with TELEGRAM_BATCHING the pass's Telegram photos go as one media group
+// =============================================
+void offlineRecordPath(char* path, size_t len, uint32_t sequence, const char* ext) {
+  snprintf(path, len, OFFLINE_QUEUE_DIR "/%08u.%s", (unsigned)sequence, ext);
+}
+
+// Lists record sequences oldest first; optionally removes unfinished .tmp files
+int scanOfflineQueue(uint32_t* sequences, int max, size_t* totalBytes, bool removeTemp) {
+  uint32_t stale[OFFLINE_STORE_QUEUE_LEN + 4];
+  int staleCount = 0;
+  int count = 0;
+
+  File dir = LittleFS.open(OFFLINE_QUEUE_DIR);
+  if (!dir) return 0;
+
+  for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+    char* ext;
+    uint32_t sequence = strtoul(f.name(), &ext, 10);
+    if (strcmp(ext, ".rec") == 0 && count < max) {
+      sequences[count++] = sequence;
+      if (totalBytes != NULL) *totalBytes += f.size();
+    } else if (strcmp(ext, ".tmp") == 0 && staleCount < (int)(sizeof(stale) / sizeof(stale[0]))) {
+      stale[staleCount++] = sequence;
+    }
+    if (sequence >= nextOfflineSequence) nextOfflineSequence = sequence + 1;
+    f.close();
+  }
+  dir.close();
+
+  for (int i = 0; removeTemp && i < staleCount; i++) {
+    char path[32];
+    offlineRecordPath(path, sizeof(path), stale[i], "tmp");
+    LittleFS.remove(path);
+    Serial.printf("🧹 Removed unfinished offline record %s\n", path);
+  }
+
+  // insertion sort, the queue is small
+  for (int i = 1; i < count; i++) {
+    uint32_t v = sequences[i];
+    int j = i - 1;
+    while (j >= 0 && sequences[j] > v) {
+      sequences[j + 1] = sequences[j];
+      j--;
+    }
+    sequences[j + 1] = v;
+  }
+  return count;
+}
+
+void removeOfflineRecord(uint32_t sequence) {
+  char path[32];
+  offlineRecordPath(path, sizeof(path), sequence, "rec");
+  File f = LittleFS.open(path, "r");
+  size_t size = f ? f.size() : 0;
+  f.close();
+
+  if (LittleFS.remove(path)) {
+    offlineRecordCount--;
+    offlineQueueBytes -= min(size, offlineQueueBytes);
+  }
+}
+
+// Drops the oldest records until one more of recordLen fits the caps
+void makeRoomInOfflineQueue(size_t recordLen) {
+  if (offlineRecordCount < OFFLINE_QUEUE_MAX_RECORDS && offlineQueueBytes + recordLen <= OFFLINE_QUEUE_MAX_BYTES) return;
+
+  uint32_t sequences[OFFLINE_QUEUE_MAX_RECORDS];
+  int count = scanOfflineQueue(sequences, OFFLINE_QUEUE_MAX_RECORDS, NULL, false);
+  for (int i = 0; i < count; i++) {
+    if (offlineRecordCount < OFFLINE_QUEUE_MAX_RECORDS && offlineQueueBytes + recordLen <= OFFLINE_QUEUE_MAX_BYTES) break;
+    removeOfflineRecord(sequences[i]);
+    offlineDropped++;
+    Serial.printf("🗑️ Offline queue full - dropped capture record %u\n", sequences[i]);
+  }
+}
+
+void storeOfflineCapture(OfflineCapture* capture) {
+  unsigned long start = millis();
+  size_t dataLen = capture->header.imageLen + capture->header.thumbLen;
+  size_t recordLen = sizeof(capture->header) + dataLen;
+  makeRoomInOfflineQueue(recordLen);
+
+  uint32_t sequence = nextOfflineSequence++;
+  char tmpPath[32], path[32];
+  offlineRecordPath(tmpPath, sizeof(tmpPath), sequence, "tmp");
+  offlineRecordPath(path, sizeof(path), sequence, "rec");
+
+  File f = LittleFS.open(tmpPath, "w");
+  bool ok = f && f.write((const uint8_t*)&capture->header, sizeof(capture->header)) == sizeof(capture->header) &&
+            f.write(capture->data, dataLen) == dataLen;
+  f.close();
+  ok = ok && LittleFS.rename(tmpPath, path);
+
+  if (!ok) {
+    LittleFS.remove(tmpPath);
+    Serial.printf("❌ Could not store capture #%u offline\n", capture->header.captureNumber);
+    return;
+  }
+
+  offlineRecordCount++;
+  offlineQueueBytes += recordLen;
+  offlineStored++;
+  Serial.printf("📦 Stored capture #%u offline in %lu ms (%d waiting, %u KB)\n",
+                capture->header.captureNumber, millis() - start, offlineRecordCount, (unsigned)(offlineQueueBytes / 1024));
+}
+
+// Records whose Telegram send waits for the rest of the drain pass
+struct DrainBatch {
+  OfflineCapture captures[TELEGRAM_BATCH_MAX];  // data loaded into PSRAM
+  uint32_t sequences[TELEGRAM_BATCH_MAX];
+  uint32_t pendingBefore[TELEGRAM_BATCH_MAX];
+  int count;
+};
+
+// Removes a delivered record, or keeps a partial delivery for the next pass
+void finishOfflineRecord(uint32_t sequence, const OfflineRecordHeader &header, uint32_t pendingBefore) {
+  if (header.pending == 0) {
+    removeOfflineRecord(sequence);
+    offlineDelivered++;
+    Serial.printf("📦 Delivered queued capture #%u (%s)\n", header.captureNumber, header.timestamp);
+  } else if (header.pending != pendingBefore) {
+    // one of two targets delivered: remember that for the next pass
+    char path[32];
+    offlineRecordPath(path, sizeof(path), sequence, "rec");
+    File update = LittleFS.open(path, "r+");
+    if (update) update.write((const uint8_t*)&header, sizeof(header));
+    update.close();
+  }
+}
+
+// Delivers one record to the targets that are still up. Returns true if
+// anything was sent (or batched).
+bool drainOfflineRecord(uint32_t sequence, bool &serverDown, bool &telegramDown, DrainBatch &batch) {
+  char path[32];
+  offlineRecordPath(path, sizeof(path), sequence, "rec");
+
+  OfflineRecordHeader header;
+  File f = LittleFS.open(path, "r");
+  if (!f) return false;
+  bool valid = f.read((uint8_t*)&header, sizeof(header)) == sizeof(header) && header.magic == OFFLINE_RECORD_MAGIC &&
+               f.size() == sizeof(header) + header.imageLen + header.thumbLen;
+  // a corrected stamp is written back with the next partial delivery
+  if (valid) correctCaptureTime(header);
+
+  bool expired = valid && OFFLINE_RETENTION_HOURS > 0 && header.capturedAt != 0 && timeInitialized &&
+                 time(NULL) - header.capturedAt > (time_t)OFFLINE_RETENTION_HOURS * 3600;
+  if (!valid || expired) {
+    f.close();
+    removeOfflineRecord(sequence);
+    offlineDropped++;
+    Serial.printf("🗑️ Dropped %s offline record %u\n", valid ? "expired" : "corrupt", sequence);
+    return false;
+  }
+
+  uint32_t targets = header.pending & ~((serverDown ? OFFLINE_TO_SERVER : 0) | (telegramDown ? OFFLINE_TO_TELEGRAM : 0));
+  size_t dataLen = header.imageLen + header.thumbLen;
+  uint8_t* data = targets != 0 ? (uint8_t*)ps_malloc(dataLen) : NULL;
+  bool loaded = data != NULL && f.read(data, dataLen) == dataLen;
+  f.close();
+  if (!loaded) {
+    free(data);
+    return false;
+  }
+
+  const uint8_t* thumb = header.thumbLen > 0 ? data + header.imageLen : NULL;
+  uint32_t pendingBefore = header.pending;
+  if (targets & OFFLINE_TO_SERVER) {
+    if (uploadImageToServer(data, header.imageLen, header.timestamp, thumb, header.thumbLen)) {
+      header.pending &= ~OFFLINE_TO_SERVER;
+      serverReachable = true;
+    } else {
+      serverDown = true;
+    }
+  }
+  if ((targets & OFFLINE_TO_TELEGRAM) && TELEGRAM_BATCHING) {
+    // finished when the batch is sent
+    int i = batch.count++;
+    batch.captures[i].header = header;
+    batch.captures[i].data = data;
+    batch.sequences[i] = sequence;
+    batch.pendingBefore[i] = pendingBefore;
+    return true;
+  }
+  if (targets & OFFLINE_TO_TELEGRAM) {
+    char caption[64];
+    formatPhotoCaption(caption, sizeof(caption), header.captureNumber, header.timestamp);
+    if (sendPhotoToTelegram(data, header.imageLen, caption)) {
+      header.pending &= ~OFFLINE_TO_TELEGRAM;
+    } else {
+      telegramDown = true;
+    }
+  }
+  free(data);
+
+  finishOfflineRecord(sequence, header, pendingBefore);
+  return true;
+}
+
+// One media group for the batched records of a drain pass
+void flushDrainBatch(DrainBatch &batch, bool &telegramDown) {
+  if (batch.count == 0) return;
+
+  OfflineCapture* captures[TELEGRAM_BATCH_MAX];
+  for (int i = 0; i < batch.count; i++) captures[i] = &batch.captures[i];
+  bool ok = !telegramDown && sendTelegramBatch(captures, batch.count);
+  if (!ok) telegramDown = true;
+
+  for (int i = 0; i < batch.count; i++) {
+    OfflineRecordHeader &header = batch.captures[i].header;
+    if (ok) header.pending &= ~OFFLINE_TO_TELEGRAM;
+    free(batch.captures[i].data);
+    finishOfflineRecord(batch.sequences[i], header, batch.pendingBefore[i]);
+  }
+  batch.count = 0;
+}
+
+void drainOfflineQueue() {
+  uint32_t sequences[OFFLINE_QUEUE_MAX_RECORDS];
+  int count = scanOfflineQueue(sequences, OFFLINE_QUEUE_MAX_RECORDS, NULL, false);
+  if (count == 0) return;
+
+  unsigned long start = millis();
+  bool serverDown = false;
+  bool telegramDown = false;
+  int sent = 0;
+  DrainBatch batch;
+  batch.count = 0;
+  for (int i = 0; i < count && sent < OFFLINE_DRAIN_BATCH && !(serverDown && telegramDown); i++) {
+    if (drainOfflineRecord(sequences[i], serverDown, telegramDown, batch)) sent++;
+    if (batch.count == TELEGRAM_BATCH_MAX) flushDrainBatch(batch, telegramDown);
+  }
+  flushDrainBatch(batch, telegramDown);
+
+  Serial.printf("📦 Offline drain: %d records tried in %lu ms, %d waiting (stored %u, delivered %u, dropped %u)\n",
+                sent, millis() - start, offlineRecordCount, offlineStored, offlineDelivered, offlineDropped);
+}
+
+void offlineQueueTask(void*) {
+  while (true) {
+    OfflineCapture* capture = NULL;
+    if (xQueueReceive(offlineQueue, &capture, pdMS_TO_TICKS(OFFLINE_DRAIN_INTERVAL)) == pdTRUE && capture != NULL) {
+      offlineTaskBusy = true;
+      storeOfflineCapture(capture);
+      offlineTaskBusy = false;
+      free(capture->data);
+      delete capture;
+      continue;  // it just failed to send; retry on the next kick or interval
+    }
+    if (offlineRecordCount > 0 && WiFi.status() == WL_CONNECTED) {
+      offlineTaskBusy = true;
+      drainOfflineQueue();
+      offlineTaskBusy = false;
+    }
+  }
+}
+
+bool initializeOfflineQueue() {
+  if (!LittleFS.begin(true)) {
+    Serial.println("❌ LittleFS mount failed");
+    return false;
+  }
+  LittleFS.mkdir(OFFLINE_QUEUE_DIR);
+
+  uint32_t sequences[OFFLINE_QUEUE_MAX_RECORDS];
+  size_t bytes = 0;
+  offlineRecordCount = scanOfflineQueue(sequences, OFFLINE_QUEUE_MAX_RECORDS, &bytes, true);
+  offlineQueueBytes = bytes;
+
+  offlineQueue = xQueueCreate(OFFLINE_STORE_QUEUE_LEN, sizeof(OfflineCapture*));
+  if (offlineQueue == NULL ||
+      xTaskCreate(offlineQueueTask, "offline_queue", OFFLINE_TASK_STACK, NULL, 1, NULL) != pdPASS) {
+    Serial.println("❌ Could not start offline queue task");
+    return false;
+  }
+
+  offlineQueueActive = true;
+  Serial.printf("📦 Offline queue: %d captures waiting (%u KB of %u KB)\n",
+                offlineRecordCount, (unsigned)(bytes / 1024), (unsigned)(OFFLINE_QUEUE_MAX_BYTES / 1024));
+  return true;
+}
+
+// Copies the uploaded image (and the thumbnail, for the server) to PSRAM
+OfflineCapture* copyOfflineCapture(SharedFrame* frame, uint32_t pending, bool withThumb) {
+  const uint8_t* image = frame->cropBuf != NULL ? frame->cropBuf : frame->buf;
+  size_t imageLen = frame->cropBuf != NULL ? frame->cropLen : frame->len;
+  size_t thumbLen = withThumb && frame->thumbBuf != NULL ? frame->thumbLen : 0;
+
+  OfflineCapture* capture = new OfflineCapture();
+  capture->data = (uint8_t*)ps_malloc(imageLen + thumbLen);
+  if (capture->data == NULL) {
+    delete capture;
+    Serial.println("❌ No PSRAM to copy the capture");
+    return NULL;
+  }
+  memcpy(capture->data, image, imageLen);
+  if (thumbLen > 0) memcpy(capture->data + imageLen, frame->thumbBuf, thumbLen);
+  capture->queuedAt = millis();
+
+  OfflineRecordHeader &h = capture->header;
+  h.magic = OFFLINE_RECORD_MAGIC;
+  h.pending = pending;
+  h.captureNumber = frame->captureNumber;
+  h.capturedAt = frame->capturedAt;
+  h.capturedUs = frame->capturedUs;
+  h.bootId = rtcBootCount;
+  snprintf(h.timestamp, sizeof(h.timestamp), "%s", frame->timestamp);
+  correctCaptureTime(h);
+  h.imageLen = imageLen;
+  h.thumbLen = thumbLen;
+  return capture;
+}
+
+// Takes ownership of the capture, even when it has to be dropped
+bool handOfflineCapture(OfflineCapture* capture) {
+  uint32_t pending = capture->header.pending;
+  uint32_t captureNumber = capture->header.captureNumber;
+  if (!offlineQueueActive || xQueueSend(offlineQueue, &capture, 0) != pdTRUE) {
+    free(capture->data);
+    delete capture;
+    Serial.println("⚠️ Offline store busy - capture dropped");
+    return false;
+  }
+  Serial.printf("📦 Capture #%u queued for %s%s\n", captureNumber,
+                pending & OFFLINE_TO_SERVER ? "server " : "", pending & OFFLINE_TO_TELEGRAM ? "Telegram" : "");
+  return true;
+}
+
+bool queueOfflineCapture(SharedFrame* frame, uint32_t pending) {
+  if (!offlineQueueActive) return false;
+
+  OfflineCapture* capture = copyOfflineCapture(frame, pending, true);
+  return capture != NULL && handOfflineCapture(capture);
+}
+
+// A live upload just worked: try the backlog now instead of at the next interval
+void kickOfflineDrain() {
+  if (!offlineQueueActive || offlineRecordCount == 0) return;
+  OfflineCapture* kick = NULL;
+  xQueueSend(offlineQueue, &kick, 0);
+}
+
+// =============================================
+// TELEGRAM BATCHING
+// - the dispatcher copies the photo Telegram gets to PSRAM and hands it
+//   to the batch task instead of starting a sendPhoto; the server upload
+//   still runs per capture
+// - the batch task collects up to TELEGRAM_BATCH_MAX per TELEGRAM_BATCH_POLICY
+//   and sends them as one sendMediaGroup (a lone photo goes as sendPhoto)
+// - a failed batch goes to the offline queue photo by photo; the drain
+//   sends its Telegram backlog as media groups as well
+// - the "tg_batch" histogram is the time each photo spent waiting for and
+//   in its batch, which is what the two policies trade against requests
+// =============================================
+QueueHandle_t telegramBatchQueue = NULL;   // OfflineCapture*, owned by whoever holds it
+uint8_t telegramBatchPolicy = TELEGRAM_BATCH_POLICY;   // read for every batch
+volatile bool telegramBatchBusy = false;
+uint32_t telegramBatches = 0;
+uint32_t telegramBatchedPhotos = 0;
+uint32_t telegramBatchFailures = 0;
+
+// Network task side; false when the photo has to be sent on its own
+bool queueTelegramBatch(SharedFrame* frame) {
+  if (telegramBatchQueue == NULL) return false;
+
+  OfflineCapture* capture = copyOfflineCapture(frame, OFFLINE_TO_TELEGRAM, false);
+  if (capture == NULL) return false;
+  if (xQueueSend(telegramBatchQueue, &capture, 0) != pdTRUE) {
+    free(capture->data);
+    delete capture;
+    return false;
+  }
+  return true;
+}
+
+void sendBatchedPhotos(OfflineCapture** captures, int count) {
+  unsigned long start = millis();
+  for (int i = 0; i < count; i++) correctCaptureTime(captures[i]->header);
+  bool ok = WiFi.status() == WL_CONNECTED && sendTelegramBatch(captures, count);
+  countMetric(metricCounters.uploads);
+  if (!ok) countMetric(metricCounters.uploadFailures);
+
+  telegramBatches++;
+  telegramBatchedPhotos += count;
+  if (!ok) telegramBatchFailures++;
+  Serial.printf("📤 Telegram batch of %d %s in %lu ms\n", count, ok ? "sent" : "failed", millis() - start);
+
+  for (int i = 0; i < count; i++) {
+    recordLatency(STAGE_TELEGRAM_BATCH, millis() - captures[i]->queuedAt);
+    if (ok || !OFFLINE_QUEUE_ENABLED) {
+      free(captures[i]->data);
+      delete captures[i];
+    } else {
+      handOfflineCapture(captures[i]);
+    }
+  }
+  if (ok) kickOfflineDrain();
+}
+
+void telegramBatchTask(void*) {
+  OfflineCapture* captures[TELEGRAM_BATCH_MAX];
+  while (true) {
+    xQueueReceive(telegramBatchQueue, &captures[0], portMAX_DELAY);
+    telegramBatchBusy = true;
+
+    int count = 1;
+    if (telegramBatchPolicy == BATCH_THROUGHPUT_FIRST) {
+      while (count < TELEGRAM_BATCH_MAX) {
+        long remaining = TELEGRAM_BATCH_WINDOW - (long)(millis() - captures[0]->queuedAt);
+        if (remaining <= 0 || xQueueReceive(telegramBatchQueue, &captures[count], pdMS_TO_TICKS(remaining)) != pdTRUE) break;
+        count++;
+      }
+    } else {
+      // whatever queued up while the last request was out
+      while (count < TELEGRAM_BATCH_MAX && xQueueReceive(telegramBatchQueue, &captures[count], 0) == pdTRUE) count++;
+    }
+
+    sendBatchedPhotos(captures, count);
+    telegramBatchBusy = false;
+  }
+}
+
+void initializeTelegramBatching() {
+  telegramBatchQueue = xQueueCreate(TELEGRAM_BATCH_MAX, sizeof(OfflineCapture*));
+  if (telegramBatchQueue == NULL ||
+      xTaskCreatePinnedToCore(telegramBatchTask, "tg_batch", UPLOAD_TASK_STACK, NULL, UPLOAD_TASK_PRIORITY, NULL, NETWORK_CORE) != pdPASS) {
+    if (telegramBatchQueue != NULL) vQueueDelete(telegramBatchQueue);
+    telegramBatchQueue = NULL;
+    Serial.println("❌ Could not start Telegram batch task - photos are sent one by one");
+    return;
+  }
+
+  if (telegramBatchPolicy == BATCH_THROUGHPUT_FIRST) {
+    Serial.printf("✓ Telegram batching: up to %d photos, throughput-first (%d ms window)\n",
+                  TELEGRAM_BATCH_MAX, TELEGRAM_BATCH_WINDOW);
+  } else {
+    Serial.printf("✓ Telegram batching: up to %d photos, latency-first\n", TELEGRAM_BATCH_MAX);
+  }
+}
+
+void printTelegramBatchStats() {
+  if (telegramBatches == 0) return;
+  Serial.printf("  Telegram batches %u (%u failed), %u photos, %u.%u per request\n",
+                telegramBatches, telegramBatchFailures, telegramBatchedPhotos,
+                telegramBatchedPhotos / telegramBatches, telegramBatchedPhotos * 10 / telegramBatches % 10);
+}
+
+// =============================================
+// METRICS
+// - one fixed-size histogram per stage, so recording never allocates and
+//   the memory cost does not grow with uptime
+// - percentiles are read from the buckets and reported as the bucket's
+//   upper bound (capped at the largest value seen)
+// - "metrics" on the serial console prints a snapshot; the same numbers go
+//   to the server as a compact key=value record with every upload
+// =============================================
+void recordLatency(MetricStage stage, unsigned long ms) {
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKETS - 1 && ms > latencyBucketBounds[bucket]) bucket++;
+
+  portENTER_CRITICAL(&metricsLock);
+  LatencyHistogram &h = stageHistograms[stage];
+  h.counts[bucket]++;
+  h.total++;
+  if (ms > h.maxMs) h.maxMs = ms;
+  portEXIT_CRITICAL(&metricsLock);
+}
+
+void countMetric(uint32_t &counter, uint32_t amount) {
+  portENTER_CRITICAL(&metricsLock);
+  counter += amount;
+  portEXIT_CRITICAL(&metricsLock);
+}
+
+uint32_t histogramPercentile(const LatencyHistogram &h, int percent) {
+  if (h.total == 0) return 0;
+  uint32_t rank = (h.total * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS - 1; i++) {
+    seen += h.counts[i];
+    if (seen >= rank) return min((uint32_t)latencyBucketBounds[i], h.maxMs);
+  }
+  return h.maxMs;
+}
+
+// Copies everything under the lock so printing never blocks recorders
+void snapshotMetrics(LatencyHistogram* histograms, MetricCounters &counters) {
+  portENTER_CRITICAL(&metricsLock);
+  memcpy(histograms, stageHistograms, sizeof(stageHistograms));
+  counters = metricCounters;
+  portEXIT_CRITICAL(&metricsLock);
+}
+
+void printMetrics() {
+  LatencyHistogram histograms[METRIC_STAGE_COUNT];
+  MetricCounters counters;
+  snapshotMetrics(histograms, counters);
+
+  Serial.printf("📊 Metrics after %lu s (ms):\n", millis() / 1000);
+  Serial.println("  stage          n    p50    p95    p99    max");
+  for (int i = 0; i < METRIC_STAGE_COUNT; i++) {
+    const LatencyHistogram &h = histograms[i];
+    Serial.printf("  %-9s %6u %6u %6u %6u %6u\n", metricStageNames[i], h.total,
+                  histogramPercentile(h, 50), histogramPercentile(h, 95), histogramPercentile(h, 99), h.maxMs);
+  }
+  Serial.printf("  captures %u (%u failed), uploads %u (%u failed, %u retries), %u KB sent\n",
+                counters.captures, counters.captureFailures, counters.uploads,
+                counters.uploadFailures, counters.uploadRetries, counters.bytesSent / 1024);
+  Serial.printf("  duplicates suppressed %u (%u KB not uploaded)\n", counters.duplicates, counters.duplicateBytes / 1024);
+  Serial.printf("  server uploads %s, %u KB resent\n", resumableServer ? "resumable" : "plain", counters.resentBytes / 1024);
+  if (FRAME_RING_ENABLED) {
+    Serial.printf("  frame ring %u of %u KB PSRAM, %u frames stored, %u dropped\n",
+                  (unsigned)(frameRingPsramUsed() / 1024), (unsigned)(FRAME_RING_PSRAM_BUDGET / 1024),
+                  ringFramesStored, ringFramesDropped);
+  }
+  if (displayAvailable) {
+    Serial.printf("  display: %u updates, last %u B, avg %u B, %u unchanged skipped\n", displayUpdates,
+                  displayBytesLast, displayUpdates ? displayBytesTotal / displayUpdates : 0, displaySkipped);
+  }
+  printTelegramBatchStats();
+  printRemoteTriggerStats();
+  printPipelineStats();
+}
+
+// e.g. "cam=CAM001;up=812;grab=3,20,30,30;tls=2,700,1000,1000;...;cap=3,0;upl=6,1,0;tx=145210"
+// stages are n,p50,p95,p99 and are left out until they have samples
+size_t formatMetricsRecord(char* out, size_t len) {
+  LatencyHistogram histograms[METRIC_STAGE_COUNT];
+  MetricCounters counters;
+  snapshotMetrics(histograms, counters);
+
+  size_t used = snprintf(out, len, "cam=%s;up=%lu", CAMERA_ID, millis() / 1000);
+  for (int i = 0; i < METRIC_STAGE_COUNT && used < len; i++) {
+    const LatencyHistogram &h = histograms[i];
+    if (h.total == 0) continue;
+    used += snprintf(out + used, len - used, ";%s=%u,%u,%u,%u", metricStageNames[i], h.total,
+                     histogramPercentile(h, 50), histogramPercentile(h, 95), histogramPercentile(h, 99));
+  }
+  if (used < len) {
+    used += snprintf(out + used, len - used, ";cap=%u,%u;upl=%u,%u,%u;tx=%u;rtx=%u;dup=%u",
+                     counters.captures, counters.captureFailures, counters.uploads, counters.uploadFailures,
+                     counters.uploadRetries, counters.bytesSent, counters.resentBytes, counters.duplicates);
+  }
+  if (used < len) {
+    // free, low-water, largest block, lowest largest block; bytes
+    used += snprintf(out + used, len - used, ";heap=%u,%u,%u,%u", (unsigned)heapMonitor.freeNow,
+                     (unsigned)heapMonitor.freeLow, (unsigned)heapMonitor.largestNow, (unsigned)heapMonitor.largestLow);
+  }
+  if (FRAME_RING_ENABLED && used < len) {
+    // PSRAM held, PSRAM budget (bytes), frames dropped
+    used += snprintf(out + used, len - used, ";ring=%u,%u,%u", (unsigned)frameRingPsramUsed(),
+                     (unsigned)FRAME_RING_PSRAM_BUDGET, ringFramesDropped);
+  }
+  if (displayAvailable && used < len) {
+    // bytes of the last update, average bytes per update, unchanged updates skipped
+    used += snprintf(out + used, len - used, ";oled=%u,%u,%u", displayBytesLast,
+                     displayUpdates ? displayBytesTotal / displayUpdates : 0, displaySkipped);
+  }
+  return min(used, len - 1);
+}
+
+// =============================================
+// SERIAL COMMANDS
+// - a low-priority task reads newline-terminated commands from the console
+// =============================================
+void handleSerialCommand(const char* command) {
+  if (strcmp(command, "metrics") == 0) {
+    printMetrics();
+  } else if (strcmp(command, "health") == 0) {
+    printSupervisorStats();
+    printHeapStats();
+    printTimeStats();
+  } else if (strcmp(command, "power") == 0) {
+    printPowerStats();
+  } else if (strncmp(command, "burst", 5) == 0 && (command[5] == '\0' || command[5] == ' ')) {
+    startBurstTest(command[5] == ' ' ? atoi(command + 6) : 5);
+  } else if (strncmp(command, "sensor", 6) == 0 && (command[6] == '\0' || command[6] == ' ')) {
+    handleSensorCommand(command[6] == ' ' ? command + 7 : "");
+  } else {
+    Serial.printf("❓ Unknown command '%s' (try: metrics, health, power, burst [n], sensor [profile])\n", command);
+  }
+}
+
+void serialCommandTask(void*) {
+  char command[SERIAL_COMMAND_MAX];
+  size_t len = 0;
+
+  while (true) {
+    while (Serial.available()) {
+      // the UART wake of an automatic light sleep is not reported, so the
+      // input itself keeps the board awake
+      if (autoLightSleep) serialAwakeUntil = millis() + IDLE_SERIAL_AWAKE;
+      char c = Serial.read();
+      if (c == '\r' || c == '\n') {
+        if (len > 0) {
+          command[len] = '\0';
+          handleSerialCommand(command);
+          len = 0;
+        }
+      } else if (len < sizeof(command) - 1) {
+        command[len++] = c;
+      }
+    }
+    vTaskDelay(pdMS_TO_TICKS(100));
+  }
+}
+
+void initializeSerialCommands() {
+  xTaskCreate(serialCommandTask, "serial_cmd", SERIAL_COMMAND_TASK_STACK, NULL, 1, NULL);
+}
+
+// =============================================
+// CONNECTION MANAGER
+// - one HTTP/1.1 keep-alive TLS socket per host, kept open between captures
+// - a socket is only reopened when the peer closed it, it sat idle past
+//   KEEPALIVE_IDLE_TIMEOUT, or the last response asked for close
+// - no TLS session resumption: WiFiClientSecure::connect() runs
+//   start_ssl_client(), which sets up the mbedTLS context and handshakes in
+//   one call, so there is no point to hand it a saved session. A reopen is
+//   a full handshake; handshake time vs reuse is tracked per host
+// =============================================
+void initializeConnections() {
+  if (TELEGRAM_VERIFY_CERT) {
+    clientTCP.setCACert(TELEGRAM_CERTIFICATE_ROOT);
+    telegramPollClient.setCACert(TELEGRAM_CERTIFICATE_ROOT);
+  } else {
+    clientTCP.setInsecure();
+    telegramPollClient.setInsecure();
+  }
+  serverClient.setInsecure();  // disable SSL verification for simplicity
+
+  if (telegramConn.lock == NULL) telegramConn.lock = xSemaphoreCreateMutex();
+  if (serverConn.lock == NULL) serverConn.lock = xSemaphoreCreateMutex();
+  telegramPollConn.quiet = true;
+  if (telegramPollConn.lock == NULL) telegramPollConn.lock = xSemaphoreCreateMutex();
+
+  Serial.println("✓ Connection manager ready (keep-alive)");
+}
+
+WiFiClientSecure* acquireConnection(HostConnection &conn, const char* host) {
+  if (xSemaphoreTake(conn.lock, pdMS_TO_TICKS(CONNECTION_LOCK_TIMEOUT)) != pdTRUE) {
+    Serial.printf("⚠️ %s connection busy\n", conn.name);
+    return NULL;
+  }
+
+  WiFiClientSecure* client = conn.client;
+  bool idleTooLong = millis() - conn.lastUsed > KEEPALIVE_IDLE_TIMEOUT;
+
+  if (client->connected() && !idleTooLong) {
+    // drop anything left over from a previous response
+    while (client->available()) client->read();
+    conn.reused = true;
+    conn.reuses++;
+    if (!conn.quiet) Serial.printf("♻️ Reusing %s connection\n", conn.name);
+    return client;
+  }
+
+  client->stop();
+  conn.reused = false;
+
+  unsigned long start = millis();
+  if (!client->connect(host, httpsPort)) {
+    conn.handshakeFailures++;
+    Serial.printf("❌ %s TLS connect failed after %lu ms\n", conn.name, millis() - start);
+    xSemaphoreGive(conn.lock);
+    return NULL;
+  }
+
+  unsigned long elapsed = millis() - start;
+  recordLatency(STAGE_TLS_CONNECT, elapsed);
+  conn.handshakes++;
+  conn.handshakeTimeTotal += elapsed;
+  if (elapsed > conn.handshakeTimeMax) conn.handshakeTimeMax = elapsed;
+  Serial.printf("🔐 %s TLS handshake: %lu ms\n", conn.name, elapsed);
+  return client;
+}
+
+void releaseConnection(HostConnection &conn, bool keepAlive) {
+  if (!keepAlive) conn.client->stop();
+  conn.lastUsed = millis();
+  xSemaphoreGive(conn.lock);
+}
+
+void printConnectionStats(HostConnection &conn) {
+  uint32_t requests = conn.handshakes + conn.reuses;
+  if (requests == 0) return;
+
+  Serial.printf("📊 %s: %u requests, %u handshakes (avg %lu ms, max %lu ms, %u failed), reuse %u%%\n",
+                conn.name, requests, conn.handshakes,
+                conn.handshakes ? conn.handshakeTimeTotal / conn.handshakes : 0UL,
+                conn.handshakeTimeMax, conn.handshakeFailures, conn.reuses * 100 / requests);
+}
+
+// =============================================
+// HTTP RESPONSE PARSER
+// - bytes are fed as they arrive; there are no Strings and no allocation,
+//   the parser and its buffers sit on the caller's stack
+// - httpFeed() stops right after the status line so the caller has the
+//   status as soon as it arrives, then continues with headers and body
+// - Content-Length and chunked framing say exactly where the response
+//   ends, so draining it never waits on a timeout
+// =============================================
+// Clears the parse state only; rx[] keeps bytes already read off the
+// socket, which after an interim 1xx response are the real response
+void httpParseReset(HttpResponse &response) {
+  response.stage = HTTP_STATUS_LINE;
+  response.status = -1;
+  response.keepAlive = false;
+  response.chunked = false;
+  response.remaining = -1;
+  response.lineLen = 0;
+  response.bodyLen = 0;
+  response.body[0] = '\0';
+  response.uploadOffset = -1;
+}
+
+void httpResponseBegin(HttpResponse &response) {
+  response.rxPos = 0;
+  response.rxLen = 0;
+  httpParseReset(response);
+}
+
+// Case-insensitive match of a header name, returns its value or NULL
+const char* httpHeaderValue(const char* line, const char* name) {
+  size_t len = strlen(name);
+  if (strncasecmp(line, name, len) != 0 || line[len] != ':') return NULL;
+  const char* value = line + len + 1;
+  while (*value == ' ' || *value == '\t') value++;
+  return value;
+}
+
+bool httpHeaderHas(const char* value, const char* token) {
+  size_t len = strlen(token);
+  for (; *value; value++) {
+    if (strncasecmp(value, token, len) == 0) return true;
+  }
+  return false;
+}
+
+// Handles one complete status, header, chunk-size or trailer line
+void httpOnLine(HttpResponse &r) {
+  const char* line = r.line;
+  const char* value;
+
+  switch (r.stage) {
+    case HTTP_STATUS_LINE:
+      if (strncmp(line, "HTTP/1.", 7) != 0 || r.lineLen < 12) {
+        r.stage = HTTP_FAILED;
+        return;
+      }
+      r.status = atoi(line + 9);
+      r.keepAlive = line[7] == '1';
+      r.stage = HTTP_HEADERS;
+      break;
+
+    case HTTP_HEADERS:
+      if (r.lineLen > 0) {
+        if ((value = httpHeaderValue(line, "Content-Length")) != NULL) {
+          r.remaining = strtol(value, NULL, 10);
+        } else if ((value = httpHeaderValue(line, "Transfer-Encoding")) != NULL) {
+          r.chunked = httpHeaderHas(value, "chunked");
+        } else if ((value = httpHeaderValue(line, "Connection")) != NULL) {
+          if (httpHeaderHas(value, "close")) r.keepAlive = false;
+          if (httpHeaderHas(value, "keep-alive")) r.keepAlive = true;
+        } else if ((value = httpHeaderValue(line, "Upload-Offset")) != NULL) {
+          r.uploadOffset = strtol(value, NULL, 10);
+        }
+        return;
+      }
+      // end of headers: pick the body framing
+      if (r.status >= 100 && r.status < 200) {
+        httpParseReset(r);              // interim response, the real one follows
+        return;
+      }
+      if (r.chunked) {
+        r.stage = HTTP_CHUNK_SIZE;
+      } else if (r.remaining > 0) {
+        r.stage = HTTP_BODY;
+      } else if (r.remaining == 0 || r.status == 204 || r.status == 304) {
+        r.stage = HTTP_DONE;
+      } else {
+        r.stage = HTTP_BODY_UNTIL_CLOSE;
+        r.keepAlive = false;
+      }
+      break;
+
+    case HTTP_CHUNK_SIZE:
+      r.remaining = strtol(line, NULL, 16);
+      r.stage = r.remaining > 0 ? HTTP_CHUNK_DATA : HTTP_TRAILERS;
+      break;
+
+    case HTTP_CHUNK_END:
+      r.stage = r.lineLen == 0 ? HTTP_CHUNK_SIZE : HTTP_FAILED;
+      break;
+
+    case HTTP_TRAILERS:
+      if (r.lineLen == 0) r.stage = HTTP_DONE;
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Keeps the first HTTP_BODY_MAX body bytes
+void httpKeepBody(HttpResponse &r, const uint8_t* data, size_t len) {
+  size_t room = HTTP_BODY_MAX - r.bodyLen;
+  if (len > room) len = room;
+  memcpy(r.body + r.bodyLen, data, len);
+  r.bodyLen += len;
+  r.body[r.bodyLen] = '\0';
+}
+
+// Parses up to len bytes and returns how many were consumed. Stops early
+// once a final (non-1xx) status line is complete.
+size_t httpFeed(HttpResponse &r, const uint8_t* data, size_t len) {
+  size_t i = 0;
+  while (i < len && r.stage < HTTP_DONE) {
+    if (r.stage == HTTP_BODY || r.stage == HTTP_CHUNK_DATA) {
+      size_t n = min((size_t)r.remaining, len - i);
+      httpKeepBody(r, data + i, n);
+      i += n;
+      r.remaining -= n;
+      if (r.remaining == 0) r.stage = r.stage == HTTP_BODY ? HTTP_DONE : HTTP_CHUNK_END;
+      continue;
+    }
+    if (r.stage == HTTP_BODY_UNTIL_CLOSE) {
+      httpKeepBody(r, data + i, len - i);
+      return len;
+    }
+
+    char c = data[i++];
+    if (c != '\n') {
+      if (c != '\r' && r.lineLen < HTTP_LINE_MAX - 1) r.line[r.lineLen++] = c;
+      continue;
+    }
+    r.line[r.lineLen] = '\0';
+    bool statusLine = r.stage == HTTP_STATUS_LINE;
+    httpOnLine(r);
+    r.lineLen = 0;
+    if (statusLine && r.status >= 200) break;
+  }
+  return i;
+}
+
+// Feeds socket bytes to the parser until the status is known (untilStatus)
+// or the whole response is consumed, so the socket is clean for the next
+// request. Returns the status code, or -1 if none arrived.
+int readHttpResponse(WiFiClientSecure &client, HttpResponse &r, bool untilStatus) {
+  unsigned long deadline = millis() + HTTP_RESPONSE_TIMEOUT;
+
+  while (r.stage < HTTP_DONE && (!untilStatus || r.status < 200)) {
+    if (r.rxPos < r.rxLen) {
+      r.rxPos += httpFeed(r, r.rx + r.rxPos, r.rxLen - r.rxPos);
+      continue;
+    }
+    if ((long)(deadline - millis()) <= 0) {
+      r.stage = HTTP_FAILED;
+      break;
+    }
+
+    int avail = client.available();
+    if (avail <= 0) {
+      if (!client.connected()) {
+        r.stage = r.stage == HTTP_BODY_UNTIL_CLOSE ? HTTP_DONE : HTTP_FAILED;
+        break;
+      }
+      delay(1);
+      continue;
+    }
+
+    int n = client.read(r.rx, min(avail, (int)sizeof(r.rx)));
+    if (n <= 0) continue;
+    r.rxPos = 0;
+    r.rxLen = n;
+  }
+
+  // anything unparsed past the end would corrupt the next response
+  if (r.stage == HTTP_FAILED || (r.stage == HTTP_DONE && r.rxPos < r.rxLen)) r.keepAlive = false;
+  return r.status;
+}
+
+// =============================================
+// MULTIPART ENCODER
+// - one multipart/form-data writer for both uploads, no Strings and no heap
+// - the fixed pieces are string literals, so their lengths are sizeof()
+//   constants and Content-Length is known before the first byte goes out
+// - output goes through the connection's TLS_RECORD_SIZE buffer: small
+//   pieces are gathered into one record, and large bodies are written
+//   straight from the frame in whole records, so every write() fills an
+//   mbedTLS record instead of sending many small ones
+// =============================================
+struct MultipartPart {
+  const char* name;
+  const char* filename;         // NULL for a plain form field
+  const uint8_t* data;
+  size_t len;
+};
+
+#define LITERAL_LEN(s) (sizeof(s) - 1)
+#define PART_HEAD_START "--" MULTIPART_BOUNDARY "\r\nContent-Disposition: form-data; name=\""
+#define PART_HEAD_FIELD_END "\"\r\n\r\n"
+#define PART_HEAD_FILE_MID "\"; filename=\""
+#define PART_HEAD_FILE_END "\"\r\nContent-Type: image/jpeg\r\n\r\n"
+#define PART_END "\r\n"
+#define MULTIPART_END "--" MULTIPART_BOUNDARY "--\r\n"
+
+struct RecordWriter {
+  WiFiClientSecure* client;
+  uint8_t* record;
+  size_t used;
+  bool ok;
+  size_t pos;                   // body bytes passed in so far
+  size_t from;                  // only body bytes in [from, to) are sent
+  size_t to;
+  size_t written = 0;           // bytes the client took, a cut-off record's included
+};
 
-  int httpCode = http.GET();
+void recordFlush(RecordWriter &w) {
+  if (w.used > 0 && w.ok) {
+    size_t n = w.client->write(w.record, w.used);
+    w.written += n;
+    w.ok = n == w.used;
+  }
+  w.used = 0;
+}
 
-  if (httpCode > 0) {
-    Serial.printf("📡 Response code: %d\n", httpCode);
-  } else {
-    Serial.printf("❌ Error: %s\n", http.errorToString(httpCode).c_str());
+void recordWrite(RecordWriter &w, const void* data, size_t len) {
+  const uint8_t* p = (const uint8_t*)data;
+
+  // clip to the window, so a chunk is the same encoder run over a range
+  size_t start = w.pos;
+  w.pos += len;
+  if (w.pos <= w.from || start >= w.to) return;
+  if (start < w.from) {
+    p += w.from - start;
+    len -= w.from - start;
+    start = w.from;
   }
+  if (start + len > w.to) len = w.to - start;
+  if (!w.ok) return;            // the link dropped, nothing more goes out
 
-  http.end();
+  // top up the pending record first
+  if (w.used > 0) {
+    size_t n = min(len, (size_t)TLS_RECORD_SIZE - w.used);
+    memcpy(w.record + w.used, p, n);
+    w.used += n;
+    p += n;
+    len -= n;
+    if (w.used == TLS_RECORD_SIZE) recordFlush(w);
+  }
 
-  if (httpCode > 0 && httpCode < 400) {
-    Serial.println("✅ Cloud server is REACHABLE!");
-    return true;
-  } else {
-    Serial.println("❌ Server not reachable - will use Telegram only");
+  // whole records go out without a copy
+  while (len >= TLS_RECORD_SIZE && w.ok) {
+    size_t n = w.client->write(p, TLS_RECORD_SIZE);
+    w.written += n;
+    w.ok = n == TLS_RECORD_SIZE;
+    p += TLS_RECORD_SIZE;
+    len -= TLS_RECORD_SIZE;
+  }
+  // a failed write leaves the rest unsent rather than staged
+  if (!w.ok) return;
+
+  if (len > 0) {
+    memcpy(w.record + w.used, p, len);
+    w.used += len;
+  }
+}
+
+void recordPrint(RecordWriter &w, const char* text) {
+  recordWrite(w, text, strlen(text));
+}
+
+size_t multipartPartLen(const MultipartPart &part) {
+  size_t len = LITERAL_LEN(PART_HEAD_START) + strlen(part.name) + part.len + LITERAL_LEN(PART_END);
+  if (part.filename == NULL) return len + LITERAL_LEN(PART_HEAD_FIELD_END);
+  return len + LITERAL_LEN(PART_HEAD_FILE_MID) + strlen(part.filename) + LITERAL_LEN(PART_HEAD_FILE_END);
+}
+
+size_t multipartBodyLen(const MultipartPart* parts, int count) {
+  size_t len = LITERAL_LEN(MULTIPART_END);
+  for (int i = 0; i < count; i++) len += multipartPartLen(parts[i]);
+  return len;
+}
+
+void writeMultipartBody(RecordWriter &w, const MultipartPart* parts, int count) {
+  for (int i = 0; i < count; i++) {
+    const MultipartPart &part = parts[i];
+    recordPrint(w, PART_HEAD_START);
+    recordPrint(w, part.name);
+    if (part.filename == NULL) {
+      recordPrint(w, PART_HEAD_FIELD_END);
+    } else {
+      recordPrint(w, PART_HEAD_FILE_MID);
+      recordPrint(w, part.filename);
+      recordPrint(w, PART_HEAD_FILE_END);
+    }
+    recordWrite(w, part.data, part.len);
+    recordPrint(w, PART_END);
+  }
+  recordPrint(w, MULTIPART_END);
+  recordFlush(w);
+}
+
+// Writes a whole multipart POST on the connection's socket (held by the caller);
+// bodySent gets the body bytes that went out, also when the write failed
+bool sendMultipartRequest(HostConnection &conn, const char* host, const char* path,
+                          const MultipartPart* parts, int count, size_t* bodySent) {
+  unsigned long start = millis();
+  size_t contentLength = multipartBodyLen(parts, count);
+
+  RecordWriter w = { conn.client, conn.record, 0, true, 0, 0, SIZE_MAX };
+  w.used = snprintf((char*)w.record, TLS_RECORD_SIZE,
+                    "POST %s HTTP/1.1\r\n"
+                    "Host: %s\r\n"
+                    "User-Agent: ESP32CAM\r\n"
+                    "Connection: keep-alive\r\n"
+                    "Content-Type: multipart/form-data; boundary=" MULTIPART_BOUNDARY "\r\n"
+                    "Content-Length: %u\r\n\r\n",
+                    path, host, (unsigned)contentLength);
+  size_t headLen = w.used;
+  writeMultipartBody(w, parts, count);
+  if (bodySent) *bodySent = w.written > headLen ? w.written - headLen : 0;
+
+  if (!w.ok) {
+    Serial.printf("⚠️ %s request write failed\n", conn.name);
     return false;
   }
+  recordLatency(STAGE_REQUEST_WRITE, millis() - start);
+  countMetric(metricCounters.bytesSent, headLen + contentLength);
+  return true;
+}
+
+// Posts a multipart form on a kept-alive connection and reads the reply.
+// A reused socket may have been dropped by the peer while idle, so a
+// request that got no status on one is retried once on a fresh socket.
+// Returns the status code, or -1.
+int postMultipart(HostConnection &conn, const char* host, const char* path,
+                  const MultipartPart* parts, int count, HttpResponse &response) {
+  for (int attempt = 0; attempt < 2; attempt++) {
+    WiFiClientSecure* client = acquireConnection(conn, host);
+    if (client == NULL) {
+      Serial.printf("❌ %s connection failed\n", conn.name);
+      return -1;
+    }
+
+    httpResponseBegin(response);
+    int statusCode = -1;
+    size_t bodySent = 0;
+    if (sendMultipartRequest(conn, host, path, parts, count, &bodySent)) {
+      unsigned long waitStart = millis();
+      statusCode = readHttpResponse(*client, response, true);
+      if (statusCode > 0) {
+        recordLatency(STAGE_FIRST_BYTE, millis() - waitStart);
+        Serial.printf("📡 %s status %d after %lu ms\n", conn.name, statusCode, millis() - waitStart);
+        readHttpResponse(*client, response, false);  // drain the body so the socket can be reused
+      }
+    }
+    bool retry = statusCode < 0 && conn.reused;
+    releaseConnection(conn, response.keepAlive);
+
+    if (retry) {
+      countMetric(metricCounters.uploadRetries);
+      if (&conn == &serverConn) countMetric(metricCounters.resentBytes, bodySent);
+      Serial.printf("⚠️ Reused %s connection dropped, retrying...\n", conn.name);
+      continue;
+    }
+
+    printConnectionStats(conn);
+    return statusCode;
+  }
+  return -1;
 }
 
 // =============================================
-// IMAGE CAPTURE AND PROCESSING
+// RESUMABLE UPLOAD
+// - the body is the same multipart form the plain POST carries; it is
+//   sent as byte ranges of at most UPLOAD_CHUNK_SIZE:
+//     PATCH /upload/<id>   Upload-Offset: <n>, Upload-Length: <total>,
+//                          Upload-Chunk: <k>, Upload-Content-Type: <form type>
+//       204 + Upload-Offset: <n + len>    chunk stored
+//       409 + Upload-Offset: <stored>     wrong offset, continue from there
+//       2xx + reply body, when the last byte arrives: the server handles the
+//       assembled form like POST /test and answers with its reply
+//     GET /upload/<id>     200 + Upload-Offset: <stored> (0 if unknown)
+// - the ID is chosen here (camera, per-boot salt, sequence), so a resume
+//   needs no state from the first request
+// - after a drop or stall only the GET and the unacknowledged tail are
+//   sent again; a server keeps what it received of a cut-off chunk
 // =============================================
-void captureAndProcessImage() {
-  Serial.println("📸 Starting image capture process...");
+// bodySent: body bytes that went out, also when the link dropped mid-chunk
+bool sendUploadRequest(HostConnection &conn, const char* host, const char* id, const MultipartPart* parts,
+                       int count, size_t total, size_t offset, size_t len, int chunk, size_t &bodySent) {
+  unsigned long start = millis();
+  RecordWriter w = { conn.client, conn.record, 0, true, 0, offset, offset + len };
 
-  camera_fb_t * fb = esp_camera_fb_get();
-  if(fb) {
-    esp_camera_fb_return(fb);
-    Serial.println("  Cleared old frame");
+  bodySent = 0;
+  if (len == 0) {
+    w.used = snprintf((char*)w.record, TLS_RECORD_SIZE,
+                      "GET " UPLOAD_PATH "/%s HTTP/1.1\r\n"
+                      "Host: %s\r\n"
+                      "User-Agent: ESP32CAM\r\n"
+                      "Connection: keep-alive\r\n\r\n",
+                      id, host);
+    recordFlush(w);
+    return w.ok;
   }
-  delay(200);
 
-  fb = NULL;
-  for(int i = 0; i < 3; i++) {
-    fb = esp_camera_fb_get();
-    if(fb && fb->len > 0) {
-      Serial.printf("✓ Capture successful on attempt %d\n", i+1);
-      break;
-    }
-    if(fb) esp_camera_fb_return(fb);
-    Serial.printf("⚠️ Capture attempt %d failed, retrying...\n", i+1);
-    delay(200);
+  w.used = snprintf((char*)w.record, TLS_RECORD_SIZE,
+                    "PATCH " UPLOAD_PATH "/%s HTTP/1.1\r\n"
+                    "Host: %s\r\n"
+                    "User-Agent: ESP32CAM\r\n"
+                    "Connection: keep-alive\r\n"
+                    "Upload-Offset: %u\r\n"
+                    "Upload-Length: %u\r\n"
+                    "Upload-Chunk: %d\r\n"
+                    "Upload-Content-Type: multipart/form-data; boundary=" MULTIPART_BOUNDARY "\r\n"
+                    "Content-Type: application/offset+octet-stream\r\n"
+                    "Content-Length: %u\r\n\r\n",
+                    id, host, (unsigned)offset, (unsigned)total, chunk, (unsigned)len);
+  size_t headLen = w.used;
+  writeMultipartBody(w, parts, count);
+  bodySent = w.written > headLen ? w.written - headLen : 0;
+
+  if (!w.ok) {
+    Serial.printf("⚠️ %s chunk %d write failed\n", conn.name, chunk);
+    return false;
   }
+  recordLatency(STAGE_REQUEST_WRITE, millis() - start);
+  countMetric(metricCounters.bytesSent, headLen + len);
+  return true;
+}
 
-  if (!fb || fb->len == 0) {
-    Serial.println("❌ Camera capture failed after 3 attempts!");
-    displayMessage("CAPTURE FAILED", "Camera error", "Press to restart");
-    systemError = true;
-    delay(2000);
+// Returns the final status code, 0 if the server refused the first chunk
+// (nothing was stored; response.status says how), or -1
+int postResumable(HostConnection &conn, const char* host, const MultipartPart* parts, int count,
+                  HttpResponse &response) {
+  if (uploadIdSalt == 0) uploadIdSalt = esp_random() | 1;
+  char id[48];
+  snprintf(id, sizeof(id), "%s-%08x-%u", CAMERA_ID, (unsigned)uploadIdSalt, (unsigned)++uploadSequence);
+
+  size_t total = multipartBodyLen(parts, count);
+  size_t offset = 0;
+  size_t sent = 0;              // body bytes written, resends included
+  bool askOffset = false;
+  int chunk = 0;
+  int failures = 0;
+  unsigned long start = millis();
+
+  while (failures <= UPLOAD_RESUME_ATTEMPTS) {
+    if (askOffset) delay(UPLOAD_RESUME_BACKOFF * failures);
 
-    while(1) {
-      checkButtonForRestart();
-      delay(100);
+    WiFiClientSecure* client = acquireConnection(conn, host);
+    if (client == NULL) {
+      failures++;
+      askOffset = true;
+      continue;
     }
-    return;
-  }
 
-  captureCount++;
-  String timestamp = getTimestamp();
+    size_t len = askOffset ? 0 : min((size_t)UPLOAD_CHUNK_SIZE, total - offset);
+    httpResponseBegin(response);
+    int statusCode = -1;
+    size_t bodySent = 0;
+    bool requestSent = sendUploadRequest(conn, host, id, parts, count, total, offset, len, chunk, bodySent);
+    sent += bodySent;
+    if (requestSent) {
+      unsigned long waitStart = millis();
+      statusCode = readHttpResponse(*client, response, true);
+      if (statusCode > 0) {
+        recordLatency(STAGE_FIRST_BYTE, millis() - waitStart);
+        readHttpResponse(*client, response, false);
+      }
+    }
+    releaseConnection(conn, statusCode > 0 && response.keepAlive);
 
-  Serial.printf("✓ Image captured! Size: %d bytes (%d KB)\n", fb->len, fb->len / 1024);
-  Serial.printf("  Resolution: %dx%d\n", fb->width, fb->height);
-  Serial.printf("  Format: %d\n", fb->format);
-  Serial.printf("📷 Camera ID: %s\n", CAMERA_ID);
-  Serial.printf("🕐 Timestamp: %s\n", timestamp.c_str());
+    // the first chunk refused outright (a plain server, or a proxy that
+    // rejects PATCH): nothing stored yet, let the caller POST the form
+    bool refused = statusCode > 0 && (statusCode < 200 || statusCode >= 300) && statusCode != 409;
+    if (offset == 0 && !askOffset && refused) return 0;
 
-  bool uploadSuccess = false;
-  if (WiFi.status() == WL_CONNECTED && serverReachable) {
-    displayMessage("UPLOADING SERVER", String(fb->len / 1024) + " KB", "Please wait...");
-  
-    if (uploadSuccess) {
-      Serial.println("✅ Server upload successful!");
-      displayMessage("SERVER: SUCCESS", "Sending Telegram...");
-      delay(1000);
-    } else {
-      Serial.println("❌ Server upload failed");
-      displayMessage("SERVER: FAILED", "Sending Telegram...");
-      serverReachable = false;
-      delay(1000);
+    bool acked = (statusCode == 200 || statusCode == 204 || statusCode == 409) &&
+                 response.uploadOffset >= 0 && (size_t)response.uploadOffset <= total;
+    // the last byte is in: the reply is the form handler's (a GET repeats it
+    // if the answer to the last chunk was lost)
+    bool done = statusCode >= 200 && statusCode < 300 && statusCode != 204 &&
+                (acked ? (size_t)response.uploadOffset >= total : offset + len >= total);
+    if (done) {
+      if (sent > total) countMetric(metricCounters.resentBytes, sent - total);
+      Serial.printf("📦 Upload %s: %u B in %d chunks, %u B resent, %lu ms\n", id, (unsigned)total,
+                    chunk + (len > 0 ? 1 : 0), (unsigned)(sent - min(sent, total)), millis() - start);
+      printConnectionStats(conn);
+      return statusCode;
     }
-  }
 
-  displayMessage("SENDING TELEGRAM", "Please wait...");
-  bool telegramSuccess = sendPhotoToTelegram(fb);
+    // a chunk the server took nothing of counts as a failure, so a stuck
+    // server cannot keep the loop going
+    if (acked && len > 0 && (size_t)response.uploadOffset == offset) acked = false;
 
-  if (telegramSuccess) {
-    Serial.println("✅ Telegram photo sent successfully!");
-    displayMessage("TELEGRAM: SUCCESS", "Plate #" + String(captureCount), "Complete!");
-  } else {
-    Serial.println("❌ Telegram send failed");
-    displayMessage("TELEGRAM: FAILED", "Check bot settings");
-  }
+    if (acked) {
+      if (len > 0 && statusCode != 409) chunk++;
+      if (statusCode == 409 || askOffset) {
+        Serial.printf("↪️ Upload %s resumes at %ld of %u\n", id, response.uploadOffset, (unsigned)total);
+      }
+      offset = response.uploadOffset;
+      askOffset = false;
+      continue;
+    }
 
-  esp_camera_fb_return(fb);
-  fb = NULL;
+    // dropped, stalled or refused: ask where the server got to
+    failures++;
+    askOffset = true;
+    countMetric(metricCounters.uploadRetries);
+    Serial.printf("⚠️ Upload %s chunk %d failed (%d), resuming (%d/%d)\n", id, chunk, statusCode,
+                  failures, UPLOAD_RESUME_ATTEMPTS);
+  }
 
-  Serial.println("✓ Memory freed, ready for next capture");
-  delay(2000);
+  if (sent > offset) countMetric(metricCounters.resentBytes, sent - offset);
+  return -1;
 }
 
 // =============================================
 // SERVER UPLOAD
 // =============================================
-bool uploadImageToServer(uint8_t *imageData, size_t imageLen, const String &timestamp) {
+bool uploadImageToServer(const uint8_t *imageData, size_t imageLen, const char* timestamp,
+                         const uint8_t* thumbData, size_t thumbLen) {
   Serial.println("🌐 Uploading image to server...");
 
   if (WiFi.status() != WL_CONNECTED) {
@@ -657,152 +4654,638 @@ bool uploadImageToServer(uint8_t *imageData, size_t imageLen, const String &time
     return false;
   }
 
-  WiFiClientSecure client;
-  client.setInsecure();  // disable SSL verification for simplicity
-  client.setTimeout(15000);  // 15s network timeout
+  char metrics[METRICS_RECORD_MAX];
+  MultipartPart parts[4] = {
+    { "file", "image.jpg", imageData, imageLen },
+    { "timestamp", NULL, (const uint8_t*)timestamp, strlen(timestamp) },
+  };
+  int partCount = 2;
+  if (thumbData != NULL) parts[partCount++] = { "thumb", "thumb.jpg", thumbData, thumbLen };
+  if (METRICS_IN_UPLOADS) parts[partCount++] = { "metrics", NULL, (const uint8_t*)metrics, formatMetricsRecord(metrics, sizeof(metrics)) };
 
-  if (!client.connect("web-production-23072.up.railway.app", 443)) {
-    Serial.println("❌ Connection failed");
-    return false;
+  HttpResponse response;
+  int statusCode = 0;
+  if (resumableServer) {
+    statusCode = postResumable(serverConn, serverHost, parts, partCount, response);
+    // a 4xx means PATCH is not taken there at all; a 5xx may pass, so only
+    // this upload goes as a plain POST
+    if (statusCode == 0 && response.status >= 400 && response.status < 500) {
+      resumableServer = false;
+      Serial.printf("⚠️ Server refused resumable uploads (%d) - using plain POST\n", response.status);
+    } else if (statusCode == 0) {
+      Serial.printf("⚠️ Resumable upload refused (%d) - plain POST this time\n", response.status);
+    }
   }
+  if (statusCode == 0) statusCode = postMultipart(serverConn, serverHost, "/test", parts, partCount, response);
+  Serial.printf("📡 Server reply (%d): %s\n", statusCode, response.body);
+  return statusCode >= 200 && statusCode < 300;
+}
 
-  String boundary = "----ESP32Boundary";
-  String startReq =
-    "POST /test HTTP/1.1\r\n"
-    "Host: web-production-23072.up.railway.app\r\n"
-    "User-Agent: ESP32CAM\r\n"
-    "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n"
-    "Connection: close\r\n"
-    "Content-Length: " + String(
-        String("--" + boundary + "\r\n").length() +
-        String("Content-Disposition: form-data; name=\"file\"; filename=\"image.jpg\"\r\n").length() +
-        String("Content-Type: image/jpeg\r\n\r\n").length() +
-        imageLen +
-        String("\r\n--" + boundary + "--\r\n").length()
-      ) + "\r\n\r\n";
-
-  client.print(startReq);
-  client.print("--" + boundary + "\r\n");
-  client.print("Content-Disposition: form-data; name=\"file\"; filename=\"image.jpg\"\r\n");
-  client.print("Content-Type: image/jpeg\r\n\r\n");
-
-  // stream in small chunks to avoid heap exhaustion
-  const size_t CHUNK = 2048;
-  for (size_t i = 0; i < imageLen; i += CHUNK) {
-    size_t len = (i + CHUNK < imageLen) ? CHUNK : (imageLen - i);
-    client.write(imageData + i, len);
-    delay(5); // yield between chunks
-  }
-
-  client.print("\r\n--" + boundary + "--\r\n");
-
-  Serial.println("🕓 Waiting for server response...");
-  unsigned long timeout = millis();
-  while (client.connected() && millis() - timeout < 15000) {
-    String line = client.readStringUntil('\n');
-    if (line.startsWith("HTTP/1.1")) Serial.println(line);
-    if (line == "\r") break;
-  }
-
-  String response = client.readString();
-  Serial.println("📡 Server reply: " + response);
-  client.stop();
-
-  if (response.indexOf("200") != -1 || response.indexOf("OK") != -1)
-    return true;
+// "duplicate of #N" record in place of an image
+bool postDuplicateToServer(int captureNumber, int duplicateOf, int distance, const char* timestamp) {
+  char capture[12], original[12], hamming[8];
+  snprintf(capture, sizeof(capture), "%d", captureNumber);
+  snprintf(original, sizeof(original), "%d", duplicateOf);
+  snprintf(hamming, sizeof(hamming), "%d", distance);
 
-  return false;
+  MultipartPart parts[] = {
+    { "camera", NULL, (const uint8_t*)CAMERA_ID, strlen(CAMERA_ID) },
+    { "capture", NULL, (const uint8_t*)capture, strlen(capture) },
+    { "duplicate_of", NULL, (const uint8_t*)original, strlen(original) },
+    { "distance", NULL, (const uint8_t*)hamming, strlen(hamming) },
+    { "timestamp", NULL, (const uint8_t*)timestamp, strlen(timestamp) },
+  };
+
+  HttpResponse response;
+  int statusCode = postMultipart(serverConn, serverHost, "/test", parts, 5, response);
+  Serial.printf("📡 Server duplicate event (%d): %s\n", statusCode, response.body);
+  return statusCode >= 200 && statusCode < 300;
 }
 
 // =============================================
 // TELEGRAM UPLOAD
 // =============================================
-bool sendPhotoToTelegram(camera_fb_t * fb) {
-  const char* myDomain = "api.telegram.org";
-  String getAll = "";
-  String getBody = "";
+// Telegram reports rejected requests with "ok":false, sometimes behind a 200
+bool telegramAccepted(int statusCode, const HttpResponse &response) {
+  bool ok = statusCode >= 200 && statusCode < 300 && strstr(response.body, "\"ok\":true") != NULL;
+  if (!ok) Serial.printf("❌ Telegram did not accept the request (%d): %s\n", statusCode, response.body);
+  return ok;
+}
 
-  Serial.println("📤 Connecting to Telegram...");
+// "CAM001 #12 2026-01-01 12:00:00" under every photo
+void formatPhotoCaption(char* out, size_t len, int captureNumber, const char* timestamp) {
+  snprintf(out, len, "%s #%d %s", CAMERA_ID, captureNumber, timestamp);
+}
 
-  if (clientTCP.connect(myDomain, 443)) {
-    Serial.println("✓ Connected to Telegram");
+bool sendPhotoToTelegram(const uint8_t* imageData, size_t imageLen, const char* caption) {
+  Serial.println("📤 Sending photo to Telegram...");
 
-    String head = "--ESP32CAM\r\nContent-Disposition: form-data; name=\"chat_id\"; \r\n\r\n" + String(CHAT_ID) + "\r\n--ESP32CAM\r\nContent-Disposition: form-data; name=\"photo\"; filename=\"" + String(CAMERA_ID) + ".jpg\"\r\nContent-Type: image/jpeg\r\n\r\n";
-    String tail = "\r\n--ESP32CAM--\r\n";
+  char filename[32];
+  snprintf(filename, sizeof(filename), "%s.jpg", CAMERA_ID);
 
-    size_t imageLen = fb->len;
-    size_t extraLen = head.length() + tail.length();
-    size_t totalLen = imageLen + extraLen;
+  MultipartPart parts[] = {
+    { "chat_id", NULL, (const uint8_t*)CHAT_ID, LITERAL_LEN(CHAT_ID) },
+    { "photo", filename, imageData, imageLen },
+    { "caption", NULL, (const uint8_t*)caption, caption != NULL ? strlen(caption) : 0 },
+  };
 
-    clientTCP.println("POST /bot" + String(BOTtoken) + "/sendPhoto HTTP/1.1");
-    clientTCP.println("Host: " + String(myDomain));
-    clientTCP.println("Content-Length: " + String(totalLen));
-    clientTCP.println("Content-Type: multipart/form-data; boundary=ESP32CAM");
-    clientTCP.println();
-    clientTCP.print(head);
+  HttpResponse response;
+  int statusCode = postMultipart(telegramConn, telegramHost, "/bot" BOTtoken "/sendPhoto", parts,
+                                 caption != NULL ? 3 : 2, response);
+  return telegramAccepted(statusCode, response);
+}
 
-    uint8_t *fbBuf = fb->buf;
-    size_t fbLen = fb->len;
+// One sendMediaGroup for up to TELEGRAM_BATCH_MAX captures, each image
+// written straight from its PSRAM copy; a single capture goes as sendPhoto
+// since a media group needs at least two
+bool sendTelegramBatch(OfflineCapture* const* captures, int count) {
+  char caption[64];
+  if (count == 1) {
+    formatPhotoCaption(caption, sizeof(caption), captures[0]->header.captureNumber, captures[0]->header.timestamp);
+    return sendPhotoToTelegram(captures[0]->data, captures[0]->header.imageLen, caption);
+  }
 
-    for (size_t n=0; n<fbLen; n=n+1024) {
-      if (n+1024 < fbLen) {
-        clientTCP.write(fbBuf, 1024);
-        fbBuf += 1024;
-      } else if (fbLen % 1024 > 0) {
-        size_t remainder = fbLen % 1024;
-        clientTCP.write(fbBuf, remainder);
-      }
-    }
+  static const char* const attachNames[TELEGRAM_BATCH_MAX] = { "p0", "p1", "p2", "p3", "p4", "p5", "p6", "p7", "p8", "p9" };
+  char media[TELEGRAM_BATCH_MAX * 128];
+  char filenames[TELEGRAM_BATCH_MAX][32];
+  MultipartPart parts[TELEGRAM_BATCH_MAX + 2];
 
-    clientTCP.print(tail);
+  size_t used = snprintf(media, sizeof(media), "[");
+  for (int i = 0; i < count; i++) {
+    const OfflineRecordHeader &h = captures[i]->header;
+    formatPhotoCaption(caption, sizeof(caption), h.captureNumber, h.timestamp);
+    used += snprintf(media + used, sizeof(media) - used, "%s{\"type\":\"photo\",\"media\":\"attach://%s\",\"caption\":\"%s\"}",
+                     i > 0 ? "," : "", attachNames[i], caption);
+    snprintf(filenames[i], sizeof(filenames[i]), "%s-%u.jpg", CAMERA_ID, (unsigned)h.captureNumber);
+    parts[i + 2] = { attachNames[i], filenames[i], captures[i]->data, h.imageLen };
+  }
+  used += snprintf(media + used, sizeof(media) - used, "]");
 
-    int waitTime = 10000;
-    long startTimer = millis();
-    boolean state = false;
+  parts[0] = { "chat_id", NULL, (const uint8_t*)CHAT_ID, LITERAL_LEN(CHAT_ID) };
+  parts[1] = { "media", NULL, (const uint8_t*)media, used };
 
-    while ((startTimer + waitTime) > millis()) {
-      Serial.print(".");
-      delay(100);
-      while (clientTCP.available()) {
-        char c = clientTCP.read();
-        if (state==true) getBody += String(c);
-        if (c == '\n') {
-          if (getAll.length()==0) state=true;
-          getAll = "";
-        }
-        else if (c != '\r')
-          getAll += String(c);
-        startTimer = millis();
-      }
-      if (getBody.length()>0) break;
+  Serial.printf("📤 Sending %d photos to Telegram as one media group...\n", count);
+  HttpResponse response;
+  int statusCode = postMultipart(telegramConn, telegramHost, "/bot" BOTtoken "/sendMediaGroup", parts, count + 2, response);
+  return telegramAccepted(statusCode, response);
+}
+
+bool sendTelegramText(const char* text) {
+  MultipartPart parts[] = {
+    { "chat_id", NULL, (const uint8_t*)CHAT_ID, LITERAL_LEN(CHAT_ID) },
+    { "text", NULL, (const uint8_t*)text, strlen(text) },
+  };
+
+  HttpResponse response;
+  int statusCode = postMultipart(telegramConn, telegramHost, "/bot" BOTtoken "/sendMessage", parts, 2, response);
+  return telegramAccepted(statusCode, response);
+}
+
+// =============================================
+// REMOTE TRIGGERS
+// - Telegram: a task long-polls getUpdates (limit=1, timeout
+//   TELEGRAM_POLL_TIMEOUT) on its own keep-alive socket, so a held poll
+//   never blocks a photo upload on telegramConn. Only CHAT_ID is obeyed
+// - that socket is a third TLS session: its mbedTLS context and record
+//   buffers (HEAP_TLS_MIN_BLOCK) stay allocated in internal RAM for as
+//   long as it is open, which is all the time. It is only (re)opened with
+//   TELEGRAM_POLL_MIN_BLOCK free, room for itself and one upload session
+// - local API: GET /capture queues a capture and answers 202 at once,
+//   GET /status returns a JSON summary
+// - both go straight to the capture queue; the photo arrives in the bot
+//   chat like any other capture. Telegram's "date" has 1 s resolution, so
+//   the measured latency starts when the command reaches the device
+// - the poll and the server keep running through idle light sleep; a
+//   command sent during a sleep slice is picked up on the next wake
+// =============================================
+WebServer localApi(LOCAL_API_PORT);
+uint32_t telegramUpdates = 0;
+uint32_t telegramPollHeapSkips = 0;          // polls skipped for want of a TLS-sized block
+bool telegramPollHeapLow = false;
+uint32_t remoteCommands[TRIGGER_HTTP + 1];
+
+// Queues a remote capture and lets the event loop show it
+bool requestRemoteCapture(CaptureTrigger trigger) {
+  if (faults[FAULT_CAMERA].active) {
+    Serial.printf("⚠️ %s capture refused: camera recovering\n", captureTriggerNames[trigger]);
+    return false;
+  }
+  if (!requestCapture(trigger, 0)) return false;
+
+  remoteCommands[trigger]++;
+  Serial.printf("📨 %s capture queued\n", captureTriggerNames[trigger]);
+  AppEvent event = {};
+  event.type = EVT_REMOTE_TRIGGER;
+  event.at = millis();
+  event.result.trigger = trigger;
+  xQueueSend(appEvents, &event, 0);
+  return true;
+}
+
+size_t formatStatusText(char* out, size_t len) {
+  return snprintf(out, len, "%s: up %lu s, %d captures, WiFi %d dBm, server %s, camera %s, %u uploading, last command to photo %lu ms",
+                  CAMERA_ID, millis() / 1000, captureCount, WiFi.RSSI(), serverReachable ? "online" : "offline",
+                  faults[FAULT_CAMERA].active ? "recovering" : "ok", (unsigned)pipelineDepth(), lastCommandLatency);
+}
+
+// Flat scans of Telegram's JSON; a field cut off past HTTP_BODY_MAX reads as missing
+bool jsonNumber(const char* json, const char* key, long long &value) {
+  const char* p = strstr(json, key);
+  if (p == NULL) return false;
+  p += strlen(key);
+  char* end;
+  value = strtoll(p, &end, 10);
+  return end != p;
+}
+
+bool jsonString(const char* json, const char* key, char* out, size_t len) {
+  const char* p = strstr(json, key);
+  if (p == NULL || len == 0) return false;
+  p += strlen(key);
+  size_t n = 0;
+  // commands are plain ASCII; an escape ends the copy
+  while (*p != '\0' && *p != '"' && *p != '\\' && n < len - 1) out[n++] = *p++;
+  out[n] = '\0';
+  return *p == '"' || *p == '\\';
+}
+
+// "/capture", "/capture@somebot" and "/capture now" all match "/capture"
+bool telegramCommandIs(const char* text, const char* command) {
+  size_t n = strlen(command);
+  return strncmp(text, command, n) == 0 && (text[n] == '\0' || text[n] == '@' || text[n] == ' ');
+}
+
+void handleTelegramCommand(const char* text) {
+  if (telegramCommandIs(text, "/capture") || telegramCommandIs(text, "/photo")) {
+    if (!requestRemoteCapture(TRIGGER_TELEGRAM)) sendTelegramText("Capture not queued: camera busy or recovering");
+  } else if (telegramCommandIs(text, "/status")) {
+    char status[256];
+    formatStatusText(status, sizeof(status));
+    sendTelegramText(status);
+  } else if (text[0] == '/') {
+    sendTelegramText("Commands: /capture, /status");
+  }
+}
+
+// Handles one update; returns its update_id, or -1 if there was none
+long long handleTelegramUpdate(const char* body) {
+  long long updateId;
+  if (!jsonNumber(body, "\"update_id\":", updateId)) return -1;
+  telegramUpdates++;
+
+  long long chat = 0, date = 0;
+  char text[32];
+  if (!jsonNumber(body, "\"chat\":{\"id\":", chat) || !jsonString(body, "\"text\":\"", text, sizeof(text))) {
+    return updateId;  // not a text message, or cut off
+  }
+  if (chat != atoll(CHAT_ID)) {
+    Serial.printf("⚠️ Telegram command from unknown chat %lld ignored\n", chat);
+    return updateId;
+  }
+
+  // with the clock set, skip commands that queued up while the camera was offline
+  time_t now = time(NULL);
+  if (jsonNumber(body, "\"date\":", date) && timeInitialized) {
+    long age = (long)(now - date);
+    if (age > TELEGRAM_COMMAND_MAX_AGE) {
+      Serial.printf("⏭️ Skipping Telegram '%s' sent %ld s ago\n", text, age);
+      return updateId;
     }
-    Serial.println();
-    clientTCP.stop();
-    Serial.println(getBody);
-    return true;
+    Serial.printf("📨 Telegram '%s' (sent %ld s ago)\n", text, age);
   } else {
-    Serial.println("❌ Failed to connect to Telegram");
-    return false;
+    Serial.printf("📨 Telegram '%s'\n", text);
+  }
+
+  handleTelegramCommand(text);
+  return updateId;
+}
+
+// The poll socket is a third TLS session next to the two upload
+// connections. A new one is only opened while the heap still has a block
+// for it and one more, so a reconnecting poll never takes the block a
+// photo upload needs; a poll already connected costs nothing new
+bool telegramPollHeapOk() {
+  if (telegramPollClient.connected()) return true;
+  size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  bool ok = largest >= TELEGRAM_POLL_MIN_BLOCK;
+  if (!ok && !telegramPollHeapLow) Serial.printf("⚠️ Telegram poll paused: largest free block %u B\n", (unsigned)largest);
+  if (!ok) telegramPollHeapSkips++;
+  telegramPollHeapLow = !ok;
+  return ok;
+}
+
+// One getUpdates long-poll; returns the HTTP status or -1
+int pollTelegramUpdates(long long offset, HttpResponse &response) {
+  WiFiClientSecure* client = acquireConnection(telegramPollConn, telegramHost);
+  if (client == NULL) return -1;
+
+  int len = snprintf((char*)telegramPollConn.record, TLS_RECORD_SIZE,
+                     "GET /bot" BOTtoken "/getUpdates?offset=%lld&limit=1&timeout=%d&allowed_updates=%%5B%%22message%%22%%5D HTTP/1.1\r\n"
+                     "Host: %s\r\n"
+                     "User-Agent: ESP32CAM\r\n"
+                     "Connection: keep-alive\r\n\r\n",
+                     offset, TELEGRAM_POLL_TIMEOUT, telegramHost);
+
+  httpResponseBegin(response);
+  int statusCode = -1;
+  if (client->write(telegramPollConn.record, len) == (size_t)len) {
+    statusCode = readHttpResponse(*client, response, false);
+  }
+  releaseConnection(telegramPollConn, statusCode > 0 && response.keepAlive);
+  // a poll cut off mid-body may have lost the update
+  return response.stage == HTTP_DONE ? statusCode : -1;
+}
+
+void telegramPollTask(void*) {
+  long long offset = 0;
+  HttpResponse response;
+
+  while (!poweringOff) {
+    if (WiFi.status() != WL_CONNECTED) {
+      vTaskDelay(pdMS_TO_TICKS(TELEGRAM_POLL_RETRY));
+      continue;
+    }
+    if (!telegramPollHeapOk()) {
+      vTaskDelay(pdMS_TO_TICKS(TELEGRAM_POLL_RETRY));
+      continue;
+    }
+
+    int statusCode = pollTelegramUpdates(offset, response);
+    if (statusCode != 200) {
+      // 409: a webhook is set on the bot, which rules out getUpdates
+      Serial.printf("⚠️ Telegram poll failed (%d): %s\n", statusCode, response.body);
+      vTaskDelay(pdMS_TO_TICKS(TELEGRAM_POLL_RETRY));
+      continue;
+    }
+
+    // the next offset confirms this update to Telegram
+    long long updateId = handleTelegramUpdate(response.body);
+    if (updateId >= 0) offset = updateId + 1;
+  }
+  vTaskDelete(NULL);
+}
+
+bool localApiAuthorized() {
+  if (LITERAL_LEN(LOCAL_API_KEY) == 0 || localApi.arg("key") == LOCAL_API_KEY) return true;
+  localApi.send(403, "application/json", "{\"error\":\"bad key\"}");
+  return false;
+}
+
+void handleLocalCapture() {
+  if (!localApiAuthorized()) return;
+  if (!requestRemoteCapture(TRIGGER_HTTP)) {
+    localApi.send(503, "application/json", "{\"queued\":false}");
+    return;
+  }
+
+  char body[96];
+  snprintf(body, sizeof(body), "{\"queued\":true,\"camera\":\"%s\",\"waiting\":%u}",
+           CAMERA_ID, (unsigned)uxQueueMessagesWaiting(captureRequests));
+  localApi.send(202, "application/json", body);
+}
+
+void handleLocalStatus() {
+  if (!localApiAuthorized()) return;
+
+  char body[256];
+  snprintf(body, sizeof(body),
+           "{\"camera\":\"%s\",\"uptime\":%lu,\"captures\":%d,\"rssi\":%d,\"server\":%s,"
+           "\"camera_ok\":%s,\"uploading\":%u,\"last_command_ms\":%lu}",
+           CAMERA_ID, millis() / 1000, captureCount, WiFi.RSSI(), serverReachable ? "true" : "false",
+           faults[FAULT_CAMERA].active ? "false" : "true", (unsigned)pipelineDepth(), lastCommandLatency);
+  localApi.send(200, "application/json", body);
+}
+
+void localApiTask(void*) {
+  while (!poweringOff) {
+    localApi.handleClient();
+    vTaskDelay(pdMS_TO_TICKS(LOCAL_API_POLL));
+  }
+  vTaskDelete(NULL);
+}
+
+void initializeRemoteTriggers() {
+  if (TELEGRAM_COMMANDS_ENABLED &&
+      xTaskCreatePinnedToCore(telegramPollTask, "tg_poll", TELEGRAM_POLL_TASK_STACK, NULL, 1, NULL, NETWORK_CORE) != pdPASS) {
+    Serial.println("❌ Could not start Telegram poll task");
+  }
+
+  if (LOCAL_API_ENABLED) {
+    localApi.on("/capture", HTTP_GET, handleLocalCapture);
+    localApi.on("/status", HTTP_GET, handleLocalStatus);
+    localApi.onNotFound([]() { localApi.send(404, "application/json", "{\"error\":\"not found\"}"); });
+    localApi.begin();
+    if (xTaskCreatePinnedToCore(localApiTask, "local_api", LOCAL_API_TASK_STACK, NULL, 1, NULL, NETWORK_CORE) != pdPASS) {
+      Serial.println("❌ Could not start local API task");
+    }
   }
+
+  Serial.printf("✓ Remote triggers: Telegram %s, HTTP %s (port %d)\n",
+                TELEGRAM_COMMANDS_ENABLED ? "/capture" : "off", LOCAL_API_ENABLED ? "GET /capture" : "off", LOCAL_API_PORT);
+}
+
+void printRemoteTriggerStats() {
+  Serial.printf("  remote captures %u Telegram, %u HTTP (%u Telegram updates read, %u polls paused for heap), last command to photo %lu ms\n",
+                remoteCommands[TRIGGER_TELEGRAM], remoteCommands[TRIGGER_HTTP], telegramUpdates, telegramPollHeapSkips,
+                lastCommandLatency);
 }
 
 // =============================================
 // POWER MANAGEMENT
+// - idle mode: after IDLE_SLEEP_AFTER ms with no capture, upload, fault or
+//   timer pending, the camera is parked (frame ring stopped, OV2640 put in
+//   COM2 standby) and the loop light-sleeps in IDLE_SLEEP_SLICE slices
+// - automatic light sleep (esp_pm_configure with light_sleep_enable) keeps
+//   the WiFi association: the radio is in max modem sleep, waking every
+//   IDLE_LISTEN_INTERVAL beacons, and FreeRTOS light-sleeps whenever every
+//   task blocks. The listen interval goes into the STA config right after
+//   WiFi.begin(), which resets it, so the association uses it
+// - a core built without CONFIG_PM_ENABLE refuses esp_pm_configure(); the
+//   loop then calls esp_light_sleep_start() itself in IDLE_SLEEP_SLICE
+//   slices. The radio is off for each whole slice and the AP may drop the
+//   association; each timed wake leaves IDLE_AWAKE_WINDOW ms for WiFi
+// - the wake is a low level on the button, which would fire the CHANGE
+//   buttonISR over and over: while it is armed the edge interrupt is off
+//   (timed slices) or replaced by the one-shot idleWakeISR (automatic)
+// - a button wake counts as the press: the edge ISR could not see it, so
+//   the state machine is fed directly and the level re-sampled
+// - wake latency (button wake -> camera streaming) is kept in the "wake"
+//   histogram; past WAKE_LATENCY_BUDGET the sensor stays powered while idle
 // =============================================
-void powerOffSystem() {
-  Serial.println("\n🔴 POWERING OFF SYSTEM...");
-  displayMessage("POWERING OFF...", "Goodbye!");
-  delay(2000);
+bool idleSleepAllowed(unsigned long now) {
+  if (appState != STATE_IDLE || debouncePending || stateDeadlineActive) return false;
+  if (captureTaskBusy || networkTaskBusy || pipelineDepth() > 0 || burstTest.running) return false;
+  if (uxQueueMessagesWaiting(captureRequests) > 0) return false;
+  if (telegramBatchBusy || (telegramBatchQueue != NULL && uxQueueMessagesWaiting(telegramBatchQueue) > 0)) return false;
+  if (offlineTaskBusy || faults[FAULT_WIFI].active || faults[FAULT_CAMERA].active) return false;
+  // a held button would wake every slice at once; an I2C transfer must not be cut off
+  if (buttonIsDown() || displayBusy || (displayQueue != NULL && uxQueueMessagesWaiting(displayQueue) > 0)) return false;
+  return (long)(now - serialAwakeUntil) >= 0;
+}
 
-  if (displayAvailable) {
-    display.clearDisplay();
-    display.display();
+// OV2640 COM2 bit 4: soft standby, registers and clock are kept
+void setCameraStandby(bool standby) {
+  sensor_t* s = esp_camera_sensor_get();
+  if (s == NULL || s->id.PID != OV2640_PID || s->set_reg == NULL) return;
+  s->set_reg(s, 0x109, 0x10, standby ? 0x10 : 0x00);
+}
+
+// Runs with cameraLock held
+void parkCamera() {
+  ringParked = frameRingActive;
+  stopFrameRing();
+  if (cameraStandbyAllowed) setCameraStandby(true);
+  cameraParked = true;
+}
+
+// Runs with cameraLock held; back to streaming with fresh frames
+void resumeParkedCamera() {
+  if (!cameraParked) return;
+  cameraParked = false;
+  setCameraStandby(false);
+
+  // the driver may still hold frames from before the standby
+  for (int i = 0; i < 2; i++) {
+    camera_fb_t* fb = esp_camera_fb_get();
+    if (fb != NULL) esp_camera_fb_return(fb);
   }
+  if (ringParked && !frameRingActive) frameRingActive = initializeFrameRing();
+}
 
-  esp_camera_deinit();
+// Takes effect at the next association, so it follows every WiFi.begin()
+void setIdleListenInterval() {
+  wifi_config_t config;
+  if (esp_wifi_get_config(WIFI_IF_STA, &config) != ESP_OK) return;
+  config.sta.listen_interval = IDLE_LISTEN_INTERVAL;
+  esp_wifi_set_config(WIFI_IF_STA, &config);
+}
+
+bool configureAutoLightSleep(bool enable) {
+  esp_pm_config_t pm = {};
+  pm.max_freq_mhz = IDLE_PM_MAX_MHZ;
+  pm.min_freq_mhz = IDLE_PM_MIN_MHZ;
+  pm.light_sleep_enable = enable;
+  return esp_pm_configure(&pm) == ESP_OK;
+}
+
+// Button wake under automatic light sleep. A level interrupt keeps firing
+// while the button is down, so it disables itself until exitIdleMode()
+// puts buttonISR back
+void IRAM_ATTR idleWakeISR() {
+  gpio_intr_disable(GPIO_NUM_13);
+  idleWakeAt = esp_timer_get_time();
+
+  AppEvent event = {};
+  event.type = EVT_IDLE_WAKE;
+  event.at = millis();
+
+  BaseType_t woken = pdFALSE;
+  xQueueSendFromISR(appEvents, &event, &woken);
+  if (woken) portYIELD_FROM_ISR();
+}
+
+void enterIdleMode() {
+  if (xSemaphoreTake(cameraLock, 0) != pdTRUE) return;  // a capture or camera re-init is running
+  parkCamera();
+  xSemaphoreGive(cameraLock);
+
+  esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+  if (autoLightSleepSupported && configureAutoLightSleep(true)) {
+    autoLightSleep = true;
+    detachInterrupt(digitalPinToInterrupt(BUTTON_PIN));
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), idleWakeISR, ONLOW_WE);
+    uart_set_wakeup_threshold(UART_NUM_0, IDLE_UART_WAKE_EDGES);
+    esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  } else if (autoLightSleepSupported) {
+    autoLightSleepSupported = false;
+    Serial.println("ℹ️ No automatic light sleep in this core - sleeping in timed slices");
+  }
+
+  idleModeActive = true;
+  powerStats.idleModeStart = esp_timer_get_time();
+  Serial.printf("💤 Idle: %s light sleep until the button or serial input\n", autoLightSleep ? "automatic" : "timed");
+}
+
+// wokeAt is the esp_timer time of a button wake, or 0
+void exitIdleMode(int64_t wokeAt) {
+  idleModeActive = false;
+  powerStats.idleModeUs += esp_timer_get_time() - powerStats.idleModeStart;
+  if (autoLightSleep) {
+    configureAutoLightSleep(false);
+    autoLightSleep = false;
+    detachInterrupt(digitalPinToInterrupt(BUTTON_PIN));
+    attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, CHANGE);
+  }
+  esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+  xSemaphoreTake(cameraLock, portMAX_DELAY);
+  resumeParkedCamera();
+  xSemaphoreGive(cameraLock);
+
+  if (wokeAt == 0) return;
+  unsigned long latency = (esp_timer_get_time() - wokeAt) / 1000;
+  recordLatency(STAGE_WAKE, latency);
+  Serial.printf("⏰ Button wake to camera ready: %lu ms\n", latency);
+  if (latency > WAKE_LATENCY_BUDGET && cameraStandbyAllowed) {
+    cameraStandbyAllowed = false;
+    Serial.printf("⚠️ Over the %d ms wake budget - camera stays powered while idle\n", WAKE_LATENCY_BUDGET);
+  }
+}
+
+// A button wake counts as the press, then the level is re-sampled once
+// settled: a short tap may already be over
+void handleButtonWake(int64_t wokeAt) {
+  powerStats.buttonWakes++;
+  buttonStable = true;
+  onButtonDown(millis());
+  exitIdleMode(wokeAt);
+
+  AppEvent edge = {};
+  edge.type = EVT_BUTTON_EDGE;
+  edge.at = millis();
+  xQueueSend(appEvents, &edge, 0);
+}
+
+// Timed slice for cores without automatic light sleep
+void lightSleepSlice() {
+  // the level wake would re-fire the edge ISR while the button is down
+  gpio_intr_disable(GPIO_NUM_13);
+  gpio_wakeup_enable(GPIO_NUM_13, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  uart_set_wakeup_threshold(UART_NUM_0, IDLE_UART_WAKE_EDGES);
+  esp_sleep_enable_uart_wakeup(UART_NUM_0);
+  esp_sleep_enable_timer_wakeup(IDLE_SLEEP_SLICE * 1000ULL);
+  Serial.flush();
+
+  int64_t sleepStart = esp_timer_get_time();
+  esp_light_sleep_start();
+  int64_t wokeAt = esp_timer_get_time();
+  powerStats.lightSleepUs += wokeAt - sleepStart;
+  powerStats.sleeps++;
+
+  // the level wake replaced the pin's edge interrupt; re-arm it
+  gpio_wakeup_disable(GPIO_NUM_13);
+  gpio_set_intr_type(GPIO_NUM_13, GPIO_INTR_ANYEDGE);
+  gpio_intr_enable(GPIO_NUM_13);
+
+  switch (esp_sleep_get_wakeup_cause()) {
+    case ESP_SLEEP_WAKEUP_GPIO:
+      handleButtonWake(wokeAt);
+      break;
+
+    case ESP_SLEEP_WAKEUP_UART:
+      powerStats.serialWakes++;
+      serialAwakeUntil = millis() + IDLE_SERIAL_AWAKE;
+      exitIdleMode(0);
+      Serial.println("⌨️ Serial woke the camera - repeat the command");
+      break;
+
+    default:
+      powerStats.timerWakes++;
+      if (supervisorTaskHandle != NULL) xTaskNotifyGive(supervisorTaskHandle);
+      break;
+  }
+}
+
+// Called by the loop after every event or timeout
+void runIdleSleep(unsigned long now) {
+  if (!idleSleepAllowed(now)) {
+    if (idleModeActive) exitIdleMode(0);
+    idleSince = now;
+    return;
+  }
+
+  if (!idleModeActive) {
+    if (now - idleSince < IDLE_SLEEP_AFTER) return;
+    enterIdleMode();
+    if (!idleModeActive) return;
+  }
+  if (!autoLightSleep) lightSleepSlice();
+}
+
+void printPowerStats() {
+  int64_t now = esp_timer_get_time();
+  int64_t idleUs = powerStats.idleModeUs + (idleModeActive ? now - powerStats.idleModeStart : 0);
+  int64_t sleepUs = powerStats.lightSleepUs;
+  int64_t activeUs = now - idleUs;
+  int64_t idleAwakeUs = idleUs - sleepUs;
+
+  // charge in mA*us over the uptime, from the assumed CURRENT_* figures.
+  // Automatic light sleep is invisible here and counts as idle awake, so
+  // then the estimate is on the high side
+  int64_t charge = activeUs * CURRENT_ACTIVE_MA + idleAwakeUs * CURRENT_IDLE_AWAKE_MA + sleepUs * CURRENT_LIGHT_SLEEP_MA;
+  Serial.printf("🔋 Power after %lu s: active %u%%, idle awake %u%%, light sleep %u%%, estimated avg %u mA (assumed currents)\n",
+                (unsigned long)(now / 1000000), (unsigned)(activeUs * 100 / now),
+                (unsigned)(idleAwakeUs * 100 / now), (unsigned)(sleepUs * 100 / now), (unsigned)(charge / now));
+  Serial.printf("  %s light sleep, %u timed sleeps; wakes: button %u, serial %u, timer %u; camera standby %s\n",
+                autoLightSleepSupported ? "automatic" : "timed", powerStats.sleeps,
+                powerStats.buttonWakes, powerStats.serialWakes, powerStats.timerWakes,
+                cameraStandbyAllowed ? "on" : "off (over wake budget)");
+}
+
+// Called by the event loop once the power-off message has been shown
+void powerOffSystem() {
+  detachInterrupt(digitalPinToInterrupt(BUTTON_PIN));
+
+  // no new captures and the remote trigger tasks end; a capture already
+  // running finishes first, and cameraLock stays taken so nothing touches
+  // the camera while it is shut down
+  poweringOff = true;
+  burstTest.running = false;
+  xQueueReset(captureRequests);
+  bool cameraFree = xSemaphoreTake(cameraLock, pdMS_TO_TICKS(POWER_OFF_CAMERA_WAIT)) == pdTRUE;
+
+  displayBlank();
+
+  if (cameraFree) {
+    stopFrameRing();
+    esp_camera_deinit();
+  } else {
+    Serial.println("⚠️ Capture still running - camera left as is for deep sleep");
+  }
 
   Serial.println("💤 Entering deep sleep mode");
-  delay(100);
+  Serial.flush();
 
   esp_sleep_enable_ext0_wakeup(GPIO_NUM_13, 0);
   esp_deep_sleep_start();
@@ -810,23 +5293,148 @@ void powerOffSystem() {
 
 // =============================================
 // DISPLAY FUNCTIONS
+// - callers only queue the newest message; a low-priority task renders it
+// - identical messages are dropped, and only the changed column span of
+//   each changed page is sent (the fixed header is never resent)
 // =============================================
-void displayMessage(String line1, String line2, String line3) {
-  if (!displayAvailable) return;
+uint32_t selectDisplayBusSpeed() {
+  for (uint32_t speed : displayBusSpeeds) {
+    Wire.setClock(speed);
+
+    int acked = 0;
+    for (int i = 0; i < DISPLAY_SPEED_PROBES; i++) {
+      Wire.beginTransmission(SCREEN_ADDRESS);
+      Wire.write((uint8_t)0x00);  // command stream
+      Wire.write((uint8_t)0xE3);  // NOP
+      if (Wire.endTransmission() == 0) acked++;
+    }
+    if (acked == DISPLAY_SPEED_PROBES) return speed;
+  }
+
+  uint32_t slowest = displayBusSpeeds[sizeof(displayBusSpeeds) / sizeof(displayBusSpeeds[0]) - 1];
+  Wire.setClock(slowest);
+  return slowest;
+}
+
+bool sameDisplayMessage(const DisplayMessage &a, const DisplayMessage &b) {
+  if (a.blank != b.blank) return false;
+  for (int i = 0; i < 3; i++) {
+    if (strcmp(a.lines[i], b.lines[i]) != 0) return false;
+  }
+  return true;
+}
 
+void renderDisplayMessage(const DisplayMessage &msg) {
   display.clearDisplay();
+  if (msg.blank) return;
+
   display.setTextSize(1);
   display.setTextColor(SSD1306_WHITE);
   display.setCursor(0, 0);
   display.println("License Plate");
   display.println("Detector");
   display.println("================");
-  display.println(line1);
-  if (line2.length() > 0) {
-    display.println(line2);
+  display.println(msg.lines[0]);
+  if (msg.lines[1][0] != '\0') {
+    display.println(msg.lines[1]);
   }
-  if (line3.length() > 0) {
-    display.println(line3);
+  if (msg.lines[2][0] != '\0') {
+    display.println(msg.lines[2]);
   }
-  display.display();
-}
\ No newline at end of file
+}
+
+// Sends the changed span of every changed page; returns the bytes written
+uint32_t pushDisplayChanges() {
+  uint8_t* buffer = display.getBuffer();
+  uint32_t bytes = 0;
+
+  for (int page = 0; page < SCREEN_HEIGHT / 8; page++) {
+    uint8_t* row = buffer + page * SCREEN_WIDTH;
+    uint8_t* shadow = displayShadow + page * SCREEN_WIDTH;
+
+    int first = 0;
+    while (first < SCREEN_WIDTH && row[first] == shadow[first]) first++;
+    if (first == SCREEN_WIDTH) continue;
+    int last = SCREEN_WIDTH - 1;
+    while (row[last] == shadow[last]) last--;
+
+    Wire.beginTransmission(SCREEN_ADDRESS);
+    Wire.write((uint8_t)0x00);  // command stream
+    Wire.write(SSD1306_COLUMNADDR);
+    Wire.write(first);
+    Wire.write(last);
+    Wire.write(SSD1306_PAGEADDR);
+    Wire.write(page);
+    Wire.write(page);
+    bool ok = Wire.endTransmission() == 0;
+    bytes += 7;
+
+    for (int col = first; ok && col <= last; col += DISPLAY_I2C_CHUNK) {
+      int len = min(DISPLAY_I2C_CHUNK, last - col + 1);
+      Wire.beginTransmission(SCREEN_ADDRESS);
+      Wire.write((uint8_t)0x40);  // data stream
+      Wire.write(row + col, len);
+      ok = Wire.endTransmission() == 0;
+      bytes += len + 1;
+    }
+
+    // a failed page keeps its old shadow so it is resent next update
+    if (ok) memcpy(shadow + first, row + first, last - first + 1);
+  }
+
+  return bytes;
+}
+
+void displayTask(void*) {
+  DisplayMessage msg;
+  DisplayMessage shown = {};
+  bool haveShown = false;
+
+  while (true) {
+    displayBusy = false;
+    xQueueReceive(displayQueue, &msg, portMAX_DELAY);
+    displayBusy = true;
+
+    if (haveShown && sameDisplayMessage(msg, shown)) {
+      displaySkipped++;
+    } else {
+      unsigned long start = millis();
+      renderDisplayMessage(msg);
+      displayBytesLast = pushDisplayChanges();
+      recordLatency(STAGE_DISPLAY_UPDATE, millis() - start);
+      displayBytesTotal += displayBytesLast;
+      displayUpdates++;
+      shown = msg;
+      haveShown = true;
+      if (DISPLAY_VERBOSE) {
+        Serial.printf("🖥️ OLED update: %u bytes (avg %u, %u skipped)\n",
+                      displayBytesLast, displayBytesTotal / displayUpdates, displaySkipped);
+      }
+    }
+
+    xSemaphoreGive(displayFlushed);
+  }
+}
+
+void displayMessage(const char* line1, const char* line2, const char* line3) {
+  if (!displayAvailable || displayQueue == NULL) return;
+
+  DisplayMessage msg = {};
+  snprintf(msg.lines[0], sizeof(msg.lines[0]), "%s", line1);
+  snprintf(msg.lines[1], sizeof(msg.lines[1]), "%s", line2);
+  snprintf(msg.lines[2], sizeof(msg.lines[2]), "%s", line3);
+
+  // never blocks: an unrendered older message is simply replaced
+  xQueueOverwrite(displayQueue, &msg);
+}
+
+// Clears the panel and waits (briefly) until it has been pushed
+void displayBlank() {
+  if (!displayAvailable || displayQueue == NULL) return;
+
+  DisplayMessage msg = {};
+  msg.blank = true;
+  xSemaphoreTake(displayFlushed, 0);
+  xQueueOverwrite(displayQueue, &msg);
+  xSemaphoreTake(displayFlushed, pdMS_TO_TICKS(500));
+}
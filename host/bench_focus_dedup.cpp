@@ -0,0 +1,339 @@
+// Duplicate suppression and burst focus scoring over a frame corpus: the
+// dHash distance and cell difference frameDHash() gives for re-triggers on
+// the same scene against those for a real change, the missed / false
+// duplicate rate at every setting of DEDUP_MAX_DISTANCE and
+// DEDUP_MAX_CELL_DIFF, and how often frameFocusScore() picks the sharp frame
+// out of a burst.
+//
+//   bench_focus_dedup [DIR] [--scenes N] [--verbose]
+//
+// With DIR, the JPEGs in it are taken as a capture sequence (sorted by
+// name): the distance of each to the previous one and its focus score are
+// listed, with no ground truth. Without, a synthetic corpus is rendered for
+// a fixed camera: every scene keeps its background, and only the car and
+// the camera side (exposure, noise, shake, JPEG quality) change.
+#include "sketch.cpp"
+#include "host.h"
+#include "check.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+static uint32_t corpusRandom(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static float corpusUniform(uint32_t &state, float lo, float hi) {
+  return lo + (hi - lo) * (corpusRandom(state) % 10000) / 10000.0f;
+}
+
+static int corpusInt(uint32_t &state, int lo, int hi) {
+  return lo + (int)(corpusRandom(state) % (uint32_t)(hi - lo + 1));
+}
+
+static double hashMs = 0, focusMs = 0;
+static int hashCalls = 0, focusCalls = 0;
+
+static CaptureHash hashOf(const std::vector<uint8_t> &jpeg) {
+  int width = 0, height = 0;
+  hostJpegSize(jpeg.data(), jpeg.size(), &width, &height);
+  CaptureHash sig = {};
+  auto start = std::chrono::steady_clock::now();
+  bool ok = frameDHash(jpeg.data(), jpeg.size(), width, height, sig);
+  hashMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  hashCalls++;
+  CHECK(ok);
+  return sig;
+}
+
+static long focusOf(const std::vector<uint8_t> &jpeg) {
+  int width = 0, height = 0;
+  hostJpegSize(jpeg.data(), jpeg.size(), &width, &height);
+  auto start = std::chrono::steady_clock::now();
+  long score = frameFocusScore(jpeg.data(), jpeg.size(), width, height);
+  focusMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  focusCalls++;
+  CHECK(score >= 0);
+  return score;
+}
+
+struct PairDistance {
+  int bits;                     // dHash Hamming distance
+  int cells;                    // cellDifference()
+};
+
+static PairDistance compare(const CaptureHash &a, const CaptureHash &b) {
+  return { __builtin_popcountll(a.hash ^ b.hash), cellDifference(a.cells, b.cells) };
+}
+
+// What findDuplicateCapture() decides for the pair under the given limits
+static bool duplicate(const PairDistance &d, int maxBits, int maxCells) {
+  return d.bits <= maxBits && d.cells <= maxCells;
+}
+
+// The same scene seen again: only what the camera adds changes
+static HostSceneSpec retrigger(const HostSceneSpec &base, uint32_t &state) {
+  HostSceneSpec spec = base;
+  spec.exposure = base.exposure + corpusInt(state, -25, 25);
+  spec.noise = corpusInt(state, 2, 6);
+  spec.shiftX = corpusInt(state, -3, 3);
+  spec.shiftY = corpusInt(state, -3, 3);
+  spec.quality = corpusInt(state, 60, 90);
+  spec.blur = corpusRandom(state) % 4 == 0 ? 1 : 0;
+  spec.motionBlur = corpusRandom(state) % 4 == 0 ? 2 : 0;
+  return spec;
+}
+
+// Something a new upload is wanted for: the car left or arrived, moved
+// along the driveway, or another car took its place
+static HostSceneSpec changed(const HostSceneSpec &base, uint32_t &state, int kind, const char* &what) {
+  HostSceneSpec spec = retrigger(base, state);
+  switch (kind) {
+    case 0:
+      spec.car = !base.car;
+      what = base.car ? "car left" : "car arrived";
+      break;
+    case 1: {
+      float step = corpusUniform(state, 0.1f, 0.25f);
+      spec.carX = base.carX + (base.carX > 0.5f ? -step : step);
+      what = "car moved";
+      break;
+    }
+    default:
+      spec.carShade = (uint8_t)(base.carShade > 95 ? base.carShade - corpusInt(state, 40, 70)
+                                                   : base.carShade + corpusInt(state, 40, 70));
+      spec.carScale = base.carScale * corpusUniform(state, 0.75f, 1.3f);
+      what = "other car";
+      break;
+  }
+  return spec;
+}
+
+static void printHistogram(const char* label, const char* unit, int bucket, const std::vector<int> &values) {
+  int counts[256] = {};
+  int top = 0;
+  for (int v : values) {
+    counts[v / bucket]++;
+    top = max(top, v / bucket);
+  }
+  printf("  %s\n", label);
+  for (int b = 0; b <= top; b++) {
+    if (counts[b] == 0) continue;
+    printf("    %3d %-6s %4d  ", b * bucket, unit, counts[b]);
+    for (int i = 0; i < counts[b] && i < 50; i++) putchar('#');
+    putchar('\n');
+  }
+}
+
+struct Corpus {
+  std::vector<PairDistance> same;       // re-triggers on an unchanged scene
+  std::vector<PairDistance> different;  // the scene changed
+};
+
+static void countErrors(const Corpus &c, int maxBits, int maxCells, int &missed, int &falseDups) {
+  missed = falseDups = 0;
+  for (const PairDistance &d : c.same) missed += !duplicate(d, maxBits, maxCells);
+  for (const PairDistance &d : c.different) falseDups += duplicate(d, maxBits, maxCells);
+}
+
+static void printErrors(const Corpus &c, const char* label, int maxBits, int maxCells) {
+  int missed, falseDups;
+  countErrors(c, maxBits, maxCells, missed, falseDups);
+  printf("  %-28s %6d (%3.0f%%) %6d (%3.0f%%)\n", label, missed, 100.0 * missed / c.same.size(), falseDups,
+         100.0 * falseDups / c.different.size());
+}
+
+// Lowest value of one measure over the changed pairs and highest over the
+// re-triggers; a setting in between separates them
+static void measureGap(const Corpus &c, bool bits, int &sameMax, int &differentMin) {
+  sameMax = 0;
+  differentMin = 255;
+  for (const PairDistance &d : c.same) sameMax = max(sameMax, bits ? d.bits : d.cells);
+  for (const PairDistance &d : c.different) differentMin = min(differentMin, bits ? d.bits : d.cells);
+}
+
+static int runFolder(const char* dir) {
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<std::string> names;
+  hostLoadJpegFolder(dir, frames, &names);
+  if (frames.empty()) {
+    printf("no JPEGs in %s\n", dir);
+    return 1;
+  }
+  printf("focus and dedup over %zu frames from %s\n", frames.size(), dir);
+  printf("  %-32s %6s %6s %10s\n", "frame", "bits", "cells", "focus");
+  CaptureHash previous = {};
+  int suppressed = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    CaptureHash sig = hashOf(frames[i]);
+    long focus = focusOf(frames[i]);
+    if (i == 0) {
+      printf("  %-32s %6s %6s %10ld\n", names[i].c_str(), "-", "-", focus);
+    } else {
+      PairDistance d = compare(previous, sig);
+      bool same = duplicate(d, DEDUP_MAX_DISTANCE, DEDUP_MAX_CELL_DIFF);
+      suppressed += same;
+      printf("  %-32s %6d %6d %10ld%s\n", names[i].c_str(), d.bits, d.cells, focus, same ? "  duplicate" : "");
+    }
+    previous = sig;
+  }
+  printf("  %d/%zu frames would be suppressed as a duplicate of the previous one\n", suppressed,
+         frames.size() - 1);
+  printf("  time  dHash %.2f ms, focus %.2f ms per frame\n", hashMs / hashCalls, focusMs / focusCalls);
+  finish("bench_focus_dedup");
+}
+
+int main(int argc, char** argv) {
+  const char* dir = nullptr;
+  int scenes = 40;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scenes") == 0 && i + 1 < argc) scenes = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--verbose") == 0) verbose = true;
+    else dir = argv[i];
+  }
+  hostSerialQuiet(true);
+  if (dir) return runFolder(dir);
+
+  // ---- dedup: distances on the same scene vs after a change ----
+  uint32_t state = 0x9E3779B9;
+  Corpus corpus;
+  const int retriggers = 4;
+  for (int i = 0; i < scenes; i++) {
+    HostSceneSpec base;
+    base.seed = 300 + i;
+    base.car = i % 6 != 5;   // one driveway in six starts empty
+    base.carX = corpusUniform(state, 0.3f, 0.7f);
+    base.carY = corpusUniform(state, 0.5f, 0.7f);
+    base.carScale = corpusUniform(state, 0.6f, 1.3f);
+    base.carShade = (uint8_t)corpusUniform(state, 30, 160);
+    base.exposure = corpusInt(state, -50, 30);
+    CaptureHash reference = hashOf(hostRenderScene(base));
+    if (verbose) {
+      printf("  scene%03d car %s at %.2f, scale %.2f, shade %d, exposure %d\n", i, base.car ? "yes" : "no", base.carX,
+             base.carScale, base.carShade, base.exposure);
+    }
+
+    for (int k = 0; k < retriggers; k++) {
+      PairDistance d = compare(reference, hashOf(hostRenderScene(retrigger(base, state))));
+      corpus.same.push_back(d);
+      if (verbose) printf("  scene%03d %-14s %2d bits %3d cells\n", i, "retrigger", d.bits, d.cells);
+    }
+    for (int kind = 0; kind < 3; kind++) {
+      if (!base.car && kind > 0) continue;
+      const char* what = "";
+      PairDistance d = compare(reference, hashOf(hostRenderScene(changed(base, state, kind, what))));
+      corpus.different.push_back(d);
+      if (verbose) printf("  scene%03d %-14s %2d bits %3d cells\n", i, what, d.bits, d.cells);
+    }
+  }
+
+  std::vector<int> sameBits, differentBits, sameCells, differentCells;
+  for (const PairDistance &d : corpus.same) {
+    sameBits.push_back(d.bits);
+    sameCells.push_back(d.cells);
+  }
+  for (const PairDistance &d : corpus.different) {
+    differentBits.push_back(d.bits);
+    differentCells.push_back(d.cells);
+  }
+  int sameMaxBits, differentMinBits, sameMaxCells, differentMinCells;
+  measureGap(corpus, true, sameMaxBits, differentMinBits);
+  measureGap(corpus, false, sameMaxCells, differentMinCells);
+
+  printf("dedup over %d synthetic scenes: %zu re-triggers, %zu changes\n", scenes, corpus.same.size(),
+         corpus.different.size());
+  printHistogram("dHash distance, same scene", "bits", 1, sameBits);
+  printHistogram("dHash distance, scene changed", "bits", 1, differentBits);
+  printHistogram("cell difference, same scene", "levels", 4, sameCells);
+  printHistogram("cell difference, scene changed", "levels", 4, differentCells);
+  printf("  dHash: re-triggers up to %d bits, changes from %d bits\n", sameMaxBits, differentMinBits);
+  printf("  cells: re-triggers up to %d levels, changes from %d levels\n", sameMaxCells, differentMinCells);
+
+  printf("  %-28s %14s %14s\n", "rule", "missed dups", "false dups");
+  char label[64];
+  for (int t = 0; t <= DEDUP_MAX_DISTANCE + 2; t += 2) {
+    snprintf(label, sizeof(label), "dHash <= %d alone", t);
+    printErrors(corpus, label, t, 255);
+  }
+  for (int t = 8; t <= 48; t += 8) {
+    snprintf(label, sizeof(label), "cells <= %d alone", t);
+    printErrors(corpus, label, 64, t);
+  }
+  snprintf(label, sizeof(label), "configured (%d bits, %d)", DEDUP_MAX_DISTANCE, DEDUP_MAX_CELL_DIFF);
+  printErrors(corpus, label, DEDUP_MAX_DISTANCE, DEDUP_MAX_CELL_DIFF);
+  int missedAtSetting, falseAtSetting;
+  countErrors(corpus, DEDUP_MAX_DISTANCE, DEDUP_MAX_CELL_DIFF, missedAtSetting, falseAtSetting);
+
+  // ---- focus: does the burst keep the sharp frame? ----
+  int picked = 0, ordered = 0, ladders = 0;
+  double worstRatio = 1e9;
+  for (int i = 0; i < scenes; i++) {
+    HostSceneSpec base;
+    base.seed = 500 + i;
+    base.carX = corpusUniform(state, 0.3f, 0.7f);
+    base.carY = corpusUniform(state, 0.5f, 0.7f);
+    base.carScale = corpusUniform(state, 0.6f, 1.3f);
+    base.carShade = (uint8_t)corpusUniform(state, 30, 160);
+    base.exposure = corpusInt(state, -50, 30);
+
+    // a burst: one sharp frame, the others smeared or out of focus, in a
+    // random order, each with its own noise and a little exposure drift
+    int sharpAt = corpusInt(state, 0, BURST_FRAMES - 1);
+    long sharpScore = 0, bestOther = -1;
+    for (int f = 0; f < BURST_FRAMES; f++) {
+      HostSceneSpec spec = base;
+      spec.exposure = base.exposure + corpusInt(state, -6, 6);
+      spec.noise = corpusInt(state, 2, 4);
+      if (f != sharpAt) {
+        if (corpusRandom(state) % 2) spec.motionBlur = corpusInt(state, 2, 8);
+        else spec.blur = corpusInt(state, 1, 2);
+      }
+      long score = focusOf(hostRenderScene(spec));
+      if (f == sharpAt) sharpScore = score;
+      else bestOther = max(bestOther, score);
+    }
+    picked += sharpScore > bestOther;
+    if (bestOther > 0) worstRatio = std::min(worstRatio, (double)sharpScore / bestOther);
+
+    // the score falls as the smear grows
+    long previous = -1;
+    bool falling = true;
+    std::string ladder;
+    for (int smear : {0, 2, 4, 8}) {
+      HostSceneSpec spec = base;
+      spec.motionBlur = smear;
+      long score = focusOf(hostRenderScene(spec));
+      if (previous >= 0 && score >= previous) falling = false;
+      previous = score;
+      ladder += " " + std::to_string(score);
+    }
+    ordered += falling;
+    ladders++;
+    if (verbose) {
+      printf("  scene%03d burst %s (sharp %ld, next %ld), smear 0/2/4/8:%s\n", i,
+             sharpScore > bestOther ? "ok  " : "MISS", sharpScore, bestOther, ladder.c_str());
+    }
+  }
+
+  printf("focus over %d synthetic bursts of %d frames\n", scenes, BURST_FRAMES);
+  printf("  sharp frame kept   %d/%d\n", picked, scenes);
+  printf("  sharp vs next best %.2fx at the closest\n", worstRatio);
+  printf("  score falls with smear 0/2/4/8 in %d/%d scenes\n", ordered, ladders);
+  printf("  time  dHash %.2f ms, focus %.2f ms per frame\n", hashMs / hashCalls, focusMs / focusCalls);
+
+  // the limits have to let every re-trigger through, and the pair of them
+  // has to stop the changes the dHash alone lets through (a small car of
+  // the background's shade is the one it still misses); the focus score has
+  // to find the sharp frame every time
+  CHECK(sameMaxBits <= DEDUP_MAX_DISTANCE);
+  CHECK(sameMaxCells <= DEDUP_MAX_CELL_DIFF);
+  CHECK_EQ(missedAtSetting, 0);
+  CHECK(falseAtSetting * 100 <= (int)corpus.different.size() * 3);
+  CHECK_EQ(picked, scenes);
+  CHECK_EQ(ordered, ladders);
+  finish("bench_focus_dedup");
+}
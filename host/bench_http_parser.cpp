@@ -0,0 +1,84 @@
+// Micro-benchmark of httpFeed() over the responses the sketch actually sees,
+// fed the way readHttpResponse() does: in one read, in HTTP_RX_CHUNK reads,
+// and in small reads as a slow TLS record stream would deliver them.
+//
+//   bench_http_parser [--iterations N]
+#include "sketch.cpp"
+#include "check.h"
+#include <chrono>
+#include <string>
+
+struct CannedResponse {
+  const char* name;
+  std::string bytes;
+  int status;
+};
+
+static std::string telegramReply() {
+  std::string body = "{\"ok\":true,\"result\":{\"message_id\":4711,\"from\":{\"id\":1,\"is_bot\":true,"
+                     "\"first_name\":\"cam\"},\"chat\":{\"id\":42,\"type\":\"private\"},\"date\":1760000000,"
+                     "\"photo\":[";
+  for (int i = 0; i < 4; i++) {
+    if (i) body += ",";
+    body += "{\"file_id\":\"AgACAgQAAxkDAAIBZ2" + std::to_string(i) + "\",\"file_size\":" + std::to_string(1200 * (i + 1)) +
+            ",\"width\":" + std::to_string(90 * (i + 1)) + ",\"height\":" + std::to_string(67 * (i + 1)) + "}";
+  }
+  body += "]}}";
+  return "HTTP/1.1 200 OK\r\nServer: nginx/1.18.0\r\nDate: Fri, 17 Oct 2025 10:00:00 GMT\r\n"
+         "Content-Type: application/json\r\nContent-Length: " + std::to_string(body.size()) +
+         "\r\nConnection: keep-alive\r\nStrict-Transport-Security: max-age=31536000; includeSubDomains; preload\r\n"
+         "Access-Control-Allow-Origin: *\r\n\r\n" + body;
+}
+
+static std::string chunkedReply() {
+  std::string out = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nTransfer-Encoding: chunked\r\n\r\n";
+  for (int i = 0; i < 8; i++) out += "40\r\n" + std::string(64, 'a' + i) + "\r\n";
+  return out + "0\r\n\r\n";
+}
+
+// Parses one response from memory in reads of at most chunk bytes, with
+// the same feed loop as readHttpResponse()
+static int parse(const std::string &bytes, size_t chunk, HttpResponse &r) {
+  httpResponseBegin(r);
+  const uint8_t* data = (const uint8_t*)bytes.data();
+  size_t at = 0;
+  while (r.stage < HTTP_DONE && at < bytes.size()) {
+    size_t end = std::min(at + chunk, bytes.size());
+    while (at < end && r.stage < HTTP_DONE) at += httpFeed(r, data + at, end - at);
+  }
+  return r.status;
+}
+
+int main(int argc, char** argv) {
+  long iterations = 200000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atol(argv[++i]);
+  }
+
+  const CannedResponse responses[] = {
+    { "upload 200", "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\nContent-Length: 2\r\n\r\nOK", 200 },
+    { "patch 204", "HTTP/1.1 204 No Content\r\nUpload-Offset: 65536\r\n\r\n", 204 },
+    { "telegram", telegramReply(), 200 },
+    { "chunked", chunkedReply(), 200 },
+    { "100+201", "HTTP/1.1 100 Continue\r\n\r\nHTTP/1.1 201 Created\r\nContent-Length: 2\r\n\r\nok", 201 },
+  };
+  const size_t chunks[] = { 4096, HTTP_RX_CHUNK, 16 };
+
+  printf("httpFeed, %ld iterations each\n", iterations);
+  printf("  %-12s %6s %6s %10s %10s\n", "response", "bytes", "read", "ns/resp", "MB/s");
+  for (const CannedResponse &c : responses) {
+    for (size_t chunk : chunks) {
+      HttpResponse r;
+      CHECK_EQ(parse(c.bytes, chunk, r), c.status);
+      CHECK_EQ(r.stage, HTTP_DONE);
+
+      volatile int sink = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (long i = 0; i < iterations; i++) sink += parse(c.bytes, chunk, r);
+      double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+      printf("  %-12s %6zu %6zu %10.1f %10.1f\n", c.name, c.bytes.size(), std::min(chunk, c.bytes.size()), ns,
+             c.bytes.size() / ns * 1000.0);
+    }
+  }
+  finish("bench_http_parser");
+}
@@ -0,0 +1,195 @@
+// Per-stage timing of the capture pipeline on the host: every capture goes
+// through captureAndProcessImage() and finishCapture() exactly as on the
+// device, against the fake camera and the in-process servers, under a few
+// link profiles.
+//
+//   bench_pipeline [--captures N] [--profiles lan,wifi,poor] [--frames DIR]
+//
+// CPU stages (grab, dedup, crop, detach) come from the sketch's own capture
+// timeline; network stages from its latency histograms. Exits non-zero if a
+// capture did not reach the upload server.
+//
+// With the poor profile, the same captures are sent again with the server
+// cutting RESUME_DROP_PERCENT of requests mid-body, once as resumable
+// uploads and once as plain POSTs (at least RESUME_CAPTURES each); resuming
+// has to send fewer bytes again per delivered upload.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+struct LinkProfile {
+  const char* name;
+  HostLink link;
+};
+
+static const LinkProfile linkProfiles[] = {
+  { "lan", { 1, 0, 0 } },
+  { "wifi", { 20, 8000, 0.5f } },
+  { "poor", { 120, 600, 3.0f } },
+};
+
+static const uint32_t RESUME_DROP_PERCENT = 20;
+static const int RESUME_CAPTURES = 20;       // at least, so a few drops land
+
+static double percentile(std::vector<double> v, int percent) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t rank = (v.size() * percent + 99) / 100;
+  return v[rank ? rank - 1 : 0];
+}
+
+static void printRow(const char* name, const std::vector<double> &v, const char* unit) {
+  printf("  %-12s %5zu %9.2f %9.2f %9.2f  %s\n", name, v.size(), percentile(v, 50), percentile(v, 95),
+         v.empty() ? 0.0 : *std::max_element(v.begin(), v.end()), unit);
+}
+
+static void resetMetrics() {
+  memset(stageHistograms, 0, sizeof(stageHistograms));
+  memset(&metricCounters, 0, sizeof(metricCounters));
+}
+
+// Drops every open connection so each profile starts with a cold handshake
+static void dropConnections() {
+  HostConnection* conns[] = { &serverConn, &telegramConn };
+  for (HostConnection* c : conns) {
+    xSemaphoreTake(c->lock, portMAX_DELAY);
+    c->client->stop();
+    xSemaphoreGive(c->lock);
+  }
+}
+
+// Bytes the server received beyond the forms it handled, per delivered
+// upload: what a drop made the sketch send again
+static double resentPerUpload(HostRig &rig, bool resumable, size_t &shot, size_t frameCount, int captures) {
+  resumableServer = resumable;
+  dropConnections();
+  resetMetrics();
+  RailwayStandIn &railway = rig.railway;
+  railway.dropPercent = RESUME_DROP_PERCENT;
+  railway.dropSeed = 2024;
+  uint64_t received = railway.bodyBytes, handled = railway.formBytes;
+  uint32_t cuts = railway.cuts;
+
+  int delivered = 0;
+  for (int i = 0; i < captures; i++) {
+    hostCameraSelect(shot++ % frameCount);
+    serverReachable = true;   // a failed upload takes the server offline until the supervisor re-probes
+    CaptureResult result = runCapture();
+    delivered += result.serverOk && result.duplicateOf == 0;
+  }
+  railway.dropPercent = 0;
+
+  uint64_t resent = (railway.bodyBytes - received) - (railway.formBytes - handled);
+  double perUpload = delivered ? (double)resent / delivered : (double)resent;
+  printf("  %-9s %2d/%d delivered, %2u drops, %8.0f B resent per upload (sketch counted %u B)\n",
+         resumable ? "resumable" : "plain", delivered, captures, railway.cuts - cuts, perUpload,
+         metricCounters.resentBytes);
+  if (resumable) CHECK_EQ(delivered, captures);
+  return perUpload;
+}
+
+int main(int argc, char** argv) {
+  int captures = 12;
+  std::string profiles = "lan,wifi";
+  const char* framesDir = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--captures") == 0 && i + 1 < argc) captures = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--profiles") == 0 && i + 1 < argc) profiles = argv[++i];
+    else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) framesDir = argv[++i];
+  }
+
+  // Distinct scenes, more of them than DEDUP_HISTORY, shown in turn across
+  // profiles so dedup never turns a capture into an event
+  std::vector<std::vector<uint8_t>> frames;
+  if (framesDir) hostLoadJpegFolder(framesDir, frames);
+  if (frames.empty()) {
+    for (uint32_t seed = 1; seed <= 16; seed++) {
+      HostSceneSpec spec;
+      spec.seed = seed * 7919;
+      spec.carX = 0.3f + 0.025f * seed;
+      spec.carShade = (uint8_t)(40 + seed * 9);
+      frames.push_back(hostRenderScene(spec));
+    }
+  }
+  hostCameraSetFrames(frames);
+  hostSerialQuiet(true);
+
+  HostRig rig;
+  startPipeline(rig);
+  printf("%zu frames, %d captures per profile\n", frames.size(), captures);
+
+  uint32_t expectedForms = 0;
+  size_t shot = 0;
+  for (const LinkProfile &profile : linkProfiles) {
+    if (("," + profiles + ",").find(std::string(",") + profile.name + ",") == std::string::npos) continue;
+    hostSetLink(profile.link);
+    dropConnections();
+    resetMetrics();
+
+    std::map<std::string, std::vector<double>> stages;
+    std::vector<std::string> order;
+    std::vector<double> captureUs, dispatchUs;
+    uint32_t formsBefore = rig.railway.forms;
+    int delivered = 0;
+
+    for (int i = 0; i < captures; i++) {
+      hostCameraSelect(shot++ % frames.size());
+      CaptureRequest request = { TRIGGER_BUTTON, millis() };
+
+      int64_t start = hostNowUs();
+      xSemaphoreTake(cameraLock, portMAX_DELAY);
+      PipelineJob job = captureAndProcessImage(request);
+      xSemaphoreGive(cameraLock);
+      int64_t prepared = hostNowUs();
+      captureUs.push_back((prepared - start) / 1000.0);
+
+      for (int p = 1; p < capturePhaseCount; p++) {
+        const char* name = captureTimeline[p].name;
+        if (!stages.count(name)) order.push_back(name);
+        stages[name].push_back(captureTimeline[p].at - captureTimeline[p - 1].at);
+      }
+      if (!job.result.captured) continue;
+
+      finishCapture(job);
+      dispatchUs.push_back((hostNowUs() - prepared) / 1000.0);
+      drainAppEvents();
+      delivered += job.result.serverOk && job.result.duplicateOf == 0;
+    }
+
+    printf("\n== %s: rtt %u ms, %u kbit/s, %.1f%% loss ==\n", profile.name, profile.link.rttMs,
+           profile.link.kbps, profile.link.lossPercent);
+    printf("  stage            n       p50       p95       max\n");
+    for (const std::string &name : order) printRow(name.c_str(), stages[name], "ms (timeline)");
+    printRow("capture", captureUs, "ms");
+    printRow("deliver", dispatchUs, "ms");
+    const MetricStage network[] = { STAGE_TLS_CONNECT, STAGE_REQUEST_WRITE, STAGE_FIRST_BYTE, STAGE_DISPATCH };
+    for (MetricStage s : network) {
+      const LatencyHistogram &h = stageHistograms[s];
+      printf("  %-12s %5u %9u %9u %9u  ms (histogram bound)\n", metricStageNames[s], h.total,
+             histogramPercentile(h, 50), histogramPercentile(h, 95), h.maxMs);
+    }
+    printf("  server: %d/%d delivered; %u handshakes, %u reuses so far\n", delivered, captures,
+           serverConn.handshakes, serverConn.reuses);
+
+    CHECK_EQ(delivered, captures);
+    expectedForms += captures;
+    CHECK_EQ(rig.railway.forms - formsBefore, (uint32_t)captures);
+  }
+  CHECK_EQ(rig.railway.forms, expectedForms);
+
+  if (("," + profiles + ",").find(",poor,") != std::string::npos) {
+    hostSetLink(linkProfiles[2].link);
+    printf("\n== poor, %u%% of server requests cut mid-body ==\n", RESUME_DROP_PERCENT);
+    int uploads = std::max(captures, RESUME_CAPTURES);
+    double resumed = resentPerUpload(rig, true, shot, frames.size(), uploads);
+    double plain = resentPerUpload(rig, false, shot, frames.size(), uploads);
+    resumableServer = RESUMABLE_UPLOADS;
+    CHECK(resumed < plain);
+  }
+  finish("bench_pipeline");
+}
@@ -0,0 +1,192 @@
+// Plate crop over a corpus: how often cropPlateRegion() finds a region, how
+// often that region really holds the plate, and how many upload bytes the
+// crop + thumbnail save against the full frame.
+//
+//   bench_plate_crop [DIR] [--scenes N] [--verbose]
+//
+// With DIR, every JPEG in it is cropped (no ground truth, so only the hit
+// rate and the bytes are reported). Without, a synthetic corpus is rendered:
+// cars of varying size, position, exposure and blur, plus scenes with no
+// plate at all, each with its plate box known.
+#include "sketch.cpp"
+#include "host.h"
+#include "check.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+struct CropOutcome {
+  bool hit;
+  size_t frameLen;
+  size_t uploadLen;             // crop + thumbnail, or the frame on a miss
+  size_t cropLen;
+  size_t thumbLen;
+  int x0, y0, x1, y1;           // crop rectangle in frame pixels
+  double ms;
+};
+
+// Runs the detector the way cropPlateRegion() does to learn where the crop
+// went (the frame only keeps the encoded result), then the real thing
+static CropOutcome cropFrame(const std::vector<uint8_t> &jpeg) {
+  CropOutcome out = {};
+  int width = 0, height = 0;
+  hostJpegSize(jpeg.data(), jpeg.size(), &width, &height);
+
+  int w = width >> PLATE_DETECT_SHIFT, h = height >> PLATE_DETECT_SHIFT;
+  std::vector<uint8_t> small(w * h * 2);
+  int boxX = 0, boxY = 0, boxW = 0, boxH = 0;
+  if (jpg2rgb565(jpeg.data(), jpeg.size(), small.data(), PLATE_DETECT_SCALE) &&
+      findPlateRegion(small.data(), w, h, boxX, boxY, boxW, boxH)) {
+    int marginX = boxW * PLATE_CROP_MARGIN / 200;
+    int marginY = boxH * PLATE_CROP_MARGIN / 100;
+    out.x0 = max(0, (boxX - marginX) << PLATE_DETECT_SHIFT);
+    out.y0 = max(0, (boxY - marginY) << PLATE_DETECT_SHIFT);
+    out.x1 = min(width, (boxX + boxW + marginX) << PLATE_DETECT_SHIFT);
+    out.y1 = min(height, (boxY + boxH + marginY) << PLATE_DETECT_SHIFT);
+  }
+
+  SharedFrame frame = {};
+  frame.buf = jpeg.data();
+  frame.len = jpeg.size();
+  frame.width = width;
+  frame.height = height;
+  auto start = std::chrono::steady_clock::now();
+  cropPlateRegion(&frame);
+  out.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  out.hit = frame.cropBuf != NULL;
+  out.frameLen = frame.len;
+  out.cropLen = frame.cropLen;
+  out.thumbLen = frame.thumbLen;
+  out.uploadLen = out.hit ? frame.cropLen + frame.thumbLen : frame.len;
+  free(frame.cropBuf);
+  free(frame.thumbBuf);
+  return out;
+}
+
+// Share of the plate box inside the crop
+static double plateCovered(const CropOutcome &c, const HostPlateBox &p) {
+  int ix = max(0, min(c.x1, p.x + p.w) - max(c.x0, p.x));
+  int iy = max(0, min(c.y1, p.y + p.h) - max(c.y0, p.y));
+  return p.w > 0 && p.h > 0 ? (double)ix * iy / (p.w * p.h) : 0;
+}
+
+static uint32_t corpusRandom(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static float corpusUniform(uint32_t &state, float lo, float hi) {
+  return lo + (hi - lo) * (corpusRandom(state) % 10000) / 10000.0f;
+}
+
+int main(int argc, char** argv) {
+  const char* dir = nullptr;
+  int scenes = 60;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--scenes") == 0 && i + 1 < argc) scenes = atoi(argv[++i]);
+    else if (strcmp(argv[i], "--verbose") == 0) verbose = true;
+    else dir = argv[i];
+  }
+  hostSerialQuiet(true);
+
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<std::string> names;
+  std::vector<HostPlateBox> plates;
+  if (dir) {
+    hostLoadJpegFolder(dir, frames, &names);
+    if (frames.empty()) {
+      printf("no JPEGs in %s\n", dir);
+      return 1;
+    }
+  } else {
+    uint32_t state = 0x2545F491;
+    for (int i = 0; i < scenes; i++) {
+      HostSceneSpec spec;
+      spec.seed = 100 + i;
+      spec.carX = corpusUniform(state, 0.3f, 0.7f);
+      spec.carY = corpusUniform(state, 0.5f, 0.7f);
+      spec.carScale = corpusUniform(state, 0.6f, 1.3f);
+      spec.carShade = (uint8_t)corpusUniform(state, 30, 160);
+      spec.exposure = (int)corpusUniform(state, -60, 40);
+      spec.blur = corpusRandom(state) % 4 == 0 ? 1 + corpusRandom(state) % 2 : 0;
+      spec.motionBlur = corpusRandom(state) % 5 == 0 ? 2 + corpusRandom(state) % 5 : 0;
+      // one scene in five has no plate: an empty driveway or a car seen side-on
+      if (i % 5 == 4) {
+        spec.car = i % 10 != 4;
+        spec.plate = false;
+      }
+      HostPlateBox plate = {0, 0, 0, 0};
+      frames.push_back(hostRenderScene(spec, &plate));
+      char name[64];
+      snprintf(name, sizeof(name), "scene%03d%s%s", i, spec.plate && spec.car ? "" : " (no plate)",
+               spec.blur || spec.motionBlur ? " (blurred)" : "");
+      names.push_back(name);
+      plates.push_back(plate);
+    }
+  }
+
+  int withPlate = 0, hits = 0, located = 0, withoutPlate = 0, falseCrops = 0, cropped = 0;
+  uint64_t frameBytes = 0, uploadBytes = 0, cropBytes = 0, thumbBytes = 0;
+  double totalMs = 0;
+  for (size_t i = 0; i < frames.size(); i++) {
+    CropOutcome c = cropFrame(frames[i]);
+    bool truth = !plates.empty();
+    bool hasPlate = truth && plates[i].w > 0;
+    double covered = hasPlate && c.hit ? plateCovered(c, plates[i]) : 0;
+
+    frameBytes += c.frameLen;
+    uploadBytes += c.uploadLen;
+    totalMs += c.ms;
+    if (c.hit) {
+      cropped++;
+      cropBytes += c.cropLen;
+      thumbBytes += c.thumbLen;
+    }
+    if (!truth || hasPlate) {
+      withPlate++;
+      hits += c.hit;
+      located += covered >= 0.9;
+    } else {
+      withoutPlate++;
+      falseCrops += c.hit;
+    }
+
+    if (verbose) {
+      printf("  %-28s %6zu B -> %6zu B  %s", names[i].c_str(), c.frameLen, c.uploadLen, c.hit ? "crop" : "full");
+      if (c.hit) printf(" %dx%d at (%d,%d)", c.x1 - c.x0, c.y1 - c.y0, c.x0, c.y0);
+      if (hasPlate) printf(", plate %d%% inside", (int)(covered * 100));
+      printf("  %.1f ms\n", c.ms);
+    }
+  }
+
+  printf("plate crop over %zu frames%s%s\n", frames.size(), dir ? " from " : " (synthetic)", dir ? dir : "");
+  if (dir) {
+    printf("  crop hit rate      %d/%d (%.0f%%)\n", hits, withPlate, 100.0 * hits / withPlate);
+  } else {
+    printf("  crop hit rate      %d/%d plates (%.0f%%)\n", hits, withPlate, withPlate ? 100.0 * hits / withPlate : 0);
+    printf("  plate in crop      %d/%d (%.0f%%, >= 90%% of the plate box)\n", located, withPlate,
+           withPlate ? 100.0 * located / withPlate : 0);
+    printf("  false crops        %d/%d frames without a plate\n", falseCrops, withoutPlate);
+  }
+  printf("  bytes              %llu KB full frames -> %llu KB uploaded (%.0f%% saved)\n",
+         (unsigned long long)frameBytes / 1024, (unsigned long long)uploadBytes / 1024,
+         frameBytes ? 100.0 * (frameBytes - uploadBytes) / frameBytes : 0);
+  if (cropped) {
+    printf("  per crop           %llu B crop + %llu B thumbnail on average\n",
+           (unsigned long long)(cropBytes / cropped), (unsigned long long)(thumbBytes / cropped));
+  }
+  printf("  time               %.1f ms per frame\n", totalMs / frames.size());
+
+  // the synthetic corpus is a regression floor for the detector settings,
+  // a little under what they reach today
+  if (!dir) {
+    CHECK(located * 100 >= withPlate * 60);
+    CHECK_EQ(falseCrops, 0);
+    CHECK(uploadBytes < frameBytes);
+  }
+  finish("bench_plate_crop");
+}
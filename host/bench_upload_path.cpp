@@ -0,0 +1,304 @@
+// Upload path against what it replaced, on the host:
+//
+// - request encoding: sendMultipartRequest() against the String-built
+//   requests of the original sketch (ported below from the baseline, the
+//   response handling left out), written to a socket that discards
+//   everything; time, write() calls and heap allocations per request
+// - frame fan-out: the refcounted SharedFrame pool against a heap-allocated
+//   frame per capture (the pre-pool code, still the fallback when the pool
+//   is empty) and against a JPEG copy per consumer; throughput and heap
+//   churn per frame with two consumers reading the whole image
+//
+//   bench_upload_path [--iterations N] [--size BYTES]
+//
+// Allocation counts cover malloc and operator new on the calling thread.
+// The host String keeps strings of up to 15 characters inline, so it
+// allocates somewhat less often than the Arduino one.
+#include "sketch.cpp"
+#include "host.h"
+#include "check.h"
+#include <chrono>
+#include <new>
+
+// ===== ALLOCATION COUNTING =====
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void __libc_free(void*);
+
+static thread_local bool counting = false;
+static thread_local uint64_t allocCount = 0;
+static thread_local uint64_t allocBytes = 0;
+
+static inline void noteAlloc(size_t size) {
+  if (counting) {
+    allocCount++;
+    allocBytes += size;
+  }
+}
+
+extern "C" void* malloc(size_t size) {
+  noteAlloc(size);
+  return __libc_malloc(size);
+}
+extern "C" void* calloc(size_t n, size_t size) {
+  noteAlloc(n * size);
+  return __libc_calloc(n, size);
+}
+extern "C" void* realloc(void* p, size_t size) {
+  noteAlloc(size);
+  return __libc_realloc(p, size);
+}
+extern "C" void free(void* p) { __libc_free(p); }
+
+void* operator new(size_t size) {
+  noteAlloc(size);
+  void* p = __libc_malloc(size ? size : 1);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { __libc_free(p); }
+void operator delete[](void* p) noexcept { __libc_free(p); }
+void operator delete(void* p, size_t) noexcept { __libc_free(p); }
+void operator delete[](void* p, size_t) noexcept { __libc_free(p); }
+
+// ===== DISCARDING SOCKET =====
+class SinkEndpoint : public HostEndpoint {
+public:
+  class Session : public HostSession {
+  public:
+    explicit Session(SinkEndpoint &ep) : ep(ep) {}
+    size_t send(const uint8_t*, size_t len) override {
+      ep.writes++;
+      ep.bytes += len;
+      return len;
+    }
+    int available() override { return 0; }
+    size_t recv(uint8_t*, size_t) override { return 0; }
+    bool open() override { return true; }
+    SinkEndpoint &ep;
+  };
+  HostSession* accept() override { return new Session(*this); }
+  uint64_t writes = 0;
+  uint64_t bytes = 0;
+};
+
+// ===== BASELINE REQUESTS (original sketch) =====
+static void legacyServerRequest(WiFiClientSecure &client, const uint8_t* imageData, size_t imageLen, bool yield) {
+  String boundary = "----ESP32Boundary";
+  String startReq =
+    "POST /test HTTP/1.1\r\n"
+    "Host: web-production-23072.up.railway.app\r\n"
+    "User-Agent: ESP32CAM\r\n"
+    "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n"
+    "Connection: close\r\n"
+    "Content-Length: " + String(
+        String("--" + boundary + "\r\n").length() +
+        String("Content-Disposition: form-data; name=\"file\"; filename=\"image.jpg\"\r\n").length() +
+        String("Content-Type: image/jpeg\r\n\r\n").length() +
+        imageLen +
+        String("\r\n--" + boundary + "--\r\n").length()
+      ) + "\r\n\r\n";
+
+  client.print(startReq);
+  client.print("--" + boundary + "\r\n");
+  client.print("Content-Disposition: form-data; name=\"file\"; filename=\"image.jpg\"\r\n");
+  client.print("Content-Type: image/jpeg\r\n\r\n");
+
+  const size_t CHUNK = 2048;
+  for (size_t i = 0; i < imageLen; i += CHUNK) {
+    size_t len = (i + CHUNK < imageLen) ? CHUNK : (imageLen - i);
+    client.write(imageData + i, len);
+    if (yield) delay(5);
+  }
+
+  client.print("\r\n--" + boundary + "--\r\n");
+}
+
+static void legacyTelegramRequest(WiFiClientSecure &client, const uint8_t* imageData, size_t imageLen) {
+  const char* myDomain = "api.telegram.org";
+  String head = "--ESP32CAM\r\nContent-Disposition: form-data; name=\"chat_id\"; \r\n\r\n" + String(CHAT_ID) + "\r\n--ESP32CAM\r\nContent-Disposition: form-data; name=\"photo\"; filename=\"" + String(CAMERA_ID) + ".jpg\"\r\nContent-Type: image/jpeg\r\n\r\n";
+  String tail = "\r\n--ESP32CAM--\r\n";
+
+  size_t extraLen = head.length() + tail.length();
+  size_t totalLen = imageLen + extraLen;
+
+  client.println("POST /bot" + String(BOTtoken) + "/sendPhoto HTTP/1.1");
+  client.println("Host: " + String(myDomain));
+  client.println("Content-Length: " + String(totalLen));
+  client.println("Content-Type: multipart/form-data; boundary=ESP32CAM");
+  client.println();
+  client.print(head);
+
+  const uint8_t* fbBuf = imageData;
+  for (size_t n = 0; n < imageLen; n = n + 1024) {
+    if (n + 1024 < imageLen) {
+      client.write(fbBuf, 1024);
+      fbBuf += 1024;
+    } else if (imageLen % 1024 > 0) {
+      client.write(fbBuf, imageLen % 1024);
+    }
+  }
+
+  client.print(tail);
+}
+
+// ===== MEASUREMENT =====
+struct Sample {
+  double usPerOp;
+  double allocsPerOp;
+  double allocBytesPerOp;
+  double writesPerOp;
+  double bytesPerOp;
+};
+
+template <typename Fn>
+static Sample measure(long iterations, SinkEndpoint* sink, Fn fn) {
+  fn();  // warm up: first-use allocations are not churn
+  uint64_t writes0 = sink ? sink->writes : 0, bytes0 = sink ? sink->bytes : 0;
+  allocCount = allocBytes = 0;
+  counting = true;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < iterations; i++) fn();
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+  counting = false;
+  Sample s;
+  s.usPerOp = us / iterations;
+  s.allocsPerOp = (double)allocCount / iterations;
+  s.allocBytesPerOp = (double)allocBytes / iterations;
+  s.writesPerOp = sink ? (double)(sink->writes - writes0) / iterations : 0;
+  s.bytesPerOp = sink ? (double)(sink->bytes - bytes0) / iterations : 0;
+  return s;
+}
+
+static void printRequestRow(const char* name, const Sample &s) {
+  printf("  %-30s %9.1f %8.1f %9.0f %8.1f %8.0f\n", name, s.usPerOp, s.allocsPerOp, s.allocBytesPerOp,
+         s.writesPerOp, s.bytesPerOp);
+}
+
+static void printFanoutRow(const char* name, const Sample &s, size_t imageLen) {
+  printf("  %-30s %9.2f %9.0f %8.1f %9.0f\n", name, s.usPerOp, 1e6 / s.usPerOp * imageLen * 2 / 1048576.0,
+         s.allocsPerOp, s.allocBytesPerOp);
+}
+
+// A consumer reads the whole image, as TLS encryption would
+static volatile uint32_t consumed;
+static void consume(const uint8_t* buf, size_t len) {
+  uint32_t sum = 0;
+  for (size_t i = 0; i < len; i += 8) sum += buf[i];
+  consumed += sum;
+}
+
+static void fanoutShared(const uint8_t* image, size_t len) {
+  SharedFrame* frame = newSharedFrame(image, len, 800, 600);
+  retainFrame(frame);
+  retainFrame(frame);
+  consume(frame->buf, frame->len);
+  releaseFrame(frame);
+  consume(frame->buf, frame->len);
+  releaseFrame(frame);
+  releaseFrame(frame);
+}
+
+// Each consumer owns a copy, freed when it is done
+static void fanoutCopies(const uint8_t* image, size_t len) {
+  SemaphoreHandle_t done = xSemaphoreCreateCounting(2, 0);
+  for (int i = 0; i < 2; i++) {
+    uint8_t* copy = (uint8_t*)ps_malloc(len);
+    memcpy(copy, image, len);
+    consume(copy, len);
+    free(copy);
+    xSemaphoreGive(done);
+  }
+  while (xSemaphoreTake(done, 0) == pdTRUE) {}
+  vSemaphoreDelete(done);
+}
+
+int main(int argc, char** argv) {
+  long iterations = 200;
+  size_t size = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) iterations = atol(argv[++i]);
+    else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) size = strtoul(argv[++i], NULL, 10);
+  }
+  hostSerialQuiet(true);
+
+  std::vector<uint8_t> image;
+  if (size) {
+    image.resize(size);
+    for (size_t i = 0; i < size; i++) image[i] = (uint8_t)(i * 131 + (i >> 7));
+  } else {
+    HostSceneSpec spec;
+    spec.quality = 90;
+    image = hostRenderScene(spec);
+  }
+  printf("image %zu bytes, %ld iterations\n", image.size(), iterations);
+
+  SinkEndpoint sink;
+  hostRoute("sink.test", 443, &sink);
+  WiFiClientSecure sinkClient;
+  sinkClient.connect("sink.test", 443);
+  HostConnection sinkConn = { "Sink", &sinkClient };
+  sinkConn.lock = xSemaphoreCreateMutex();
+
+  // ----- request encoding -----
+  printf("\nrequest encoding (per request)          us   allocs  alloc B   writes    bytes\n");
+  MultipartPart serverParts[] = { { "file", "image.jpg", image.data(), image.size() } };
+  char photoName[48];
+  snprintf(photoName, sizeof(photoName), "%s.jpg", CAMERA_ID);
+  MultipartPart telegramParts[] = {
+    { "chat_id", NULL, (const uint8_t*)CHAT_ID, strlen(CHAT_ID) },
+    { "photo", photoName, image.data(), image.size() },
+  };
+
+  // the baseline sleeps 5 ms per 2 KB chunk, so it gets fewer rounds
+  long slowIterations = max(2L, iterations / 20);
+  Sample legacyServerYield = measure(slowIterations, &sink, [&] {
+    legacyServerRequest(sinkClient, image.data(), image.size(), true);
+  });
+  Sample legacyServer = measure(iterations, &sink, [&] {
+    legacyServerRequest(sinkClient, image.data(), image.size(), false);
+  });
+  Sample encoderServer = measure(iterations, &sink, [&] {
+    sendMultipartRequest(sinkConn, "sink.test", "/test", serverParts, 1);
+  });
+  Sample legacyTelegram = measure(iterations, &sink, [&] {
+    legacyTelegramRequest(sinkClient, image.data(), image.size());
+  });
+  Sample encoderTelegram = measure(iterations, &sink, [&] {
+    sendMultipartRequest(sinkConn, "sink.test", "/botTOKEN/sendPhoto", telegramParts, 2);
+  });
+  printRequestRow("server, String + delay(5)", legacyServerYield);
+  printRequestRow("server, String", legacyServer);
+  printRequestRow("server, encoder", encoderServer);
+  printRequestRow("Telegram, String", legacyTelegram);
+  printRequestRow("Telegram, encoder", encoderTelegram);
+
+  CHECK_EQ(encoderServer.allocsPerOp, 0);
+  CHECK_EQ(encoderTelegram.allocsPerOp, 0);
+  CHECK(encoderServer.writesPerOp < legacyServer.writesPerOp);
+  CHECK(encoderTelegram.writesPerOp < legacyTelegram.writesPerOp);
+
+  // ----- frame fan-out -----
+  initializeUploadWorkers();   // fills the pool's semaphores
+  printf("\nframe fan-out, two consumers (per frame)    us      MB/s   allocs   alloc B\n");
+  Sample pooled = measure(iterations * 10, nullptr, [&] { fanoutShared(image.data(), image.size()); });
+
+  // an exhausted pool makes newSharedFrame() allocate, as every frame did before the pool
+  bool saved[FRAME_POOL_SIZE];
+  memcpy(saved, framePoolUsed, sizeof(saved));
+  for (int i = 0; i < FRAME_POOL_SIZE; i++) framePoolUsed[i] = true;
+  Sample heapFrames = measure(iterations * 10, nullptr, [&] { fanoutShared(image.data(), image.size()); });
+  memcpy(framePoolUsed, saved, sizeof(saved));
+
+  Sample copies = measure(iterations * 10, nullptr, [&] { fanoutCopies(image.data(), image.size()); });
+  printFanoutRow("shared, pooled frame", pooled, image.size());
+  printFanoutRow("shared, heap frame", heapFrames, image.size());
+  printFanoutRow("copy per consumer", copies, image.size());
+
+  CHECK_EQ(pooled.allocsPerOp, 0);
+  CHECK(heapFrames.allocsPerOp > 0);
+  CHECK(copies.allocBytesPerOp >= image.size() * 2);
+  finish("bench_upload_path");
+}
@@ -0,0 +1,35 @@
+#pragma once
+// Minimal test reporting: CHECK records a failure and carries on, finish()
+// prints the tally and leaves with _exit so the sketch's task threads,
+// which never return, do not hold the process open
+#include <stdio.h>
+#include <unistd.h>
+
+static int checksRun = 0;
+static int checksFailed = 0;
+
+#define CHECK(cond)                                                       \
+  do {                                                                    \
+    checksRun++;                                                          \
+    if (!(cond)) {                                                        \
+      checksFailed++;                                                     \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);              \
+    }                                                                     \
+  } while (0)
+
+#define CHECK_EQ(actual, expected)                                        \
+  do {                                                                    \
+    checksRun++;                                                          \
+    long long a_ = (long long)(actual), e_ = (long long)(expected);       \
+    if (a_ != e_) {                                                       \
+      checksFailed++;                                                     \
+      printf("FAIL %s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, \
+             #actual, a_, e_);                                            \
+    }                                                                     \
+  } while (0)
+
+[[noreturn]] static inline void finish(const char* name) {
+  printf("%s: %d checks, %d failed\n", name, checksRun, checksFailed);
+  fflush(stdout);
+  _exit(checksFailed ? 1 : 0);
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "Arduino.h"
+// Text renders as a per-character bit pattern rather than a font: enough for
+// the display code's dirty-page tracking to see what changed
+class Adafruit_GFX : public Print {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : width_(w), height_(h) {}
+  size_t write(uint8_t) override; using Print::write;
+  void setTextSize(uint8_t s) { textSize_ = s ? s : 1; }
+  void setTextColor(uint16_t c) { color_ = c; } void setTextColor(uint16_t c, uint16_t) { color_ = c; }
+  void setCursor(int16_t x, int16_t y) { cursorX_ = x; cursorY_ = y; }
+  void fillRect(int16_t, int16_t, int16_t, int16_t, uint16_t); void drawFastHLine(int16_t, int16_t, int16_t, uint16_t);
+  void setTextWrap(bool) {} int16_t width() const { return width_; } int16_t height() const { return height_; }
+  virtual void drawPixel(int16_t, int16_t, uint16_t) = 0;
+
+protected:
+  int16_t width_, height_;
+  int16_t cursorX_ = 0, cursorY_ = 0;
+  uint8_t textSize_ = 1;
+  uint16_t color_ = 1;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include "Adafruit_GFX.h"
+#include "Wire.h"
+#define SSD1306_SWITCHCAPVCC 0x02
+#define SSD1306_WHITE 1
+#define SSD1306_BLACK 0
+#define SSD1306_COLUMNADDR 0x21
+#define SSD1306_PAGEADDR 0x22
+#define SSD1306_DISPLAYOFF 0xAE
+#define SSD1306_DISPLAYON 0xAF
+class Adafruit_SSD1306 : public Adafruit_GFX {
+public:
+  Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi = &Wire, int8_t rst_pin = -1, uint32_t clkDuring = 400000UL, uint32_t clkAfter = 100000UL);
+  ~Adafruit_SSD1306();
+  bool begin(uint8_t switchvcc = SSD1306_SWITCHCAPVCC, uint8_t i2caddr = 0, bool reset = true, bool periphBegin = true);
+  void display(); void clearDisplay(); void ssd1306_command(uint8_t); uint8_t* getBuffer() { return buffer_; }
+  void drawPixel(int16_t, int16_t, uint16_t) override;
+  void dim(bool) {}
+
+private:
+  TwoWire* wire_;
+  uint8_t addr_ = 0x3C;
+  uint8_t* buffer_;
+};
@@ -0,0 +1,191 @@
+#pragma once
+// Host stand-in for the Arduino-ESP32 core: just enough of the API surface the
+// sketch uses, backed by the runtime in host/mock/*.cpp (see host.h for the
+// knobs tests turn)
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <sys/time.h>
+#include <stdarg.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+using std::min;
+using std::max;
+typedef uint8_t byte;
+typedef bool boolean;
+#define HIGH 1
+#define LOW 0
+#define INPUT 1
+#define OUTPUT 3
+#define INPUT_PULLUP 5
+#define CHANGE 3
+#define FALLING 2
+#define RISING 1
+#define ONLOW 4
+#define ONHIGH 5
+#define ONLOW_WE 12               // level interrupt that also arms the light-sleep GPIO wake
+#define ONHIGH_WE 13
+#define IRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define DRAM_ATTR
+#define EXT_RAM_ATTR
+#define PROGMEM
+#define F(x) x
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long);
+void delayMicroseconds(unsigned int);
+void yield();
+void pinMode(uint8_t, uint8_t);
+void digitalWrite(uint8_t, uint8_t);
+int digitalRead(uint8_t);
+bool psramFound();
+void* ps_malloc(size_t);
+void* ps_calloc(size_t, size_t);
+void* ps_realloc(void*, size_t);
+int digitalPinToInterrupt(int);
+void attachInterrupt(uint8_t, void (*)(void), int);
+void detachInterrupt(uint8_t);
+
+// Arduino's String keeps its text on the heap like this one does, so heap
+// tests see the same allocations the device would make
+class String {
+public:
+  String(const char* s = "") : s_(s ? s : "") {}
+  String(const String&) = default;
+  String(const std::string& s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(int v, unsigned char base = 10) : s_(fromLong(v, base)) {}
+  String(unsigned int v, unsigned char base = 10) : s_(fromUnsigned(v, base)) {}
+  String(long v, unsigned char base = 10) : s_(fromLong(v, base)) {}
+  String(unsigned long v, unsigned char base = 10) : s_(fromUnsigned(v, base)) {}
+  String(float v, unsigned int d = 2) : s_(fromDouble(v, d)) {}
+  String(double v, unsigned int d = 2) : s_(fromDouble(v, d)) {}
+  String& operator=(const String&) = default;
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  unsigned int length() const { return s_.size(); }
+  const char* c_str() const { return s_.c_str(); }
+  bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+  bool endsWith(const String& p) const {
+    return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+  }
+  int indexOf(const String& p) const { size_t i = s_.find(p.s_); return i == std::string::npos ? -1 : (int)i; }
+  int indexOf(char c) const { size_t i = s_.find(c); return i == std::string::npos ? -1 : (int)i; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const char* o) const { return s_ != o; }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from > s_.size()) return String();
+    return String(s_.substr(from, std::min<size_t>(to, s_.size()) - from));
+  }
+  String substring(unsigned int from) const { return substring(from, s_.size()); }
+  void trim();
+  void toLowerCase();
+  void toUpperCase();
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(s_.c_str(), o.s_.c_str()) == 0; }
+  long toInt() const { return atol(s_.c_str()); }
+  bool reserve(unsigned int n) { s_.reserve(n); return true; }
+
+private:
+  static std::string fromLong(long v, unsigned char base);
+  static std::string fromUnsigned(unsigned long v, unsigned char base);
+  static std::string fromDouble(double v, unsigned int decimals);
+  std::string s_;
+};
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, char b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, int b) { return a + String(b); }
+inline String operator+(const String& a, unsigned long b) { return a + String(b); }
+
+class Printable;
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  virtual size_t write(const uint8_t*, size_t);
+  size_t write(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+  size_t print(const char*);
+  size_t print(const String&);
+  size_t print(char);
+  size_t print(int, int = 10);
+  size_t print(unsigned int, int = 10);
+  size_t print(long, int = 10);
+  size_t print(unsigned long, int = 10);
+  size_t print(double, int = 2);
+  size_t print(const Printable&);
+  size_t println(const char*);
+  size_t println(const String&);
+  size_t println(char);
+  size_t println(int, int = 10);
+  size_t println(unsigned int, int = 10);
+  size_t println(long, int = 10);
+  size_t println(unsigned long, int = 10);
+  size_t println(double, int = 2);
+  size_t println(const Printable&);
+  size_t println();
+  size_t printf(const char*, ...) __attribute__((format(printf, 2, 3)));
+  virtual void flush() {}
+};
+class Printable { public: virtual ~Printable(){} virtual size_t printTo(Print&) const = 0; };
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  int read(uint8_t*, size_t);
+  void setTimeout(unsigned long ms) { timeout_ = ms; }
+  String readStringUntil(char);
+  String readString();
+  size_t readBytes(uint8_t*, size_t);
+
+protected:
+  int timedRead();
+  unsigned long timeout_ = 1000;
+};
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long) {}
+  size_t write(uint8_t) override;
+  size_t write(const uint8_t*, size_t) override;
+  using Print::write;
+  int available() override; int read() override; int peek() override;
+  void flush() override;
+  operator bool() const { return true; }
+};
+extern HardwareSerial Serial;
+class EspClass {
+public:
+  uint32_t getPsramSize(); uint32_t getFreePsram(); uint32_t getFreeHeap(); uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap(); uint32_t getHeapSize(); uint32_t getMaxAllocPsram(); uint32_t getMinFreePsram();
+  void restart() __attribute__((noreturn));
+  uint64_t getEfuseMac();
+};
+extern EspClass ESP;
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp32-hal-log.h"
+#include "esp_attr.h"
+#include "driver/gpio.h"
+struct tm;
+bool getLocalTime(struct tm*, uint32_t ms = 5000);
+void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr);
+#define log_e(...)
+#define log_i(...)
+#define log_w(...)
+#define log_d(...)
@@ -0,0 +1,13 @@
+#pragma once
+#include "Arduino.h"
+#include "IPAddress.h"
+class Client : public Stream {
+public:
+  virtual int connect(const char*, uint16_t) = 0;
+  virtual size_t write(uint8_t) override = 0;
+  virtual size_t write(const uint8_t*, size_t) override = 0;
+  using Print::write;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+  virtual operator bool() = 0;
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <Arduino.h>
+#include <memory>
+namespace fs {
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+struct FileImpl;
+// Files map onto a host directory (host.h: hostFsRoot()); copies share the
+// open handle like the core's File does
+class File : public Stream {
+public:
+  File() {}
+  explicit File(std::shared_ptr<FileImpl> impl) : impl_(impl) {}
+  size_t write(uint8_t) override;
+  size_t write(const uint8_t*, size_t) override;
+  using Print::write;
+  int available() override; int read() override; int peek() override;
+  size_t read(uint8_t*, size_t);
+  bool seek(uint32_t, SeekMode = SeekSet);
+  size_t size() const;
+  size_t position() const;
+  void close() { impl_.reset(); }
+  operator bool() const { return impl_ != nullptr; }
+  const char* name() const;
+  const char* path() const;
+  bool isDirectory();
+  File openNextFile(const char* mode = "r");
+  void rewindDirectory();
+  time_t getLastWrite();
+
+private:
+  std::shared_ptr<FileImpl> impl_;
+};
+class FS {
+public:
+  File open(const char*, const char* mode = "r", bool create = false);
+  File open(const String& p, const char* mode = "r", bool create = false) { return open(p.c_str(), mode, create); }
+  bool exists(const char*);
+  bool exists(const String& p) { return exists(p.c_str()); }
+  bool remove(const char*);
+  bool remove(const String& p) { return remove(p.c_str()); }
+  bool rename(const char*, const char*);
+  bool rename(const String& a, const String& b) { return rename(a.c_str(), b.c_str()); }
+  bool mkdir(const char*);
+  bool mkdir(const String& p) { return mkdir(p.c_str()); }
+  bool rmdir(const char*);
+};
+}
+using fs::FS;
+using fs::File;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
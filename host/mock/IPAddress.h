@@ -0,0 +1,16 @@
+#pragma once
+#include "Arduino.h"
+class IPAddress : public Printable {
+public:
+  IPAddress() : addr_(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr_(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t a) : addr_(a) {}
+  operator uint32_t() const { return addr_; }
+  String toString() const;
+  size_t printTo(Print& p) const override { return p.print(toString()); }
+  uint8_t operator[](int i) const { return (addr_ >> (8 * i)) & 0xFF; }
+  bool operator==(const IPAddress& o) const { return addr_ == o.addr_; }
+
+private:
+  uint32_t addr_;
+};
@@ -0,0 +1,4 @@
+#pragma once
+#include "Arduino.h"
+#include "Client.h"
+extern const char* TELEGRAM_CERTIFICATE_ROOT;
@@ -0,0 +1,31 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include "WiFi.h"
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_POST };
+class WebServer {
+public:
+  typedef std::function<void(void)> THandlerFunction;
+  WebServer(int port = 80) : port_(port) {}
+  void begin();
+  void handleClient() {}
+  void on(const String& uri, THandlerFunction fn) { on(uri, HTTP_ANY, fn); }
+  void on(const String& uri, HTTPMethod, THandlerFunction fn) { routes_.push_back({uri, fn}); }
+  void onNotFound(THandlerFunction fn) { notFound_ = fn; }
+  String arg(const String& name);
+  bool hasArg(const String& name);
+  void send(int code, const char* content_type = NULL, const String& content = String(""));
+  void sendHeader(const String&, const String&, bool = false) {}
+
+  // host.h: hostWebRequest() dispatches through here
+  int serve(const char* uri, const char* query, std::string* body);
+
+private:
+  struct Route { String uri; THandlerFunction fn; };
+  int port_;
+  std::vector<Route> routes_;
+  THandlerFunction notFound_;
+  std::string query_;
+  int sentCode_ = 0;
+  std::string sentBody_;
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "esp_wifi.h"
+typedef enum { WL_IDLE_STATUS=0, WL_NO_SSID_AVAIL=1, WL_SCAN_COMPLETED=2, WL_CONNECTED=3, WL_CONNECT_FAILED=4, WL_CONNECTION_LOST=5, WL_DISCONNECTED=6 } wl_status_t;
+typedef enum { WIFI_OFF=0, WIFI_STA=1, WIFI_AP=2, WIFI_AP_STA=3 } wifi_mode_t_ard;
+#define WIFI_MODE_STA_ 1
+typedef int arduino_event_id_t;
+typedef struct { int event_id; } arduino_event_t;
+class WiFiClass {
+public:
+  bool mode(int); wl_status_t begin(const char*, const char*, int32_t channel = 0, const uint8_t* bssid = nullptr, bool connect = true);
+  wl_status_t status(); IPAddress localIP(); IPAddress gatewayIP(); IPAddress subnetMask(); IPAddress dnsIP(uint8_t = 0);
+  bool config(IPAddress, IPAddress, IPAddress, IPAddress = IPAddress(), IPAddress = IPAddress());
+  uint8_t* BSSID(); int32_t channel(); int8_t RSSI(); bool reconnect(); bool disconnect(bool wifioff = false, bool eraseap = false);
+  bool setSleep(bool); bool setSleep(wifi_ps_type_t); bool setAutoReconnect(bool); bool persistent(bool); bool isConnected();
+  bool setHostname(const char*); String macAddress();
+};
+extern WiFiClass WiFi;
@@ -0,0 +1,22 @@
+#pragma once
+#include "WiFiClient.h"
+class HostSession;
+// Connections go wherever host.h routed the host name: an in-memory stand-in
+// or a real TLS socket on localhost
+class WiFiClientSecure : public WiFiClient {
+public:
+  WiFiClientSecure(); ~WiFiClientSecure();
+  int connect(const char*, uint16_t) override;
+  int connect(const char*, uint16_t, int32_t);
+  size_t write(uint8_t) override; size_t write(const uint8_t*, size_t) override; using Print::write;
+  int available() override; int read() override; int peek() override; int read(uint8_t*, size_t);
+  void stop() override; uint8_t connected() override; operator bool() override;
+  void setInsecure() {} void setCACert(const char*) {} void setHandshakeTimeout(unsigned long) {}
+  int lastError(char*, const size_t);
+
+private:
+  HostSession* session_ = nullptr;
+  void* tlsBuffer_ = nullptr;
+  int peeked_ = -1;
+  int64_t readyAtUs_ = 0;
+};
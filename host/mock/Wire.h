@@ -0,0 +1,19 @@
+#pragma once
+#include "Arduino.h"
+// I2C with a device at every address that acks everything; the bytes written
+// are counted so display tests can see what a refresh costs on the bus
+class TwoWire : public Stream {
+public:
+  bool begin(int, int, uint32_t freq = 0) { if (freq) clock_ = freq; return true; }
+  bool setClock(uint32_t f) { clock_ = f; return true; } uint32_t getClock() { return clock_; } void setTimeOut(uint16_t) {}
+  void beginTransmission(uint8_t) { pending_ = 0; } uint8_t endTransmission(bool stop = true);
+  size_t write(uint8_t) override { pending_++; return 1; } size_t write(const uint8_t*, size_t n) override { pending_ += n; return n; } using Print::write;
+  int available() override { return 0; } int read() override { return -1; } int peek() override { return -1; }
+  uint64_t bytesWritten = 0;
+  uint32_t transactions = 0;
+
+private:
+  uint32_t clock_ = 100000;
+  size_t pending_ = 0;
+};
+extern TwoWire Wire;
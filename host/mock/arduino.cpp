@@ -0,0 +1,500 @@
+// Core runtime: clock, pins, Serial, heap and power queries
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFi.h"
+#include "esp_pm.h"
+#include "esp_sntp.h"
+#include "driver/uart.h"
+#include "host.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// ===== CLOCK =====
+static const auto clockStart = std::chrono::steady_clock::now();
+static std::atomic<bool> manualClock{false};
+static std::atomic<int64_t> manualUs{0};
+
+int64_t hostNowUs() {
+  if (manualClock) return manualUs;
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - clockStart).count();
+}
+
+void hostUseManualClock(bool manual) {
+  if (manual) manualUs = hostNowUs();
+  manualClock = manual;
+}
+
+void hostAdvanceMs(uint32_t ms) { manualUs += (int64_t)ms * 1000; }
+
+unsigned long millis() { return (unsigned long)(hostNowUs() / 1000); }
+unsigned long micros() { return (unsigned long)hostNowUs(); }
+int64_t esp_timer_get_time(void) { return hostNowUs(); }
+
+void delay(unsigned long ms) {
+  if (manualClock) {
+    hostAdvanceMs(ms);
+    std::this_thread::yield();
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us) {
+  if (manualClock) {
+    manualUs += us;
+    return;
+  }
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield() { std::this_thread::yield(); }
+
+// ===== GPIO =====
+struct PinState {
+  int level = HIGH;
+  void (*isr)(void) = nullptr;
+  int mode = 0;
+  bool intrEnabled = true;
+  bool wakeup = false;
+};
+static PinState pins[40];
+static std::recursive_mutex pinLock;
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < 40 && mode == INPUT_PULLUP) pins[pin].level = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin < 40) pins[pin].level = level;
+}
+
+int digitalRead(uint8_t pin) { return pin < 40 ? pins[pin].level : LOW; }
+int digitalPinToInterrupt(int pin) { return pin; }
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  std::lock_guard<std::recursive_mutex> hold(pinLock);
+  pins[pin].isr = isr;
+  pins[pin].mode = mode;
+  pins[pin].intrEnabled = true;
+  if (mode == ONLOW_WE || mode == ONHIGH_WE) pins[pin].wakeup = true;
+}
+
+// Like the core: the pin's wake goes with its interrupt
+void detachInterrupt(uint8_t pin) {
+  std::lock_guard<std::recursive_mutex> hold(pinLock);
+  pins[pin].isr = nullptr;
+  pins[pin].wakeup = false;
+}
+
+void hostSetPin(uint8_t pin, int level) {
+  void (*isr)(void) = nullptr;
+  {
+    std::lock_guard<std::recursive_mutex> hold(pinLock);
+    PinState &p = pins[pin];
+    int previous = p.level;
+    p.level = level;
+    if (p.isr == nullptr || !p.intrEnabled || previous == level) return;
+    bool rising = level == HIGH;
+    if (p.mode == CHANGE || (p.mode == RISING && rising) || (p.mode == FALLING && !rising)) isr = p.isr;
+    // a level interrupt fires once here, as if its ISR disabled it at once
+    if (((p.mode == ONLOW || p.mode == ONLOW_WE) && !rising) || ((p.mode == ONHIGH || p.mode == ONHIGH_WE) && rising)) {
+      isr = p.isr;
+    }
+  }
+  if (isr) isr();
+}
+
+int hostPinLevel(uint8_t pin) { return pins[pin].level; }
+bool hostInterruptAttached(uint8_t pin) { return pins[pin].isr != nullptr && pins[pin].intrEnabled; }
+bool hostGpioWakeupArmed(uint8_t pin) { return pins[pin].wakeup; }
+
+esp_err_t gpio_wakeup_enable(gpio_num_t pin, gpio_int_type_t) { pins[pin].wakeup = true; return ESP_OK; }
+esp_err_t gpio_wakeup_disable(gpio_num_t pin) { pins[pin].wakeup = false; return ESP_OK; }
+esp_err_t gpio_set_intr_type(gpio_num_t, gpio_int_type_t) { return ESP_OK; }
+esp_err_t gpio_intr_disable(gpio_num_t pin) { pins[pin].intrEnabled = false; return ESP_OK; }
+esp_err_t gpio_intr_enable(gpio_num_t pin) { pins[pin].intrEnabled = true; return ESP_OK; }
+int gpio_get_level(gpio_num_t pin) { return pins[pin].level; }
+esp_err_t gpio_hold_en(gpio_num_t) { return ESP_OK; }
+esp_err_t gpio_hold_dis(gpio_num_t) { return ESP_OK; }
+
+// ===== STRING / PRINT =====
+std::string String::fromLong(long v, unsigned char base) {
+  if (base == 10) return std::to_string(v);
+  return v < 0 ? "-" + fromUnsigned((unsigned long)-v, base) : fromUnsigned(v, base);
+}
+
+std::string String::fromUnsigned(unsigned long v, unsigned char base) {
+  if (base == 10) return std::to_string(v);
+  char digits[65];
+  int i = 64;
+  digits[i] = '\0';
+  do {
+    int d = v % base;
+    digits[--i] = d < 10 ? '0' + d : 'a' + d - 10;
+    v /= base;
+  } while (v);
+  return digits + i;
+}
+
+std::string String::fromDouble(double v, unsigned int decimals) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+  return buf;
+}
+
+void String::trim() {
+  size_t a = s_.find_first_not_of(" \t\r\n");
+  if (a == std::string::npos) { s_.clear(); return; }
+  size_t b = s_.find_last_not_of(" \t\r\n");
+  s_ = s_.substr(a, b - a + 1);
+}
+
+void String::toLowerCase() { for (char &c : s_) c = tolower((unsigned char)c); }
+void String::toUpperCase() { for (char &c : s_) c = toupper((unsigned char)c); }
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(buf);
+}
+
+size_t Print::write(const uint8_t* data, size_t len) {
+  size_t n = 0;
+  while (len--) n += write(*data++);
+  return n;
+}
+
+size_t Print::print(const char* s) { return write(s); }
+size_t Print::print(const String& s) { return write((const uint8_t*)s.c_str(), s.length()); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(int v, int base) { return print(String((long)v, base)); }
+size_t Print::print(unsigned int v, int base) { return print(String((unsigned long)v, base)); }
+size_t Print::print(long v, int base) { return print(String(v, base)); }
+size_t Print::print(unsigned long v, int base) { return print(String(v, base)); }
+size_t Print::print(double v, int digits) { return print(String(v, digits)); }
+size_t Print::print(const Printable& p) { return p.printTo(*this); }
+size_t Print::println() { return write("\r\n"); }
+size_t Print::println(const char* s) { return print(s) + println(); }
+size_t Print::println(const String& s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(int v, int base) { return print(v, base) + println(); }
+size_t Print::println(unsigned int v, int base) { return print(v, base) + println(); }
+size_t Print::println(long v, int base) { return print(v, base) + println(); }
+size_t Print::println(unsigned long v, int base) { return print(v, base) + println(); }
+size_t Print::println(double v, int digits) { return print(v, digits) + println(); }
+size_t Print::println(const Printable& p) { return print(p) + println(); }
+
+size_t Print::printf(const char* format, ...) {
+  char stackBuf[256];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(stackBuf, sizeof(stackBuf), format, args);
+  va_end(args);
+  if (len < 0) return 0;
+  if ((size_t)len < sizeof(stackBuf)) return write((const uint8_t*)stackBuf, len);
+  char* big = (char*)malloc(len + 1);
+  va_start(args, format);
+  vsnprintf(big, len + 1, format, args);
+  va_end(args);
+  size_t n = write((const uint8_t*)big, len);
+  free(big);
+  return n;
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) return c;
+    delay(1);
+  } while (millis() - start < timeout_);
+  return -1;
+}
+
+int Stream::read(uint8_t* buf, size_t len) { return (int)readBytes(buf, len); }
+
+size_t Stream::readBytes(uint8_t* buf, size_t len) {
+  size_t n = 0;
+  while (n < len) {
+    int c = timedRead();
+    if (c < 0) break;
+    buf[n++] = (uint8_t)c;
+  }
+  return n;
+}
+
+String Stream::readStringUntil(char terminator) {
+  String s;
+  int c;
+  while ((c = timedRead()) >= 0 && c != terminator) s += (char)c;
+  return s;
+}
+
+String Stream::readString() {
+  String s;
+  int c;
+  while ((c = timedRead()) >= 0) s += (char)c;
+  return s;
+}
+
+// ===== SERIAL =====
+HardwareSerial Serial;
+static std::atomic<bool> serialQuiet{false};
+static std::mutex serialInLock;
+static std::deque<char> serialIn;
+
+void hostSerialQuiet(bool quiet) { serialQuiet = quiet; }
+
+void hostSerialInput(const char* text) {
+  std::lock_guard<std::mutex> hold(serialInLock);
+  while (*text) serialIn.push_back(*text++);
+}
+
+size_t HardwareSerial::write(uint8_t c) { return write(&c, 1); }
+
+size_t HardwareSerial::write(const uint8_t* data, size_t len) {
+  if (!serialQuiet) fwrite(data, 1, len, stdout);
+  return len;
+}
+
+void HardwareSerial::flush() { fflush(stdout); }
+
+int HardwareSerial::available() {
+  std::lock_guard<std::mutex> hold(serialInLock);
+  return (int)serialIn.size();
+}
+
+int HardwareSerial::read() {
+  std::lock_guard<std::mutex> hold(serialInLock);
+  if (serialIn.empty()) return -1;
+  char c = serialIn.front();
+  serialIn.pop_front();
+  return (uint8_t)c;
+}
+
+int HardwareSerial::peek() {
+  std::lock_guard<std::mutex> hold(serialInLock);
+  return serialIn.empty() ? -1 : (uint8_t)serialIn.front();
+}
+
+// ===== HEAP =====
+// Defaults: an ESP32 with WiFi up and two TLS sessions open
+static const HostHeapProbe* heapProbe = nullptr;
+static const size_t INTERNAL_TOTAL = 320 * 1024;
+static const size_t PSRAM_TOTAL = 4 * 1024 * 1024;
+
+static thread_local int offDeviceDepth = 0;
+
+void hostSetHeapProbe(const HostHeapProbe* probe) { heapProbe = probe; }
+bool hostOffDeviceHeap() { return offDeviceDepth > 0; }
+HostOffDeviceScope::HostOffDeviceScope() { offDeviceDepth++; }
+HostOffDeviceScope::~HostOffDeviceScope() { offDeviceDepth--; }
+
+static size_t freeInternal() { return heapProbe ? heapProbe->freeSize() : 150 * 1024; }
+static size_t minimumInternal() { return heapProbe ? heapProbe->minimumFreeSize() : 120 * 1024; }
+static size_t largestInternal() { return heapProbe ? heapProbe->largestFreeBlock() : 110 * 1024; }
+
+bool psramFound() { return true; }
+void* ps_malloc(size_t n) {
+  HostOffDeviceScope psram;
+  return malloc(n);
+}
+
+void* ps_calloc(size_t n, size_t size) {
+  HostOffDeviceScope psram;
+  return calloc(n, size);
+}
+
+void* ps_realloc(void* p, size_t n) {
+  HostOffDeviceScope psram;
+  return realloc(p, n);
+}
+
+void* heap_caps_malloc(size_t n, uint32_t caps) {
+  if (caps & MALLOC_CAP_SPIRAM) return ps_malloc(n);
+  return malloc(n);
+}
+
+void* heap_caps_calloc(size_t n, size_t size, uint32_t caps) {
+  if (caps & MALLOC_CAP_SPIRAM) return ps_calloc(n, size);
+  return calloc(n, size);
+}
+void heap_caps_free(void* p) { free(p); }
+
+size_t heap_caps_get_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? PSRAM_TOTAL / 2 : freeInternal();
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? PSRAM_TOTAL / 2 : minimumInternal();
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? PSRAM_TOTAL / 2 : largestInternal();
+}
+
+size_t heap_caps_get_total_size(uint32_t caps) {
+  return (caps & MALLOC_CAP_SPIRAM) ? PSRAM_TOTAL : INTERNAL_TOTAL;
+}
+
+EspClass ESP;
+uint32_t EspClass::getPsramSize() { return PSRAM_TOTAL; }
+uint32_t EspClass::getFreePsram() { return PSRAM_TOTAL / 2; }
+uint32_t EspClass::getMinFreePsram() { return PSRAM_TOTAL / 2; }
+uint32_t EspClass::getMaxAllocPsram() { return PSRAM_TOTAL / 2; }
+uint32_t EspClass::getFreeHeap() { return freeInternal(); }
+uint32_t EspClass::getMinFreeHeap() { return minimumInternal(); }
+uint32_t EspClass::getMaxAllocHeap() { return largestInternal(); }
+uint32_t EspClass::getHeapSize() { return INTERNAL_TOTAL; }
+uint64_t EspClass::getEfuseMac() { return 0x0000A1B2C3D4E5F6ull; }
+
+void EspClass::restart() {
+  fflush(stdout);
+  throw HostRestart();
+}
+
+// ===== SYSTEM =====
+const char* esp_err_to_name(esp_err_t err) {
+  switch (err) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+    default: return "ESP_ERR";
+  }
+}
+
+uint32_t esp_random(void) {
+  static std::atomic<uint32_t> state{0x9E3779B9u};
+  uint32_t x = state.load();
+  uint32_t next;
+  do {
+    next = x;
+    next ^= next << 13;
+    next ^= next >> 17;
+    next ^= next << 5;
+  } while (!state.compare_exchange_weak(x, next));
+  return next;
+}
+
+esp_reset_reason_t esp_reset_reason(void) { return ESP_RST_POWERON; }
+
+// ===== POWER =====
+static HostPower power = {};
+static esp_err_t pmResult = ESP_ERR_NOT_SUPPORTED;
+static esp_sleep_wakeup_cause_t wakeCause = ESP_SLEEP_WAKEUP_UNDEFINED;
+static esp_sleep_wakeup_cause_t nextWake = ESP_SLEEP_WAKEUP_TIMER;
+
+HostPower hostPower() { return power; }
+void hostSetPmResult(int err) { pmResult = err; }
+
+esp_err_t esp_pm_configure(const void* config) {
+  const esp_pm_config_t* pm = (const esp_pm_config_t*)config;
+  if (pmResult != ESP_OK) return pmResult;
+  power.pmConfigured = true;
+  power.pmLightSleep = pm->light_sleep_enable;
+  power.pmMaxMhz = pm->max_freq_mhz;
+  power.pmMinMhz = pm->min_freq_mhz;
+  return ESP_OK;
+}
+
+esp_sleep_wakeup_cause_t esp_sleep_get_wakeup_cause(void) { return wakeCause; }
+esp_err_t esp_sleep_enable_ext0_wakeup(gpio_num_t, int) { return ESP_OK; }
+esp_err_t esp_sleep_enable_timer_wakeup(uint64_t) { return ESP_OK; }
+esp_err_t esp_sleep_enable_gpio_wakeup(void) { return ESP_OK; }
+esp_err_t esp_sleep_enable_uart_wakeup(int) { return ESP_OK; }
+esp_err_t esp_sleep_disable_wakeup_source(esp_sleep_source_t) { return ESP_OK; }
+esp_err_t uart_set_wakeup_threshold(uart_port_t, int) { return ESP_OK; }
+
+void hostSetNextWake(int cause) { nextWake = (esp_sleep_wakeup_cause_t)cause; }
+
+esp_err_t esp_light_sleep_start(void) {
+  power.lightSleeps++;
+  for (const PinState &p : pins) {
+    bool edge = p.mode == CHANGE || p.mode == RISING || p.mode == FALLING;
+    if (p.wakeup && p.isr && p.intrEnabled && edge) power.edgeIsrSleeps++;
+  }
+  // the press that woke it, without an edge for any ISR
+  if (nextWake == ESP_SLEEP_WAKEUP_GPIO) {
+    for (PinState &p : pins) {
+      if (p.wakeup) p.level = LOW;
+    }
+  }
+  wakeCause = nextWake;
+  nextWake = ESP_SLEEP_WAKEUP_TIMER;
+  return ESP_OK;
+}
+
+void esp_deep_sleep_start(void) {
+  fflush(stdout);
+  throw HostDeepSleep();
+}
+
+// ===== WIFI =====
+WiFiClass WiFi;
+static std::atomic<int> wifiStatus{WL_CONNECTED};
+static wifi_config_t staConfig = {};
+static uint8_t bssid[6] = {0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+
+void hostSetWiFiStatus(int status) { wifiStatus = status; }
+
+bool WiFiClass::mode(int) { return true; }
+wl_status_t WiFiClass::begin(const char*, const char*, int32_t, const uint8_t*, bool) {
+  // Arduino's begin() writes a fresh STA config, listen interval included
+  staConfig.sta.listen_interval = 0;
+  return (wl_status_t)wifiStatus.load();
+}
+wl_status_t WiFiClass::status() { return (wl_status_t)wifiStatus.load(); }
+bool WiFiClass::isConnected() { return wifiStatus == WL_CONNECTED; }
+IPAddress WiFiClass::localIP() { return IPAddress(192, 168, 1, 50); }
+IPAddress WiFiClass::gatewayIP() { return IPAddress(192, 168, 1, 1); }
+IPAddress WiFiClass::subnetMask() { return IPAddress(255, 255, 255, 0); }
+IPAddress WiFiClass::dnsIP(uint8_t) { return IPAddress(192, 168, 1, 1); }
+bool WiFiClass::config(IPAddress, IPAddress, IPAddress, IPAddress, IPAddress) { return true; }
+uint8_t* WiFiClass::BSSID() { return bssid; }
+int32_t WiFiClass::channel() { return 6; }
+int8_t WiFiClass::RSSI() { return -61; }
+bool WiFiClass::reconnect() { return true; }
+bool WiFiClass::disconnect(bool, bool) { return true; }
+bool WiFiClass::setSleep(bool enabled) { power.wifiPowerSave = enabled ? WIFI_PS_MIN_MODEM : WIFI_PS_NONE; return true; }
+bool WiFiClass::setSleep(wifi_ps_type_t mode) { power.wifiPowerSave = mode; return true; }
+bool WiFiClass::setAutoReconnect(bool) { return true; }
+bool WiFiClass::persistent(bool) { return true; }
+bool WiFiClass::setHostname(const char*) { return true; }
+String WiFiClass::macAddress() { return String("A1:B2:C3:D4:E5:F6"); }
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t mode) {
+  power.wifiPowerSave = mode;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_get_config(wifi_interface_t, wifi_config_t* config) {
+  *config = staConfig;
+  return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_config(wifi_interface_t, wifi_config_t* config) {
+  staConfig = *config;
+  power.listenInterval = config->sta.listen_interval;
+  return ESP_OK;
+}
+
+// ===== TIME =====
+static sntp_sync_time_cb_t sntpCallback = nullptr;
+
+void configTime(long, int, const char*, const char*, const char*) {}
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) { sntpCallback = callback; }
+void sntp_set_sync_interval(uint32_t) {}
+bool sntp_restart(void) { return true; }
+
+bool getLocalTime(struct tm* info, uint32_t) {
+  time_t now = time(nullptr);
+  localtime_r(&now, info);
+  return true;
+}
@@ -0,0 +1,595 @@
+// Fake OV2640: serves JPEG scenes rendered here or loaded from a folder, and a
+// sensor_t whose setters only track status. The image converters use libjpeg
+// with the same output formats as esp32-camera (big-endian RGB565).
+#include "Arduino.h"
+#include "esp_camera.h"
+#include "img_converters.h"
+#include "host.h"
+#include <atomic>
+#include <csetjmp>
+#include <dirent.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// Arduino.h has its own boolean; keep libjpeg's int one under another name
+#define boolean jpeg_boolean
+#include <jpeglib.h>
+#undef boolean
+
+// ===== LIBJPEG HELPERS =====
+struct JpegError {
+  jpeg_error_mgr mgr;
+  jmp_buf escape;
+};
+
+static void jpegErrorExit(j_common_ptr info) { longjmp(((JpegError*)info->err)->escape, 1); }
+static void jpegSilence(j_common_ptr, int) {}
+
+// Decodes to RGB888 at 1/denom scale
+static bool decodeRgb(const uint8_t* jpeg, size_t len, int denom, std::vector<uint8_t> &rgb, int &w, int &h) {
+  jpeg_decompress_struct info;
+  JpegError err;
+  info.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = jpegErrorExit;
+  err.mgr.emit_message = jpegSilence;
+  if (setjmp(err.escape)) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+  jpeg_create_decompress(&info);
+  jpeg_mem_src(&info, jpeg, len);
+  if (jpeg_read_header(&info, TRUE) != JPEG_HEADER_OK) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+  info.out_color_space = JCS_RGB;
+  info.scale_num = 1;
+  info.scale_denom = denom;
+  jpeg_start_decompress(&info);
+  w = info.output_width;
+  h = info.output_height;
+  rgb.resize((size_t)w * h * 3);
+  while (info.output_scanline < info.output_height) {
+    JSAMPROW row = rgb.data() + (size_t)info.output_scanline * w * 3;
+    jpeg_read_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_decompress(&info);
+  jpeg_destroy_decompress(&info);
+  return true;
+}
+
+static bool encodeRgb(const uint8_t* rgb, int w, int h, int quality, uint8_t** out, size_t* outLen) {
+  jpeg_compress_struct info;
+  JpegError err;
+  unsigned char* mem = nullptr;
+  unsigned long memLen = 0;
+  info.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = jpegErrorExit;
+  if (setjmp(err.escape)) {
+    jpeg_destroy_compress(&info);
+    free(mem);
+    return false;
+  }
+  jpeg_create_compress(&info);
+  jpeg_mem_dest(&info, &mem, &memLen);
+  info.image_width = w;
+  info.image_height = h;
+  info.input_components = 3;
+  info.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&info);
+  jpeg_set_quality(&info, quality, TRUE);
+  jpeg_start_compress(&info, TRUE);
+  while (info.next_scanline < info.image_height) {
+    JSAMPROW row = (JSAMPROW)rgb + (size_t)info.next_scanline * w * 3;
+    jpeg_write_scanlines(&info, &row, 1);
+  }
+  jpeg_finish_compress(&info);
+  jpeg_destroy_compress(&info);
+  *out = mem;
+  *outLen = memLen;
+  return true;
+}
+
+bool hostJpegSize(const uint8_t* jpeg, size_t len, int* width, int* height) {
+  jpeg_decompress_struct info;
+  JpegError err;
+  info.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = jpegErrorExit;
+  err.mgr.emit_message = jpegSilence;
+  if (setjmp(err.escape)) {
+    jpeg_destroy_decompress(&info);
+    return false;
+  }
+  jpeg_create_decompress(&info);
+  jpeg_mem_src(&info, jpeg, len);
+  bool ok = jpeg_read_header(&info, TRUE) == JPEG_HEADER_OK;
+  *width = info.image_width;
+  *height = info.image_height;
+  jpeg_destroy_decompress(&info);
+  return ok;
+}
+
+// ===== SCENES =====
+static uint32_t mix(uint32_t x) {
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+// Value noise: smooth blobs of light and shade for the background
+static float smoothNoise(uint32_t seed, float x, float y) {
+  int xi = (int)floorf(x), yi = (int)floorf(y);
+  float fx = x - xi, fy = y - yi;
+  auto at = [seed](int a, int b) { return (mix(seed ^ mix(a * 73856093u ^ b * 19349663u)) & 0xFFFF) / 65535.0f; };
+  float top = at(xi, yi) + (at(xi + 1, yi) - at(xi, yi)) * fx;
+  float bottom = at(xi, yi + 1) + (at(xi + 1, yi + 1) - at(xi, yi + 1)) * fx;
+  return top + (bottom - top) * fy;
+}
+
+static void fillRect(std::vector<uint8_t> &img, int W, int H, int x, int y, int w, int h, int r, int g, int b) {
+  for (int yy = std::max(0, y); yy < std::min(H, y + h); yy++) {
+    for (int xx = std::max(0, x); xx < std::min(W, x + w); xx++) {
+      uint8_t* p = &img[((size_t)yy * W + xx) * 3];
+      p[0] = r;
+      p[1] = g;
+      p[2] = b;
+    }
+  }
+}
+
+// 5x7 glyph-ish strokes: enough vertical edges to look like characters
+static void drawPlateText(std::vector<uint8_t> &img, int W, int H, const HostPlateBox &box, uint32_t seed) {
+  int chars = 7;
+  int margin = box.w / 12;
+  int cw = (box.w - 2 * margin) / chars;
+  int ch = box.h * 6 / 10;
+  int cy = box.y + (box.h - ch) / 2;
+  int stroke = std::max(1, cw / 5);
+  for (int c = 0; c < chars; c++) {
+    int cx = box.x + margin + c * cw + cw / 8;
+    uint32_t shape = mix(seed * 31 + c);
+    int gw = cw * 3 / 4;
+    fillRect(img, W, H, cx, cy, stroke, ch, 20, 20, 20);
+    if (shape & 1) fillRect(img, W, H, cx + gw - stroke, cy, stroke, ch, 20, 20, 20);
+    if (shape & 2) fillRect(img, W, H, cx, cy, gw, stroke, 20, 20, 20);
+    if (shape & 4) fillRect(img, W, H, cx, cy + ch / 2, gw, stroke, 20, 20, 20);
+    if (shape & 8) fillRect(img, W, H, cx, cy + ch - stroke, gw, stroke, 20, 20, 20);
+  }
+}
+
+std::vector<uint8_t> hostRenderScene(const HostSceneSpec &spec, HostPlateBox* plateOut) {
+  int W = spec.width, H = spec.height;
+  std::vector<uint8_t> img((size_t)W * H * 3);
+
+  // Background: a lit wall over a darker driveway, with texture
+  float scale = W / 800.0f;
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      float sx = (x + spec.shiftX) / scale, sy = (y + spec.shiftY) / scale;
+      float n = smoothNoise(spec.seed, sx / 90.0f, sy / 90.0f) * 0.7f + smoothNoise(spec.seed + 7, sx / 23.0f, sy / 23.0f) * 0.3f;
+      float base = y < H * 0.55f ? 150 + 60 * n : 85 + 50 * n;
+      uint8_t* p = &img[((size_t)y * W + x) * 3];
+      p[0] = (uint8_t)std::min(255.0f, base * (0.9f + 0.2f * smoothNoise(spec.seed + 3, sx / 200.0f, 0)));
+      p[1] = (uint8_t)std::min(255.0f, base);
+      p[2] = (uint8_t)std::min(255.0f, base * 0.92f);
+    }
+  }
+
+  HostPlateBox plate = {0, 0, 0, 0};
+  if (spec.car) {
+    int cw = (int)(W * 0.45f * spec.carScale);
+    int ch = cw * 55 / 100;
+    int cx = (int)(W * spec.carX) - cw / 2 - spec.shiftX;
+    int cy = (int)(H * spec.carY) - ch / 2 - spec.shiftY;
+    uint8_t shade = spec.carShade;
+    fillRect(img, W, H, cx, cy + ch / 4, cw, ch * 3 / 4, shade, shade, shade + 10);
+    fillRect(img, W, H, cx + cw / 6, cy, cw * 2 / 3, ch / 3, shade + 15, shade + 15, shade + 25);
+    fillRect(img, W, H, cx + cw / 5, cy + ch / 20, cw * 3 / 5, ch / 5, 40, 50, 60);   // windscreen
+    fillRect(img, W, H, cx + cw / 12, cy + ch / 2, cw / 8, ch / 10, 230, 220, 180);   // lamps
+    fillRect(img, W, H, cx + cw - cw / 12 - cw / 8, cy + ch / 2, cw / 8, ch / 10, 230, 220, 180);
+    if (spec.plate) {
+      plate.w = cw * 30 / 100;
+      plate.h = plate.w * 22 / 100;
+      plate.x = cx + (cw - plate.w) / 2;
+      plate.y = cy + ch * 70 / 100;
+      fillRect(img, W, H, plate.x, plate.y, plate.w, plate.h, 235, 235, 228);
+      drawPlateText(img, W, H, plate, spec.seed);
+    }
+  }
+
+  if (spec.blur > 0 || spec.motionBlur > 0) {
+    std::vector<uint8_t> src = img;
+    int rx = std::max(spec.blur, spec.motionBlur), ry = spec.blur;
+    for (int y = 0; y < H; y++) {
+      for (int x = 0; x < W; x++) {
+        int sum[3] = {0, 0, 0}, n = 0;
+        for (int dy = -ry; dy <= ry; dy++) {
+          int yy = std::min(H - 1, std::max(0, y + dy));
+          for (int dx = -rx; dx <= rx; dx++) {
+            int xx = std::min(W - 1, std::max(0, x + dx));
+            const uint8_t* p = &src[((size_t)yy * W + xx) * 3];
+            sum[0] += p[0];
+            sum[1] += p[1];
+            sum[2] += p[2];
+            n++;
+          }
+        }
+        uint8_t* p = &img[((size_t)y * W + x) * 3];
+        for (int c = 0; c < 3; c++) p[c] = sum[c] / n;
+      }
+    }
+  }
+
+  uint32_t grain = mix(spec.seed * 977 + spec.exposure * 131 + spec.noise + spec.shiftX * 7 + spec.blur * 13);
+  for (size_t i = 0; i < img.size(); i++) {
+    int v = img[i] + spec.exposure;
+    if (spec.noise) v += (int)(mix(grain + (uint32_t)i) % (2 * spec.noise + 1)) - spec.noise;
+    img[i] = (uint8_t)std::min(255, std::max(0, v));
+  }
+
+  uint8_t* jpeg = nullptr;
+  size_t len = 0;
+  encodeRgb(img.data(), W, H, spec.quality, &jpeg, &len);
+  std::vector<uint8_t> out(jpeg, jpeg + len);
+  free(jpeg);
+  if (plateOut) *plateOut = plate;
+  return out;
+}
+
+size_t hostLoadJpegFolder(const char* dir, std::vector<std::vector<uint8_t>> &frames, std::vector<std::string>* names) {
+  std::vector<std::string> files;
+  if (DIR* d = opendir(dir)) {
+    while (dirent* e = readdir(d)) {
+      std::string n = e->d_name;
+      std::string lower = n;
+      for (char &c : lower) c = tolower((unsigned char)c);
+      if (lower.size() > 4 && (lower.rfind(".jpg") == lower.size() - 4 || lower.rfind(".jpeg") == lower.size() - 5)) files.push_back(n);
+    }
+    closedir(d);
+  }
+  std::sort(files.begin(), files.end());
+  for (const std::string &n : files) {
+    std::string path = std::string(dir) + "/" + n;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) continue;
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + got);
+    fclose(f);
+    int w, h;
+    if (!hostJpegSize(data.data(), data.size(), &w, &h)) continue;
+    frames.push_back(std::move(data));
+    if (names) names->push_back(n);
+  }
+  return files.size();
+}
+
+// ===== CAMERA DRIVER =====
+static const int FB_MAX = 4;
+static std::mutex cameraLock;
+static std::vector<std::vector<uint8_t>> sceneFrames;
+static std::atomic<size_t> selectedScene{0};
+static std::atomic<uint32_t> frameIntervalMs{0};
+static std::atomic<bool> failInit{false};
+static bool cameraUp = false;
+static size_t fbCount = 1;
+static camera_fb_t fbs[FB_MAX];
+static bool fbOut[FB_MAX];
+static HostCameraStats stats = {};
+static std::atomic<uint32_t> sensorWrites{0};
+static int64_t lastFrameUs = 0;
+
+void hostCameraSetFrames(const std::vector<std::vector<uint8_t>> &jpegs) {
+  std::lock_guard<std::mutex> hold(cameraLock);
+  sceneFrames = jpegs;
+  selectedScene = 0;
+}
+
+void hostCameraSelect(size_t index) { selectedScene = index; }
+size_t hostCameraFrames() { return sceneFrames.size(); }
+void hostCameraFrameInterval(uint32_t ms) { frameIntervalMs = ms; }
+void hostCameraFailInit(bool fail) { failInit = fail; }
+
+HostCameraStats hostCameraStats() {
+  std::lock_guard<std::mutex> hold(cameraLock);
+  HostCameraStats current = stats;
+  current.sensorWrites = sensorWrites;
+  return current;
+}
+
+static sensor_t sensor;
+static void initSensor(framesize_t size, int quality);
+
+esp_err_t esp_camera_init(const camera_config_t* config) {
+  HostOffDeviceScope psram;
+  std::lock_guard<std::mutex> hold(cameraLock);
+  if (failInit) return ESP_FAIL;
+  if (sceneFrames.empty()) {
+    HostSceneSpec spec;
+    sceneFrames.push_back(hostRenderScene(spec));
+  }
+  cameraUp = true;
+  fbCount = std::min<size_t>(FB_MAX, std::max<size_t>(1, config->fb_count));
+  memset(fbOut, 0, sizeof(fbOut));
+  stats.inits++;
+  initSensor(config->frame_size, config->jpeg_quality);
+  return ESP_OK;
+}
+
+esp_err_t esp_camera_deinit(void) {
+  std::lock_guard<std::mutex> hold(cameraLock);
+  for (size_t i = 0; i < fbCount; i++) {
+    if (fbOut[i]) {
+      stats.deinitWithFramesOut++;
+      break;
+    }
+  }
+  cameraUp = false;
+  stats.deinits++;
+  return ESP_OK;
+}
+
+camera_fb_t* esp_camera_fb_get(void) {
+  HostOffDeviceScope psram;
+  // The sensor delivers a frame per period; a grab waits for the next one
+  uint32_t interval = frameIntervalMs;
+  if (interval) {
+    int64_t due = lastFrameUs + (int64_t)interval * 1000;
+    int64_t now = hostNowUs();
+    if (due > now) delay((due - now + 999) / 1000);
+  }
+  std::lock_guard<std::mutex> hold(cameraLock);
+  if (!cameraUp) return nullptr;
+  for (size_t i = 0; i < fbCount; i++) {
+    if (fbOut[i]) continue;
+    const std::vector<uint8_t> &jpeg = sceneFrames[selectedScene % sceneFrames.size()];
+    int w = 0, h = 0;
+    hostJpegSize(jpeg.data(), jpeg.size(), &w, &h);
+    int64_t now = hostNowUs();
+    lastFrameUs = now;
+    camera_fb_t &fb = fbs[i];
+    fb.buf = (uint8_t*)jpeg.data();
+    fb.len = jpeg.size();
+    fb.width = w;
+    fb.height = h;
+    fb.format = PIXFORMAT_JPEG;
+    fb.timestamp.tv_sec = now / 1000000;
+    fb.timestamp.tv_usec = now % 1000000;
+    fbOut[i] = true;
+    stats.framesServed++;
+    stats.framesOut++;
+    return &fb;
+  }
+  return nullptr;   // every buffer is held by the caller: the driver times out
+}
+
+void esp_camera_fb_return(camera_fb_t* fb) {
+  std::lock_guard<std::mutex> hold(cameraLock);
+  int i = fb - fbs;
+  if (i >= 0 && i < FB_MAX && fbOut[i]) {
+    fbOut[i] = false;
+    stats.framesOut--;
+  }
+}
+
+// ===== SENSOR =====
+static uint8_t sensorRegs[0x200];
+
+void hostResetSensorWrites() { sensorWrites = 0; }
+
+#define SENSOR_SETTER(name, field)                   \
+  static int name(sensor_t* s, int value) {          \
+    s->status.field = value;                         \
+    sensorWrites++;                                  \
+    return 0;                                        \
+  }
+SENSOR_SETTER(setContrast, contrast)
+SENSOR_SETTER(setBrightness, brightness)
+SENSOR_SETTER(setSaturation, saturation)
+SENSOR_SETTER(setSharpness, sharpness)
+SENSOR_SETTER(setDenoise, denoise)
+SENSOR_SETTER(setQuality, quality)
+SENSOR_SETTER(setColorbar, colorbar)
+SENSOR_SETTER(setWhitebal, awb)
+SENSOR_SETTER(setGainCtrl, agc)
+SENSOR_SETTER(setExposureCtrl, aec)
+SENSOR_SETTER(setHmirror, hmirror)
+SENSOR_SETTER(setVflip, vflip)
+SENSOR_SETTER(setAec2, aec2)
+SENSOR_SETTER(setAwbGain, awb_gain)
+SENSOR_SETTER(setAgcGain, agc_gain)
+SENSOR_SETTER(setAecValue, aec_value)
+SENSOR_SETTER(setSpecialEffect, special_effect)
+SENSOR_SETTER(setWbMode, wb_mode)
+SENSOR_SETTER(setAeLevel, ae_level)
+SENSOR_SETTER(setDcw, dcw)
+SENSOR_SETTER(setBpc, bpc)
+SENSOR_SETTER(setWpc, wpc)
+SENSOR_SETTER(setRawGma, raw_gma)
+SENSOR_SETTER(setLenc, lenc)
+#undef SENSOR_SETTER
+
+static int setFramesize(sensor_t* s, framesize_t size) {
+  s->status.framesize = size;
+  sensorWrites++;
+  return 0;
+}
+
+static int setGainceiling(sensor_t* s, gainceiling_t ceiling) {
+  s->status.gainceiling = ceiling;
+  sensorWrites++;
+  return 0;
+}
+
+static int setPixformat(sensor_t* s, pixformat_t format) {
+  s->pixformat = format;
+  return 0;
+}
+
+static int getReg(sensor_t*, int reg, int mask) { return sensorRegs[reg & 0x1FF] & mask; }
+
+static int setReg(sensor_t*, int reg, int mask, int value) {
+  uint8_t &r = sensorRegs[reg & 0x1FF];
+  r = (r & ~mask) | (value & mask);
+  sensorWrites++;
+  return 0;
+}
+
+static void initSensor(framesize_t size, int quality) {
+  memset(&sensor, 0, sizeof(sensor));
+  sensor.id.PID = OV2640_PID;
+  sensor.pixformat = PIXFORMAT_JPEG;
+  sensor.status.framesize = size;
+  sensor.status.quality = quality;
+  sensor.status.awb = 1;
+  sensor.status.aec = 1;
+  sensor.status.agc = 1;
+  sensor.status.bpc = 0;
+  sensor.status.wpc = 1;
+  sensor.status.raw_gma = 1;
+  sensor.status.lenc = 1;
+  sensor.status.dcw = 1;
+  sensor.status.aec_value = 300;
+  sensor.set_pixformat = setPixformat;
+  sensor.set_framesize = setFramesize;
+  sensor.set_contrast = setContrast;
+  sensor.set_brightness = setBrightness;
+  sensor.set_saturation = setSaturation;
+  sensor.set_sharpness = setSharpness;
+  sensor.set_denoise = setDenoise;
+  sensor.set_gainceiling = setGainceiling;
+  sensor.set_quality = setQuality;
+  sensor.set_colorbar = setColorbar;
+  sensor.set_whitebal = setWhitebal;
+  sensor.set_gain_ctrl = setGainCtrl;
+  sensor.set_exposure_ctrl = setExposureCtrl;
+  sensor.set_hmirror = setHmirror;
+  sensor.set_vflip = setVflip;
+  sensor.set_aec2 = setAec2;
+  sensor.set_awb_gain = setAwbGain;
+  sensor.set_agc_gain = setAgcGain;
+  sensor.set_aec_value = setAecValue;
+  sensor.set_special_effect = setSpecialEffect;
+  sensor.set_wb_mode = setWbMode;
+  sensor.set_ae_level = setAeLevel;
+  sensor.set_dcw = setDcw;
+  sensor.set_bpc = setBpc;
+  sensor.set_wpc = setWpc;
+  sensor.set_raw_gma = setRawGma;
+  sensor.set_lenc = setLenc;
+  sensor.get_reg = getReg;
+  sensor.set_reg = setReg;
+}
+
+sensor_t* esp_camera_sensor_get(void) {
+  std::lock_guard<std::mutex> hold(cameraLock);
+  return cameraUp ? &sensor : nullptr;
+}
+
+// ===== CONVERTERS =====
+static std::atomic<bool> decodeCacheOn{false};
+struct DecodeEntry {
+  const uint8_t* jpeg;
+  size_t len;
+  int scale;
+  std::vector<uint8_t> out;
+};
+static std::mutex decodeCacheLock;
+static std::vector<DecodeEntry> decodeCache;
+
+void hostDecodeCache(bool enabled) {
+  std::lock_guard<std::mutex> hold(decodeCacheLock);
+  decodeCacheOn = enabled;
+  decodeCache.clear();
+}
+
+static bool isSceneFrame(const uint8_t* jpeg) {
+  for (const std::vector<uint8_t> &f : sceneFrames) {
+    if (f.data() == jpeg) return true;
+  }
+  return false;
+}
+
+bool jpg2rgb565(const uint8_t* jpeg, size_t len, uint8_t* out, jpg_scale_t scale) {
+  HostOffDeviceScope psram;
+  bool cacheable = decodeCacheOn && isSceneFrame(jpeg);
+  if (cacheable) {
+    std::lock_guard<std::mutex> hold(decodeCacheLock);
+    for (const DecodeEntry &e : decodeCache) {
+      if (e.jpeg == jpeg && e.len == len && e.scale == scale) {
+        memcpy(out, e.out.data(), e.out.size());
+        return true;
+      }
+    }
+  }
+
+  std::vector<uint8_t> rgb;
+  int w, h;
+  if (!decodeRgb(jpeg, len, 1 << scale, rgb, w, h)) return false;
+  // esp32-camera writes (width >> scale) x (height >> scale)
+  int fullW, fullH;
+  hostJpegSize(jpeg, len, &fullW, &fullH);
+  int outW = fullW >> scale, outH = fullH >> scale;
+  for (int y = 0; y < outH; y++) {
+    for (int x = 0; x < outW; x++) {
+      const uint8_t* p = &rgb[((size_t)std::min(y, h - 1) * w + std::min(x, w - 1)) * 3];
+      uint16_t v = ((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3);
+      out[((size_t)y * outW + x) * 2] = v >> 8;
+      out[((size_t)y * outW + x) * 2 + 1] = v & 0xFF;
+    }
+  }
+
+  if (cacheable) {
+    std::lock_guard<std::mutex> hold(decodeCacheLock);
+    decodeCache.push_back({jpeg, len, scale, std::vector<uint8_t>(out, out + (size_t)outW * outH * 2)});
+  }
+  return true;
+}
+
+bool fmt2rgb888(const uint8_t* src, size_t len, pixformat_t format, uint8_t* out) {
+  HostOffDeviceScope psram;
+  if (format != PIXFORMAT_JPEG) return false;
+  std::vector<uint8_t> rgb;
+  int w, h;
+  if (!decodeRgb(src, len, 1, rgb, w, h)) return false;
+  memcpy(out, rgb.data(), rgb.size());
+  return true;
+}
+
+bool fmt2jpg(uint8_t* src, size_t len, uint16_t width, uint16_t height, pixformat_t format, uint8_t quality,
+             uint8_t** out, size_t* outLen) {
+  HostOffDeviceScope psram;
+  std::vector<uint8_t> rgb((size_t)width * height * 3);
+  if (format == PIXFORMAT_RGB565) {
+    if (len < (size_t)width * height * 2) return false;
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+      uint16_t v = (src[i * 2] << 8) | src[i * 2 + 1];
+      rgb[i * 3] = (v >> 8) & 0xF8;
+      rgb[i * 3 + 1] = (v >> 3) & 0xFC;
+      rgb[i * 3 + 2] = (v << 3) & 0xF8;
+    }
+  } else if (format == PIXFORMAT_RGB888) {
+    memcpy(rgb.data(), src, rgb.size());
+  } else if (format == PIXFORMAT_GRAYSCALE) {
+    for (size_t i = 0; i < (size_t)width * height; i++) rgb[i * 3] = rgb[i * 3 + 1] = rgb[i * 3 + 2] = src[i];
+  } else {
+    return false;
+  }
+  return encodeRgb(rgb.data(), width, height, quality ? quality : 1, out, outLen);
+}
+
+bool frame2jpg(camera_fb_t* fb, uint8_t quality, uint8_t** out, size_t* outLen) {
+  HostOffDeviceScope psram;
+  if (fb->format == PIXFORMAT_JPEG) {
+    *out = (uint8_t*)malloc(fb->len);
+    memcpy(*out, fb->buf, fb->len);
+    *outLen = fb->len;
+    return true;
+  }
+  return fmt2jpg(fb->buf, fb->len, fb->width, fb->height, fb->format, quality, out, outLen);
+}
@@ -0,0 +1,75 @@
+// I2C bus and the SSD1306 frame buffer
+#include "Arduino.h"
+#include "Wire.h"
+#include "Adafruit_SSD1306.h"
+
+TwoWire Wire;
+
+uint8_t TwoWire::endTransmission(bool) {
+  bytesWritten += pending_;
+  transactions++;
+  pending_ = 0;
+  return 0;
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+  if (c == '\n') {
+    cursorX_ = 0;
+    cursorY_ += 8 * textSize_;
+    return 1;
+  }
+  if (c == '\r') return 1;
+  // Stand-in glyph: the character code as a 5x7 bit pattern
+  for (int col = 0; col < 5; col++) {
+    for (int row = 0; row < 7; row++) {
+      if ((c * 31 + col * 7 + row) % 3 == 0) drawPixel(cursorX_ + col, cursorY_ + row, color_);
+    }
+  }
+  cursorX_ += 6 * textSize_;
+  return 1;
+}
+
+void Adafruit_GFX::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t yy = y; yy < y + h; yy++) {
+    for (int16_t xx = x; xx < x + w; xx++) drawPixel(xx, yy, color);
+  }
+}
+
+void Adafruit_GFX::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { fillRect(x, y, w, 1, color); }
+
+Adafruit_SSD1306::Adafruit_SSD1306(uint8_t w, uint8_t h, TwoWire* twi, int8_t, uint32_t, uint32_t)
+    : Adafruit_GFX(w, h), wire_(twi), buffer_((uint8_t*)calloc(w * ((h + 7) / 8), 1)) {}
+
+Adafruit_SSD1306::~Adafruit_SSD1306() { free(buffer_); }
+
+bool Adafruit_SSD1306::begin(uint8_t, uint8_t addr, bool, bool) {
+  if (addr) addr_ = addr;
+  return true;
+}
+
+void Adafruit_SSD1306::display() {
+  wire_->beginTransmission(addr_);
+  wire_->write(buffer_, width_ * ((height_ + 7) / 8));
+  wire_->endTransmission();
+}
+
+void Adafruit_SSD1306::clearDisplay() { memset(buffer_, 0, width_ * ((height_ + 7) / 8)); }
+
+void Adafruit_SSD1306::ssd1306_command(uint8_t c) {
+  wire_->beginTransmission(addr_);
+  wire_->write((uint8_t)0x00);
+  wire_->write(c);
+  wire_->endTransmission();
+}
+
+void Adafruit_SSD1306::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) return;
+  uint8_t &b = buffer_[x + (y / 8) * width_];
+  if (color) {
+    b |= 1 << (y & 7);
+  } else {
+    b &= ~(1 << (y & 7));
+  }
+}
+
+const char* TELEGRAM_CERTIFICATE_ROOT = "-----BEGIN CERTIFICATE-----\nhost\n-----END CERTIFICATE-----\n";
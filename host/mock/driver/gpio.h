@@ -0,0 +1,12 @@
+#pragma once
+#include "esp_system.h"
+typedef enum { GPIO_NUM_0=0, GPIO_NUM_4=4, GPIO_NUM_12=12, GPIO_NUM_13=13, GPIO_NUM_32=32 } gpio_num_t;
+typedef enum { GPIO_INTR_DISABLE, GPIO_INTR_POSEDGE, GPIO_INTR_NEGEDGE, GPIO_INTR_ANYEDGE, GPIO_INTR_LOW_LEVEL, GPIO_INTR_HIGH_LEVEL } gpio_int_type_t;
+esp_err_t gpio_wakeup_enable(gpio_num_t, gpio_int_type_t);
+esp_err_t gpio_wakeup_disable(gpio_num_t);
+esp_err_t gpio_set_intr_type(gpio_num_t, gpio_int_type_t);
+esp_err_t gpio_intr_disable(gpio_num_t);
+esp_err_t gpio_intr_enable(gpio_num_t);
+int gpio_get_level(gpio_num_t);
+esp_err_t gpio_hold_en(gpio_num_t);
+esp_err_t gpio_hold_dis(gpio_num_t);
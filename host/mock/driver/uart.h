@@ -0,0 +1,4 @@
+#pragma once
+#include "esp_system.h"
+typedef enum { UART_NUM_0, UART_NUM_1, UART_NUM_2 } uart_port_t;
+esp_err_t uart_set_wakeup_threshold(uart_port_t, int);
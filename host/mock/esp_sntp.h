@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+#include <sys/time.h>
+typedef void (*sntp_sync_time_cb_t)(struct timeval* tv);
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback);
+void sntp_set_sync_interval(uint32_t interval_ms);
+bool sntp_restart(void);
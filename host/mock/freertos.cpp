@@ -0,0 +1,221 @@
+// FreeRTOS on std::thread: tasks are detached threads, queues and semaphores
+// are fixed ring buffers under a mutex (no allocation after creation, like
+// the real ones), critical sections share one recursive lock
+#include "Arduino.h"
+#include "host.h"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// ===== CRITICAL SECTIONS =====
+static std::recursive_mutex criticalLock;
+
+void portENTER_CRITICAL(portMUX_TYPE*) { criticalLock.lock(); }
+void portEXIT_CRITICAL(portMUX_TYPE*) { criticalLock.unlock(); }
+void portENTER_CRITICAL_ISR(portMUX_TYPE*) { criticalLock.lock(); }
+void portEXIT_CRITICAL_ISR(portMUX_TYPE*) { criticalLock.unlock(); }
+
+// Waits use real time even under the manual clock: tests that freeze the
+// clock only ever poll with a zero timeout
+static bool waitFor(std::condition_variable &cv, std::unique_lock<std::mutex> &lock, TickType_t ticks,
+                    const std::function<bool()> &ready) {
+  if (ready()) return true;
+  if (ticks == 0) return false;
+  if (ticks == portMAX_DELAY) {
+    cv.wait(lock, ready);
+    return true;
+  }
+  return cv.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+// ===== QUEUES =====
+struct HostQueue {
+  std::mutex lock;
+  std::condition_variable changed;
+  uint8_t* items;
+  size_t itemSize;
+  size_t capacity;
+  size_t head = 0;
+  size_t count = 0;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  HostQueue* q = new HostQueue();
+  q->itemSize = itemSize;
+  q->capacity = length;
+  q->items = itemSize ? (uint8_t*)malloc((size_t)length * itemSize) : nullptr;
+  return q;
+}
+
+static BaseType_t queuePut(QueueHandle_t handle, const void* item, TickType_t ticks, bool front) {
+  HostQueue* q = (HostQueue*)handle;
+  std::unique_lock<std::mutex> hold(q->lock);
+  if (!waitFor(q->changed, hold, ticks, [q] { return q->count < q->capacity; })) return pdFALSE;
+  size_t slot;
+  if (front) {
+    q->head = (q->head + q->capacity - 1) % q->capacity;
+    slot = q->head;
+  } else {
+    slot = (q->head + q->count) % q->capacity;
+  }
+  if (q->itemSize) memcpy(q->items + slot * q->itemSize, item, q->itemSize);
+  q->count++;
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void* item, TickType_t ticks) { return queuePut(q, item, ticks, false); }
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void* item, TickType_t ticks) { return queuePut(q, item, ticks, false); }
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void* item, TickType_t ticks) { return queuePut(q, item, ticks, true); }
+
+BaseType_t xQueueSendFromISR(QueueHandle_t q, const void* item, BaseType_t* woken) {
+  if (woken) *woken = pdFALSE;
+  return queuePut(q, item, 0, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t handle, const void* item) {
+  HostQueue* q = (HostQueue*)handle;
+  std::lock_guard<std::mutex> hold(q->lock);
+  q->head = 0;
+  q->count = 1;
+  memcpy(q->items, item, q->itemSize);
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+static BaseType_t queueTake(QueueHandle_t handle, void* item, TickType_t ticks, bool remove) {
+  HostQueue* q = (HostQueue*)handle;
+  std::unique_lock<std::mutex> hold(q->lock);
+  if (!waitFor(q->changed, hold, ticks, [q] { return q->count > 0; })) return pdFALSE;
+  if (q->itemSize && item) memcpy(item, q->items + q->head * q->itemSize, q->itemSize);
+  if (remove) {
+    q->head = (q->head + 1) % q->capacity;
+    q->count--;
+    q->changed.notify_all();
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void* item, TickType_t ticks) { return queueTake(q, item, ticks, true); }
+BaseType_t xQueuePeek(QueueHandle_t q, void* item, TickType_t ticks) { return queueTake(q, item, ticks, false); }
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t handle) {
+  HostQueue* q = (HostQueue*)handle;
+  std::lock_guard<std::mutex> hold(q->lock);
+  return q->count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t handle) {
+  HostQueue* q = (HostQueue*)handle;
+  std::lock_guard<std::mutex> hold(q->lock);
+  return q->capacity - q->count;
+}
+
+BaseType_t xQueueReset(QueueHandle_t handle) {
+  HostQueue* q = (HostQueue*)handle;
+  std::lock_guard<std::mutex> hold(q->lock);
+  q->head = 0;
+  q->count = 0;
+  q->changed.notify_all();
+  return pdTRUE;
+}
+
+void vQueueDelete(QueueHandle_t handle) {
+  HostQueue* q = (HostQueue*)handle;
+  free(q->items);
+  delete q;
+}
+
+// ===== SEMAPHORES =====
+// A semaphore is a queue of empty items: give = send, take = receive
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+  HostQueue* q = (HostQueue*)xQueueCreate(max, 0);
+  q->count = initial;
+  return q;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return xSemaphoreCreateCounting(1, 0); }
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return xSemaphoreCreateCounting(1, 1); }
+BaseType_t xSemaphoreTake(SemaphoreHandle_t s, TickType_t ticks) { return queueTake(s, nullptr, ticks, true); }
+BaseType_t xSemaphoreGive(SemaphoreHandle_t s) { return queuePut(s, nullptr, 0, false); }
+void vSemaphoreDelete(SemaphoreHandle_t s) { vQueueDelete(s); }
+
+// ===== TASKS =====
+struct HostTask {
+  std::mutex lock;
+  std::condition_variable notified;
+  uint32_t notifications = 0;
+};
+
+// vTaskDelete(NULL) unwinds the task's thread back to its entry wrapper
+struct TaskExit {};
+
+static thread_local HostTask* currentTask = nullptr;
+
+static HostTask* selfTask() {
+  if (currentTask == nullptr) currentTask = new HostTask();
+  return currentTask;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char*, uint32_t, void* param, UBaseType_t,
+                                   TaskHandle_t* handle, BaseType_t) {
+  HostTask* task = new HostTask();
+  if (handle) *handle = task;
+  std::thread([fn, param, task] {
+    currentTask = task;
+    try {
+      fn(param);
+    } catch (const TaskExit&) {
+    }
+  }).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char* name, uint32_t stack, void* param, UBaseType_t prio,
+                       TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(fn, name, stack, param, prio, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+  if (handle == nullptr || handle == currentTask) throw TaskExit();
+  // Deleting another task is not modelled; the sketch only ends its own
+}
+
+void vTaskDelay(TickType_t ticks) { delay(ticks); }
+
+void vTaskDelayUntil(TickType_t* previous, TickType_t period) {
+  TickType_t next = *previous + period;
+  TickType_t now = millis();
+  if ((int32_t)(next - now) > 0) delay(next - now);
+  *previous = next;
+}
+
+TickType_t xTaskGetTickCount(void) { return (TickType_t)millis(); }
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks) {
+  HostTask* task = selfTask();
+  std::unique_lock<std::mutex> hold(task->lock);
+  if (!waitFor(task->notified, hold, ticks, [task] { return task->notifications > 0; })) return 0;
+  uint32_t value = task->notifications;
+  task->notifications = clear ? 0 : value - 1;
+  return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t handle) {
+  HostTask* task = (HostTask*)handle;
+  std::lock_guard<std::mutex> hold(task->lock);
+  task->notifications++;
+  task->notified.notify_all();
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t handle, BaseType_t* woken) {
+  if (woken) *woken = pdFALSE;
+  xTaskNotifyGive(handle);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) { return selfTask(); }
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t) { return 2048; }
+BaseType_t xPortGetCoreID(void) { return 1; }
@@ -0,0 +1,24 @@
+#pragma once
+#include <stdint.h>
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xffffffffu
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(x) ((TickType_t)(x))
+#define configTICK_RATE_HZ 1000
+#define tskNO_AFFINITY 0x7fffffff
+#define PRO_CPU_NUM 0
+#define APP_CPU_NUM 1
+#define CONFIG_ARDUINO_RUNNING_CORE 1
+typedef struct { int x; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+void portENTER_CRITICAL(portMUX_TYPE*);
+void portEXIT_CRITICAL(portMUX_TYPE*);
+void portENTER_CRITICAL_ISR(portMUX_TYPE*);
+void portEXIT_CRITICAL_ISR(portMUX_TYPE*);
+#define portYIELD_FROM_ISR() do{}while(0)
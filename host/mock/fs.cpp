@@ -0,0 +1,157 @@
+// LittleFS on a temp directory
+#include "Arduino.h"
+#include "LittleFS.h"
+#include "host.h"
+#include <cerrno>
+#include <dirent.h>
+#include <vector>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+
+fs::LittleFSFS LittleFS;
+
+static std::string fsRoot;
+
+const char* hostFsRoot() {
+  if (fsRoot.empty()) {
+    char tmpl[] = "/tmp/esp32-littlefs-XXXXXX";
+    fsRoot = mkdtemp(tmpl) ? tmpl : "/tmp";
+  }
+  return fsRoot.c_str();
+}
+
+static std::string hostPath(const char* path) { return std::string(hostFsRoot()) + (path[0] == '/' ? "" : "/") + path; }
+
+namespace fs {
+
+struct FileImpl {
+  std::string path;
+  std::string name;
+  FILE* file = nullptr;
+  DIR* dir = nullptr;
+  ~FileImpl() {
+    if (file) fclose(file);
+    if (dir) closedir(dir);
+  }
+};
+
+size_t File::write(uint8_t c) { return write(&c, 1); }
+size_t File::write(const uint8_t* data, size_t len) { return impl_ && impl_->file ? fwrite(data, 1, len, impl_->file) : 0; }
+
+int File::available() {
+  if (!impl_ || !impl_->file) return 0;
+  return (int)(size() - position());
+}
+
+int File::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File::peek() {
+  if (!impl_ || !impl_->file) return -1;
+  int c = fgetc(impl_->file);
+  if (c != EOF) ungetc(c, impl_->file);
+  return c == EOF ? -1 : c;
+}
+
+size_t File::read(uint8_t* buf, size_t len) { return impl_ && impl_->file ? fread(buf, 1, len, impl_->file) : 0; }
+
+bool File::seek(uint32_t pos, SeekMode mode) {
+  if (!impl_ || !impl_->file) return false;
+  int whence = mode == SeekSet ? SEEK_SET : mode == SeekCur ? SEEK_CUR : SEEK_END;
+  return fseek(impl_->file, pos, whence) == 0;
+}
+
+size_t File::size() const {
+  if (!impl_ || !impl_->file) return 0;
+  fflush(impl_->file);
+  struct stat st;
+  return fstat(fileno(impl_->file), &st) == 0 ? st.st_size : 0;
+}
+
+size_t File::position() const { return impl_ && impl_->file ? ftell(impl_->file) : 0; }
+const char* File::name() const { return impl_ ? impl_->name.c_str() : ""; }
+const char* File::path() const { return impl_ ? impl_->path.c_str() : ""; }
+bool File::isDirectory() { return impl_ && impl_->dir; }
+
+File File::openNextFile(const char* mode) {
+  if (!impl_ || !impl_->dir) return File();
+  while (dirent* e = readdir(impl_->dir)) {
+    if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+    std::string child = impl_->path + (impl_->path == "/" ? "" : "/") + e->d_name;
+    return LittleFS.open(child.c_str(), mode);
+  }
+  return File();
+}
+
+void File::rewindDirectory() {
+  if (impl_ && impl_->dir) rewinddir(impl_->dir);
+}
+
+time_t File::getLastWrite() { return 0; }
+
+File FS::open(const char* path, const char* mode, bool) {
+  std::string real = hostPath(path);
+  auto impl = std::make_shared<FileImpl>();
+  impl->path = path;
+  const char* slash = strrchr(path, '/');
+  impl->name = slash ? slash + 1 : path;
+  struct stat st;
+  if (stat(real.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    impl->dir = opendir(real.c_str());
+    return impl->dir ? File(impl) : File();
+  }
+  // Arduino modes are the stdio ones, read in binary
+  std::string m = mode;
+  if (m.find('b') == std::string::npos) m += "b";
+  impl->file = fopen(real.c_str(), m.c_str());
+  return impl->file ? File(impl) : File();
+}
+
+bool FS::exists(const char* path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char* path) { return unlink(hostPath(path).c_str()) == 0; }
+bool FS::rename(const char* from, const char* to) { return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0; }
+bool FS::mkdir(const char* path) { return ::mkdir(hostPath(path).c_str(), 0755) == 0 || errno == EEXIST; }
+bool FS::rmdir(const char* path) { return ::rmdir(hostPath(path).c_str()) == 0; }
+
+bool LittleFSFS::begin(bool, const char*, uint8_t, const char*) {
+  hostFsRoot();
+  return true;
+}
+
+bool LittleFSFS::format() { return true; }
+size_t LittleFSFS::totalBytes() { return 1408 * 1024; }
+
+size_t LittleFSFS::usedBytes() {
+  size_t used = 0;
+  std::vector<std::string> dirs = {hostFsRoot()};
+  while (!dirs.empty()) {
+    std::string d = dirs.back();
+    dirs.pop_back();
+    DIR* dir = opendir(d.c_str());
+    if (!dir) continue;
+    while (dirent* e = readdir(dir)) {
+      if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+      std::string p = d + "/" + e->d_name;
+      struct stat st;
+      if (stat(p.c_str(), &st) != 0) continue;
+      if (S_ISDIR(st.st_mode)) {
+        dirs.push_back(p);
+      } else {
+        used += (st.st_size + 4095) / 4096 * 4096;
+      }
+    }
+    closedir(dir);
+  }
+  return used;
+}
+
+void LittleFSFS::end() {}
+
+}  // namespace fs
@@ -0,0 +1,170 @@
+#pragma once
+// Knobs of the host runtime that stands in for the ESP32 under the sketch.
+// Tests and benchmarks include this next to the sketch to drive the clock,
+// the button, the fake camera and the fake network; the sketch itself never
+// sees any of it.
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// ===== CLOCK =====
+// Real time by default; manual mode freezes millis()/micros() until a test
+// advances them (delay() then advances the clock instead of sleeping)
+int64_t hostNowUs();
+void hostUseManualClock(bool manual);
+void hostAdvanceMs(uint32_t ms);
+
+// ===== SERIAL =====
+void hostSerialQuiet(bool quiet);
+void hostSerialInput(const char* text);
+
+// ===== GPIO =====
+// Drives an input pin; an attached interrupt fires on a matching edge
+void hostSetPin(uint8_t pin, int level);
+int hostPinLevel(uint8_t pin);
+bool hostInterruptAttached(uint8_t pin);
+bool hostGpioWakeupArmed(uint8_t pin);
+
+// ===== HEAP =====
+// heap_caps_* and ESP.getFreeHeap() answer from the probe when one is set,
+// otherwise from constants that look like a healthy ESP32 after WiFi start
+struct HostHeapProbe {
+  size_t (*freeSize)();
+  size_t (*minimumFreeSize)();
+  size_t (*largestFreeBlock)();
+};
+void hostSetHeapProbe(const HostHeapProbe* probe);
+// True while the calling thread allocates memory that is not the device's
+// internal RAM: PSRAM (ps_malloc, heap_caps_malloc with MALLOC_CAP_SPIRAM),
+// the fake camera's buffers and the far end of every connection. A probe
+// that models the internal heap sends those allocations to libc.
+bool hostOffDeviceHeap();
+struct HostOffDeviceScope {
+  HostOffDeviceScope();
+  ~HostOffDeviceScope();
+};
+
+// ===== POWER =====
+struct HostPower {
+  uint32_t lightSleeps;
+  uint32_t edgeIsrSleeps;    // light sleeps entered with a level wake armed under a live edge ISR
+  int wifiPowerSave;         // last esp_wifi_set_ps() mode
+  uint16_t listenInterval;   // last STA config written
+  bool pmConfigured;
+  bool pmLightSleep;
+  int pmMaxMhz;
+  int pmMinMhz;
+};
+HostPower hostPower();
+// esp_pm_configure() answers with this (the Arduino core ships without
+// tickless idle, so ESP_ERR_NOT_SUPPORTED is what a stock build returns)
+void hostSetPmResult(int err);
+// The next esp_light_sleep_start() reports this wake cause (a timer wake
+// otherwise); a GPIO wake also pulls the armed wake pins low, as the press
+void hostSetNextWake(int cause);
+// Thrown by esp_deep_sleep_start() and ESP.restart() so tests can observe
+// them instead of the process ending
+struct HostDeepSleep {};
+struct HostRestart {};
+
+// ===== CAMERA =====
+struct HostPlateBox { int x, y, w, h; };
+
+// A parked-car scene: textured background, a car body and its plate. The
+// same seed always renders the same background so sequences can be built
+// from small variations of one scene.
+struct HostSceneSpec {
+  int width = 800;
+  int height = 600;
+  uint32_t seed = 1;
+  bool car = true;
+  bool plate = true;
+  float carX = 0.5f;         // car centre, fraction of the frame
+  float carY = 0.62f;
+  float carScale = 1.0f;     // 1.0 = car 45% of the frame width
+  uint8_t carShade = 70;
+  int exposure = 0;          // luma offset applied to the whole frame
+  int noise = 3;             // +- sensor noise
+  int blur = 0;              // box blur radius (defocus)
+  int motionBlur = 0;        // horizontal smear length
+  int shiftX = 0;            // camera shake in pixels
+  int shiftY = 0;
+  int quality = 80;          // libjpeg quality
+};
+std::vector<uint8_t> hostRenderScene(const HostSceneSpec& spec, HostPlateBox* plate = nullptr);
+bool hostJpegSize(const uint8_t* jpeg, size_t len, int* width, int* height);
+// Loads every *.jpg/*.jpeg in a folder, sorted by name
+size_t hostLoadJpegFolder(const char* dir, std::vector<std::vector<uint8_t>>& frames,
+                          std::vector<std::string>* names = nullptr);
+
+// Frames esp_camera_fb_get() hands out; hostCameraSelect picks the current
+// one (the camera "sees" that scene until told otherwise)
+void hostCameraSetFrames(const std::vector<std::vector<uint8_t>>& jpegs);
+void hostCameraSelect(size_t index);
+size_t hostCameraFrames();
+void hostCameraFrameInterval(uint32_t ms);   // sensor frame period, 0 = instant
+void hostCameraFailInit(bool fail);
+struct HostCameraStats {
+  uint32_t inits;
+  uint32_t deinits;
+  uint32_t deinitWithFramesOut;   // driver torn down under a frame in use
+  uint32_t framesServed;
+  uint32_t framesOut;
+  uint32_t sensorWrites;
+};
+HostCameraStats hostCameraStats();
+void hostResetSensorWrites();
+// Memoises jpg2rgb565() on the frames above so long soak runs are not
+// dominated by JPEG decoding; leave off for timing benchmarks
+void hostDecodeCache(bool enabled);
+
+// ===== NETWORK =====
+void hostSetWiFiStatus(int status);   // wl_status_t
+
+// Shaping applied to every client connection: connect costs one RTT (plus
+// two for the TLS handshake), writes are paced to the bandwidth, lost
+// segments cost a retransmission timeout and replies arrive an RTT later
+struct HostLink {
+  uint32_t rttMs = 0;
+  uint32_t kbps = 0;        // 0 = unlimited
+  float lossPercent = 0;
+};
+void hostSetLink(const HostLink& link);
+// Internal-RAM cost of a TLS session, allocated on connect and freed on stop
+// (the mbedTLS record buffers plus context on the device)
+void hostSetTlsSessionBytes(size_t bytes);
+
+class HostSession {
+public:
+  virtual ~HostSession() {}
+  virtual size_t send(const uint8_t* data, size_t len) = 0;
+  virtual int available() = 0;          // bytes readable right now
+  virtual size_t recv(uint8_t* data, size_t len) = 0;
+  virtual bool open() = 0;              // false once the peer closed and data is drained
+};
+class HostEndpoint {
+public:
+  virtual ~HostEndpoint() {}
+  virtual HostSession* accept() = 0;    // nullptr refuses the connection
+};
+// Connections to host:port go to the endpoint (nullptr removes the route)
+void hostRoute(const char* host, uint16_t port, HostEndpoint* endpoint);
+// Connections to host:port become real TLS connections to 127.0.0.1:localPort
+void hostRouteTls(const char* host, uint16_t port, uint16_t localPort);
+
+struct HostNetStats {
+  uint32_t connects;
+  uint32_t refused;
+  uint64_t bytesSent;
+  uint64_t bytesReceived;
+};
+HostNetStats hostNetStats();
+
+// ===== WEB SERVER =====
+// Runs the handler registered for uri on the most recently started WebServer
+// and returns the status it sent (0 when nothing matched)
+int hostWebRequest(const char* uri, const char* query, std::string* body = nullptr);
+
+// ===== FILESYSTEM =====
+const char* hostFsRoot();   // LittleFS lives in a temp directory
@@ -0,0 +1,7 @@
+#pragma once
+#include "esp_camera.h"
+typedef enum { JPG_SCALE_NONE, JPG_SCALE_2X, JPG_SCALE_4X, JPG_SCALE_8X, JPG_SCALE_MAX = JPG_SCALE_8X } jpg_scale_t;
+bool jpg2rgb565(const uint8_t*, size_t, uint8_t*, jpg_scale_t);
+bool fmt2rgb888(const uint8_t*, size_t, pixformat_t, uint8_t*);
+bool fmt2jpg(uint8_t*, size_t, uint16_t, uint16_t, pixformat_t, uint8_t, uint8_t**, size_t*);
+bool frame2jpg(camera_fb_t*, uint8_t, uint8_t**, size_t*);
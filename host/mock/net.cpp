@@ -0,0 +1,337 @@
+// Network: WiFiClientSecure connections routed to in-memory endpoints or to
+// real TLS sockets on localhost, shaped by HostLink; plus the WebServer
+#include "Arduino.h"
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+#include "WebServer.h"
+#include "host.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+// ===== ROUTES =====
+struct Route {
+  std::string host;
+  uint16_t port;
+  HostEndpoint* endpoint;
+  uint16_t tlsPort;
+};
+static std::mutex routeLock;
+static std::vector<Route> routes;
+static HostLink shaping;
+static std::atomic<size_t> tlsSessionBytes{0};
+static std::mutex statsLock;
+static HostNetStats netStats = {};
+
+static void setRoute(const char* host, uint16_t port, HostEndpoint* endpoint, uint16_t tlsPort) {
+  std::lock_guard<std::mutex> hold(routeLock);
+  for (size_t i = 0; i < routes.size(); i++) {
+    if (routes[i].host == host && routes[i].port == port) {
+      routes.erase(routes.begin() + i);
+      break;
+    }
+  }
+  if (endpoint || tlsPort) routes.push_back({host, port, endpoint, tlsPort});
+}
+
+void hostRoute(const char* host, uint16_t port, HostEndpoint* endpoint) { setRoute(host, port, endpoint, 0); }
+void hostRouteTls(const char* host, uint16_t port, uint16_t localPort) { setRoute(host, port, nullptr, localPort); }
+void hostSetLink(const HostLink &l) { shaping = l; }
+void hostSetTlsSessionBytes(size_t bytes) { tlsSessionBytes = bytes; }
+
+HostNetStats hostNetStats() {
+  std::lock_guard<std::mutex> hold(statsLock);
+  return netStats;
+}
+
+// ===== REAL TLS =====
+// TLS 1.2 like the mbedTLS build on the device; non-blocking after the
+// handshake so available() never waits for a record
+class TlsSession : public HostSession {
+public:
+  ~TlsSession() override {
+    if (ssl) {
+      SSL_shutdown(ssl);
+      SSL_free(ssl);
+    }
+    if (ctx) SSL_CTX_free(ctx);
+    if (fd >= 0) close(fd);
+  }
+
+  bool connect(uint16_t port) {
+    // a write to a socket the server has shut down fails, as lwIP's does,
+    // instead of raising SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) return false;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr);
+    ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+    if (SSL_connect(ssl) != 1) return false;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    return true;
+  }
+
+  size_t send(const uint8_t* data, size_t len) override {
+    size_t sent = 0;
+    while (sent < len && !closed) {
+      int n = SSL_write(ssl, data + sent, (int)(len - sent));
+      if (n > 0) {
+        sent += n;
+        continue;
+      }
+      int err = SSL_get_error(ssl, n);
+      if (err != SSL_ERROR_WANT_WRITE && err != SSL_ERROR_WANT_READ) {
+        closed = true;
+        break;
+      }
+      pollfd p = {fd, (short)(err == SSL_ERROR_WANT_WRITE ? POLLOUT : POLLIN), 0};
+      poll(&p, 1, 100);
+    }
+    return sent;
+  }
+
+  int available() override {
+    if (pos < len) return (int)(len - pos);
+    if (closed) return 0;
+    int n = SSL_read(ssl, buf, sizeof(buf));
+    if (n > 0) {
+      pos = 0;
+      len = n;
+      return n;
+    }
+    int err = SSL_get_error(ssl, n);
+    if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE) closed = true;
+    return 0;
+  }
+
+  size_t recv(uint8_t* data, size_t want) override {
+    size_t n = std::min<size_t>(want, available());
+    memcpy(data, buf + pos, n);
+    pos += n;
+    return n;
+  }
+
+  bool open() override { return !closed || pos < len; }
+
+private:
+  int fd = -1;
+  SSL_CTX* ctx = nullptr;
+  SSL* ssl = nullptr;
+  bool closed = false;
+  uint8_t buf[16384];
+  size_t pos = 0;
+  size_t len = 0;
+};
+
+// ===== CLIENT =====
+static uint32_t linkRandom() {
+  static std::atomic<uint32_t> state{12345};
+  uint32_t x = state.fetch_add(0x9E3779B9u) + 0x9E3779B9u;
+  x ^= x >> 16;
+  x *= 0x45d9f3b;
+  x ^= x >> 16;
+  return x;
+}
+
+WiFiClientSecure::WiFiClientSecure() {}
+WiFiClientSecure::~WiFiClientSecure() { stop(); }
+
+int WiFiClientSecure::connect(const char* host, uint16_t port, int32_t) { return connect(host, port); }
+
+int WiFiClientSecure::connect(const char* host, uint16_t port) {
+  stop();
+  if (WiFi.status() != WL_CONNECTED) return 0;
+  Route route = {"", 0, nullptr, 0};
+  {
+    std::lock_guard<std::mutex> hold(routeLock);
+    for (const Route &r : routes) {
+      if (r.host == host && r.port == port) route = r;
+    }
+  }
+
+  // TCP handshake plus the two round trips of a full TLS 1.2 handshake
+  if (shaping.rttMs) delay(shaping.rttMs * 3);
+  {
+    HostOffDeviceScope farEnd;
+    if (route.endpoint) {
+      session_ = route.endpoint->accept();
+    } else if (route.tlsPort) {
+      TlsSession* tls = new TlsSession();
+      if (tls->connect(route.tlsPort)) {
+        session_ = tls;
+      } else {
+        delete tls;
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> hold(statsLock);
+  if (session_ == nullptr) {
+    netStats.refused++;
+    return 0;
+  }
+  netStats.connects++;
+  size_t bytes = tlsSessionBytes;
+  if (bytes) tlsBuffer_ = ::operator new(bytes);
+  peeked_ = -1;
+  readyAtUs_ = 0;
+  return 1;
+}
+
+size_t WiFiClientSecure::write(uint8_t c) { return write(&c, 1); }
+
+size_t WiFiClientSecure::write(const uint8_t* data, size_t len) {
+  if (session_ == nullptr) return 0;
+  size_t sent;
+  {
+    HostOffDeviceScope farEnd;
+    if (!session_->open()) return 0;
+    sent = session_->send(data, len);
+  }
+
+  // Pace to the link: serialisation time plus a retransmission timeout for
+  // every segment the loss rate claims
+  uint64_t waitUs = shaping.kbps ? (uint64_t)sent * 8000 / shaping.kbps : 0;
+  if (shaping.lossPercent > 0) {
+    for (size_t seg = 0; seg < (sent + 1459) / 1460; seg++) {
+      if ((linkRandom() % 10000) < shaping.lossPercent * 100) waitUs += std::max<uint32_t>(200, shaping.rttMs * 2) * 1000;
+    }
+  }
+  if (waitUs) delayMicroseconds(waitUs);
+  readyAtUs_ = hostNowUs() + (int64_t)shaping.rttMs * 1000;
+
+  std::lock_guard<std::mutex> hold(statsLock);
+  netStats.bytesSent += sent;
+  return sent;
+}
+
+int WiFiClientSecure::available() {
+  if (session_ == nullptr) return 0;
+  HostOffDeviceScope farEnd;
+  if (peeked_ >= 0) return 1 + std::max(0, session_->available());
+  if (readyAtUs_ && hostNowUs() < readyAtUs_) return 0;
+  return session_->available();
+}
+
+int WiFiClientSecure::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int WiFiClientSecure::peek() {
+  if (peeked_ < 0) {
+    HostOffDeviceScope farEnd;
+    uint8_t c;
+    if (available() <= 0 || session_->recv(&c, 1) != 1) return -1;
+    peeked_ = c;
+  }
+  return peeked_;
+}
+
+int WiFiClientSecure::read(uint8_t* buf, size_t len) {
+  if (session_ == nullptr || len == 0) return -1;
+  size_t n = 0;
+  if (peeked_ >= 0) {
+    buf[n++] = (uint8_t)peeked_;
+    peeked_ = -1;
+  }
+  if (n < len && available() > 0) {
+    HostOffDeviceScope farEnd;
+    n += session_->recv(buf + n, len - n);
+  }
+  if (n == 0) return -1;
+  std::lock_guard<std::mutex> hold(statsLock);
+  netStats.bytesReceived += n;
+  return (int)n;
+}
+
+void WiFiClientSecure::stop() {
+  {
+    HostOffDeviceScope farEnd;
+    delete session_;
+  }
+  session_ = nullptr;
+  ::operator delete(tlsBuffer_);
+  tlsBuffer_ = nullptr;
+  peeked_ = -1;
+}
+
+uint8_t WiFiClientSecure::connected() {
+  HostOffDeviceScope farEnd;
+  return session_ != nullptr && (session_->open() || available() > 0);
+}
+
+WiFiClientSecure::operator bool() { return connected(); }
+
+int WiFiClientSecure::lastError(char* buf, const size_t len) {
+  if (len) buf[0] = '\0';
+  return 0;
+}
+
+// ===== WEB SERVER =====
+static WebServer* activeServer = nullptr;
+
+void WebServer::begin() { activeServer = this; }
+
+String WebServer::arg(const String &name) {
+  std::string key = std::string(name.c_str()) + "=";
+  size_t at = 0;
+  while (at < query_.size()) {
+    size_t end = query_.find('&', at);
+    if (end == std::string::npos) end = query_.size();
+    if (query_.compare(at, key.size(), key) == 0) return String(query_.substr(at + key.size(), end - at - key.size()));
+    at = end + 1;
+  }
+  return String();
+}
+
+bool WebServer::hasArg(const String &name) {
+  std::string key = std::string(name.c_str()) + "=";
+  return query_.compare(0, key.size(), key) == 0 || query_.find("&" + key) != std::string::npos;
+}
+
+void WebServer::send(int code, const char*, const String &content) {
+  sentCode_ = code;
+  sentBody_ = content.c_str();
+}
+
+int WebServer::serve(const char* uri, const char* query, std::string* body) {
+  query_ = query ? query : "";
+  sentCode_ = 0;
+  sentBody_.clear();
+  bool matched = false;
+  for (const Route &r : routes_) {
+    if (r.uri == uri) {
+      r.fn();
+      matched = true;
+      break;
+    }
+  }
+  if (!matched && notFound_) notFound_();
+  if (body) *body = sentBody_;
+  return sentCode_;
+}
+
+int hostWebRequest(const char* uri, const char* query, std::string* body) {
+  return activeServer ? activeServer->serve(uri, query, body) : 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+typedef enum { PIXFORMAT_RGB565, PIXFORMAT_YUV422, PIXFORMAT_YUV420, PIXFORMAT_GRAYSCALE, PIXFORMAT_JPEG, PIXFORMAT_RGB888 } pixformat_t;
+typedef enum { FRAMESIZE_96X96, FRAMESIZE_QQVGA, FRAMESIZE_QCIF, FRAMESIZE_HQVGA, FRAMESIZE_240X240, FRAMESIZE_QVGA, FRAMESIZE_CIF, FRAMESIZE_HVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA, FRAMESIZE_XGA, FRAMESIZE_HD, FRAMESIZE_SXGA, FRAMESIZE_UXGA, FRAMESIZE_INVALID } framesize_t;
+typedef enum { GAINCEILING_2X, GAINCEILING_4X, GAINCEILING_8X, GAINCEILING_16X, GAINCEILING_32X, GAINCEILING_64X, GAINCEILING_128X } gainceiling_t;
+typedef struct { uint16_t width; uint16_t height; } resolution_info_t;
+extern const resolution_info_t resolution[];
+typedef struct { uint8_t MIDH, MIDL; uint16_t PID; uint8_t VER; } sensor_id_t;
+#define OV2640_PID 0x26
+typedef struct {
+  framesize_t framesize; bool scale; bool binning; uint8_t quality; int8_t brightness; int8_t contrast; int8_t saturation; int8_t sharpness; uint8_t denoise; uint8_t special_effect; uint8_t wb_mode; uint8_t awb; uint8_t awb_gain; uint8_t aec; uint8_t aec2; int8_t ae_level; uint16_t aec_value; uint8_t agc; uint8_t agc_gain; uint8_t gainceiling; uint8_t bpc; uint8_t wpc; uint8_t raw_gma; uint8_t lenc; uint8_t hmirror; uint8_t vflip; uint8_t dcw; uint8_t colorbar;
+} camera_status_t;
+typedef struct _sensor sensor_t;
+typedef struct _sensor {
+  sensor_id_t id; uint8_t slv_addr; pixformat_t pixformat; camera_status_t status; int xclk_freq_hz;
+  int (*init_status)(sensor_t*);
+  int (*reset)(sensor_t*);
+  int (*set_pixformat)(sensor_t*, pixformat_t);
+  int (*set_framesize)(sensor_t*, framesize_t);
+  int (*set_contrast)(sensor_t*, int);
+  int (*set_brightness)(sensor_t*, int);
+  int (*set_saturation)(sensor_t*, int);
+  int (*set_sharpness)(sensor_t*, int);
+  int (*set_denoise)(sensor_t*, int);
+  int (*set_gainceiling)(sensor_t*, gainceiling_t);
+  int (*set_quality)(sensor_t*, int);
+  int (*set_colorbar)(sensor_t*, int);
+  int (*set_whitebal)(sensor_t*, int);
+  int (*set_gain_ctrl)(sensor_t*, int);
+  int (*set_exposure_ctrl)(sensor_t*, int);
+  int (*set_hmirror)(sensor_t*, int);
+  int (*set_vflip)(sensor_t*, int);
+  int (*set_aec2)(sensor_t*, int);
+  int (*set_awb_gain)(sensor_t*, int);
+  int (*set_agc_gain)(sensor_t*, int);
+  int (*set_aec_value)(sensor_t*, int);
+  int (*set_special_effect)(sensor_t*, int);
+  int (*set_wb_mode)(sensor_t*, int);
+  int (*set_ae_level)(sensor_t*, int);
+  int (*set_dcw)(sensor_t*, int);
+  int (*set_bpc)(sensor_t*, int);
+  int (*set_wpc)(sensor_t*, int);
+  int (*set_raw_gma)(sensor_t*, int);
+  int (*set_lenc)(sensor_t*, int);
+  int (*get_reg)(sensor_t*, int, int);
+  int (*set_reg)(sensor_t*, int, int, int);
+  int (*set_res_raw)(sensor_t*, int, int, int, int, int, int, int, int, int, int, bool, bool);
+  int (*set_pll)(sensor_t*, int, int, int, int, int, int, int, int);
+  int (*set_xclk)(sensor_t*, int, int);
+} sensor_t;
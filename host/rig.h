@@ -0,0 +1,45 @@
+#pragma once
+// Sketch-side helpers shared by the host tests; include after sketch.cpp.
+// startPipeline() is setup() minus the display, supervisor, remote triggers
+// and the capture/network tasks, with both servers replaced by stand-ins, so
+// a test drives captures itself and sees every stage on its own thread.
+#include "standin.h"
+
+struct HostRig {
+  RailwayStandIn railway;
+  TelegramStandIn telegram;
+};
+
+inline void startPipeline(HostRig &rig) {
+  hostRoute(serverHost, httpsPort, &rig.railway);
+  hostRoute(telegramHost, httpsPort, &rig.telegram);
+  initializeConnections();
+  cameraLock = xSemaphoreCreateMutex();
+  appEvents = xQueueCreate(APP_EVENT_QUEUE_LEN, sizeof(AppEvent));
+  captureRequests = xQueueCreate(CAPTURE_REQUEST_QUEUE_LEN, sizeof(CaptureRequest));
+  initializeUploadWorkers();
+  initializeCamera();
+  if (TELEGRAM_BATCHING) initializeTelegramBatching();
+  serverReachable = true;
+  systemInitialized = true;
+}
+
+// Drops whatever the pipeline reported to the event loop
+inline int drainAppEvents() {
+  AppEvent event;
+  int done = 0;
+  while (xQueueReceive(appEvents, &event, 0) == pdTRUE) done += event.type == EVT_CAPTURE_DONE;
+  return done;
+}
+
+// One capture through the same steps as captureTask and networkTask, on the
+// calling thread; returns the result the event loop would have been sent
+inline CaptureResult runCapture(CaptureTrigger trigger = TRIGGER_BUTTON) {
+  CaptureRequest request = { (uint8_t)trigger, millis() };
+  xSemaphoreTake(cameraLock, portMAX_DELAY);
+  PipelineJob job = captureAndProcessImage(request);
+  xSemaphoreGive(cameraLock);
+  if (job.result.captured) finishCapture(job);
+  drainAppEvents();
+  return job.result;
+}
@@ -0,0 +1,654 @@
+#include "Arduino.h"
+#include "standin.h"
+#include <algorithm>
+#include <filesystem>
+#include <thread>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+// ===== FORMS =====
+static const uint8_t* findBytes(const uint8_t* at, const uint8_t* end, const char* needle, size_t len) {
+  if ((size_t)(end - at) < len) return nullptr;
+  for (const uint8_t* p = at; p + len <= end; p++) {
+    if (*p == (uint8_t)needle[0] && memcmp(p, needle, len) == 0) return p;
+  }
+  return nullptr;
+}
+
+static std::string headerParam(const std::string &head, const char* key) {
+  size_t at = head.find(key);
+  if (at == std::string::npos) return "";
+  at += strlen(key);
+  size_t end = head.find('"', at);
+  return head.substr(at, end == std::string::npos ? std::string::npos : end - at);
+}
+
+bool hostParseForm(const char* contentType, const uint8_t* body, size_t len, std::vector<HostFormPart> &parts) {
+  const char* b = strstr(contentType, "boundary=");
+  if (b == nullptr) return false;
+  std::string delimiter = std::string("--") + (b + 9);
+  const uint8_t* end = body + len;
+  const uint8_t* at = findBytes(body, end, delimiter.c_str(), delimiter.size());
+  while (at) {
+    at += delimiter.size();
+    if (end - at >= 2 && at[0] == '-' && at[1] == '-') return true;   // closing delimiter
+    at += 2;   // CRLF
+    const uint8_t* headEnd = findBytes(at, end, "\r\n\r\n", 4);
+    if (headEnd == nullptr) return false;
+    std::string head((const char*)at, headEnd - at);
+    const uint8_t* data = headEnd + 4;
+    std::string next = "\r\n" + delimiter;
+    const uint8_t* dataEnd = findBytes(data, end, next.c_str(), next.size());
+    if (dataEnd == nullptr) return false;
+    parts.push_back({headerParam(head, "name=\""), headerParam(head, "filename=\""), data, (size_t)(dataEnd - data)});
+    at = dataEnd + 2;
+  }
+  return false;
+}
+
+// ===== HTTP SESSION =====
+class HttpSession : public HostSession {
+public:
+  explicit HttpSession(HostHttpServer &server) : server(server) {}
+
+  size_t send(const uint8_t* data, size_t len) override {
+    std::lock_guard<std::mutex> hold(lock);
+    if (closed) return 0;
+    for (size_t i = 0; i < len;) {
+      if (!inBody) {
+        head.push_back((char)data[i++]);
+        if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0) startBody();
+      } else {
+        size_t n = std::min(len - i, (size_t)request.contentLength - body.size());
+        if (cutAt >= 0) n = std::min(n, (size_t)cutAt - body.size());
+        body.insert(body.end(), data + i, data + i + n);
+        i += n;
+      }
+      if (inBody && cutAt >= 0 && body.size() == (size_t)cutAt) {
+        cut();
+        return i;
+      }
+      if (inBody && body.size() == (size_t)request.contentLength) respond();
+    }
+    return len;
+  }
+
+  int available() override {
+    std::lock_guard<std::mutex> hold(lock);
+    if (hostNowUs() < readyAtUs) return 0;
+    return (int)(out.size() - outPos);
+  }
+
+  size_t recv(uint8_t* data, size_t len) override {
+    std::lock_guard<std::mutex> hold(lock);
+    if (hostNowUs() < readyAtUs) return 0;
+    size_t n = std::min(len, out.size() - outPos);
+    memcpy(data, out.data() + outPos, n);
+    outPos += n;
+    if (outPos == out.size()) {
+      out.clear();
+      outPos = 0;
+    }
+    return n;
+  }
+
+  bool open() override {
+    std::lock_guard<std::mutex> hold(lock);
+    return !closed || outPos < out.size();
+  }
+
+private:
+  static void copyHeader(const std::string &head, const char* name, char* out, size_t len) {
+    out[0] = '\0';
+    size_t at = 0;
+    size_t nameLen = strlen(name);
+    while ((at = head.find("\r\n", at)) != std::string::npos) {
+      at += 2;
+      if (strncasecmp(head.c_str() + at, name, nameLen) == 0 && head[at + nameLen] == ':') {
+        size_t v = at + nameLen + 1;
+        while (head[v] == ' ') v++;
+        size_t e = head.find("\r\n", v);
+        snprintf(out, len, "%s", head.substr(v, e - v).c_str());
+        return;
+      }
+    }
+  }
+
+  void startBody() {
+    memset(&request, 0, sizeof(request));
+    char target[sizeof(request.path) + 16] = "";
+    sscanf(head.c_str(), "%7s %270s", request.method, target);
+    snprintf(request.path, sizeof(request.path), "%s", target);
+    char value[160];
+    copyHeader(head, "Content-Length", value, sizeof(value));
+    request.contentLength = value[0] ? atol(value) : 0;
+    copyHeader(head, "Upload-Offset", value, sizeof(value));
+    request.uploadOffset = value[0] ? atol(value) : -1;
+    copyHeader(head, "Upload-Length", value, sizeof(value));
+    request.uploadLength = value[0] ? atol(value) : -1;
+    copyHeader(head, "Connection", value, sizeof(value));
+    request.close = strcasecmp(value, "close") == 0;
+    copyHeader(head, "Content-Type", request.contentType, sizeof(request.contentType));
+    copyHeader(head, "Upload-Content-Type", request.uploadContentType, sizeof(request.uploadContentType));
+    inBody = true;
+    body.clear();
+    cutAt = -1;
+    if (request.contentLength > 0) {
+      std::lock_guard<std::mutex> hold(server.lock);
+      if (server.cutAfterBytes > 0 && server.cutAfterBytes < request.contentLength) {
+        cutAt = server.cutAfterBytes;
+        server.cutAfterBytes = 0;
+      } else if (server.dropPercent > 0) {
+        // a run with the same seed cuts at the same bytes
+        uint32_t x = server.dropSeed += 0x9E3779B9u;
+        x ^= x >> 16;
+        x *= 0x45d9f3b;
+        x ^= x >> 16;
+        if (x % 100 < server.dropPercent) cutAt = (x / 100) % request.contentLength;
+      }
+    }
+  }
+
+  // the link went down mid-body: the server sees what had arrived, the
+  // client's next write fails and no reply ever comes
+  void cut() {
+    request.body = body.data();
+    request.bodyLen = body.size();
+    server.cuts++;
+    {
+      std::lock_guard<std::mutex> hold(server.lock);
+      server.handleCut(request);
+    }
+    closed = true;
+    head.clear();
+    inBody = false;
+  }
+
+  void respond() {
+    request.body = body.data();
+    request.bodyLen = body.size();
+    HostHttpReply reply;
+    uint32_t n = ++server.requests;
+    {
+      std::lock_guard<std::mutex> hold(server.lock);
+      server.handle(request, reply);
+    }
+    if (request.close || (server.closeEvery && n % server.closeEvery == 0)) reply.close = true;
+
+    if (server.interimContinue) out += "HTTP/1.1 100 Continue\r\n\r\n";
+    char line[160];
+    snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\n", reply.status, reply.status < 300 ? "OK" : "Error");
+    out += line;
+    out += reply.headers;
+    out += reply.close ? "Connection: close\r\n" : "Connection: keep-alive\r\n";
+    out += "Content-Type: application/json\r\n";
+    if (reply.status == 204) {
+      out += "\r\n";
+    } else if (server.chunkedReplies) {
+      out += "Transfer-Encoding: chunked\r\n\r\n";
+      size_t half = reply.body.size() / 2;
+      if (half) {
+        snprintf(line, sizeof(line), "%zx;part=1\r\n", half);
+        out += line;
+        out.append(reply.body, 0, half);
+        out += "\r\n";
+      }
+      snprintf(line, sizeof(line), "%zx\r\n", reply.body.size() - half);
+      out += line;
+      out.append(reply.body, half, std::string::npos);
+      out += "\r\n0\r\n\r\n";
+    } else {
+      snprintf(line, sizeof(line), "Content-Length: %zu\r\n\r\n", reply.body.size());
+      out += line;
+      out += reply.body;
+    }
+    readyAtUs = hostNowUs() + reply.delayUs;
+    closed = reply.close;
+    head.clear();
+    inBody = false;
+  }
+
+  HostHttpServer &server;
+  std::mutex lock;
+  std::string head;
+  std::vector<uint8_t> body;
+  bool inBody = false;
+  long cutAt = -1;               // body byte the connection drops at
+  HostHttpRequest request;
+  std::string out;
+  size_t outPos = 0;
+  int64_t readyAtUs = 0;
+  bool closed = false;
+};
+
+HostSession* HostHttpServer::accept() {
+  if (refuseConnections) return nullptr;
+  connections++;
+  return new HttpSession(*this);
+}
+
+// ===== RAILWAY =====
+void RailwayStandIn::handleForm(const char* contentType, const uint8_t* body, size_t len, HostHttpReply &reply) {
+  std::vector<HostFormPart> parts;
+  if (!hostParseForm(contentType, body, len, parts)) {
+    reply.status = 400;
+    reply.body = "{\"error\":\"bad form\"}";
+    return;
+  }
+  if (failPosts > 0) {
+    failPosts--;
+    reply.status = 500;
+    reply.body = "{\"error\":\"busy\"}";
+    return;
+  }
+  forms++;
+  formBytes += len;
+  for (const HostFormPart &p : parts) {
+    if (p.name == "file") {
+      images++;
+      lastImageLen = p.len;
+    } else if (p.name == "thumb") {
+      thumbs++;
+    } else if (p.name == "timestamp") {
+      lastTimestamp.assign((const char*)p.data, p.len);
+    }
+  }
+  reply.status = 200;
+  reply.body = "{\"status\":\"ok\",\"plate\":\"HOST123\",\"confidence\":0.93}";
+}
+
+void RailwayStandIn::handle(const HostHttpRequest &request, HostHttpReply &reply) {
+  bodyBytes += request.bodyLen;
+  bool upload = strncmp(request.path, "/upload/", 8) == 0;
+
+  if (strcmp(request.method, "POST") == 0 && strcmp(request.path, "/test") == 0) {
+    posts++;
+    handleForm(request.contentType, request.body, request.bodyLen, reply);
+    return;
+  }
+  if (!upload || !resumable) {
+    reply.status = strcmp(request.method, "GET") == 0 && !upload ? 200 : 404;
+    reply.body = reply.status == 200 ? "{\"status\":\"up\"}" : "{\"error\":\"not found\"}";
+    return;
+  }
+
+  char offsetHeader[48];
+  if (strcmp(request.method, "GET") == 0) {
+    offsetQueries++;
+    Upload* u = findUpload(request.path, -1);
+    long stored = u ? (long)u->data.size() : 0;
+    snprintf(offsetHeader, sizeof(offsetHeader), "Upload-Offset: %ld\r\n", stored);
+    reply.headers = offsetHeader;
+    if (u && u->complete) {
+      handleForm(request.uploadContentType[0] ? request.uploadContentType : "", u->data.data(), u->data.size(), reply);
+    } else {
+      reply.status = 200;
+      reply.body = "{}";
+    }
+    return;
+  }
+
+  patches++;
+  if (request.uploadOffset == 0 && refuseFirstChunk) {
+    reply.status = refuseFirstChunk;
+    reply.body = "{\"error\":\"refused\"}";
+    return;
+  }
+  Upload* u = findUpload(request.path, request.uploadLength);
+  if (request.uploadOffset != (long)u->data.size()) {
+    snprintf(offsetHeader, sizeof(offsetHeader), "Upload-Offset: %u\r\n", (unsigned)u->data.size());
+    reply.headers = offsetHeader;
+    reply.status = 409;
+    return;
+  }
+  u->data.insert(u->data.end(), request.body, request.body + request.bodyLen);
+  snprintf(offsetHeader, sizeof(offsetHeader), "Upload-Offset: %u\r\n", (unsigned)u->data.size());
+  reply.headers = offsetHeader;
+  if ((long)u->data.size() < u->total) {
+    reply.status = 204;
+    return;
+  }
+  u->complete = true;
+  handleForm(request.uploadContentType, u->data.data(), u->data.size(), reply);
+}
+
+RailwayStandIn::Upload* RailwayStandIn::findUpload(const char* path, long total) {
+  std::string id = path + 8;
+  for (Upload &candidate : uploads) {
+    if (candidate.id == id) return &candidate;
+  }
+  if (total < 0) return nullptr;
+  // keep the last few uploads, like the Python server's table
+  if (uploads.size() >= 8) uploads.pop_front();
+  uploads.push_back({id, {}, total, false});
+  return &uploads.back();
+}
+
+// A chunk cut off mid-body is kept up to the last byte that arrived, as
+// upload_server.py does, so the client resumes from there
+void RailwayStandIn::handleCut(const HostHttpRequest &partial) {
+  bodyBytes += partial.bodyLen;
+  if (!resumable || strcmp(partial.method, "PATCH") != 0 || strncmp(partial.path, "/upload/", 8) != 0) return;
+  if (partial.uploadOffset == 0 && refuseFirstChunk) return;
+  Upload* u = findUpload(partial.path, partial.uploadLength);
+  if (partial.uploadOffset != (long)u->data.size()) return;
+  u->data.insert(u->data.end(), partial.body, partial.body + partial.bodyLen);
+}
+
+// ===== TELEGRAM =====
+void TelegramStandIn::queueMessage(long long chatId, const char* text) {
+  std::lock_guard<std::mutex> hold(lock);
+  char update[512];
+  snprintf(update, sizeof(update),
+           "{\"ok\":true,\"result\":[{\"update_id\":%lld,\"message\":{\"message_id\":%lld,"
+           "\"from\":{\"id\":%lld,\"is_bot\":false,\"first_name\":\"Host\"},"
+           "\"chat\":{\"id\":%lld,\"first_name\":\"Host\",\"type\":\"private\"},"
+           "\"date\":%ld,\"text\":\"%s\"}}]}",
+           nextUpdate, nextUpdate, chatId, chatId, (long)time(nullptr), text);
+  nextUpdate++;
+  updates.push_back(update);
+}
+
+void TelegramStandIn::handle(const HostHttpRequest &request, HostHttpReply &reply) {
+  const char* method = strrchr(request.path, '/');
+  method = method ? method + 1 : request.path;
+  reply.body = "{\"ok\":true,\"result\":{\"message_id\":1}}";
+
+  if (strncmp(method, "getUpdates", 10) == 0) {
+    polls++;
+    if (!updates.empty()) {
+      reply.body = updates.front();
+      updates.pop_front();
+    } else {
+      reply.body = "{\"ok\":true,\"result\":[]}";
+      reply.delayUs = (int64_t)pollHoldMs * 1000;
+    }
+    return;
+  }
+
+  bool upload = strcmp(method, "sendPhoto") == 0 || strcmp(method, "sendMediaGroup") == 0;
+  if (upload && rateLimitNext > 0) {
+    rateLimitNext--;
+    reply.status = 429;
+    reply.body = "{\"ok\":false,\"error_code\":429,\"description\":\"Too Many Requests: retry after 1\"}";
+    return;
+  }
+
+  std::vector<HostFormPart> parts;
+  if (!hostParseForm(request.contentType, request.body, request.bodyLen, parts)) {
+    reply.status = 400;
+    reply.body = "{\"ok\":false,\"description\":\"Bad Request: bad form\"}";
+    return;
+  }
+  int files = 0;
+  for (const HostFormPart &p : parts) files += !p.filename.empty();
+
+  if (strcmp(method, "sendPhoto") == 0) {
+    photos += files;
+    photoRequests++;
+    requestPhotos.push_back(files);
+    for (const HostFormPart &p : parts) {
+      if (p.name == "caption") captions.emplace_back((const char*)p.data, p.len);
+    }
+  } else if (strcmp(method, "sendMediaGroup") == 0) {
+    if (files < 2 || files > 10) {
+      reply.status = 400;
+      reply.body = "{\"ok\":false,\"description\":\"Bad Request: group must have 2-10 items\"}";
+      return;
+    }
+    photos += files;
+    photoRequests++;
+    mediaGroups++;
+    requestPhotos.push_back(files);
+    // the captions are inside the media JSON, one per item
+    for (const HostFormPart &p : parts) {
+      if (p.name != "media") continue;
+      std::string media((const char*)p.data, p.len);
+      for (size_t at = 0; (at = media.find("\"caption\":\"", at)) != std::string::npos;) {
+        at += 11;
+        size_t end = media.find('"', at);
+        captions.push_back(media.substr(at, end - at));
+      }
+    }
+  } else if (strcmp(method, "sendMessage") == 0) {
+    messages++;
+  } else {
+    reply.status = 404;
+    reply.body = "{\"ok\":false,\"description\":\"Not Found\"}";
+  }
+}
+
+// ===== SCRIPTED =====
+class ScriptedSession : public HostSession {
+public:
+  explicit ScriptedSession(HostScriptedEndpoint &ep) : ep(ep) {}
+  size_t send(const uint8_t* data, size_t len) override {
+    ep.received.append((const char*)data, len);
+    return len;
+  }
+  int available() override { return chunk < ep.chunks.size() ? (int)(ep.chunks[chunk].size() - pos) : 0; }
+  size_t recv(uint8_t* data, size_t len) override {
+    if (chunk >= ep.chunks.size()) return 0;
+    size_t n = std::min(len, ep.chunks[chunk].size() - pos);
+    memcpy(data, ep.chunks[chunk].data() + pos, n);
+    pos += n;
+    if (pos == ep.chunks[chunk].size()) {
+      chunk++;
+      pos = 0;
+    }
+    return n;
+  }
+  bool open() override { return !(ep.closeAtEnd && chunk >= ep.chunks.size()); }
+
+private:
+  HostScriptedEndpoint &ep;
+  size_t chunk = 0;
+  size_t pos = 0;
+};
+
+HostSession* HostScriptedEndpoint::accept() { return new ScriptedSession(*this); }
+
+// ===== TLS LISTENER =====
+static X509* makeCertificate(EVP_PKEY* key) {
+  X509* cert = X509_new();
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 24 * 3600);
+  X509_set_pubkey(cert, key);
+  X509_NAME* name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"localhost", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  X509_sign(cert, key, EVP_sha256());
+  return cert;
+}
+
+static SSL_CTX* makeServerContext() {
+  EVP_PKEY* key = EVP_RSA_gen(2048);
+  X509* cert = makeCertificate(key);
+  SSL_CTX* ctx = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_use_certificate(ctx, cert);
+  SSL_CTX_use_PrivateKey(ctx, key);
+  X509_free(cert);
+  EVP_PKEY_free(key);
+  return ctx;
+}
+
+HostTlsServer::HostTlsServer(HostHttpServer &app) : app_(app) {
+  ctx_ = makeServerContext();
+  listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(listenFd_, (sockaddr*)&addr, sizeof(addr));
+  socklen_t len = sizeof(addr);
+  getsockname(listenFd_, (sockaddr*)&addr, &len);
+  port_ = ntohs(addr.sin_port);
+  listen(listenFd_, 8);
+
+  std::thread([this] {
+    while (running_) {
+      int fd = ::accept(listenFd_, nullptr, nullptr);
+      if (fd < 0) break;
+      std::thread([this, fd] { serve(fd); }).detach();
+    }
+  }).detach();
+}
+
+HostTlsServer::~HostTlsServer() {
+  running_ = false;
+  shutdown(listenFd_, SHUT_RDWR);
+  close(listenFd_);
+}
+
+void HostTlsServer::serve(int fd) {
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  SSL* ssl = SSL_new((SSL_CTX*)ctx_);
+  SSL_set_fd(ssl, fd);
+  if (SSL_accept(ssl) != 1) {
+    SSL_free(ssl);
+    close(fd);
+    return;
+  }
+  handshakes_++;
+  if (SSL_session_reused(ssl)) resumed_++;
+
+  HostSession* session = app_.accept();
+  uint8_t buf[16384];
+  while (running_ && session) {
+    int avail;
+    while ((avail = session->available()) > 0) {
+      size_t n = session->recv(buf, std::min<size_t>(avail, sizeof(buf)));
+      SSL_write(ssl, buf, (int)n);
+    }
+    if (!session->open()) break;
+    pollfd p = {fd, POLLIN, 0};
+    if (SSL_pending(ssl) == 0 && poll(&p, 1, 5) <= 0) continue;
+    int n = SSL_read(ssl, buf, sizeof(buf));
+    if (n <= 0) break;
+    session->send(buf, n);
+  }
+  delete session;
+  SSL_shutdown(ssl);
+  SSL_free(ssl);
+  close(fd);
+}
+
+// ===== SCRIPT SERVERS =====
+static uint16_t freeLocalPort() {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  bind(fd, (sockaddr*)&addr, sizeof(addr));
+  socklen_t len = sizeof(addr);
+  getsockname(fd, (sockaddr*)&addr, &len);
+  close(fd);
+  return ntohs(addr.sin_port);
+}
+
+static bool accepting(uint16_t port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  bool ok = connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+  close(fd);
+  return ok;
+}
+
+HostScriptServer::HostScriptServer(const char* python, const char* script, const std::vector<std::string> &args) {
+  char dir[] = "/tmp/esp32host-XXXXXX";
+  if (mkdtemp(dir) == nullptr) return;
+  dir_ = dir;
+  std::string cert = dir_ + "/cert.pem", key = dir_ + "/key.pem";
+  EVP_PKEY* pkey = EVP_RSA_gen(2048);
+  X509* x509 = makeCertificate(pkey);
+  FILE* f = fopen(cert.c_str(), "w");
+  PEM_write_X509(f, x509);
+  fclose(f);
+  f = fopen(key.c_str(), "w");
+  PEM_write_PrivateKey(f, pkey, nullptr, nullptr, 0, nullptr, nullptr);
+  fclose(f);
+  X509_free(x509);
+  EVP_PKEY_free(pkey);
+
+  port_ = freeLocalPort();
+  std::vector<std::string> argv = { python, script, "--port", std::to_string(port_), "--tls", cert, key,
+                                    "--out", outDir() };
+  argv.insert(argv.end(), args.begin(), args.end());
+
+  int in[2];
+  if (pipe(in) != 0) return;
+  pid_ = fork();
+  if (pid_ == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGTERM);   // not left behind by a test that crashes
+    dup2(in[0], 0);
+    close(in[0]);
+    close(in[1]);
+    std::vector<char*> cargs;
+    for (std::string &a : argv) cargs.push_back(&a[0]);
+    cargs.push_back(nullptr);
+    setenv("PYTHONUNBUFFERED", "1", 1);
+    execv(python, cargs.data());
+    _exit(127);
+  }
+  close(in[0]);
+  stdin_ = in[1];
+  if (pid_ < 0) return;
+
+  // the interpreter takes a moment to start and bind
+  for (int i = 0; i < 200 && !ready_; i++) {
+    if (waitpid(pid_, nullptr, WNOHANG) == pid_) {
+      pid_ = -1;
+      return;
+    }
+    ready_ = accepting(port_);
+    if (!ready_) usleep(50000);
+  }
+}
+
+HostScriptServer::~HostScriptServer() {
+  if (stdin_ >= 0) close(stdin_);
+  if (pid_ > 0) {
+    kill(pid_, SIGTERM);
+    waitpid(pid_, nullptr, 0);
+  }
+  if (!dir_.empty()) {
+    std::error_code ignored;
+    std::filesystem::remove_all(dir_, ignored);
+  }
+}
+
+std::vector<std::string> HostScriptServer::outFiles() const {
+  std::vector<std::string> names;
+  std::error_code missing;
+  for (const auto &entry : std::filesystem::directory_iterator(outDir(), missing)) {
+    names.push_back(entry.path().filename().string());
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+void HostScriptServer::writeLine(const char* line) {
+  std::string text = std::string(line) + "\n";
+  if (stdin_ >= 0 && write(stdin_, text.data(), text.size()) < 0) {
+    close(stdin_);
+    stdin_ = -1;
+  }
+}
+
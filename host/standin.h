@@ -0,0 +1,169 @@
+#pragma once
+// In-process stand-ins for the servers the sketch talks to. They follow
+// server/upload_server.py and server/mock_telegram.py closely enough for the
+// sketch's protocol code to run unchanged against them; route them with
+// hostRoute(serverHost, httpsPort, &railway) etc. HostScriptServer runs the
+// scripts themselves, for the tests that check the two still agree.
+#include "host.h"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct HostHttpRequest {
+  char method[8];
+  char path[256];
+  char contentType[160];
+  char uploadContentType[160];   // PATCH: type of the assembled body
+  long contentLength;
+  long uploadOffset;
+  long uploadLength;
+  bool close;
+  const uint8_t* body;
+  size_t bodyLen;
+};
+
+struct HostHttpReply {
+  int status = 200;
+  std::string body;
+  std::string headers;           // extra header lines, each ending in \r\n
+  bool close = false;
+  int64_t delayUs = 0;           // hold the reply (long-poll)
+};
+
+struct HostFormPart {
+  std::string name;
+  std::string filename;
+  const uint8_t* data;
+  size_t len;
+};
+// Splits a multipart/form-data body; false if it is malformed
+bool hostParseForm(const char* contentType, const uint8_t* body, size_t len, std::vector<HostFormPart> &parts);
+
+// HTTP/1.1 with keep-alive over an in-memory session
+class HostHttpServer : public HostEndpoint {
+public:
+  HostSession* accept() override;
+  virtual void handle(const HostHttpRequest &request, HostHttpReply &reply) = 0;
+  // what arrived of a request whose connection was cut (body is partial)
+  virtual void handleCut(const HostHttpRequest &) {}
+
+  bool refuseConnections = false;
+  uint32_t closeEvery = 0;       // answer every Nth request with Connection: close
+  bool chunkedReplies = false;   // frame reply bodies as two chunks
+  bool interimContinue = false;  // precede every reply with "100 Continue"
+  uint32_t cutAfterBytes = 0;    // drop the connection once the next body longer than this reaches it
+  uint32_t dropPercent = 0;      // drop this share of requests at a random body byte (--drop-rate)
+  uint32_t dropSeed = 1;
+  std::atomic<uint32_t> connections{0};
+  std::atomic<uint32_t> requests{0};
+  std::atomic<uint32_t> cuts{0};
+  std::mutex lock;               // held around handle()
+};
+
+// Railway upload server: POST /test, and the resumable PATCH/GET /upload
+class RailwayStandIn : public HostHttpServer {
+public:
+  void handle(const HostHttpRequest &request, HostHttpReply &reply) override;
+  void handleCut(const HostHttpRequest &partial) override;
+
+  bool resumable = true;
+  int refuseFirstChunk = 0;      // answer offset-0 PATCHes with this status (a proxy that rejects PATCH)
+  uint32_t failPosts = 0;        // the next N form posts get a 500
+  uint32_t forms = 0;            // forms handled, by either route
+  uint32_t images = 0;
+  uint32_t thumbs = 0;
+  uint32_t patches = 0;
+  uint32_t posts = 0;
+  uint32_t offsetQueries = 0;    // GET /upload/<id>
+  uint64_t bodyBytes = 0;        // every body byte received, cut requests included
+  uint64_t formBytes = 0;        // bytes of the forms handled
+  std::string lastTimestamp;
+  size_t lastImageLen = 0;
+
+private:
+  void handleForm(const char* contentType, const uint8_t* body, size_t len, HostHttpReply &reply);
+  struct Upload {
+    std::string id;
+    std::vector<uint8_t> data;
+    long total;
+    bool complete;
+  };
+  Upload* findUpload(const char* path, long total);   // creates it if total >= 0
+  std::deque<Upload> uploads;
+};
+
+// Telegram Bot API: sendPhoto, sendMediaGroup, sendMessage, getUpdates
+class TelegramStandIn : public HostHttpServer {
+public:
+  void handle(const HostHttpRequest &request, HostHttpReply &reply) override;
+  void queueMessage(long long chatId, const char* text);
+
+  uint32_t pollHoldMs = 200;     // an empty getUpdates is held this long
+  uint32_t rateLimitNext = 0;    // the next N uploads get a 429
+  uint32_t photos = 0;
+  uint32_t photoRequests = 0;    // sendPhoto + sendMediaGroup
+  uint32_t mediaGroups = 0;
+  uint32_t messages = 0;
+  uint32_t polls = 0;
+  std::vector<uint32_t> requestPhotos;   // photos in each sendPhoto / sendMediaGroup, in order
+  std::vector<std::string> captions;     // every photo's caption, in order
+
+private:
+  std::deque<std::string> updates;
+  long long nextUpdate = 1;
+};
+
+// Replays canned bytes: each chunk becomes readable only after the previous
+// one was consumed, so a test controls exactly how a response is split
+class HostScriptedEndpoint : public HostEndpoint {
+public:
+  HostSession* accept() override;
+  std::vector<std::string> chunks;
+  bool closeAtEnd = false;
+  std::string received;          // what the client wrote, across sessions
+};
+
+// A real TLS listener on 127.0.0.1 in front of an HTTP stand-in, with a
+// self-signed certificate made at start-up
+class HostTlsServer {
+public:
+  explicit HostTlsServer(HostHttpServer &app);
+  ~HostTlsServer();
+  uint16_t port() const { return port_; }
+  uint32_t handshakes() const { return handshakes_; }
+  uint32_t resumedSessions() const { return resumed_; }
+
+private:
+  void serve(int fd);
+  HostHttpServer &app_;
+  void* ctx_;
+  int listenFd_;
+  uint16_t port_;
+  std::atomic<uint32_t> handshakes_{0};
+  std::atomic<uint32_t> resumed_{0};
+  std::atomic<bool> running_{true};
+};
+
+// One of the scripts in server/ run as a child process, on a free local
+// port with TLS on a certificate made for it and --out in a temporary
+// directory; route the sketch to it with hostRouteTls(host, httpsPort,
+// port()). Killed, and the directory removed, on destruction.
+class HostScriptServer {
+public:
+  HostScriptServer(const char* python, const char* script, const std::vector<std::string> &args = {});
+  ~HostScriptServer();
+  bool ready() const { return ready_; }       // accepting connections
+  uint16_t port() const { return port_; }
+  std::string outDir() const { return dir_ + "/out"; }
+  std::vector<std::string> outFiles() const;  // names in outDir(), sorted
+  void writeLine(const char* line);           // to the script's stdin
+
+private:
+  std::string dir_;
+  uint16_t port_ = 0;
+  int pid_ = -1;
+  int stdin_ = -1;
+  bool ready_ = false;
+};
@@ -0,0 +1,336 @@
+// Heap soak: capture/dispatch cycles through the whole pipeline with the
+// device's internal RAM modelled as a fixed arena, failing if the high-water
+// mark or fragmentation keeps growing once the pipeline has warmed up.
+//
+//   test_heap_soak [--cycles N] [--arena KB] [--inject-leak] [--verbose]
+//
+// Every allocation the sketch, its libraries and its tasks make comes out of
+// a first-fit arena with coalescing; PSRAM, the fake camera and the far end
+// of each connection (hostOffDeviceHeap()) go to libc as before. First fit
+// fragments more readily than the TLSF allocator in ESP-IDF, so a pattern
+// that holds up here holds up there. The arena also answers the sketch's
+// heap_caps_* queries, so its own heap monitor watches the same numbers.
+//
+// The cycles mix button captures of changing scenes (uploaded, Telegram
+// batched), repeats of the last scene (duplicate events) and remote
+// triggers, with both servers closing the connection now and then so TLS
+// sessions are torn down and set up again. --inject-leak loses 48 bytes
+// every ten cycles and has to fail.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <vector>
+
+// ===== INTERNAL RAM ARENA =====
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void __libc_free(void*);
+
+struct ArenaBlock {
+  size_t size;                  // including this header
+  ArenaBlock* prevPhys;         // block just below, NULL for the first
+  ArenaBlock* nextFree;         // address-ordered free list
+  size_t free;
+};
+
+static const size_t ARENA_ALIGN = 16;
+static const size_t ARENA_MIN_SPLIT = sizeof(ArenaBlock) + 32;
+static const size_t ARENA_MAX = 512 * 1024;
+
+alignas(ARENA_ALIGN) static uint8_t arena[ARENA_MAX];
+static size_t arenaSize = 0;      // 0 until the model is switched on
+static ArenaBlock* freeList = nullptr;
+static size_t arenaUsed = 0;      // bytes in allocated blocks, headers included
+static size_t arenaPeak = 0;
+static uint64_t arenaExhausted = 0;
+static std::atomic_flag arenaLock = ATOMIC_FLAG_INIT;
+static void* volatile injectedLeak = nullptr;  // --inject-leak: kept reachable, the leak is the point
+
+struct ArenaHold {
+  ArenaHold() { while (arenaLock.test_and_set(std::memory_order_acquire)) {} }
+  ~ArenaHold() { arenaLock.clear(std::memory_order_release); }
+};
+
+static inline bool inArena(const void* p) { return p >= arena && p < arena + arenaSize; }
+static inline ArenaBlock* physNext(ArenaBlock* b) {
+  uint8_t* next = (uint8_t*)b + b->size;
+  return next < arena + arenaSize ? (ArenaBlock*)next : nullptr;
+}
+
+static void arenaStart(size_t bytes) {
+  ArenaHold hold;
+  arenaSize = std::min(bytes, ARENA_MAX);
+  ArenaBlock* all = (ArenaBlock*)arena;
+  *all = { arenaSize, nullptr, nullptr, 1 };
+  freeList = all;
+}
+
+static void* arenaAlloc(size_t n) {
+  size_t need = (n + sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+  ArenaHold hold;
+  ArenaBlock** link = &freeList;
+  while (*link && (*link)->size < need) link = &(*link)->nextFree;
+  ArenaBlock* b = *link;
+  if (b == nullptr) {
+    arenaExhausted++;
+    return nullptr;
+  }
+
+  if (b->size - need >= ARENA_MIN_SPLIT) {
+    ArenaBlock* rest = (ArenaBlock*)((uint8_t*)b + need);
+    *rest = { b->size - need, b, b->nextFree, 1 };
+    if (ArenaBlock* after = physNext(rest)) after->prevPhys = rest;
+    b->size = need;
+    *link = rest;
+  } else {
+    *link = b->nextFree;
+  }
+  b->free = 0;
+  b->nextFree = nullptr;
+  arenaUsed += b->size;
+  arenaPeak = std::max(arenaPeak, arenaUsed);
+  return b + 1;
+}
+
+static void unlinkFree(ArenaBlock* b) {
+  ArenaBlock** link = &freeList;
+  while (*link != b) link = &(*link)->nextFree;
+  *link = b->nextFree;
+}
+
+static void arenaFree(void* p) {
+  ArenaBlock* b = (ArenaBlock*)p - 1;
+  ArenaHold hold;
+  arenaUsed -= b->size;
+  b->free = 1;
+
+  ArenaBlock* next = physNext(b);
+  if (next && next->free) {
+    unlinkFree(next);
+    b->size += next->size;
+    if (ArenaBlock* after = physNext(b)) after->prevPhys = b;
+  }
+  ArenaBlock* prev = b->prevPhys;
+  if (prev && prev->free) {
+    prev->size += b->size;
+    if (ArenaBlock* after = physNext(prev)) after->prevPhys = prev;
+    return;
+  }
+
+  ArenaBlock** link = &freeList;
+  while (*link && *link < b) link = &(*link)->nextFree;
+  b->nextFree = *link;
+  *link = b;
+}
+
+static size_t arenaUsable(void* p) { return ((ArenaBlock*)p - 1)->size - sizeof(ArenaBlock); }
+
+static size_t arenaLargestFree() {
+  ArenaHold hold;
+  size_t largest = 0;
+  for (ArenaBlock* b = freeList; b; b = b->nextFree) largest = std::max(largest, b->size);
+  return largest > sizeof(ArenaBlock) ? largest - sizeof(ArenaBlock) : 0;
+}
+
+static inline bool onDevice() { return arenaSize != 0 && !hostOffDeviceHeap(); }
+
+static void* deviceAlloc(size_t n) {
+  if (onDevice()) {
+    if (void* p = arenaAlloc(n ? n : 1)) return p;
+  }
+  return __libc_malloc(n);
+}
+
+extern "C" void* malloc(size_t n) { return deviceAlloc(n); }
+extern "C" void* calloc(size_t n, size_t size) {
+  if (!onDevice()) return __libc_calloc(n, size);
+  void* p = deviceAlloc(n * size);
+  if (p) memset(p, 0, n * size);
+  return p;
+}
+extern "C" void* realloc(void* p, size_t n) {
+  if (p == nullptr) return malloc(n);
+  if (!inArena(p)) return __libc_realloc(p, n);
+  if (n <= arenaUsable(p)) return p;
+  void* grown = deviceAlloc(n);
+  if (grown) {
+    memcpy(grown, p, arenaUsable(p));
+    arenaFree(p);
+  }
+  return grown;
+}
+extern "C" void free(void* p) {
+  if (p == nullptr) return;
+  if (inArena(p)) arenaFree(p);
+  else __libc_free(p);
+}
+
+void* operator new(size_t size) {
+  void* p = deviceAlloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+static size_t probeFree() { return arenaSize - arenaUsed; }
+static size_t probeMinimumFree() { return arenaSize - arenaPeak; }
+static const HostHeapProbe arenaProbe = { probeFree, probeMinimumFree, arenaLargestFree };
+
+// ===== SOAK =====
+struct HeapWindow {
+  size_t peakUsed;              // arena high-water mark within the window
+  size_t largestLow;            // smallest "largest free block" seen
+  int fragmentationMax;         // % of free RAM outside the largest block
+};
+
+static void sampleWindow(HeapWindow &w) {
+  size_t largest = arenaLargestFree();
+  size_t free = probeFree();
+  int fragmentation = free ? 100 - (int)(largest * 100 / free) : 0;
+  w.largestLow = std::min(w.largestLow, largest);
+  w.fragmentationMax = std::max(w.fragmentationMax, fragmentation);
+}
+
+// Median of each over windows [from, to)
+static HeapWindow summarize(const std::vector<HeapWindow> &windows, size_t from, size_t to) {
+  std::vector<size_t> peak, largest;
+  std::vector<int> fragmentation;
+  HeapWindow s = { 0, 0, 0 };
+  for (size_t i = from; i < to; i++) {
+    peak.push_back(windows[i].peakUsed);
+    largest.push_back(windows[i].largestLow);
+    fragmentation.push_back(windows[i].fragmentationMax);
+  }
+  if (largest.empty()) return s;
+  std::nth_element(peak.begin(), peak.begin() + peak.size() / 2, peak.end());
+  std::nth_element(largest.begin(), largest.begin() + largest.size() / 2, largest.end());
+  std::nth_element(fragmentation.begin(), fragmentation.begin() + fragmentation.size() / 2, fragmentation.end());
+  s.peakUsed = peak[peak.size() / 2];
+  s.largestLow = largest[largest.size() / 2];
+  s.fragmentationMax = fragmentation[fragmentation.size() / 2];
+  return s;
+}
+
+int main(int argc, char** argv) {
+  long cycles = 100000;
+  size_t arenaKb = 160;
+  bool injectLeak = false;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) cycles = atol(argv[++i]);
+    else if (strcmp(argv[i], "--arena") == 0 && i + 1 < argc) arenaKb = atol(argv[++i]);
+    else if (strcmp(argv[i], "--inject-leak") == 0) injectLeak = true;
+    else if (strcmp(argv[i], "--verbose") == 0) verbose = true;
+  }
+  hostSerialQuiet(true);
+
+  // QQVGA scenes keep 100k cycles quick; the decode cache takes JPEG work
+  // off the hot loop, the crop and thumbnail are still encoded every time
+  std::vector<std::vector<uint8_t>> frames;
+  for (uint32_t seed = 1; seed <= 12; seed++) {
+    HostSceneSpec spec;
+    spec.width = 160;
+    spec.height = 120;
+    spec.seed = seed * 7919;
+    spec.carX = 0.3f + 0.03f * seed;
+    spec.carShade = (uint8_t)(40 + seed * 9);
+    frames.push_back(hostRenderScene(spec));
+  }
+  hostCameraSetFrames(frames);
+  hostDecodeCache(true);
+  hostSetTlsSessionBytes(24 * 1024);
+
+  HostRig rig;
+  rig.railway.closeEvery = 37;
+  rig.telegram.closeEvery = 23;
+  const long windowCycles = std::max(1L, cycles / 100);
+  std::vector<HeapWindow> windows;
+  windows.reserve(cycles / windowCycles + 1);
+
+  arenaStart(arenaKb * 1024);
+  hostSetHeapProbe(&arenaProbe);
+  startPipeline(rig);
+  size_t afterStart = arenaUsed;
+
+  HeapWindow window = { 0, SIZE_MAX, 0 };
+  uint32_t delivered = 0, duplicates = 0, remotes = 0, failed = 0;
+  size_t scene = 0;
+  auto started = std::chrono::steady_clock::now();
+  arenaPeak = arenaUsed;
+
+  for (long cycle = 0; cycle < cycles; cycle++) {
+    // a new scene two captures in three, the same one again otherwise
+    CaptureTrigger trigger = TRIGGER_BUTTON;
+    if (cycle % 3 != 2) scene++;
+    if (cycle % 50 == 49) trigger = cycle % 100 == 99 ? TRIGGER_HTTP : TRIGGER_TELEGRAM;
+    hostCameraSelect(scene % frames.size());
+
+    CaptureResult result = runCapture(trigger);
+    if (result.duplicateOf != 0) duplicates++;
+    else if (result.trigger != TRIGGER_BUTTON) remotes++;
+    else if (result.serverOk) delivered++;
+    if (!result.captured || !result.serverOk) failed++;
+
+    // a second per cycle on the sketch's clock: one heap sample every ten
+    sampleHeap((unsigned long)cycle * 1000);
+    if (injectLeak && cycle % 10 == 9) injectedLeak = malloc(48);
+
+    sampleWindow(window);
+    if ((cycle + 1) % windowCycles == 0) {
+      window.peakUsed = arenaPeak;
+      windows.push_back(window);
+      if (verbose) {
+        printf("  window %3zu  high water %6zu B, largest free %6zu B, frag max %2d%%, in use %6zu B\n",
+               windows.size(), window.peakUsed, window.largestLow, window.fragmentationMax, arenaUsed);
+      }
+      window = { 0, SIZE_MAX, 0 };
+      ArenaHold hold;
+      arenaPeak = arenaUsed;
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  // the first fifth warms up (connections, batches, lazily allocated
+  // buffers). After that the high-water mark may not rise. A single window
+  // can spike when a TLS session opens next to a frame and the batch task,
+  // more often on one core, so all three compare the typical (median)
+  // window. Task timing moves that by a few granules from run to run, hence
+  // the slack; a leak of a few bytes per cycle is kilobytes per half.
+  HostOffDeviceScope report;
+  size_t warm = windows.size() / 5;
+  size_t half = warm + (windows.size() - warm) / 2;
+  HeapWindow early = summarize(windows, warm, half);
+  HeapWindow late = summarize(windows, half, windows.size());
+  const size_t slack = arenaSize / 100;
+
+  printf("heap soak: %ld cycles in %.1f s, %zu KB internal RAM arena (first fit)\n", cycles, seconds, arenaKb);
+  printf("  captures   %u uploaded, %u duplicates, %u remote, %u failed\n", delivered, duplicates, remotes, failed);
+  printf("  arena      %zu B after start, %zu B in use at the end\n", afterStart, arenaUsed);
+  printf("  %-10s %12s %14s %10s\n", "windows", "high water", "largest free", "frag");
+  printf("  %-10s %10zu B %12zu B %9d%%\n", "early", early.peakUsed, early.largestLow, early.fragmentationMax);
+  printf("  %-10s %10zu B %12zu B %9d%%\n", "late", late.peakUsed, late.largestLow, late.fragmentationMax);
+  printf("  sketch     %u samples, %u below a TLS session, %d shrinking windows, frag max %d%%\n",
+         heapMonitor.samples, heapMonitor.lowBlockSamples, heapMonitor.shrinkingWindows,
+         heapMonitor.fragmentationMax);
+  printf("  frame pool %u heap fallbacks\n", framePoolFallbacks);
+
+  CHECK_EQ(arenaExhausted, 0);
+  CHECK_EQ(failed, 0);
+  CHECK(delivered > 0 && duplicates > 0 && remotes > 0);
+  CHECK(late.peakUsed <= early.peakUsed + slack);
+  CHECK(late.largestLow + slack >= early.largestLow);
+  CHECK(late.fragmentationMax <= early.fragmentationMax + 1);
+  CHECK(heapMonitor.shrinkingWindows < HEAP_TREND_WARN);
+  CHECK_EQ(heapMonitor.lowBlockSamples, 0);
+  finish("test_heap_soak");
+}
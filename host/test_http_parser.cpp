@@ -0,0 +1,161 @@
+// HTTP response parser: status line split across reads, chunked bodies,
+// interim 1xx responses, keep-alive decisions. Responses are replayed by a
+// scripted endpoint, one chunk per socket read, through readHttpResponse().
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+#include <string>
+#include <vector>
+
+static HostScriptedEndpoint script;
+static WiFiClientSecure client;
+
+// Reads one response replayed in the given pieces
+static int replay(const std::vector<std::string> &pieces, HttpResponse &r, bool untilStatus = false,
+                  bool closeAtEnd = false) {
+  script.chunks = pieces;
+  script.closeAtEnd = closeAtEnd;
+  client.connect("parser.test", 443);
+  httpResponseBegin(r);
+  return readHttpResponse(client, r, untilStatus);
+}
+
+static void testSplitStatusLine() {
+  const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello";
+  // every split point, including inside "HTTP/1." and the CRLFs
+  for (size_t at = 1; at < response.size(); at++) {
+    HttpResponse r;
+    int status = replay({ response.substr(0, at), response.substr(at) }, r);
+    CHECK_EQ(status, 200);
+    CHECK_EQ(r.stage, HTTP_DONE);
+    CHECK(strcmp(r.body, "hello") == 0);
+    CHECK(r.keepAlive);
+  }
+
+  // byte by byte
+  std::vector<std::string> bytes;
+  for (char c : response) bytes.push_back(std::string(1, c));
+  HttpResponse r;
+  CHECK_EQ(replay(bytes, r), 200);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "hello") == 0);
+}
+
+static void testChunked() {
+  HttpResponse r;
+  replay({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel",
+           "lo\r\n6\r\n world\r\n0\r\n",
+           "\r\n" }, r);
+  CHECK_EQ(r.status, 200);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "hello world") == 0);
+  CHECK(r.keepAlive);
+
+  // trailers after the last chunk
+  replay({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nok\r\n0\r\nX-Trace: 1\r\n\r\n" }, r);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "ok") == 0);
+  CHECK(r.keepAlive);
+
+  // a chunk not followed by CRLF is a framing error
+  replay({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nokX\r\n0\r\n\r\n" }, r);
+  CHECK_EQ(r.stage, HTTP_FAILED);
+  CHECK(!r.keepAlive);
+}
+
+static void testInterimResponse() {
+  const char* interim = "HTTP/1.1 100 Continue\r\n\r\n";
+  const char* final = "HTTP/1.1 201 Created\r\nContent-Length: 2\r\nUpload-Offset: 7\r\n\r\nok";
+
+  // both in the same read: the final response must survive the 1xx reset
+  HttpResponse r;
+  int status = replay({ std::string(interim) + final }, r);
+  CHECK_EQ(status, 201);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "ok") == 0);
+  CHECK_EQ(r.uploadOffset, 7);
+  CHECK(r.keepAlive);
+
+  // waiting for the status skips the interim one, then the drain continues
+  status = replay({ std::string(interim) + final }, r, true);
+  CHECK_EQ(status, 201);
+  CHECK(r.stage < HTTP_DONE);
+  readHttpResponse(client, r, false);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "ok") == 0);
+
+  // and across reads, with the status line of the final one split too
+  status = replay({ "HTTP/1.1 100 Cont", "inue\r\n\r\nHTTP/1.1 2", "00 OK\r\nContent-Length: 2\r\n\r\nok" }, r);
+  CHECK_EQ(status, 200);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "ok") == 0);
+}
+
+static void testKeepAlive() {
+  HttpResponse r;
+  replay({ "HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n" }, r);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(!r.keepAlive);
+
+  replay({ "HTTP/1.0 200 OK\r\nConnection: keep-alive\r\nContent-Length: 0\r\n\r\n" }, r);
+  CHECK(r.keepAlive);
+
+  replay({ "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok" }, r);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(!r.keepAlive);
+
+  replay({ "HTTP/1.1 204 No Content\r\n\r\n" }, r);
+  CHECK_EQ(r.status, 204);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(r.keepAlive);
+
+  // no framing: the body runs to the close and the socket cannot be reused
+  replay({ "HTTP/1.1 200 OK\r\n\r\nall of it", " until close" }, r, false, true);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(strcmp(r.body, "all of it until close") == 0);
+  CHECK(!r.keepAlive);
+
+  // bytes past the end of the response poison the socket
+  replay({ "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nokHTTP/1.1" }, r);
+  CHECK_EQ(r.stage, HTTP_DONE);
+  CHECK(!r.keepAlive);
+
+  // not HTTP at all
+  replay({ "SSH-2.0-OpenSSH\r\n" }, r);
+  CHECK_EQ(r.stage, HTTP_FAILED);
+  CHECK_EQ(r.status, -1);
+}
+
+// End to end: both stand-ins put "100 Continue" before every reply, and the
+// uploads still succeed on kept-alive connections
+static void testInterimEndToEnd() {
+  HostSceneSpec spec;
+  hostCameraSetFrames({ hostRenderScene(spec) });
+  HostRig rig;
+  rig.railway.interimContinue = true;
+  rig.telegram.interimContinue = true;
+  startPipeline(rig);
+
+  for (int i = 0; i < 3; i++) {
+    // remote triggers skip dedup, so the same scene goes out every time
+    CaptureResult result = runCapture(TRIGGER_HTTP);
+    CHECK(result.serverOk);
+    CHECK(result.telegramOk);
+  }
+  CHECK_EQ(rig.railway.forms, 3);
+  CHECK_EQ(rig.telegram.photos, 3);
+  CHECK_EQ(rig.railway.connections, 1);
+  CHECK_EQ(rig.telegram.connections, 1);
+}
+
+int main() {
+  hostSerialQuiet(true);
+  hostRoute("parser.test", 443, &script);
+  testSplitStatusLine();
+  testChunked();
+  testInterimResponse();
+  testKeepAlive();
+  testInterimEndToEnd();
+  finish("test_http_parser");
+}
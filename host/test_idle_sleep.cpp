@@ -0,0 +1,140 @@
+// Idle light sleep on a manual clock, both ways the sketch can sleep:
+// timed slices when esp_pm_configure() is refused (a stock Arduino core)
+// and automatic light sleep when it is accepted. Either way the level wake
+// on the button never runs under the CHANGE buttonISR, the edge ISR is
+// back once awake, and the press that woke the board still captures.
+#include "sketch.cpp"
+#include "host.h"
+#include "check.h"
+
+// loop() minus the blocking wait
+static void pump(unsigned long ms) {
+  for (unsigned long i = 0; i < ms; i++) {
+    hostAdvanceMs(1);
+    AppEvent event;
+    while (xQueueReceive(appEvents, &event, 0) == pdTRUE) handleAppEvent(event);
+    runAppTimers(millis());
+    runIdleSleep(millis());
+  }
+}
+
+static int takeRequests() {
+  CaptureRequest request;
+  int n = 0;
+  while (xQueueReceive(captureRequests, &request, 0) == pdTRUE) n++;
+  return n;
+}
+
+static void press() { hostSetPin(BUTTON_PIN, LOW); }
+static void release() { hostSetPin(BUTTON_PIN, HIGH); }
+
+static void resetState() {
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  takeRequests();
+  if (idleModeActive) exitIdleMode(0);
+  appState = STATE_IDLE;
+  stateDeadlineActive = false;
+  lastCaptureTime = 0;
+  idleSince = millis();
+}
+
+// The released button ends a tap; the tap asks for one capture
+static void checkTapCaptures() {
+  CHECK_EQ(appState, STATE_PRESSED);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(takeRequests(), 1);
+}
+
+static void testTimedSlices() {
+  resetState();
+  pump(IDLE_SLEEP_AFTER + 10);
+  CHECK(idleModeActive);
+  CHECK(!autoLightSleep);
+  CHECK(!autoLightSleepSupported);
+  CHECK(hostPower().lightSleeps > 0);
+  CHECK_EQ(hostPower().edgeIsrSleeps, 0u);
+  CHECK_EQ(hostPower().wifiPowerSave, (int)WIFI_PS_MAX_MODEM);
+  // between slices the edge ISR is back and the level wake disarmed
+  CHECK(hostInterruptAttached(BUTTON_PIN));
+  CHECK(!hostGpioWakeupArmed(BUTTON_PIN));
+
+  // pressed while asleep: no edge reaches the ISR, the wake is the press
+  uint32_t wakes = powerStats.buttonWakes;
+  hostSetNextWake(ESP_SLEEP_WAKEUP_GPIO);
+  pump(1);
+  CHECK(buttonIsDown());
+  CHECK(!idleModeActive);
+  CHECK_EQ(powerStats.buttonWakes, wakes + 1);
+  CHECK_EQ(hostPower().edgeIsrSleeps, 0u);
+  checkTapCaptures();
+}
+
+static void testAutomatic() {
+  resetState();
+  hostSetPmResult(ESP_OK);
+  autoLightSleepSupported = true;
+  startWiFi(false);
+  CHECK_EQ(hostPower().listenInterval, IDLE_LISTEN_INTERVAL);
+
+  uint32_t sleeps = hostPower().lightSleeps;
+  pump(IDLE_SLEEP_AFTER + 10);
+  CHECK(idleModeActive);
+  CHECK(autoLightSleep);
+  CHECK(hostPower().pmLightSleep);
+  CHECK_EQ(hostPower().pmMinMhz, IDLE_PM_MIN_MHZ);
+  CHECK_EQ(hostPower().wifiPowerSave, (int)WIFI_PS_MAX_MODEM);
+  CHECK_EQ(hostPower().lightSleeps, sleeps);   // the loop never sleeps itself
+  CHECK(hostGpioWakeupArmed(BUTTON_PIN));
+
+  // the wake ISR fires once and stays off until the loop takes over
+  uint32_t wakes = powerStats.buttonWakes;
+  press();
+  CHECK(!hostInterruptAttached(BUTTON_PIN));
+  pump(1);
+  CHECK(!idleModeActive);
+  CHECK(!autoLightSleep);
+  CHECK(!hostPower().pmLightSleep);
+  CHECK(!hostGpioWakeupArmed(BUTTON_PIN));
+  CHECK(hostInterruptAttached(BUTTON_PIN));
+  CHECK_EQ(powerStats.buttonWakes, wakes + 1);
+  checkTapCaptures();
+
+  // idle ended for another reason before the wake event was handled: the
+  // press is still seen, as an edge
+  resetState();
+  pump(IDLE_SLEEP_AFTER + 10);
+  CHECK(autoLightSleep);
+  press();
+  exitIdleMode(0);
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  checkTapCaptures();
+
+  // serial input keeps it awake; the UART wake itself is not reported
+  resetState();
+  pump(IDLE_SLEEP_AFTER + 10);
+  CHECK(autoLightSleep);
+  serialAwakeUntil = millis() + IDLE_SERIAL_AWAKE;
+  pump(1);
+  CHECK(!idleModeActive);
+  CHECK(hostInterruptAttached(BUTTON_PIN));
+  CHECK(!hostGpioWakeupArmed(BUTTON_PIN));
+}
+
+int main() {
+  hostSerialQuiet(true);
+  hostUseManualClock(true);
+
+  // the event loop's queues and the button, without the tasks or display
+  appEvents = xQueueCreate(APP_EVENT_QUEUE_LEN, sizeof(AppEvent));
+  captureRequests = xQueueCreate(CAPTURE_REQUEST_QUEUE_LEN, sizeof(CaptureRequest));
+  cameraLock = xSemaphoreCreateMutex();
+  initializePins();
+  buttonStable = buttonIsDown();
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, CHANGE);
+
+  testTimedSlices();
+  testAutomatic();
+  finish("test_idle_sleep");
+}
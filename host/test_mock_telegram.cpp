@@ -0,0 +1,93 @@
+// The sketch's Telegram calls against server/mock_telegram.py itself, the
+// script the Telegram stand-in follows: a captioned sendPhoto, a batch
+// sent as sendMediaGroup (which the script checks the way the Bot API
+// does), a sendMessage, and a "/capture" typed on the script's stdin coming
+// back through getUpdates as a queued capture.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+#include <fstream>
+#include <iterator>
+
+static const int BATCH = 3;
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// the script saves a photo as <time>-<random>-<caption, sanitised>.jpg
+static int savedWith(HostScriptServer &server, const char* caption, const std::vector<uint8_t> &image) {
+  std::string suffix = "-" + std::string(caption) + ".jpg";
+  for (char &c : suffix) {
+    if (c == ' ' || c == ':') c = '_';
+  }
+  int found = 0;
+  for (const std::string &name : server.outFiles()) {
+    if (name.size() < suffix.size() || name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+    found++;
+    CHECK(readFile(server.outDir() + "/" + name) == image);
+  }
+  return found;
+}
+
+static void run(const char* python, const char* script) {
+  HostSceneSpec spec;
+  spec.width = 320;
+  spec.height = 240;
+  std::vector<uint8_t> image = hostRenderScene(spec);
+
+  HostScriptServer server(python, script);
+  CHECK(server.ready());
+  if (!server.ready()) return;
+  HostRig rig;
+  startPipeline(rig);
+  hostRouteTls(telegramHost, httpsPort, server.port());
+
+  // sendPhoto
+  char caption[64];
+  formatPhotoCaption(caption, sizeof(caption), 1, "2026-10-17 12:00:01");
+  CHECK(sendPhotoToTelegram(image.data(), image.size(), caption));
+  CHECK_EQ(savedWith(server, caption, image), 1);
+
+  // sendMediaGroup: every photo saved under its own caption
+  OfflineCapture captures[BATCH];
+  OfflineCapture* batch[BATCH];
+  for (int i = 0; i < BATCH; i++) {
+    OfflineRecordHeader &h = captures[i].header;
+    h.captureNumber = 2 + i;
+    snprintf(h.timestamp, sizeof(h.timestamp), "2026-10-17 12:00:%02d", 2 + i);
+    h.imageLen = image.size();
+    captures[i].data = image.data();
+    batch[i] = &captures[i];
+  }
+  CHECK(sendTelegramBatch(batch, BATCH));
+  for (int i = 0; i < BATCH; i++) {
+    formatPhotoCaption(caption, sizeof(caption), 2 + i, captures[i].header.timestamp);
+    CHECK_EQ(savedWith(server, caption, image), 1);
+  }
+  CHECK_EQ(server.outFiles().size(), (size_t)(1 + BATCH));
+
+  CHECK(sendTelegramText("test_mock_telegram"));
+
+  // a command from the bot chat comes back as a Telegram capture request
+  server.writeLine("/capture");
+  HttpResponse response;
+  CHECK_EQ(pollTelegramUpdates(0, response), 200);
+  CHECK(handleTelegramUpdate(response.body) > 0);
+  CaptureRequest request;
+  CHECK(xQueueReceive(captureRequests, &request, 0) == pdTRUE);
+  CHECK_EQ(request.trigger, TRIGGER_TELEGRAM);
+  CHECK_EQ(remoteCommands[TRIGGER_TELEGRAM], 1u);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("usage: test_mock_telegram <python3> <mock_telegram.py>\n");
+    return 2;
+  }
+  hostSerialQuiet(true);
+  run(argv[1], argv[2]);   // the script is stopped when run() returns
+  finish("test_mock_telegram");
+}
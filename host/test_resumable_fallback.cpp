@@ -0,0 +1,67 @@
+// Resumable upload fallback against the Railway stand-in: any answer to the
+// first PATCH other than 2xx or 409 (refuseFirstChunk plays a proxy that
+// rejects PATCH) sends the form as a plain POST, so the image is never
+// lost. A 4xx turns resumable uploads off for good, anything else only for
+// that upload.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+
+static std::vector<uint8_t> image;
+
+static bool upload() { return uploadImageToServer(image.data(), image.size(), "2026-10-17 12:00:00", NULL, 0); }
+
+// One refused first chunk, then the plain POST
+static void refuseOnce(RailwayStandIn &railway, int status, bool staysResumable) {
+  resumableServer = true;
+  railway.refuseFirstChunk = status;
+  uint32_t posts = railway.posts, patches = railway.patches, images = railway.images;
+  CHECK(upload());
+  CHECK_EQ(railway.patches, patches + 1);
+  CHECK_EQ(railway.posts, posts + 1);
+  CHECK_EQ(railway.images, images + 1);
+  CHECK_EQ(resumableServer, staysResumable);
+  railway.refuseFirstChunk = 0;
+}
+
+int main() {
+  hostSerialQuiet(true);
+  HostSceneSpec spec;
+  spec.width = 320;
+  spec.height = 240;
+  image = hostRenderScene(spec);
+
+  HostRig rig;
+  hostRoute(serverHost, httpsPort, &rig.railway);
+  initializeConnections();
+
+  // the plain case first: chunks only
+  CHECK(upload());
+  CHECK(rig.railway.patches > 0);
+  CHECK_EQ(rig.railway.posts, 0u);
+  CHECK(resumableServer);
+
+  // refusals no status list would have caught
+  refuseOnce(rig.railway, 400, false);
+  refuseOnce(rig.railway, 403, false);
+  refuseOnce(rig.railway, 302, true);
+  refuseOnce(rig.railway, 500, true);
+  refuseOnce(rig.railway, 502, true);
+  // the ones it already handled
+  refuseOnce(rig.railway, 405, false);
+  refuseOnce(rig.railway, 501, true);
+
+  // after a 5xx the next upload is resumable again
+  uint32_t posts = rig.railway.posts;
+  CHECK(upload());
+  CHECK_EQ(rig.railway.posts, posts);
+
+  // once off, no PATCH is tried at all
+  resumableServer = false;
+  uint32_t patches = rig.railway.patches;
+  CHECK(upload());
+  CHECK_EQ(rig.railway.patches, patches);
+  CHECK_EQ(rig.railway.posts, posts + 1);
+  finish("test_resumable_fallback");
+}
@@ -0,0 +1,88 @@
+// Resumable upload across a link drop, against the Railway stand-in:
+// cutAfterBytes drops the connection partway into a chunk, the stand-in
+// keeps what arrived (as upload_server.py does), and the sketch asks
+// GET /upload/<id> where to carry on. Only the tail goes out again, where a
+// plain POST hit by the same drop sends the whole form a second time.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+
+static std::vector<uint8_t> image;
+
+static bool upload() { return uploadImageToServer(image.data(), image.size(), "2026-10-17 12:00:00", NULL, 0); }
+
+static void resetCounters(RailwayStandIn &railway) {
+  memset(&metricCounters, 0, sizeof(metricCounters));
+  railway.bodyBytes = 0;
+  railway.formBytes = 0;
+}
+
+int main() {
+  hostSerialQuiet(true);
+  HostSceneSpec spec;
+  spec.width = 800;
+  spec.height = 600;
+  image = hostRenderScene(spec);
+  // more than a chunk, so a resume has chunks after it
+  CHECK(image.size() > UPLOAD_CHUNK_SIZE);
+
+  HostRig rig;
+  RailwayStandIn &railway = rig.railway;
+  hostRoute(serverHost, httpsPort, &railway);
+  initializeConnections();
+
+  // a clean upload first: every body byte once (the metrics field makes
+  // each form a few bytes longer than the last)
+  resetCounters(railway);
+  CHECK(upload());
+  CHECK_EQ(railway.images, 1u);
+  CHECK_EQ(railway.lastImageLen, image.size());
+  CHECK_EQ(railway.offsetQueries, 0u);
+  CHECK_EQ(metricCounters.resentBytes, 0u);
+  CHECK_EQ(railway.bodyBytes, railway.formBytes);
+  uint64_t body = railway.formBytes;
+
+  // the link drops 5000 bytes into the first chunk
+  resetCounters(railway);
+  railway.cutAfterBytes = 5000;
+  uint32_t cuts = railway.cuts, queries = railway.offsetQueries;
+  CHECK(upload());
+  CHECK_EQ(railway.cuts, cuts + 1);
+  CHECK_EQ(railway.offsetQueries, queries + 1);
+  CHECK_EQ(railway.images, 2u);
+  CHECK_EQ(railway.lastImageLen, image.size());
+  CHECK_EQ(metricCounters.uploadRetries, 1u);
+  // the server kept the cut chunk's head, so nothing was sent twice
+  CHECK_EQ(railway.bodyBytes, railway.formBytes);
+  CHECK(metricCounters.resentBytes < body / 10);
+
+  // random drops, a third of all requests: every upload still completes
+  // from the stored offsets
+  resetCounters(railway);
+  railway.dropPercent = 33;
+  railway.dropSeed = 12345;
+  cuts = railway.cuts;
+  for (int i = 0; i < 8; i++) CHECK(upload());
+  railway.dropPercent = 0;
+  CHECK(railway.cuts > cuts);
+  CHECK_EQ(railway.images, 10u);
+  CHECK_EQ(railway.bodyBytes, railway.formBytes);
+  CHECK(metricCounters.resentBytes < body / 10);
+  printf("resumable: %u drops over 8 uploads, %u B resent, %llu B received for %llu B of forms\n",
+         railway.cuts - cuts, metricCounters.resentBytes, (unsigned long long)railway.bodyBytes,
+         (unsigned long long)railway.formBytes);
+
+  // a drop on a plain POST: the kept-alive socket was reused, so the
+  // sketch retries once on a fresh one and the form goes out again from
+  // byte 0; what had gone out before the drop is resent
+  resumableServer = false;
+  resetCounters(railway);
+  railway.cutAfterBytes = 5000 + UPLOAD_CHUNK_SIZE;
+  uint32_t posts = railway.posts;
+  CHECK(upload());
+  CHECK_EQ(railway.posts, posts + 1);
+  CHECK_EQ(metricCounters.resentBytes, 5000u + UPLOAD_CHUNK_SIZE);
+  CHECK_EQ(railway.bodyBytes, railway.formBytes + 5000 + UPLOAD_CHUNK_SIZE);
+  finish("test_resumable_resume");
+}
@@ -0,0 +1,155 @@
+// Sensor profiles against the fake OV2640: camera init applies the active
+// row in one pass that only writes what differs from the driver's status
+// cache, a switch writes at most the fields the two rows disagree on, and
+// the "sensor" command and the day/night switch go through the same path.
+// Every setter on the fake sensor counts as one SCCB write.
+#include "sketch.cpp"
+#include "host.h"
+#include "check.h"
+
+// Writes a switch from one row to another needs; SENSOR_ANY keeps the
+// sensor's value, so it never costs a write
+static int rowDifference(int from, int to) {
+  int n = 0;
+  for (int field = 0; field < SENSOR_FIELD_COUNT; field++) {
+    int value = sensorProfiles[to].values[field];
+    if (value != SENSOR_ANY && value != sensorProfiles[from].values[field]) n++;
+  }
+  return n;
+}
+
+// Fields the status cache says differ from the row
+static int pendingWrites(sensor_t* s, int profile) {
+  int n = 0;
+  for (int field = 0; field < SENSOR_FIELD_COUNT; field++) {
+    int value = sensorProfiles[profile].values[field];
+    if (value != SENSOR_ANY && sensorStatusValue(s->status, field) != value) n++;
+  }
+  return n;
+}
+
+// The status cache holds every value the profile pins
+static bool profileInPlace(sensor_t* s, int profile) {
+  for (int field = 0; field < SENSOR_FIELD_COUNT; field++) {
+    int value = sensorProfiles[profile].values[field];
+    if (value != SENSOR_ANY && sensorStatusValue(s->status, field) != value) return false;
+  }
+  return true;
+}
+
+static int writesFor(int profile) {
+  sensor_t* s = esp_camera_sensor_get();
+  hostResetSensorWrites();
+  CHECK_EQ(applySensorProfile(s, profile), 0);
+  CHECK_EQ(activeSensorProfile, profile);
+  CHECK(profileInPlace(s, profile));
+  CHECK_EQ((int)hostCameraStats().sensorWrites, sensorWritesLast);
+  CHECK_EQ(sensorWritesLast + sensorSkippedLast, SENSOR_FIELD_COUNT);
+  return sensorWritesLast;
+}
+
+static void testInit() {
+  // the config already set size and quality, and the driver defaults match
+  // most of the day row: only the rest is written
+  hostResetSensorWrites();
+  CHECK(initializeCamera());
+  sensor_t* s = esp_camera_sensor_get();
+  CHECK(s != NULL);
+  CHECK_EQ(activeSensorProfile, SENSOR_DAY);
+  CHECK(profileInPlace(s, SENSOR_DAY));
+  CHECK_EQ((int)hostCameraStats().sensorWrites, sensorWritesLast);
+  CHECK(sensorWritesLast > 0);
+  CHECK(sensorSkippedLast > SENSOR_FIELD_COUNT / 2);
+
+  // applying it again costs nothing
+  CHECK_EQ(writesFor(SENSOR_DAY), 0);
+}
+
+static void testSwitching() {
+  const int order[] = { SENSOR_NIGHT, SENSOR_FAST, SENSOR_DAY, SENSOR_FAST, SENSOR_NIGHT, SENSOR_DAY };
+  int from = SENSOR_DAY;
+  sensor_t* s = esp_camera_sensor_get();
+  for (int to : order) {
+    // a value pinned by an earlier row can already be in place
+    int pending = pendingWrites(s, to);
+    CHECK(pending <= rowDifference(from, to));
+    CHECK_EQ(writesFor(to), pending);
+    from = to;
+  }
+
+  // "fast" pins the exposure; going back to AEC leaves the value alone
+  writesFor(SENSOR_FAST);
+  CHECK_EQ(s->status.aec, 0);
+  CHECK_EQ(s->status.aec_value, 120);
+  writesFor(SENSOR_DAY);
+  CHECK_EQ(s->status.aec, 1);
+  CHECK_EQ(s->status.aec_value, 120);
+}
+
+static void testCommand() {
+  writesFor(SENSOR_DAY);
+  sensorProfileAuto = true;
+  uint32_t switches = sensorProfileSwitches;
+
+  handleSensorCommand("night");
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+  CHECK(!sensorProfileAuto);
+  CHECK_EQ(sensorProfileSwitches, switches + 1);
+
+  handleSensorCommand("bogus");
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+  CHECK(!sensorProfileAuto);
+
+  // fixed until "auto" hands it back to the light level
+  handleSensorCommand("auto");
+  CHECK(sensorProfileAuto);
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+
+  // with the camera busy nothing changes
+  xSemaphoreTake(cameraLock, portMAX_DELAY);
+  handleSensorCommand("fast");
+  xSemaphoreGive(cameraLock);
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+  CHECK(sensorProfileAuto);
+}
+
+static void testDayNight() {
+  sensor_t* s = esp_camera_sensor_get();
+  writesFor(SENSOR_DAY);
+  uint32_t switches = sensorProfileSwitches;
+
+  // dusk: under the day row the frames go dark
+  adaptSensorProfile(NIGHT_ENTER_LUMA + 10);
+  CHECK_EQ(activeSensorProfile, SENSOR_DAY);
+  hostResetSensorWrites();
+  adaptSensorProfile(NIGHT_ENTER_LUMA - 1);
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+  CHECK_EQ((int)hostCameraStats().sensorWrites, rowDifference(SENSOR_DAY, SENSOR_NIGHT));
+
+  // bright frames at high gain are still night; at low gain it is day
+  s->set_reg(s, 0x100, 0xFF, 0x30);          // 4x
+  adaptSensorProfile(DAY_ENTER_LUMA + 20);
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+  s->set_reg(s, 0x100, 0xFF, 0x00);          // 1x
+  adaptSensorProfile(DAY_ENTER_LUMA - 1);
+  CHECK_EQ(activeSensorProfile, SENSOR_NIGHT);
+  adaptSensorProfile(DAY_ENTER_LUMA);
+  CHECK_EQ(activeSensorProfile, SENSOR_DAY);
+  CHECK_EQ(sensorProfileSwitches, switches + 2);
+
+  // an undecodable frame changes nothing
+  adaptSensorProfile(-1);
+  CHECK_EQ(activeSensorProfile, SENSOR_DAY);
+}
+
+int main() {
+  hostSerialQuiet(true);
+  hostUseManualClock(true);
+  cameraLock = xSemaphoreCreateMutex();
+
+  testInit();
+  testSwitching();
+  testCommand();
+  testDayNight();
+  finish("test_sensor_profile");
+}
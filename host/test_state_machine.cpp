@@ -0,0 +1,298 @@
+// Button / capture state machine on a manual clock: the test drives GPIO 13
+// through the real buttonISR(), pumps appEvents into handleAppEvent() and
+// runs runAppTimers() once per millisecond, the way loop() does. The capture
+// and network tasks are played by the test, which answers requests on
+// captureRequests with the events those tasks would post.
+#include "sketch.cpp"
+#include "host.h"
+#include "check.h"
+#include <string>
+
+static void pump(unsigned long ms) {
+  for (unsigned long i = 0; i < ms; i++) {
+    hostAdvanceMs(1);
+    AppEvent event;
+    while (xQueueReceive(appEvents, &event, 0) == pdTRUE) handleAppEvent(event);
+    runAppTimers(millis());
+  }
+}
+
+// Top line of the newest message queued for the display task
+static std::string shown() {
+  DisplayMessage msg;
+  if (xQueuePeek(displayQueue, &msg, 0) != pdTRUE) return "";
+  return msg.lines[0];
+}
+
+static std::string shownLine(int line) {
+  DisplayMessage msg;
+  if (xQueuePeek(displayQueue, &msg, 0) != pdTRUE) return "";
+  return msg.lines[line];
+}
+
+static int takeRequests(uint8_t* trigger = nullptr) {
+  CaptureRequest request;
+  int n = 0;
+  while (xQueueReceive(captureRequests, &request, 0) == pdTRUE) {
+    if (trigger) *trigger = request.trigger;
+    n++;
+  }
+  return n;
+}
+
+static void post(AppEventType type, const CaptureResult &result) {
+  AppEvent event = { (uint8_t)type, millis(), result };
+  xQueueSend(appEvents, &event, 0);
+}
+
+static void press() { hostSetPin(BUTTON_PIN, LOW); }
+static void release() { hostSetPin(BUTTON_PIN, HIGH); }
+
+// Back to idle with the button up and no cooldown running
+static void resetState() {
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  takeRequests();
+  appState = STATE_IDLE;
+  stateDeadlineActive = false;
+  lastCaptureTime = 0;
+  pump(CAPTURE_COOLDOWN);
+}
+
+static void testDebounce() {
+  resetState();
+
+  // a bouncing press: only the first edge reaches the queue, and the level
+  // is sampled once it has settled
+  unsigned long pressedAt = millis();
+  press();
+  pump(2);
+  release();
+  pump(2);
+  press();
+  pump(BUTTON_DEBOUNCE_MS - 5);
+  CHECK_EQ(appState, STATE_IDLE);
+  pump(5);
+  CHECK_EQ(appState, STATE_PRESSED);
+  CHECK_EQ(pressStartTime, pressedAt);
+  CHECK(shown() == "BUTTON PRESSED");
+
+  // a bouncing release captures exactly once
+  pump(200);
+  release();
+  pump(1);
+  press();
+  pump(1);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_CAPTURING);
+  uint8_t trigger = 0xff;
+  CHECK_EQ(takeRequests(&trigger), 1);
+  CHECK_EQ(trigger, TRIGGER_BUTTON);
+  CHECK(shown() == "CAPTURING...");
+
+  // a glitch shorter than the debounce time is no press at all
+  resetState();
+  press();
+  pump(5);
+  release();
+  pump(BUTTON_DEBOUNCE_MS * 3);
+  CHECK_EQ(appState, STATE_IDLE);
+  CHECK_EQ(takeRequests(), 0);
+  CHECK(!debouncePending);
+}
+
+static void testCaptureFlow() {
+  resetState();
+  press();
+  pump(100);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_CAPTURING);
+  CHECK_EQ(takeRequests(), 1);
+
+  // pressing while the capture runs does nothing
+  press();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_CAPTURING);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(takeRequests(), 0);
+
+  // the capture task hands the frame to the network task
+  CaptureResult result = {};
+  result.captured = true;
+  result.serverAttempted = true;
+  result.captureNumber = 7;
+  result.len = 40 * 1024;
+  post(EVT_UPLOAD_STARTED, result);
+  pump(1);
+  CHECK_EQ(appState, STATE_UPLOADING);
+  CHECK(shown() == "UPLOADING");
+  CHECK(shownLine(1) == "40 KB");
+  CHECK_EQ(lastCaptureTime, millis() - 1);
+
+  // a press while uploading is inside the cooldown: released, it goes back
+  // to idle without a capture
+  press();
+  pump(100);
+  CHECK_EQ(appState, STATE_PRESSED);
+  CHECK(pressSkipsCapture);
+  CHECK(shown() == "COOLDOWN ACTIVE");
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_IDLE);
+  CHECK_EQ(takeRequests(), 0);
+
+  // the network task reports; the result shows, then the idle screen
+  result.serverOk = true;
+  result.telegramBatched = true;
+  post(EVT_CAPTURE_DONE, result);
+  pump(1);
+  CHECK_EQ(appState, STATE_SHOW_RESULT);
+  CHECK(shown() == "TELEGRAM: BATCHED");
+  CHECK(shownLine(1) == "Plate #7");
+  CHECK(shownLine(2) == "Server: OK");
+  pump(RESULT_DISPLAY_TIME);
+  CHECK_EQ(appState, STATE_IDLE);
+
+  // past the cooldown a press captures again
+  pump(CAPTURE_COOLDOWN);
+  press();
+  pump(100);
+  CHECK(!pressSkipsCapture);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_CAPTURING);
+  CHECK_EQ(takeRequests(), 1);
+}
+
+static void testFailuresAndRemote() {
+  // the camera failed: the error shows and the cooldown starts
+  resetState();
+  press();
+  pump(100);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(takeRequests(), 1);
+  CaptureResult failed = {};
+  post(EVT_CAPTURE_DONE, failed);
+  pump(1);
+  CHECK_EQ(appState, STATE_SHOW_RESULT);
+  CHECK(shown() == "CAPTURE FAILED");
+  CHECK_EQ(lastCaptureTime, millis() - 1);
+  pump(RESULT_DISPLAY_TIME);
+  CHECK_EQ(appState, STATE_IDLE);
+
+  // a duplicate is reported as such
+  resetState();
+  CaptureResult duplicate = {};
+  duplicate.captured = true;
+  duplicate.duplicateOf = 3;
+  post(EVT_CAPTURE_DONE, duplicate);
+  pump(1);
+  CHECK(shown() == "DUPLICATE");
+  CHECK(shownLine(1) == "Same as #3");
+
+  // a full capture queue turns the release into "busy"
+  resetState();
+  CaptureRequest filler = { TRIGGER_BURST, millis() };
+  while (xQueueSend(captureRequests, &filler, 0) == pdTRUE) {}
+  press();
+  pump(100);
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_SHOW_RESULT);
+  CHECK(shown() == "CAPTURE BUSY");
+  CHECK_EQ(takeRequests(), CAPTURE_REQUEST_QUEUE_LEN);
+
+  // a remote trigger from idle takes the screen but not the button
+  resetState();
+  CaptureResult remote = {};
+  remote.trigger = TRIGGER_TELEGRAM;
+  post(EVT_REMOTE_TRIGGER, remote);
+  pump(1);
+  CHECK_EQ(appState, STATE_IDLE);
+  CHECK(shown() == "REMOTE CAPTURE");
+  CHECK(shownLine(1) == "From Telegram");
+  // ...but not from under a press
+  press();
+  pump(100);
+  post(EVT_REMOTE_TRIGGER, remote);
+  pump(1);
+  CHECK_EQ(appState, STATE_PRESSED);
+  CHECK(shown() == "BUTTON PRESSED");
+}
+
+static void testLongPress() {
+  // released before the hold time, a long press is still a capture
+  resetState();
+  press();
+  pump(HOLD_MESSAGE_DELAY + 500);
+  CHECK_EQ(appState, STATE_PRESSED);
+  CHECK(shown() == "HOLD TO POWER OFF");
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_CAPTURING);
+  CHECK_EQ(takeRequests(), 1);
+
+  // held: the countdown refreshes every second, then the board powers off
+  resetState();
+  press();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  unsigned long heldFrom = pressStartTime;
+  pump(HOLD_MESSAGE_DELAY);
+  CHECK(shown() == "HOLD TO POWER OFF");
+  CHECK(shownLine(1) == "5 seconds...");
+  pump(1000);
+  CHECK(shownLine(1) == "4 seconds...");
+  pump(heldFrom + BUTTON_HOLD_TIME - millis() - 1);
+  CHECK_EQ(appState, STATE_PRESSED);
+  pump(1);
+  CHECK_EQ(appState, STATE_POWERING_OFF);
+  CHECK(shown() == "POWERING OFF...");
+
+  // releasing now no longer matters
+  release();
+  pump(BUTTON_DEBOUNCE_MS + 1);
+  CHECK_EQ(appState, STATE_POWERING_OFF);
+  CHECK_EQ(takeRequests(), 0);
+
+  bool slept = false;
+  try {
+    pump(POWER_OFF_MESSAGE_TIME);
+  } catch (const HostDeepSleep &) {
+    slept = true;
+  }
+  CHECK(slept);
+  CHECK(!hostInterruptAttached(BUTTON_PIN));
+  // the camera was shut down under its lock, which is kept, and nothing
+  // can queue another capture
+  CHECK(poweringOff);
+  CHECK(xSemaphoreTake(cameraLock, 0) != pdTRUE);
+  CHECK(!requestCapture(TRIGGER_TELEGRAM, 0));
+  CHECK_EQ(takeRequests(), 0);
+}
+
+int main() {
+  hostSerialQuiet(true);
+  hostUseManualClock(true);
+
+  // the event loop's queues and the button, without the tasks behind them;
+  // the display queue is read back instead of rendered
+  appEvents = xQueueCreate(APP_EVENT_QUEUE_LEN, sizeof(AppEvent));
+  captureRequests = xQueueCreate(CAPTURE_REQUEST_QUEUE_LEN, sizeof(CaptureRequest));
+  cameraLock = xSemaphoreCreateMutex();
+  displayQueue = xQueueCreate(1, sizeof(DisplayMessage));
+  displayFlushed = xSemaphoreCreateBinary();
+  displayAvailable = true;
+  initializePins();
+  buttonStable = buttonIsDown();
+  attachInterrupt(digitalPinToInterrupt(BUTTON_PIN), buttonISR, CHANGE);
+
+  testDebounce();
+  testCaptureFlow();
+  testFailuresAndRemote();
+  testLongPress();
+  finish("test_state_machine");
+}
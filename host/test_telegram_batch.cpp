@@ -0,0 +1,163 @@
+// Telegram batching against the Telegram stand-in: 12 photos, more than a
+// media group holds, are handed to the running telegramBatchTask under each
+// policy. Every request carries 1 photo (sendPhoto) or 2-10 (sendMediaGroup),
+// every photo is captioned with the camera, capture number and timestamp,
+// and latency-first sends the first photo at once where throughput-first
+// holds a short batch for TELEGRAM_BATCH_WINDOW.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+#include <string>
+
+static const int PHOTOS = 12;
+static std::vector<uint8_t> image;
+static uint32_t nextCapture = 1;
+
+static OfflineCapture* makeCapture() {
+  OfflineCapture* capture = new OfflineCapture();
+  capture->data = (uint8_t*)ps_malloc(image.size());
+  memcpy(capture->data, image.data(), image.size());
+  capture->queuedAt = millis();
+  OfflineRecordHeader &h = capture->header;
+  h.magic = OFFLINE_RECORD_MAGIC;
+  h.pending = OFFLINE_TO_TELEGRAM;
+  h.captureNumber = nextCapture++;
+  h.capturedAt = 1792238400 + h.captureNumber;   // set, so the sender leaves the timestamp alone
+  h.bootId = rtcBootCount;
+  snprintf(h.timestamp, sizeof(h.timestamp), "2026-10-17 12:00:%02u", (unsigned)h.captureNumber % 60);
+  h.imageLen = image.size();
+  return capture;
+}
+
+static void queuePhotos(int n) {
+  for (int i = 0; i < n; i++) {
+    OfflineCapture* capture = makeCapture();
+    xQueueSend(telegramBatchQueue, &capture, portMAX_DELAY);
+  }
+}
+
+static uint32_t photosSent(TelegramStandIn &telegram) {
+  std::lock_guard<std::mutex> hold(telegram.lock);
+  return telegram.photos;
+}
+
+// ms from start until the stand-in has taken `photos` in all, or -1
+static long waitForPhotos(TelegramStandIn &telegram, uint32_t photos, unsigned long start, unsigned long limitMs) {
+  while (photosSent(telegram) < photos) {
+    if (millis() - start > limitMs) return -1;
+    delay(5);
+  }
+  while (telegramBatchBusy) delay(1);
+  return (long)(millis() - start);
+}
+
+static void resetStandIn(TelegramStandIn &telegram) {
+  std::lock_guard<std::mutex> hold(telegram.lock);
+  telegram.photos = 0;
+  telegram.photoRequests = 0;
+  telegram.mediaGroups = 0;
+  telegram.requestPhotos.clear();
+  telegram.captions.clear();
+}
+
+// Every request within the Bot API's limits, every photo captioned
+// "CAM001 #<n> <timestamp>" in capture order
+static void checkRequests(TelegramStandIn &telegram, uint32_t firstCapture) {
+  std::lock_guard<std::mutex> hold(telegram.lock);
+  uint32_t total = 0, groups = 0;
+  for (uint32_t n : telegram.requestPhotos) {
+    CHECK(n == 1 || (n >= 2 && n <= TELEGRAM_BATCH_MAX));
+    groups += n > 1;
+    total += n;
+  }
+  CHECK_EQ(total, (uint32_t)PHOTOS);
+  CHECK_EQ(telegram.mediaGroups, groups);
+  CHECK_EQ(telegram.photoRequests, (uint32_t)telegram.requestPhotos.size());
+  CHECK_EQ(telegram.captions.size(), (size_t)PHOTOS);
+  for (size_t i = 0; i < telegram.captions.size(); i++) {
+    uint32_t capture = firstCapture + i;
+    char expected[64];
+    snprintf(expected, sizeof(expected), "%s #%u 2026-10-17 12:00:%02u", CAMERA_ID, (unsigned)capture,
+             (unsigned)capture % 60);
+    CHECK(telegram.captions[i] == expected);
+  }
+}
+
+int main() {
+  hostSerialQuiet(true);
+  HostSceneSpec spec;
+  spec.width = 320;
+  spec.height = 240;
+  image = hostRenderScene(spec);
+
+  HostRig rig;
+  TelegramStandIn &telegram = rig.telegram;
+  hostRoute(telegramHost, httpsPort, &telegram);
+  // a request takes a few hundred ms, so photos queue up behind it
+  hostSetLink({ 100, 2000, 0 });
+  initializeConnections();
+  initializeTelegramBatching();
+  CHECK(telegramBatchQueue != NULL);
+
+  // latency-first: the first photo goes out alone straight away; the rest,
+  // queued while it is on the wire, follow as the batches the API takes
+  telegramBatchPolicy = BATCH_LATENCY_FIRST;
+  resetStandIn(telegram);
+  uint32_t first = nextCapture;
+  unsigned long start = millis();
+  queuePhotos(1);
+  while (!telegramBatchBusy) delay(1);
+  delay(50);   // past the non-blocking collect, well inside the request
+  queuePhotos(PHOTOS - 1);
+  long took = waitForPhotos(telegram, PHOTOS, start, 20000);
+  CHECK(took >= 0);
+  checkRequests(telegram, first);
+  {
+    std::lock_guard<std::mutex> hold(telegram.lock);
+    // the queue holds TELEGRAM_BATCH_MAX, the last one waits its turn
+    std::vector<uint32_t> expected = { 1, TELEGRAM_BATCH_MAX, PHOTOS - 1 - TELEGRAM_BATCH_MAX };
+    CHECK(telegram.requestPhotos == expected);
+    CHECK_EQ(telegram.mediaGroups, 1u);
+  }
+  CHECK(took < TELEGRAM_BATCH_WINDOW);
+  printf("latency-first: %u photos in %u requests (%u media groups), %ld ms\n", photosSent(telegram),
+         telegram.photoRequests, telegram.mediaGroups, took);
+
+  // a lone photo is not held back
+  resetStandIn(telegram);
+  start = millis();
+  queuePhotos(1);
+  took = waitForPhotos(telegram, 1, start, 20000);
+  CHECK(took >= 0 && took < TELEGRAM_BATCH_WINDOW / 2);
+
+  // throughput-first: a full group goes at once, the two left over wait
+  // out the window for company that does not come
+  telegramBatchPolicy = BATCH_THROUGHPUT_FIRST;
+  resetStandIn(telegram);
+  first = nextCapture;
+  start = millis();
+  queuePhotos(PHOTOS);
+  took = waitForPhotos(telegram, PHOTOS, start, 20000);
+  CHECK(took >= TELEGRAM_BATCH_WINDOW);
+  checkRequests(telegram, first);
+  {
+    std::lock_guard<std::mutex> hold(telegram.lock);
+    CHECK_EQ(telegram.requestPhotos.size(), (size_t)2);
+    if (telegram.requestPhotos.size() == 2) {
+      CHECK_EQ(telegram.requestPhotos[0], (uint32_t)TELEGRAM_BATCH_MAX);
+      CHECK_EQ(telegram.requestPhotos[1], (uint32_t)(PHOTOS - TELEGRAM_BATCH_MAX));
+    }
+    CHECK_EQ(telegram.mediaGroups, 2u);
+  }
+  printf("throughput-first: %u photos in %u requests (%u media groups), %ld ms\n", photosSent(telegram),
+         telegram.photoRequests, telegram.mediaGroups, took);
+
+  // and a lone photo waits the whole window
+  resetStandIn(telegram);
+  start = millis();
+  queuePhotos(1);
+  took = waitForPhotos(telegram, 1, start, 20000);
+  CHECK(took >= TELEGRAM_BATCH_WINDOW);
+  finish("test_telegram_batch");
+}
@@ -0,0 +1,105 @@
+// The connection manager against a real TLS endpoint on 127.0.0.1: one
+// handshake carries every upload while the server keeps the socket open, a
+// "Connection: close" or an idle socket costs exactly one new handshake,
+// and no reconnect is a resumed session (start_ssl_client() cannot take
+// one), so each is a full handshake the device pays for. The Telegram
+// poll only opens its own session with heap to spare.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+
+static size_t scene = 0;
+
+// One capture of a scene the camera has not seen yet
+static bool upload() {
+  hostCameraSelect(scene++);
+  CaptureResult result = runCapture();
+  return result.captured && result.serverOk && result.duplicateOf == 0;
+}
+
+static void testKeepAlive(HostRig &rig, HostTlsServer &tls) {
+  for (int i = 0; i < 8; i++) CHECK(upload());
+  CHECK_EQ(rig.railway.images, 8u);
+  CHECK_EQ(tls.handshakes(), 1u);
+  CHECK_EQ(serverConn.handshakes, 1u);
+  CHECK_EQ(serverConn.handshakeFailures, 0u);
+  CHECK_EQ(serverConn.reuses + serverConn.handshakes, rig.railway.requests.load());
+}
+
+static void testServerClose(HostRig &rig, HostTlsServer &tls) {
+  // every third request is answered with Connection: close; the next one
+  // opens a new socket and nothing is lost
+  rig.railway.closeEvery = 3;
+  uint32_t requests = rig.railway.requests;
+  uint32_t handshakes = tls.handshakes();
+  for (int i = 0; i < 6; i++) CHECK(upload());
+  uint32_t closes = rig.railway.requests / 3 - requests / 3;
+  CHECK(closes > 0);
+  CHECK(tls.handshakes() - handshakes >= closes - 1);
+  CHECK(tls.handshakes() - handshakes <= closes);
+  CHECK_EQ(serverConn.handshakes, tls.handshakes());
+  CHECK_EQ(rig.railway.connections.load(), tls.handshakes());
+  CHECK_EQ(rig.railway.images, 14u);
+  rig.railway.closeEvery = 0;
+}
+
+static void testIdle(HostRig &rig, HostTlsServer &tls) {
+  CHECK(upload());
+  uint32_t handshakes = tls.handshakes();
+  CHECK(upload());
+  CHECK_EQ(tls.handshakes(), handshakes);
+
+  // past the idle timeout the socket is assumed dropped server side
+  serverConn.lastUsed = millis() - KEEPALIVE_IDLE_TIMEOUT - 1;
+  CHECK(upload());
+  CHECK_EQ(tls.handshakes(), handshakes + 1);
+  CHECK(!serverConn.reused);
+  CHECK(upload());
+  CHECK(serverConn.reused);
+  CHECK_EQ(rig.railway.images, 18u);
+}
+
+// The poll's own TLS session only opens with room for it and one upload
+static size_t probeLargest = 0;
+static size_t probeSize() { return probeLargest; }
+
+static void testPollHeapBudget() {
+  static const HostHeapProbe probe = { probeSize, probeSize, probeSize };
+  hostSetHeapProbe(&probe);
+  uint32_t skips = telegramPollHeapSkips;
+  probeLargest = TELEGRAM_POLL_MIN_BLOCK - 1;
+  CHECK(!telegramPollHeapOk());
+  CHECK_EQ(telegramPollHeapSkips, skips + 1);
+  probeLargest = TELEGRAM_POLL_MIN_BLOCK;
+  CHECK(telegramPollHeapOk());
+  CHECK(!telegramPollHeapLow);
+  hostSetHeapProbe(nullptr);
+}
+
+int main() {
+  hostSerialQuiet(true);
+  std::vector<std::vector<uint8_t>> frames;
+  for (uint32_t seed = 1; seed <= 24; seed++) {
+    HostSceneSpec spec;
+    spec.width = 320;
+    spec.height = 240;
+    spec.seed = seed * 104729;
+    spec.carX = 0.2f + 0.025f * seed;
+    spec.carShade = (uint8_t)(30 + seed * 7);
+    frames.push_back(hostRenderScene(spec));
+  }
+  hostCameraSetFrames(frames);
+
+  HostRig rig;
+  HostTlsServer tls(rig.railway);
+  startPipeline(rig);
+  hostRouteTls(serverHost, httpsPort, tls.port());
+
+  testKeepAlive(rig, tls);
+  testServerClose(rig, tls);
+  testIdle(rig, tls);
+  testPollHeapBudget();
+  CHECK_EQ(tls.resumedSessions(), 0u);
+  finish("test_tls_connection");
+}
@@ -0,0 +1,97 @@
+// Adaptive quality's uplink estimate: throughput comes from the uploads
+// that were timed, and the bytes a profile sends per dispatch are learned
+// from both photos, the Telegram one also when it went into a batch (its
+// image is its share of the media group). Then the whole pipeline, with
+// batching on, has to learn them.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+
+static void resetEstimate() {
+  uplinkBytesPerMs = 0;
+  uplinkSamples = 0;
+  for (size_t &bytes : profileSentBytes) bytes = 0;
+}
+
+static SharedFrame served(size_t serverBytes, unsigned long serverTime) {
+  SharedFrame frame = {};
+  frame.len = 40000;
+  frame.serverOk = true;
+  frame.serverBytes = serverBytes;
+  frame.serverTime = serverTime;
+  return frame;
+}
+
+static void testSamples() {
+  resetEstimate();
+  // both uploads timed: both count for throughput and size
+  SharedFrame both = served(30000, 1000 + UPLOAD_OVERHEAD_MS);
+  both.telegramOk = true;
+  both.telegramBytes = 30000;
+  both.telegramTime = 800 + UPLOAD_OVERHEAD_MS;
+  recordUplinkSample(&both, false);
+  CHECK_EQ(uplinkSamples, 1u);
+  CHECK_EQ(profileSentBytes[0], 60000u);
+  CHECK(uplinkBytesPerMs > 59.9f && uplinkBytesPerMs < 60.1f);
+
+  // batched: throughput from the server upload alone, size with the photo
+  resetEstimate();
+  SharedFrame batched = served(30000, 1000 + UPLOAD_OVERHEAD_MS);
+  recordUplinkSample(&batched, true);
+  CHECK_EQ(uplinkSamples, 1u);
+  CHECK(uplinkBytesPerMs > 29.9f && uplinkBytesPerMs < 30.1f);
+  CHECK_EQ(profileSentBytes[0], 30000u + 40000u);
+
+  // a cropped frame batches the crop
+  resetEstimate();
+  uint8_t crop[1];
+  SharedFrame cropped = served(12000, 500 + UPLOAD_OVERHEAD_MS);
+  cropped.cropBuf = crop;
+  cropped.cropLen = 12000;
+  recordUplinkSample(&cropped, true);
+  CHECK_EQ(profileSentBytes[0], 24000u);
+
+  // half a dispatch says nothing about a profile's size
+  resetEstimate();
+  SharedFrame lost = served(30000, 1000 + UPLOAD_OVERHEAD_MS);
+  recordUplinkSample(&lost, false);
+  CHECK_EQ(uplinkSamples, 1u);
+  CHECK_EQ(profileSentBytes[0], 0u);
+  lost.serverOk = false;
+  recordUplinkSample(&lost, true);
+  CHECK_EQ(profileSentBytes[0], 0u);
+}
+
+static void testPipeline() {
+  std::vector<std::vector<uint8_t>> frames;
+  for (uint32_t seed = 1; seed <= 6; seed++) {
+    HostSceneSpec spec;
+    spec.width = 320;
+    spec.height = 240;
+    spec.seed = seed * 7919;
+    spec.carX = 0.3f + 0.05f * seed;
+    frames.push_back(hostRenderScene(spec));
+  }
+  hostCameraSetFrames(frames);
+  hostSetLink({ 50, 200, 0 });   // slow enough that uploads outlast UPLOAD_OVERHEAD_MS
+
+  resetEstimate();
+  HostRig rig;
+  startPipeline(rig);
+  for (size_t i = 0; i < frames.size(); i++) {
+    hostCameraSelect(i);
+    CaptureResult result = runCapture();
+    CHECK(result.serverOk);
+    CHECK(result.telegramBatched);
+  }
+  CHECK(uplinkSamples > 0);
+  CHECK(profileSentBytes[activeProfile] > 0);
+}
+
+int main() {
+  hostSerialQuiet(true);
+  testSamples();
+  if (TELEGRAM_BATCHING) testPipeline();
+  finish("test_uplink_estimate");
+}
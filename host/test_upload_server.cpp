@@ -0,0 +1,65 @@
+// Resumable uploads against server/upload_server.py itself, the reference
+// server the Railway stand-in follows: the script runs on a local port
+// with --drop-rate cutting bodies off part-way, and every upload still
+// arrives whole from the offsets it kept.
+#include "sketch.cpp"
+#include "host.h"
+#include "rig.h"
+#include "check.h"
+#include <fstream>
+#include <iterator>
+
+static const int UPLOADS = 6;
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void run(const char* python, const char* script) {
+  HostSceneSpec spec;
+  spec.width = 800;
+  spec.height = 600;
+  std::vector<uint8_t> image = hostRenderScene(spec);
+  // more than a chunk, so a drop can land before the last one
+  CHECK(image.size() > UPLOAD_CHUNK_SIZE);
+
+  HostScriptServer server(python, script, { "--drop-rate", "0.3", "--seed", "7" });
+  CHECK(server.ready());
+  if (!server.ready()) return;
+  hostRouteTls(serverHost, httpsPort, server.port());
+  initializeConnections();
+
+  memset(&metricCounters, 0, sizeof(metricCounters));
+  CHECK(resumableServer);
+  for (int i = 0; i < UPLOADS; i++) {
+    CHECK(uploadImageToServer(image.data(), image.size(), "2026-10-17 12:00:00", NULL, 0));
+  }
+  // the script answered every PATCH, so the sketch never fell back to POST
+  CHECK(resumableServer);
+  CHECK(metricCounters.uploadRetries > 0);
+  // resuming from the stored offset sends at most the cut chunk's tail
+  // again, bytes that were in the socket buffer when the link went; a
+  // plain POST would send the whole form
+  CHECK(metricCounters.resentBytes <= metricCounters.uploadRetries * UPLOAD_CHUNK_SIZE);
+
+  int images = 0;
+  for (const std::string &name : server.outFiles()) {
+    if (name.size() < 10 || name.compare(name.size() - 10, 10, "-image.jpg") != 0) continue;
+    images++;
+    CHECK(readFile(server.outDir() + "/" + name) == image);
+  }
+  CHECK_EQ(images, UPLOADS);
+  printf("upload_server.py: %d uploads, %u retries, %u B resent\n", UPLOADS, metricCounters.uploadRetries,
+         metricCounters.resentBytes);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("usage: test_upload_server <python3> <upload_server.py>\n");
+    return 2;
+  }
+  hostSerialQuiet(true);
+  run(argv[1], argv[2]);   // the script is stopped when run() returns
+  finish("test_upload_server");
+}
@@ -0,0 +1,285 @@
+#!/usr/bin/env python3
+"""Stand-in for the parts of the Telegram Bot API the sketch uses.
+
+  POST /bot<token>/sendPhoto        chat_id, photo, caption
+  POST /bot<token>/sendMediaGroup   chat_id, media (JSON), one part per photo
+  POST /bot<token>/sendMessage      chat_id, text
+  GET  /bot<token>/getUpdates       offset, limit, timeout (long-poll)
+
+Requests are checked the way Telegram checks them: a media group needs
+2-10 items, each "attach://<name>" has to match an uploaded part, and
+captions are limited to 1024 characters. Photos are saved with their
+caption in the file name, and the request/photo counts are printed after
+every upload, so batching policies can be compared by requests per photo.
+
+Lines typed on stdin become messages from --chat-id, e.g. "/capture".
+
+--fail-rate answers that fraction of uploads with a 429, like a rate-
+limited bot; --delay adds a fixed reply delay to mimic a slow link.
+host/test_mock_telegram.cpp runs the sketch's Telegram calls against it.
+
+  python3 mock_telegram.py --port 8443 --tls cert.pem key.pem [--fail-rate 0.1]
+
+To use it, set telegramHost to this machine, httpsPort to the port, and
+TELEGRAM_VERIFY_CERT to false. A self-signed pair works:
+  openssl req -x509 -newkey rsa:2048 -nodes -keyout key.pem -out cert.pem -subj /CN=test
+"""
+
+import argparse
+import json
+import os
+import random
+import re
+import ssl
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+from upload_server import parse_multipart
+
+MEDIA_GROUP_MIN = 2
+MEDIA_GROUP_MAX = 10
+CAPTION_MAX = 1024
+POLL_TIMEOUT_MAX = 50
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.requests = 0           # sendPhoto + sendMediaGroup
+        self.photos = 0
+        self.groups = 0
+
+    def add(self, photos, group):
+        with self.lock:
+            self.requests += 1
+            self.photos += photos
+            self.groups += group
+            print(f"  stats: {self.photos} photos in {self.requests} requests "
+                  f"({self.groups} media groups), {self.photos / self.requests:.1f} per request")
+
+
+class Updates:
+    """Queued incoming messages, handed out by getUpdates."""
+
+    def __init__(self):
+        self.cond = threading.Condition()
+        self.items = []
+        self.next_id = 1
+
+    def add_text(self, chat_id, text):
+        with self.cond:
+            self.items.append({
+                "update_id": self.next_id,
+                "message": {
+                    "message_id": self.next_id,
+                    "from": {"id": chat_id, "is_bot": False, "first_name": "Mock"},
+                    "chat": {"id": chat_id, "first_name": "Mock", "type": "private"},
+                    "date": int(time.time()),
+                    "text": text,
+                },
+            })
+            self.next_id += 1
+            self.cond.notify_all()
+
+    def get(self, offset, limit, timeout):
+        deadline = time.time() + timeout
+        with self.cond:
+            # an offset confirms every update before it
+            self.items = [u for u in self.items if u["update_id"] >= offset]
+            while not self.items and time.time() < deadline:
+                self.cond.wait(deadline - time.time())
+            return self.items[:limit]
+
+
+stats = Stats()
+updates = Updates()
+message_ids = iter(range(1, 1 << 31))
+message_ids_lock = threading.Lock()
+options = None
+
+
+def next_message(chat_id, **fields):
+    with message_ids_lock:
+        message_id = next(message_ids)
+    return dict({"message_id": message_id, "chat": {"id": chat_id, "type": "private"},
+                 "date": int(time.time())}, **fields)
+
+
+def save_photo(data, caption):
+    name = re.sub(r"[^A-Za-z0-9#_-]+", "_", caption or "photo").strip("_")
+    path = os.path.join(options.out, f"{time.strftime('%Y%m%d-%H%M%S')}-{random.randrange(1 << 16):04x}-{name}.jpg")
+    with open(path, "wb") as f:
+        f.write(data)
+    print(f"  photo {len(data)} B '{caption}' -> {path}")
+    return {"file_id": os.path.basename(path), "file_size": len(data), "width": 0, "height": 0}
+
+
+class ApiError(Exception):
+    def __init__(self, code, description):
+        super().__init__(description)
+        self.code = code
+        self.description = description
+
+
+def field_text(fields, name):
+    if name not in fields:
+        raise ApiError(400, f"Bad Request: {name} is empty")
+    return fields[name][1].decode(errors="replace")
+
+
+def check_chat(fields):
+    chat_id = field_text(fields, "chat_id")
+    if chat_id != str(options.chat_id):
+        raise ApiError(400, "Bad Request: chat not found")
+    return options.chat_id
+
+
+def check_caption(caption):
+    if caption is not None and len(caption) > CAPTION_MAX:
+        raise ApiError(400, "Bad Request: message caption is too long")
+
+
+def send_photo(fields):
+    chat_id = check_chat(fields)
+    if "photo" not in fields or fields["photo"][0] is None:
+        raise ApiError(400, "Bad Request: there is no photo in the request")
+    caption = fields["caption"][1].decode() if "caption" in fields else None
+    check_caption(caption)
+    photo = save_photo(fields["photo"][1], caption)
+    stats.add(1, 0)
+    return next_message(chat_id, photo=[photo], caption=caption)
+
+
+def send_media_group(fields):
+    chat_id = check_chat(fields)
+    try:
+        media = json.loads(field_text(fields, "media"))
+    except json.JSONDecodeError:
+        raise ApiError(400, "Bad Request: can't parse media JSON object")
+    if not isinstance(media, list) or not MEDIA_GROUP_MIN <= len(media) <= MEDIA_GROUP_MAX:
+        raise ApiError(400, "Bad Request: media must include 2-10 items")
+
+    photos = []
+    for item in media:
+        ref = item.get("media", "")
+        if item.get("type") != "photo" or not ref.startswith("attach://"):
+            raise ApiError(400, "Bad Request: wrong media item")
+        part = fields.get(ref[len("attach://"):])
+        if part is None or part[0] is None:
+            raise ApiError(400, f"Bad Request: file {ref} not found in the request")
+        check_caption(item.get("caption"))
+        photos.append((part[1], item.get("caption")))
+
+    result = [next_message(chat_id, media_group_id="1", photo=[save_photo(data, caption)], caption=caption)
+              for data, caption in photos]
+    stats.add(len(photos), 1)
+    return result
+
+
+def send_message(fields):
+    chat_id = check_chat(fields)
+    text = field_text(fields, "text")
+    print(f"  message: {text}")
+    return next_message(chat_id, text=text)
+
+
+METHODS = {"sendPhoto": send_photo, "sendMediaGroup": send_media_group, "sendMessage": send_message}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        print(f"{self.address_string()} {fmt % args}")
+
+    def reply(self, code, payload):
+        # compact like the real API; the sketch scans for "ok":true
+        body = json.dumps(payload, separators=(",", ":")).encode()
+        if options.delay:
+            time.sleep(options.delay / 1000)
+        self.send_response(code)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+    def method(self):
+        match = re.fullmatch(r"/bot([^/]+)/(\w+)", urlparse(self.path).path)
+        if match is None or (options.token and match.group(1) != options.token):
+            self.reply(404, {"ok": False, "error_code": 404, "description": "Not Found"})
+            return None
+        return match.group(2)
+
+    def do_GET(self):
+        name = self.method()
+        if name is None:
+            return
+        if name != "getUpdates":
+            self.reply(404, {"ok": False, "error_code": 404, "description": "Not Found: method not found"})
+            return
+        query = parse_qs(urlparse(self.path).query)
+        offset = int(query.get("offset", ["0"])[0])
+        limit = int(query.get("limit", ["100"])[0])
+        timeout = min(int(query.get("timeout", ["0"])[0]), POLL_TIMEOUT_MAX)
+        self.reply(200, {"ok": True, "result": updates.get(offset, limit, timeout)})
+
+    def do_POST(self):
+        name = self.method()
+        if name is None:
+            return
+        body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+        handler = METHODS.get(name)
+        if handler is None:
+            self.reply(404, {"ok": False, "error_code": 404, "description": "Not Found: method not found"})
+            return
+        if name != "sendMessage" and random.random() < options.fail_rate:
+            print(f"  simulated 429 for {name}")
+            self.reply(429, {"ok": False, "error_code": 429, "description": "Too Many Requests: retry after 1",
+                             "parameters": {"retry_after": 1}})
+            return
+        try:
+            fields = parse_multipart(body, self.headers.get("Content-Type", ""))
+            self.reply(200, {"ok": True, "result": handler(fields)})
+        except ValueError:
+            self.reply(400, {"ok": False, "error_code": 400, "description": "Bad Request: not a multipart form"})
+        except ApiError as e:
+            print(f"  rejected {name}: {e.description}")
+            self.reply(e.code, {"ok": False, "error_code": e.code, "description": e.description})
+
+
+def read_commands():
+    for line in sys.stdin:
+        text = line.strip()
+        if text:
+            updates.add_text(options.chat_id, text)
+            print(f"  queued update '{text}'")
+
+
+def main():
+    global options
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--tls", nargs=2, metavar=("CERT", "KEY"))
+    parser.add_argument("--out", default="telegram", help="directory for received photos")
+    parser.add_argument("--chat-id", type=int, default=5765390339, help="the only chat the bot talks to")
+    parser.add_argument("--token", default="", help="require this bot token (any token if empty)")
+    parser.add_argument("--fail-rate", type=float, default=0.0, help="fraction of uploads answered with 429")
+    parser.add_argument("--delay", type=int, default=0, help="ms added before every reply")
+    options = parser.parse_args()
+    os.makedirs(options.out, exist_ok=True)
+
+    server = ThreadingHTTPServer(("", options.port), Handler)
+    if options.tls:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(*options.tls)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    threading.Thread(target=read_commands, daemon=True).start()
+    print(f"Listening on {options.port} ({'TLS' if options.tls else 'plain HTTP'}), chat {options.chat_id}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,262 @@
+#!/usr/bin/env python3
+"""Reference server for the ESP32-CAM uploads, for testing on Linux.
+
+Speaks both upload modes of the sketch:
+
+  POST /test                 multipart form (file, thumb, metrics, ...)
+  GET  /test                 reachability probe
+
+  PATCH /upload/<id>         one chunk of the same multipart form
+      Upload-Offset: <n>     where this chunk starts
+      Upload-Length: <total> size of the whole form
+      Upload-Chunk: <k>      chunk number, for the log only
+      Upload-Content-Type:   Content-Type of the assembled form
+    -> 204, Upload-Offset: <n + len>     chunk stored
+    -> 409, Upload-Offset: <stored>      offset mismatch, resend from there
+    -> 200, Upload-Offset: <total>       last chunk: the assembled form is
+                                         handled like POST /test
+  GET /upload/<id>
+    -> 200, Upload-Offset: <stored>      0 for an unknown ID; a finished
+                                         upload repeats its final reply
+
+Bytes of a chunk cut off by a dropped connection are kept, so the device
+only resends what never arrived.
+
+--drop-rate simulates a lossy link by cutting that fraction of chunk and
+form bodies off part-way, --seed makes the drops repeat from run to run.
+Received vs. delivered bytes are printed after every completed upload.
+host/test_upload_server.cpp runs the sketch's uploads against it.
+
+  python3 upload_server.py --port 8080 [--tls cert.pem key.pem] [--drop-rate 0.2] [--seed 1]
+
+The sketch talks TLS with setInsecure(), so any self-signed pair works:
+  openssl req -x509 -newkey rsa:2048 -nodes -keyout key.pem -out cert.pem -subj /CN=test
+"""
+
+import argparse
+import json
+import os
+import random
+import socket
+import ssl
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+READ_SIZE = 4096
+DONE_KEEP_SECONDS = 600         # finished uploads answer GET this long
+
+
+class UploadState:
+    def __init__(self, length, content_type):
+        self.length = length
+        self.content_type = content_type
+        self.data = bytearray()
+        self.reply = None           # final reply once complete
+        self.finished_at = 0.0
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.received = 0           # body bytes read off the wire
+        self.delivered = 0          # bytes of completed forms
+        self.uploads = 0
+
+    def add_received(self, n):
+        with self.lock:
+            self.received += n
+
+    def add_upload(self, n):
+        with self.lock:
+            self.uploads += 1
+            self.delivered += n
+            resent = self.received - self.delivered
+            print(f"  stats: {self.uploads} uploads, {self.delivered} B delivered, "
+                  f"{self.received} B received, {resent / self.uploads:.0f} B resent per upload")
+
+
+uploads = {}
+uploads_lock = threading.Lock()
+stats = Stats()
+options = None
+
+
+def parse_multipart(body, content_type):
+    """Returns {name: (filename, bytes)} for a multipart/form-data body."""
+    boundary = None
+    for item in content_type.split(";"):
+        key, _, value = item.strip().partition("=")
+        if key.lower() == "boundary":
+            boundary = value.strip('"').encode()
+    if boundary is None:
+        raise ValueError("no boundary")
+
+    fields = {}
+    for part in body.split(b"--" + boundary)[1:]:
+        if part.startswith(b"--"):
+            break
+        head, _, data = part[2:].partition(b"\r\n\r\n")
+        name = filename = None
+        for line in head.decode(errors="replace").split("\r\n"):
+            if line.lower().startswith("content-disposition:"):
+                for item in line.split(";")[1:]:
+                    key, _, value = item.strip().partition("=")
+                    if key == "name":
+                        name = value.strip('"')
+                    elif key == "filename":
+                        filename = value.strip('"')
+        if name is not None:
+            fields[name] = (filename, data[:-2] if data.endswith(b"\r\n") else data)
+    return fields
+
+
+def handle_form(body, content_type):
+    """Stores the files of one upload form, returns the JSON reply."""
+    fields = parse_multipart(body, content_type)
+    stamp = time.strftime("%Y%m%d-%H%M%S")
+    saved = []
+    for name, (filename, data) in fields.items():
+        if filename is None:
+            print(f"  {name} = {data.decode(errors='replace')}")
+            continue
+        path = os.path.join(options.out, f"{stamp}-{random.randrange(1 << 16):04x}-{filename}")
+        with open(path, "wb") as f:
+            f.write(data)
+        saved.append(path)
+        print(f"  saved {name}: {path} ({len(data)} B)")
+    stats.add_upload(len(body))
+    return {"status": "ok", "saved": saved}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def log_message(self, fmt, *args):
+        print(f"{self.address_string()} {fmt % args}")
+
+    def reply(self, code, body=b"", headers=None):
+        self.send_response(code)
+        for key, value in (headers or {}).items():
+            self.send_header(key, str(value))
+        if code != 204:
+            self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        if body and code != 204:
+            self.wfile.write(body)
+
+    def read_body(self, length, sink):
+        """Reads up to length bytes into sink; False if the link was 'cut'."""
+        cut = length
+        if length > 0 and random.random() < options.drop_rate:
+            cut = random.randrange(length)
+
+        done = 0
+        while done < cut:
+            data = self.rfile.read(min(READ_SIZE, cut - done))
+            if not data:
+                return False
+            sink += data
+            stats.add_received(len(data))
+            done += len(data)
+
+        if done < length:
+            print(f"  simulated drop after {done} of {length} B")
+            self.close_connection = True
+            try:
+                self.connection.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            return False
+        return True
+
+    def upload_id(self):
+        return self.path[len("/upload/"):].split("?")[0]
+
+    def do_GET(self):
+        if self.path == "/test":
+            self.reply(200, b"OK\n", {"Content-Type": "text/plain"})
+        elif self.path.startswith("/upload/"):
+            with uploads_lock:
+                state = uploads.get(self.upload_id())
+            if state is None:
+                self.reply(200, b"", {"Upload-Offset": 0})
+            elif state.reply is not None:
+                self.reply(200, state.reply, {"Upload-Offset": state.length, "Content-Type": "application/json"})
+            else:
+                self.reply(200, b"", {"Upload-Offset": len(state.data)})
+        else:
+            self.reply(404)
+
+    def do_POST(self):
+        if self.path != "/test":
+            self.reply(404)
+            return
+        body = bytearray()
+        if not self.read_body(int(self.headers.get("Content-Length", 0)), body):
+            return
+        result = handle_form(bytes(body), self.headers.get("Content-Type", ""))
+        self.reply(200, json.dumps(result).encode(), {"Content-Type": "application/json"})
+
+    def do_PATCH(self):
+        if not self.path.startswith("/upload/"):
+            self.reply(404)
+            return
+        upload_id = self.upload_id()
+        offset = int(self.headers.get("Upload-Offset", -1))
+        total = int(self.headers.get("Upload-Length", -1))
+        length = int(self.headers.get("Content-Length", 0))
+
+        with uploads_lock:
+            now = time.time()
+            for key in [k for k, s in uploads.items() if s.reply is not None and now - s.finished_at > DONE_KEEP_SECONDS]:
+                del uploads[key]
+            state = uploads.setdefault(upload_id, UploadState(total, self.headers.get("Upload-Content-Type", "")))
+
+        if state.reply is not None or offset != len(state.data) or total != state.length:
+            # drain the body so the connection stays usable, then report where we are
+            self.rfile.read(length)
+            stored = state.length if state.reply is not None else len(state.data)
+            self.reply(409, b"", {"Upload-Offset": stored})
+            return
+
+        print(f"  {upload_id} chunk {self.headers.get('Upload-Chunk')}: {offset}+{length} of {total}")
+        complete = self.read_body(length, state.data)
+        if not complete:
+            return                  # what arrived is kept; the device resumes from it
+
+        if len(state.data) < state.length:
+            self.reply(204, b"", {"Upload-Offset": len(state.data)})
+            return
+
+        result = handle_form(bytes(state.data), state.content_type)
+        state.reply = json.dumps(result).encode()
+        state.finished_at = time.time()
+        state.data = bytearray()
+        self.reply(200, state.reply, {"Upload-Offset": state.length, "Content-Type": "application/json"})
+
+
+def main():
+    global options
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--tls", nargs=2, metavar=("CERT", "KEY"))
+    parser.add_argument("--out", default="uploads", help="directory for received images")
+    parser.add_argument("--drop-rate", type=float, default=0.0, help="fraction of bodies cut off part-way")
+    parser.add_argument("--seed", type=int, help="seed for the drops, for repeatable runs")
+    options = parser.parse_args()
+    if options.seed is not None:
+        random.seed(options.seed)
+    os.makedirs(options.out, exist_ok=True)
+
+    server = ThreadingHTTPServer(("", options.port), Handler)
+    if options.tls:
+        context = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        context.load_cert_chain(*options.tls)
+        server.socket = context.wrap_socket(server.socket, server_side=True)
+    print(f"Listening on {options.port} ({'TLS' if options.tls else 'plain HTTP'}), drop rate {options.drop_rate}")
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()